@@ -1,35 +1,59 @@
 const express = require("express");
-const fs = require("fs");
-const { exec } = require("child_process");
 const path = require("path");
+const { CompilePool } = require("./compile-pool");
+const { DiskCache } = require("./disk-cache");
 const app = express();
 
 
 const cors = require('cors');
 app.use(cors());
 
-app.use(express.json());
-app.use(express.static(path.join(__dirname, './frontend')));
-
+app.use(express.json({ limit: "4mb" }));
+// The compiler's .wasm is revalidated against its ETag on every load, not given an expiry:
+// a rebuilt module is picked up at once, and an unchanged one is served from the HTTP
+// cache, which is what lets the browser reuse the machine code it compiled last time.
+app.use(express.static(path.join(__dirname, './frontend'), {
+    setHeaders: (res, file) => {
+        if (file.endsWith(".wasm")) res.set("Cache-Control", "no-cache");
+    },
+}));
+
+// COMPILE_CACHE_DIR keeps llc output on disk across restarts, capped at COMPILE_CACHE_MB.
+const diskCache = process.env.COMPILE_CACHE_DIR
+    ? new DiskCache({
+        dir: process.env.COMPILE_CACHE_DIR,
+        maxBytes: (Number(process.env.COMPILE_CACHE_MB) || 512) * 1024 * 1024,
+    })
+    : null;
+
+const pool = new CompilePool({
+    concurrency: Number(process.env.COMPILE_WORKERS) || undefined,
+    maxQueue: Number(process.env.COMPILE_QUEUE) || undefined,
+    diskCache,
+});
 
-app.post("/compile-ir", (req, res) => {
-    const irCode = req.body.ir;
-    console.log("Received IR code:", irCode);
-    const inputPath = path.join(__dirname, "temp.ll");
-    const outputPath = path.join(__dirname, "temp.s");
 
-    fs.writeFileSync(inputPath, irCode);
+app.post("/compile-ir", async (req, res) => {
+    const irCode = req.body && req.body.ir;
+    if (typeof irCode !== "string" || !irCode) {
+        return res.status(400).json({ error: "request body must be JSON with a non-empty 'ir' string" });
+    }
 
-    exec(`llc ${inputPath} -o ${outputPath}`, (err, stdout, stderr) => {
-        if (err || stderr) {
-            console.error("llc error:", err);
-            res.status(500).json({ error: stderr || err.message });
-        } else {
-            const asmCode = fs.readFileSync(outputPath, "utf8");
-            console.log("Read assembly code, sending response");
-            res.json({ asm: asmCode });
+    try {
+        const asmCode = await pool.compile(irCode);
+        res.json({ asm: asmCode });
+    } catch (err) {
+        if (err.code === "QUEUE_FULL") {
+            res.set("Retry-After", "1");
+            return res.status(503).json({ error: err.message });
         }
-    });
+        console.error("llc error:", err.message);
+        res.status(500).json({ error: err.message });
+    }
+});
+
+app.get("/compile-ir/stats", (req, res) => {
+    res.json(pool.snapshot());
 });
 
 
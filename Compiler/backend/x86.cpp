@@ -0,0 +1,880 @@
+#include "x86.h"
+#include "../optimizer/optimizer.h"
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// -------------------- x86-64 backend --------------------
+// rax, rdx, r11 and xmm0, xmm15 are scratch for instruction patterns (division, return
+// values, constants, element indices, memory-to-memory moves). Only caller-saved registers
+// are handed out, so the prologue never has to preserve anything but rbp. Floats and
+// vectors share the xmm registers; an <8 x float> takes the whole ymm register.
+constexpr X86Reg allocatableGPRs[] = {X86Reg::RCX, X86Reg::RSI, X86Reg::RDI, X86Reg::R8, X86Reg::R9, X86Reg::R10};
+constexpr X86Reg allocatableXMMs[] = {X86Reg::XMM1, X86Reg::XMM2, X86Reg::XMM3, X86Reg::XMM4, X86Reg::XMM5,
+                                      X86Reg::XMM6, X86Reg::XMM7, X86Reg::XMM8, X86Reg::XMM9, X86Reg::XMM10,
+                                      X86Reg::XMM11, X86Reg::XMM12, X86Reg::XMM13, X86Reg::XMM14};
+// Where the System V calling convention passes the first integer and float arguments.
+constexpr X86Reg intArgumentRegs[] = {X86Reg::RDI, X86Reg::RSI, X86Reg::RDX, X86Reg::RCX, X86Reg::R8, X86Reg::R9};
+constexpr X86Reg floatArgumentRegs[] = {X86Reg::XMM0, X86Reg::XMM1, X86Reg::XMM2, X86Reg::XMM3,
+                                        X86Reg::XMM4, X86Reg::XMM5, X86Reg::XMM6, X86Reg::XMM7};
+
+int32_t floatBits(float f) {
+    int32_t bits;
+    std::memcpy(&bits, &f, sizeof bits);
+    return bits;
+}
+
+// Blocks are emitted in layout order, each under a label numbered by its block index. Phi
+// operands are copied into the phi's location at the end of each predecessor; a conditional
+// jump along an edge that needs such copies goes through a stub, numbered after the blocks,
+// that makes them and then jumps on.
+struct X86Selector {
+    struct Move {
+        X86Operand dst, src;
+        IRType type;
+    };
+    struct Stub {
+        int32_t label;
+        uint32_t target;
+        std::vector<Move> moves;
+    };
+
+    const IRFunction& fn;
+    X86Function out;
+    std::vector<X86Operand> location;  // per IR instruction, then per parameter: register or frame slot
+    std::vector<char> fused;           // compares that only set the flags for the branch after them
+    std::vector<uint32_t> layout;      // non-empty blocks, in order
+    std::vector<Stub> stubs;
+    int32_t frameSize = 0;
+
+    explicit X86Selector(const IRFunction& f)
+        : fn(f), location(f.insts.size() + f.params.size()), fused(f.insts.size() + f.params.size(), 0) {
+        out.name = f.name;
+    }
+
+    bool usedYMM = false;  // vzeroupper before returning, or SSE code after us runs slowly
+
+    // `bytes` below the last slot, aligned to `align`.
+    int32_t newSlot(int32_t bytes = 4, int32_t align = 4) {
+        frameSize = (frameSize + bytes + align - 1) / align * align;
+        return -frameSize;
+    }
+
+    // Vectors are spilled whole; arrays start on a 16-byte boundary.
+    static int32_t slotBytes(IRType type) { return type == IRType::V8Float ? 32 : type == IRType::V4I32 ? 16 : 4; }
+    static int32_t elementBytes(IRType type) { return type == IRType::I8 ? 1 : 4; }
+
+    void emit(X86Op op, uint8_t width, X86Operand dst = {}, X86Operand src = {}, X86Cond cond = X86Cond::E) {
+        out.code.push_back({op, width, dst, src, cond});
+    }
+
+    void shuffle(X86Op op, uint8_t width, X86Reg dst, X86Reg src, uint8_t imm = 0) {
+        emit(op, width, X86Operand::ofReg(dst), X86Operand::ofReg(src));
+        out.code.back().imm = imm;
+    }
+
+    static bool producesValue(const IRInst& inst) {
+        return inst.op == IROp::Load || isBinaryOp(inst.op) || inst.op == IROp::ICmp || inst.op == IROp::FCmp ||
+               inst.op == IROp::ZExt || inst.op == IROp::Phi || inst.op == IROp::InsertElement ||
+               inst.op == IROp::ShuffleVector || inst.op == IROp::ReduceAdd || inst.op == IROp::Call;
+    }
+
+    // Parameters are numbered after the instructions, so they take part in allocation like
+    // any other value.
+    uint32_t valueId(const IRValue& v) const {
+        if (v.kind == IRValue::Kind::Inst) return v.inst;
+        if (v.kind == IRValue::Kind::Arg) return static_cast<uint32_t>(fn.insts.size()) + v.inst;
+        return IRCFG::kNone;
+    }
+
+    IRType valueType(uint32_t id) const {
+        return id < fn.insts.size() ? fn.insts[id].type : fn.params[id - fn.insts.size()].type;
+    }
+
+    // The getelementptr behind an element address, or null for an alloca. Neither has code
+    // of its own: each load and store works the element's address out where it needs it.
+    const IRInst* elementOf(const IRValue& address) const {
+        if (address.kind != IRValue::Kind::Inst) return nullptr;
+        const IRInst* inst = &fn.insts[address.inst];
+        if (inst->op == IROp::Bitcast) inst = &fn.insts[inst->a.inst];
+        return inst->op == IROp::GEP ? inst : nullptr;
+    }
+
+    // Linear scan over live intervals in layout order. An interval runs from the first to the
+    // last position where the value must be kept: its definition, its uses, the blocks it is
+    // live through and, for a phi, the end of each predecessor, where it is written. An
+    // interval that ends at the instruction defining another value gives up its register
+    // first, so `x = op a, b` may land in the register of a or b; the patterns below allow
+    // for that. Parameters are defined at the top of the entry block. Every register is
+    // caller-saved, so a value live across a call goes straight to the stack.
+    void allocate() {
+        // One walk in layout order gives positions, block bounds, use counts, the values
+        // used outside their block and, provisionally, the allocation order.
+        const uint32_t count = static_cast<uint32_t>(fn.insts.size() + fn.params.size());
+        std::vector<uint32_t> blockOf(count, IRCFG::kNone), uses(count, 0);
+        std::vector<uint32_t> blockStart(fn.blocks.size(), 0), blockEnd(fn.blocks.size(), 0);
+        std::vector<uint32_t> start(count, UINT32_MAX), end(count, 0);
+        auto cover = [&](uint32_t id, uint32_t p) {
+            start[id] = std::min(start[id], p);
+            end[id] = std::max(end[id], p);
+        };
+        std::vector<std::pair<uint32_t, uint32_t>> liveInto;  // value, block it is used in
+        std::vector<uint32_t> order, phis, fusible, calls;
+        for (uint32_t id = static_cast<uint32_t>(fn.insts.size()); id < count; ++id) {
+            blockOf[id] = 0;
+            order.push_back(id);
+        }
+        uint32_t next = 1;  // position 0 is where the parameters arrive, all at once
+        for (uint32_t b = 0; b < fn.blocks.size(); ++b) {
+            uint32_t previous = IRCFG::kNone;
+            for (uint32_t id : fn.blocks[b].insts) {
+                const IRInst& inst = fn.insts[id];
+                if (inst.dead) continue;
+                if (previous == IRCFG::kNone) {
+                    layout.push_back(b);
+                    blockStart[b] = next;
+                }
+                uint32_t p = blockEnd[b] = next++;
+                blockOf[id] = b;
+                if (inst.op == IROp::Alloca && inst.b.kind == IRValue::Kind::Int) {
+                    location[id] = X86Operand::ofFrame(newSlot(inst.b.i * elementBytes(inst.type), 16));
+                } else if (inst.op == IROp::Alloca) {
+                    location[id] = X86Operand::ofFrame(newSlot());
+                } else if (producesValue(inst)) {
+                    order.push_back(id);
+                }
+                if (producesValue(inst)) cover(id, p);
+                if (inst.op == IROp::Call) calls.push_back(p);
+                if (inst.op == IROp::CondBr && inst.a.kind == IRValue::Kind::Inst && inst.a.inst == previous) {
+                    fusible.push_back(previous);
+                }
+                previous = id;
+                if (inst.op == IROp::Phi) {
+                    // Covered once every block's end is known.
+                    phis.push_back(id);
+                    for (const IRIncoming& in : inst.incoming) {
+                        if (valueId(in.value) != IRCFG::kNone) ++uses[valueId(in.value)];
+                    }
+                    continue;
+                }
+                forEachOperand(inst, [&](IRValue v) {
+                    // An element's index is read by the access, not by the getelementptr.
+                    if (const IRInst* gep = elementOf(v)) v = gep->b;
+                    uint32_t used = valueId(v);
+                    if (used == IRCFG::kNone) return;
+                    ++uses[used];
+                    cover(used, p);
+                    // A definition laid out further down is sorted out below.
+                    if (blockOf[used] != b) liveInto.push_back({used, b});
+                });
+            }
+        }
+
+        // oeq and une need two flags and are always materialized.
+        for (uint32_t cmp : fusible) {
+            const IRInst& inst = fn.insts[cmp];
+            bool twoFlags = inst.pred == IRPred::OEQ || inst.pred == IRPred::UNE;
+            if (uses[cmp] == 1 && (inst.op == IROp::ICmp || (inst.op == IROp::FCmp && !twoFlags))) fused[cmp] = 1;
+        }
+        if (!fusible.empty()) order.erase(std::remove_if(order.begin(), order.end(), [&](uint32_t id) { return fused[id]; }), order.end());
+
+        for (uint32_t id : phis) {
+            for (const IRIncoming& in : fn.insts[id].incoming) {
+                if (in.block >= fn.blocks.size() || fn.blocks[in.block].insts.empty()) continue;
+                cover(id, blockEnd[in.block]);
+                uint32_t v = valueId(in.value);
+                if (v == IRCFG::kNone || blockOf[v] == IRCFG::kNone) continue;
+                cover(v, blockEnd[in.block]);
+                if (blockOf[v] != in.block) liveInto.push_back({v, in.block});
+            }
+        }
+        // A value used in a block other than its own is live from the top of that block, and
+        // from the end of every block on the way back to its definition.
+        liveInto.erase(std::remove_if(liveInto.begin(), liveInto.end(),
+                                      [&](const std::pair<uint32_t, uint32_t>& use) {
+                                          return blockOf[use.first] == IRCFG::kNone || blockOf[use.first] == use.second;
+                                      }),
+                       liveInto.end());
+        if (!liveInto.empty()) {
+            IRCFG cfg(fn);
+            std::sort(liveInto.begin(), liveInto.end());
+            std::vector<uint32_t> seen(fn.blocks.size(), IRCFG::kNone), work;
+            for (auto [id, from] : liveInto) {
+                work.push_back(from);
+                while (!work.empty()) {
+                    uint32_t b = work.back();
+                    work.pop_back();
+                    if (seen[b] == id || b == blockOf[id]) continue;
+                    seen[b] = id;
+                    cover(id, blockStart[b]);
+                    for (uint32_t p : cfg.preds[b]) {
+                        cover(id, blockEnd[p]);
+                        work.push_back(p);
+                    }
+                }
+            }
+        }
+
+        // Parameters that are never read need no place at all.
+        for (uint32_t id = static_cast<uint32_t>(fn.insts.size()); id < count; ++id) {
+            if (uses[id]) cover(id, 0);
+        }
+        order.erase(std::remove_if(order.begin(), order.end(), [&](uint32_t id) { return start[id] == UINT32_MAX; }),
+                    order.end());
+
+        // Definitions already come in position order unless a phi's hull reaches back to a
+        // predecessor laid out above it.
+        auto byStart = [&](uint32_t a, uint32_t b) { return start[a] < start[b]; };
+        if (!std::is_sorted(order.begin(), order.end(), byStart)) std::stable_sort(order.begin(), order.end(), byStart);
+
+        std::vector<X86Reg> freeGPRs(std::rbegin(allocatableGPRs), std::rend(allocatableGPRs));
+        std::vector<X86Reg> freeXMMs(std::rbegin(allocatableXMMs), std::rend(allocatableXMMs));
+        std::vector<uint32_t> active;  // values currently in registers
+        // An fcmp has the type of its operands but yields an i1.
+        auto inXMM = [&](uint32_t id) {
+            IRType type = valueType(id);
+            bool fcmp = id < fn.insts.size() && fn.insts[id].op == IROp::FCmp;
+            return (elementType(type) == IRType::Float || type == IRType::V4I32) && !fcmp;
+        };
+        auto poolFor = [&](uint32_t id) -> std::vector<X86Reg>& { return inXMM(id) ? freeXMMs : freeGPRs; };
+        auto acrossCall = [&](uint32_t id) {
+            auto call = std::upper_bound(calls.begin(), calls.end(), start[id]);
+            return call != calls.end() && *call < end[id];
+        };
+
+        for (uint32_t id : order) {
+            if (acrossCall(id)) {
+                int32_t bytes = slotBytes(valueType(id));
+                location[id] = X86Operand::ofFrame(newSlot(bytes, bytes));
+                continue;
+            }
+            for (size_t i = 0; i < active.size();) {
+                if (end[active[i]] <= start[id]) {
+                    poolFor(active[i]).push_back(location[active[i]].reg);
+                    active[i] = active.back();
+                    active.pop_back();
+                } else {
+                    ++i;
+                }
+            }
+
+            std::vector<X86Reg>& pool = poolFor(id);
+            if (!pool.empty()) {
+                location[id] = X86Operand::ofReg(pool.back());
+                pool.pop_back();
+                active.push_back(id);
+                continue;
+            }
+            // No register left: whichever of this value and the active ones of its class
+            // lives longest goes to the stack.
+            uint32_t victim = id;
+            for (uint32_t other : active) {
+                if (inXMM(other) == inXMM(id) && end[other] > end[victim]) victim = other;
+            }
+            if (victim != id) {
+                location[id] = location[victim];
+                std::replace(active.begin(), active.end(), victim, id);
+            }
+            int32_t bytes = slotBytes(valueType(victim));
+            location[victim] = X86Operand::ofFrame(newSlot(bytes, bytes));
+        }
+    }
+
+    X86Operand operand(const IRValue& v, IRType type) {
+        switch (v.kind) {
+            case IRValue::Kind::Inst:
+            case IRValue::Kind::Arg:   return location[valueId(v)];
+            case IRValue::Kind::Int:   return X86Operand::ofImm(v.i);
+            case IRValue::Kind::Float: return X86Operand::ofImm(floatBits(v.f));
+            default:                   return X86Operand::ofImm(type == IRType::Float ? floatBits(0.0f) : 0);
+        }
+    }
+
+    static bool sameReg(const X86Operand& a, const X86Operand& b) {
+        return a.kind == X86Operand::Kind::Reg && b.kind == X86Operand::Kind::Reg && a.reg == b.reg;
+    }
+
+    static bool sameLocation(const X86Operand& a, const X86Operand& b) {
+        return sameReg(a, b) || (a.kind == X86Operand::Kind::Mem && b.kind == X86Operand::Kind::Mem && a.value == b.value);
+    }
+
+    // Moves an integer (width 4), float or vector value into register `reg`. A constant
+    // vector has the same value in every lane.
+    void load(X86Reg reg, const X86Operand& src, IRType type) {
+        X86Operand dst = X86Operand::ofReg(reg);
+        if (sameReg(dst, src)) return;
+        if (isVectorType(type)) {
+            bool ints = type == IRType::V4I32;
+            uint8_t width = ints ? 16 : 32;
+            if (src.kind == X86Operand::Kind::Reg) return emit(ints ? X86Op::MovDQA : X86Op::VMovAPS, width, dst, src);
+            if (src.kind == X86Operand::Kind::Mem) return emit(ints ? X86Op::MovDQU : X86Op::VMovUPS, width, dst, src);
+            if (src.value == 0) return emit(ints ? X86Op::PXor : X86Op::VXorPS, width, dst, dst);
+            emit(X86Op::Mov, 4, X86Operand::ofReg(X86Reg::R11), src);
+            emit(X86Op::MovD, 4, dst, X86Operand::ofReg(X86Reg::R11));
+            if (ints) return shuffle(X86Op::PShufD, 16, reg, reg, 0);
+            return shuffle(X86Op::VBroadcastSS, 32, reg, reg);
+        }
+        if (type != IRType::Float) return emit(X86Op::Mov, 4, dst, src);
+        if (src.kind == X86Operand::Kind::Imm) {
+            emit(X86Op::Mov, 4, X86Operand::ofReg(X86Reg::R11), src);
+            return emit(X86Op::MovD, 4, dst, X86Operand::ofReg(X86Reg::R11));
+        }
+        emit(X86Op::MovSS, 4, dst, src);
+    }
+
+    // Writes register `reg` to a value location.
+    void save(const X86Operand& dst, X86Reg reg, IRType type) {
+        X86Operand src = X86Operand::ofReg(reg);
+        if (sameReg(dst, src)) return;
+        if (isVectorType(type) && dst.kind == X86Operand::Kind::Reg) return load(dst.reg, src, type);
+        if (type == IRType::V4I32) return emit(X86Op::MovDQU, 16, dst, src);
+        if (type == IRType::V8Float) return emit(X86Op::VMovUPS, 32, dst, src);
+        emit(type == IRType::Float ? X86Op::MovSS : X86Op::Mov, 4, dst, src);
+    }
+
+    // Any location to any other, through r11 or xmm15 between two frame slots.
+    void move(const X86Operand& dst, const X86Operand& src, IRType type) {
+        if (dst.kind == X86Operand::Kind::Reg) return load(dst.reg, src, type);
+        if (src.kind == X86Operand::Kind::Reg) return save(dst, src.reg, type);
+        if (src.kind == X86Operand::Kind::Imm && !isVectorType(type)) return emit(X86Op::Mov, 4, dst, src);
+        X86Reg scratch = type == IRType::I32 || type == IRType::I8 || type == IRType::I1 ? X86Reg::R11 : X86Reg::XMM15;
+        load(scratch, src, type);
+        save(dst, scratch, type);
+    }
+
+    void binary(const IRInst& inst, uint32_t id) {
+        X86Operand dst = location[id];
+        X86Operand a = operand(inst.a, inst.type);
+        X86Operand b = operand(inst.b, inst.type);
+        bool isFloat = inst.type == IRType::Float;
+        if (isVectorType(inst.type)) return vectorBinary(inst, dst, a, b);
+
+        if (inst.op == IROp::SDiv) {
+            load(X86Reg::RAX, a, inst.type);
+            emit(X86Op::Cdq, 4);
+            if (b.kind == X86Operand::Kind::Imm) {
+                load(X86Reg::R11, b, inst.type);
+                b = X86Operand::ofReg(X86Reg::R11);
+            }
+            emit(X86Op::IDiv, 4, {}, b);
+            if (inst.type == IRType::I8) emit(X86Op::MovSX8, 4, X86Operand::ofReg(X86Reg::RAX), X86Operand::ofReg(X86Reg::RAX));
+            return save(dst, X86Reg::RAX, inst.type);
+        }
+
+        // Compute in the destination register unless it is spilled or holds b.
+        X86Reg scratch = isFloat ? X86Reg::XMM0 : X86Reg::RAX;
+        X86Reg target = dst.kind == X86Operand::Kind::Reg && !sameReg(dst, b) ? dst.reg : scratch;
+        load(target, a, inst.type);
+        if (isFloat && b.kind == X86Operand::Kind::Imm) {
+            load(X86Reg::XMM15, b, inst.type);
+            b = X86Operand::ofReg(X86Reg::XMM15);
+        }
+        X86Op op = X86Op::Add;
+        switch (inst.op) {
+            case IROp::Add:  op = X86Op::Add; break;
+            case IROp::Sub:  op = X86Op::Sub; break;
+            case IROp::Mul:  op = X86Op::IMul; break;
+            case IROp::FAdd: op = X86Op::AddSS; break;
+            case IROp::FSub: op = X86Op::SubSS; break;
+            case IROp::FMul: op = X86Op::MulSS; break;
+            case IROp::FDiv: op = X86Op::DivSS; break;
+            default: break;
+        }
+        emit(op, 4, X86Operand::ofReg(target), b);
+        // i8 values are kept sign-extended in 32-bit registers.
+        if (inst.type == IRType::I8) emit(X86Op::MovSX8, 4, X86Operand::ofReg(target), X86Operand::ofReg(target));
+        save(dst, target, inst.type);
+    }
+
+    // The same pattern on whole registers; constants and spilled operands go through xmm15.
+    void vectorBinary(const IRInst& inst, const X86Operand& dst, const X86Operand& a, X86Operand b) {
+        bool ints = inst.type == IRType::V4I32;
+        X86Reg target = dst.kind == X86Operand::Kind::Reg && !sameReg(dst, b) ? dst.reg : X86Reg::XMM0;
+        load(target, a, inst.type);
+        if (b.kind != X86Operand::Kind::Reg) {
+            load(X86Reg::XMM15, b, inst.type);
+            b = X86Operand::ofReg(X86Reg::XMM15);
+        }
+        X86Op op = X86Op::PAddD;
+        switch (inst.op) {
+            case IROp::Add:  op = X86Op::PAddD; break;
+            case IROp::Sub:  op = X86Op::PSubD; break;
+            case IROp::Mul:  op = X86Op::PMulLD; break;
+            case IROp::FAdd: op = X86Op::VAddPS; break;
+            case IROp::FSub: op = X86Op::VSubPS; break;
+            case IROp::FMul: op = X86Op::VMulPS; break;
+            case IROp::FDiv: op = X86Op::VDivPS; break;
+            default: break;
+        }
+        emit(op, ints ? 16 : 32, X86Operand::ofReg(target), b);
+        save(dst, target, inst.type);
+    }
+
+    // The memory operand of a load or store: an alloca's slot, or an element of an array.
+    // A constant index folds into the displacement; any other is read into r11 unless it
+    // is in a register already. Upper halves of 64-bit registers are always zero, since
+    // only 32-bit values are ever written to them, and an index in bounds is not negative.
+    X86Operand address(const IRValue& v) {
+        const IRInst* gep = elementOf(v);
+        if (!gep) return operand(v, IRType::I32);
+        int32_t base = location[gep->a.inst].value;
+        uint8_t scale = static_cast<uint8_t>(elementBytes(gep->type));
+        int64_t disp = base + static_cast<int64_t>(gep->b.i) * scale;
+        if (gep->b.kind == IRValue::Kind::Int && disp >= INT32_MIN && disp <= INT32_MAX) {
+            return X86Operand::ofFrame(static_cast<int32_t>(disp));
+        }
+        X86Operand index = operand(gep->b, IRType::I32);
+        if (index.kind != X86Operand::Kind::Reg) {
+            load(X86Reg::R11, index, IRType::I32);
+            index = X86Operand::ofReg(X86Reg::R11);
+        }
+        return X86Operand::ofElement(base, index.reg, scale);
+    }
+
+    // Sets the flags for `cmp` and returns the condition under which it holds. For oeq and
+    // une that is only half the answer: the parity flag says whether the operands were NaN.
+    X86Cond compare(const IRInst& cmp) {
+        X86Operand a = operand(cmp.a, cmp.type), b = operand(cmp.b, cmp.type);
+        if (cmp.op == IROp::FCmp) {
+            // ucomiss sets CF for "below" and for NaN alike, so a < b is tested as b > a.
+            bool swap = cmp.pred == IRPred::OLT || cmp.pred == IRPred::OLE;
+            if (swap) std::swap(a, b);
+            if (a.kind != X86Operand::Kind::Reg) {
+                load(X86Reg::XMM0, a, IRType::Float);
+                a = X86Operand::ofReg(X86Reg::XMM0);
+            }
+            if (b.kind == X86Operand::Kind::Imm) {
+                load(X86Reg::XMM15, b, IRType::Float);
+                b = X86Operand::ofReg(X86Reg::XMM15);
+            }
+            emit(X86Op::UComiSS, 4, a, b);
+            switch (cmp.pred) {
+                case IRPred::OGT:
+                case IRPred::OLT: return X86Cond::A;
+                case IRPred::OGE:
+                case IRPred::OLE: return X86Cond::AE;
+                case IRPred::OEQ: return X86Cond::E;
+                default:          return X86Cond::NE;
+            }
+        }
+        if (a.kind == X86Operand::Kind::Imm || (a.kind == X86Operand::Kind::Mem && b.kind == X86Operand::Kind::Mem)) {
+            load(X86Reg::RAX, a, cmp.type);
+            a = X86Operand::ofReg(X86Reg::RAX);
+        }
+        emit(X86Op::Cmp, 4, a, b);
+        switch (cmp.pred) {
+            case IRPred::EQ:  return X86Cond::E;
+            case IRPred::NE:  return X86Cond::NE;
+            case IRPred::SLT: return X86Cond::L;
+            case IRPred::SLE: return X86Cond::LE;
+            case IRPred::SGT: return X86Cond::G;
+            default:          return X86Cond::GE;
+        }
+    }
+
+    // A compare as a 0 or 1 value.
+    void materialize(const IRInst& cmp, uint32_t id) {
+        X86Operand eax = X86Operand::ofReg(X86Reg::RAX), r11 = X86Operand::ofReg(X86Reg::R11);
+        X86Cond cc = compare(cmp);
+        emit(X86Op::SetCC, 1, eax, {}, cc);
+        emit(X86Op::MovZX8, 4, eax, eax);
+        if (cmp.op == IROp::FCmp && (cmp.pred == IRPred::OEQ || cmp.pred == IRPred::UNE)) {
+            // NaN operands set PF: oeq also needs it clear, une holds whenever it is set.
+            bool equal = cmp.pred == IRPred::OEQ;
+            emit(X86Op::SetCC, 1, r11, {}, equal ? X86Cond::NP : X86Cond::P);
+            emit(X86Op::MovZX8, 4, r11, r11);
+            emit(equal ? X86Op::And : X86Op::Or, 4, eax, r11);
+        }
+        save(location[id], X86Reg::RAX, IRType::I32);
+    }
+
+    // The copies into `to`'s phis along the edge from `from`. Undef operands need none.
+    std::vector<Move> edgeMoves(uint32_t from, uint32_t to) {
+        std::vector<Move> moves;
+        for (uint32_t id : fn.blocks[to].insts) {
+            const IRInst& phi = fn.insts[id];
+            if (phi.dead) continue;
+            if (phi.op != IROp::Phi) break;
+            IRValue v = incomingFrom(phi, from);
+            if (v.kind == IRValue::Kind::None || v.kind == IRValue::Kind::Undef) continue;
+            X86Operand src = operand(v, phi.type);
+            if (!sameLocation(location[id], src)) moves.push_back({location[id], src, phi.type});
+        }
+        return moves;
+    }
+
+    // The copies of one edge happen at once: a copy waits while its destination is still to
+    // be read by another, and a cycle is broken by parking one destination in rax or, for
+    // floats, `parkXMM`. Argument registers include xmm0, so calls park in xmm15.
+    void parallelMove(std::vector<Move> moves, X86Reg parkXMM = X86Reg::XMM0) {
+        while (!moves.empty()) {
+            size_t ready = moves.size();
+            for (size_t i = 0; i < moves.size() && ready == moves.size(); ++i) {
+                bool read = false;
+                for (size_t j = 0; j < moves.size(); ++j) read = read || (j != i && sameLocation(moves[j].src, moves[i].dst));
+                if (!read) ready = i;
+            }
+            if (ready == moves.size()) {
+                ready = 0;
+                X86Operand blocked = moves[0].dst;
+                X86Operand park = X86Operand::ofReg(moves[0].type == IRType::Float ? parkXMM : X86Reg::RAX);
+                move(park, blocked, moves[0].type);
+                for (Move& m : moves) {
+                    if (sameLocation(m.src, blocked)) m.src = park;
+                }
+            }
+            move(moves[ready].dst, moves[ready].src, moves[ready].type);
+            moves.erase(moves.begin() + static_cast<std::ptrdiff_t>(ready));
+        }
+    }
+
+    // Takes the edge from -> to, falling through when `to` is the next block.
+    void jump(uint32_t from, uint32_t to, uint32_t next) {
+        parallelMove(edgeMoves(from, to));
+        if (to != next) emit(X86Op::Jmp, 8, X86Operand::ofLabel(static_cast<int32_t>(to)));
+    }
+
+    // Where a conditional jump along from -> to lands: the block itself, or a stub that makes
+    // the edge's phi copies first.
+    X86Operand edgeLabel(uint32_t from, uint32_t to) {
+        std::vector<Move> moves = edgeMoves(from, to);
+        if (moves.empty()) return X86Operand::ofLabel(static_cast<int32_t>(to));
+        int32_t label = static_cast<int32_t>(fn.blocks.size() + stubs.size());
+        stubs.push_back({label, to, std::move(moves)});
+        return X86Operand::ofLabel(label);
+    }
+
+    void conditionalBranch(const IRInst& br, uint32_t block, uint32_t next) {
+        uint32_t ifTrue = br.target[0], ifFalse = br.target[1];
+        X86Cond cc = X86Cond::NE;
+        if (br.a.kind != IRValue::Kind::Inst) {
+            bool taken = br.a.kind == IRValue::Kind::Int && br.a.i;
+            return jump(block, taken ? ifTrue : ifFalse, next);
+        }
+        if (fused[br.a.inst]) {
+            cc = compare(fn.insts[br.a.inst]);
+        } else {
+            X86Operand flag = location[br.a.inst];
+            if (flag.kind == X86Operand::Kind::Reg) emit(X86Op::Test, 4, flag, flag);
+            else emit(X86Op::Cmp, 4, flag, X86Operand::ofImm(0));
+        }
+        if (ifTrue == ifFalse) return jump(block, ifTrue, next);
+        // Fall through to the true successor when it comes next and needs no copies.
+        if (ifTrue == next && edgeMoves(block, ifTrue).empty()) {
+            std::swap(ifTrue, ifFalse);
+            cc = static_cast<X86Cond>(static_cast<uint8_t>(cc) ^ 1);
+        }
+        emit(X86Op::Jcc, 8, edgeLabel(block, ifTrue), {}, cc);
+        jump(block, ifFalse, next);
+    }
+
+    // Arguments go to their registers all at once, like the copies of an edge. Nothing but
+    // rbp survives the call in a register, which allocate() has already made sure of.
+    void call(const IRInst& inst, uint32_t id) {
+        std::vector<Move> moves;
+        size_t ints = 0, floats = 0;
+        for (const IRArgument& arg : inst.args) {
+            X86Reg reg = arg.type == IRType::Float ? floatArgumentRegs[floats++] : intArgumentRegs[ints++];
+            X86Operand src = operand(arg.value, arg.type);
+            if (!sameReg(X86Operand::ofReg(reg), src)) moves.push_back({X86Operand::ofReg(reg), src, arg.type});
+        }
+        parallelMove(std::move(moves), X86Reg::XMM15);
+        auto known = std::find(out.callees.begin(), out.callees.end(), inst.name);
+        if (known == out.callees.end()) known = out.callees.insert(known, inst.name);
+        if (usedYMM) emit(X86Op::VZeroUpper, 0);
+        emit(X86Op::Call, 8, X86Operand::ofLabel(static_cast<int32_t>(known - out.callees.begin())));
+        save(location[id], inst.type == IRType::Float ? X86Reg::XMM0 : X86Reg::RAX, inst.type);
+    }
+
+    // Parameters arrive in the argument registers and move to wherever allocate() put them.
+    void parameters() {
+        std::vector<Move> moves;
+        size_t ints = 0, floats = 0;
+        for (uint32_t k = 0; k < fn.params.size(); ++k) {
+            IRType type = fn.params[k].type;
+            X86Reg reg = type == IRType::Float ? floatArgumentRegs[floats++] : intArgumentRegs[ints++];
+            X86Operand dst = location[fn.insts.size() + k];
+            if (dst.kind != X86Operand::Kind::None && !sameReg(dst, X86Operand::ofReg(reg))) {
+                moves.push_back({dst, X86Operand::ofReg(reg), type});
+            }
+        }
+        parallelMove(std::move(moves), X86Reg::XMM15);
+    }
+
+    void select() {
+        allocate();
+        for (const IRInst& inst : fn.insts) usedYMM = usedYMM || (!inst.dead && inst.type == IRType::V8Float);
+        X86Operand rbp = X86Operand::ofReg(X86Reg::RBP), rsp = X86Operand::ofReg(X86Reg::RSP);
+        emit(X86Op::Push, 8, {}, rbp);
+        emit(X86Op::Mov, 8, rbp, rsp);
+        int32_t frame = out.frameBytes = (frameSize + 15) & ~15;
+        if (frame) emit(X86Op::Sub, 8, rsp, X86Operand::ofImm(frame));
+        parameters();
+
+        for (size_t k = 0; k < layout.size(); ++k) {
+            uint32_t b = layout[k];
+            uint32_t next = k + 1 < layout.size() ? layout[k + 1] : IRCFG::kNone;
+            // Nothing branches to the entry block.
+            if (k) emit(X86Op::Label, 0, X86Operand::ofLabel(static_cast<int32_t>(b)));
+            for (uint32_t id : fn.blocks[b].insts) {
+                const IRInst& inst = fn.insts[id];
+                if (inst.dead) continue;
+                bool inXMM = elementType(inst.type) == IRType::Float || inst.type == IRType::V4I32;
+                switch (inst.op) {
+                    case IROp::Alloca:
+                    case IROp::Phi:
+                    case IROp::GEP:
+                    case IROp::Bitcast:
+                        break;
+                    case IROp::Load: {
+                        X86Operand dst = location[id], slot = address(inst.a);
+                        X86Reg target = dst.kind == X86Operand::Kind::Reg ? dst.reg : inXMM ? X86Reg::XMM0 : X86Reg::RAX;
+                        if (inst.type == IRType::I8) emit(X86Op::MovSX8, 4, X86Operand::ofReg(target), slot);
+                        else load(target, slot, inst.type);
+                        save(dst, target, inst.type);
+                        break;
+                    }
+                    case IROp::Store: {
+                        // The value first: a constant vector needs r11, which may also carry the index.
+                        X86Operand value = operand(inst.a, inst.type);
+                        if (value.kind == X86Operand::Kind::Mem || (isVectorType(inst.type) && value.kind == X86Operand::Kind::Imm)) {
+                            X86Reg scratch = inXMM ? X86Reg::XMM0 : X86Reg::RAX;
+                            load(scratch, value, inst.type);
+                            value = X86Operand::ofReg(scratch);
+                        }
+                        X86Operand slot = address(inst.b);
+                        if (isVectorType(inst.type)) {
+                            save(slot, value.reg, inst.type);
+                            break;
+                        }
+                        uint8_t width = inst.type == IRType::I8 ? 1 : 4;
+                        emit(inst.type == IRType::Float && value.kind == X86Operand::Kind::Reg ? X86Op::MovSS : X86Op::Mov,
+                             width, slot, value);
+                        break;
+                    }
+                    case IROp::InsertElement: {
+                        // Only lane 0 matters: the shufflevector after it copies that everywhere.
+                        X86Operand dst = location[id], scalar = operand(inst.b, elementType(inst.type));
+                        X86Reg target = dst.kind == X86Operand::Kind::Reg ? dst.reg : X86Reg::XMM0;
+                        if (inst.type == IRType::V8Float) {
+                            load(target, scalar, IRType::Float);
+                        } else if (scalar.kind == X86Operand::Kind::Imm) {
+                            emit(X86Op::Mov, 4, X86Operand::ofReg(X86Reg::R11), scalar);
+                            emit(X86Op::MovD, 4, X86Operand::ofReg(target), X86Operand::ofReg(X86Reg::R11));
+                        } else {
+                            emit(X86Op::MovD, 4, X86Operand::ofReg(target), scalar);
+                        }
+                        save(dst, target, inst.type);
+                        break;
+                    }
+                    case IROp::ShuffleVector: {
+                        X86Operand dst = location[id];
+                        X86Reg target = dst.kind == X86Operand::Kind::Reg ? dst.reg : X86Reg::XMM0;
+                        X86Operand src = operand(inst.a, inst.type);
+                        if (src.kind != X86Operand::Kind::Reg) load(target, src, inst.type);
+                        X86Reg from = src.kind == X86Operand::Kind::Reg ? src.reg : target;
+                        // A constant is a splat already.
+                        if (src.kind != X86Operand::Kind::Imm) {
+                            if (inst.type == IRType::V4I32) shuffle(X86Op::PShufD, 16, target, from, 0);
+                            else shuffle(X86Op::VBroadcastSS, 32, target, from);
+                        }
+                        save(dst, target, inst.type);
+                        break;
+                    }
+                    case IROp::ReduceAdd: {
+                        // Halves, then pairs: lanes 2,3 onto 0,1, then lane 1 onto 0.
+                        X86Operand xmm0 = X86Operand::ofReg(X86Reg::XMM0), xmm15 = X86Operand::ofReg(X86Reg::XMM15);
+                        load(X86Reg::XMM0, operand(inst.a, IRType::V4I32), IRType::V4I32);
+                        shuffle(X86Op::PShufD, 16, X86Reg::XMM15, X86Reg::XMM0, 0x4E);
+                        emit(X86Op::PAddD, 16, xmm0, xmm15);
+                        shuffle(X86Op::PShufD, 16, X86Reg::XMM15, X86Reg::XMM0, 0xB1);
+                        emit(X86Op::PAddD, 16, xmm0, xmm15);
+                        emit(X86Op::MovD, 4, location[id], xmm0);
+                        break;
+                    }
+                    case IROp::Ret:
+                        if (inst.type == IRType::Float) load(X86Reg::XMM0, operand(inst.a, inst.type), inst.type);
+                        else if (inst.type != IRType::Void) load(X86Reg::RAX, operand(inst.a, inst.type), inst.type);
+                        if (usedYMM) emit(X86Op::VZeroUpper, 0);
+                        emit(X86Op::Mov, 8, rsp, rbp);
+                        emit(X86Op::Pop, 8, {}, rbp);
+                        emit(X86Op::Ret, 8);
+                        break;
+                    case IROp::ICmp:
+                    case IROp::FCmp:
+                        if (!fused[id]) materialize(inst, id);
+                        break;
+                    case IROp::ZExt: {
+                        // i1 values are already 0 or 1 in 32 bits.
+                        X86Operand dst = location[id];
+                        X86Reg target = dst.kind == X86Operand::Kind::Reg ? dst.reg : X86Reg::RAX;
+                        load(target, operand(inst.a, IRType::I1), IRType::I32);
+                        save(dst, target, IRType::I32);
+                        break;
+                    }
+                    case IROp::Br:
+                        jump(b, inst.target[0], next);
+                        break;
+                    case IROp::CondBr:
+                        conditionalBranch(inst, b, next);
+                        break;
+                    case IROp::Call:
+                        call(inst, id);
+                        break;
+                    default:
+                        binary(inst, id);
+                        break;
+                }
+            }
+        }
+        for (const Stub& stub : stubs) {
+            emit(X86Op::Label, 0, X86Operand::ofLabel(stub.label));
+            parallelMove(stub.moves);
+            emit(X86Op::Jmp, 8, X86Operand::ofLabel(static_cast<int32_t>(stub.target)));
+        }
+    }
+};
+
+X86Function selectX86(const IRFunction& fn) {
+    X86Selector selector(fn);
+    selector.select();
+    return std::move(selector.out);
+}
+
+const char* x86RegName(X86Reg reg, uint8_t width) {
+    static const char* const q[] = {"rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi",
+                                    "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15"};
+    static const char* const l[] = {"eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi",
+                                    "r8d", "r9d", "r10d", "r11d", "r12d", "r13d", "r14d", "r15d"};
+    static const char* const b[] = {"al", "cl", "dl", "bl", "spl", "bpl", "sil", "dil",
+                                    "r8b", "r9b", "r10b", "r11b", "r12b", "r13b", "r14b", "r15b"};
+    static const char* const x[] = {"xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7",
+                                    "xmm8", "xmm9", "xmm10", "xmm11", "xmm12", "xmm13", "xmm14", "xmm15"};
+    static const char* const y[] = {"ymm0", "ymm1", "ymm2", "ymm3", "ymm4", "ymm5", "ymm6", "ymm7",
+                                    "ymm8", "ymm9", "ymm10", "ymm11", "ymm12", "ymm13", "ymm14", "ymm15"};
+    unsigned n = static_cast<unsigned>(reg);
+    if (n >= 16) return width == 32 ? y[n - 16] : x[n - 16];
+    return width == 8 ? q[n] : width == 1 ? b[n] : l[n];
+}
+
+std::string formatX86Operand(const X86Operand& o, uint8_t width) {
+    switch (o.kind) {
+        case X86Operand::Kind::Reg: return std::string("%") + x86RegName(o.reg, width);
+        case X86Operand::Kind::Imm: return "$" + std::to_string(o.value);
+        case X86Operand::Kind::Mem:
+            if (o.index == X86Reg::RSP) return std::to_string(o.value) + "(%rbp)";
+            return std::to_string(o.value) + "(%rbp,%" + x86RegName(o.index, 8) + "," + std::to_string(o.scale) + ")";
+        case X86Operand::Kind::None:
+        case X86Operand::Kind::Label: break;
+    }
+    return "";
+}
+
+const char* x86CondName(X86Cond cond) {
+    static const char* const names[] = {"o", "no", "b", "ae", "e", "ne", "be", "a", "s", "ns", "p", "np", "l", "ge", "le", "g"};
+    return names[static_cast<uint8_t>(cond)];
+}
+
+// Labels are local to the file, so they carry the function name to stay unique across functions.
+std::string formatX86Inst(const X86Inst& inst, const X86Function& fn) {
+    const std::string& function = fn.name;
+    char suffix = inst.width == 8 ? 'q' : inst.width == 1 ? 'b' : 'l';
+    auto two = [&](const char* mnemonic, uint8_t srcWidth, uint8_t dstWidth) {
+        return std::string(mnemonic) + "\t" + formatX86Operand(inst.src, srcWidth) + ", " + formatX86Operand(inst.dst, dstWidth);
+    };
+    auto sized = [&](const char* base) { return std::string(base) + suffix; };
+    auto label = [&] { return ".L" + function + "_" + std::to_string(inst.dst.value); };
+    // dst = dst op src, spelled with the destination as both first source and result.
+    auto vex = [&](const char* mnemonic) { return two(mnemonic, 32, 32) + ", " + formatX86Operand(inst.dst, 32); };
+    switch (inst.op) {
+        case X86Op::Mov:    return two(sized("mov").c_str(), inst.width, inst.width);
+        case X86Op::MovSX8: return two("movsbl", 1, 4);
+        case X86Op::MovD:   return two("movd", 4, 4);
+        case X86Op::Add:    return two(sized("add").c_str(), inst.width, inst.width);
+        case X86Op::Sub:    return two(sized("sub").c_str(), inst.width, inst.width);
+        case X86Op::IMul:   return two(sized("imul").c_str(), inst.width, inst.width);
+        case X86Op::Cdq:    return "cltd";
+        case X86Op::IDiv:   return sized("idiv") + "\t" + formatX86Operand(inst.src, inst.width);
+        case X86Op::MovSS:  return two("movss", 4, 4);
+        case X86Op::AddSS:  return two("addss", 4, 4);
+        case X86Op::SubSS:  return two("subss", 4, 4);
+        case X86Op::MulSS:  return two("mulss", 4, 4);
+        case X86Op::DivSS:  return two("divss", 4, 4);
+        case X86Op::Push:   return "pushq\t" + formatX86Operand(inst.src, 8);
+        case X86Op::Pop:    return "popq\t" + formatX86Operand(inst.src, 8);
+        case X86Op::Ret:    return "retq";
+        case X86Op::Cmp:    return two(sized("cmp").c_str(), inst.width, inst.width);
+        case X86Op::Test:   return two(sized("test").c_str(), inst.width, inst.width);
+        case X86Op::UComiSS: return two("ucomiss", 4, 4);
+        case X86Op::SetCC:  return std::string("set") + x86CondName(inst.cond) + "\t" + formatX86Operand(inst.dst, 1);
+        case X86Op::MovZX8: return two("movzbl", 1, 4);
+        case X86Op::And:    return two(sized("and").c_str(), inst.width, inst.width);
+        case X86Op::Or:     return two(sized("or").c_str(), inst.width, inst.width);
+        case X86Op::Jmp:    return "jmp\t" + label();
+        case X86Op::Jcc:    return std::string("j") + x86CondName(inst.cond) + "\t" + label();
+        case X86Op::Label:  return label() + ":";
+        case X86Op::MovDQA: return two("movdqa", 16, 16);
+        case X86Op::MovDQU: return two("movdqu", 16, 16);
+        case X86Op::PAddD:  return two("paddd", 16, 16);
+        case X86Op::PSubD:  return two("psubd", 16, 16);
+        case X86Op::PMulLD: return two("pmulld", 16, 16);
+        case X86Op::PXor:   return two("pxor", 16, 16);
+        case X86Op::PShufD: return "pshufd\t$" + std::to_string(inst.imm) + ", " + two("", 16, 16).substr(1);
+        case X86Op::VMovAPS: return two("vmovaps", 32, 32);
+        case X86Op::VMovUPS: return two("vmovups", 32, 32);
+        case X86Op::VAddPS: return vex("vaddps");
+        case X86Op::VSubPS: return vex("vsubps");
+        case X86Op::VMulPS: return vex("vmulps");
+        case X86Op::VDivPS: return vex("vdivps");
+        case X86Op::VXorPS: return vex("vxorps");
+        case X86Op::VBroadcastSS: return two("vbroadcastss", 16, 32);
+        case X86Op::VZeroUpper: return "vzeroupper";
+        case X86Op::Call:   return "callq\t" + fn.callees[inst.dst.value];
+    }
+    return "";
+}
+
+std::string printX86Prologue() {
+    return "\t.text\n";
+}
+
+std::string printX86Function(const X86Function& fn) {
+    std::string out = "\t.globl\t" + fn.name + "\n";
+    out += "\t.p2align\t4, 0x90\n";
+    out += "\t.type\t" + fn.name + ",@function\n";
+    out += fn.name + ":\n";
+    for (const X86Inst& inst : fn.code) {
+        out += (inst.op == X86Op::Label ? "" : "\t") + formatX86Inst(inst, fn) + "\n";
+    }
+    out += "\t.size\t" + fn.name + ", .-" + fn.name + "\n";
+    return out;
+}
+
+std::string printX86Epilogue() {
+    return "\t.section\t\".note.GNU-stack\",\"\",@progbits\n";
+}
+
+std::string printX86(const std::vector<X86Function>& functions) {
+    std::string out = printX86Prologue();
+    for (const X86Function& fn : functions) out += printX86Function(fn);
+    return out + printX86Epilogue();
+}
+
+std::string compileToX86(const std::string& ir) {
+    IRModule module;
+    std::string error;
+    if (!parseIR(ir, module, error)) return "; error: " + error + "\n";
+    optimizeModule(module);
+    return lowerToX86(module);
+}
+
+std::string lowerToX86(const IRModule& module) {
+    std::vector<X86Function> functions;
+    std::string error;
+    for (const IRFunction& fn : module.functions) {
+        if (!checkIRFunction(fn, error)) return "; error: function @" + fn.name + ": " + error + "\n";
+        functions.push_back(selectX86(fn));
+    }
+    return printX86(functions);
+}
@@ -0,0 +1,118 @@
+// The native backend: instruction selection, register allocation and GNU assembler
+// output for x86-64.
+#pragma once
+
+#include "../ir/ir.h"
+
+// -------------------- x86-64 backend --------------------
+// Machine code for the IR above, as a list of already register-allocated instructions.
+// Register numbers are the hardware encodings; XMM registers follow the 16 GPRs and are
+// named as YMM registers in instructions of width 32.
+enum class X86Reg : uint8_t {
+    RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15,
+    XMM0, XMM1, XMM2, XMM3, XMM4, XMM5, XMM6, XMM7,
+    XMM8, XMM9, XMM10, XMM11, XMM12, XMM13, XMM14, XMM15
+};
+
+enum class X86Op : uint8_t {
+    Mov,     // dst = src, `width` bytes
+    MovSX8,  // dst (32-bit) = sign-extended byte src
+    MovD,    // between the low 32 bits of an xmm register and a 32-bit gpr or memory
+    Add,
+    Sub,
+    IMul,
+    Cdq,     // edx:eax = sign-extended eax
+    IDiv,    // eax = edx:eax / src
+    MovSS,
+    AddSS,
+    SubSS,
+    MulSS,
+    DivSS,
+    Push,
+    Pop,
+    Ret,
+    Cmp,      // flags = dst - src
+    Test,     // flags = dst & src
+    UComiSS,  // flags = unordered compare of xmm dst with src
+    SetCC,    // byte dst = `cond` ? 1 : 0
+    MovZX8,   // dst (32-bit) = zero-extended byte src
+    And,
+    Or,
+    Jmp,      // to label dst
+    Jcc,      // to label dst if `cond`
+    Label,    // dst names the position
+    // SSE on <4 x i32> (pmulld is SSE4.1). Memory operands of the arithmetic must be
+    // 16-byte aligned.
+    MovDQA,   // register to register
+    MovDQU,   // to or from memory
+    PAddD,
+    PSubD,
+    PMulLD,
+    PXor,
+    PShufD,   // dst = lanes of src in the order `imm` gives
+    // AVX on <8 x float>, in the destructive form dst = dst op src. vbroadcastss from a
+    // register needs AVX2.
+    VMovAPS,  // register to register
+    VMovUPS,  // to or from memory
+    VAddPS,
+    VSubPS,
+    VMulPS,
+    VDivPS,
+    VXorPS,
+    VBroadcastSS,  // every lane of ymm dst = the low float of xmm or memory src
+    VZeroUpper,
+    Call      // the function callees[dst.value]
+};
+
+// Condition codes in their hardware order, so jcc is 0x70 + cc and the inverse is cc ^ 1.
+enum class X86Cond : uint8_t { O, NO, B, AE, E, NE, BE, A, S, NS, P, NP, L, GE, LE, G };
+
+// A register, an immediate, a frame slot at disp(%rbp), an array element at
+// disp(%rbp,index,scale) or a label number.
+struct X86Operand {
+    enum class Kind : uint8_t { None, Reg, Imm, Mem, Label };
+    Kind kind = Kind::None;
+    X86Reg reg = X86Reg::RAX;
+    X86Reg index = X86Reg::RSP;  // RSP for none, as in the SIB byte
+    uint8_t scale = 1;
+    int32_t value = 0;  // immediate or displacement
+
+    static X86Operand ofReg(X86Reg r) { X86Operand o; o.kind = Kind::Reg; o.reg = r; return o; }
+    static X86Operand ofImm(int32_t v) { X86Operand o; o.kind = Kind::Imm; o.value = v; return o; }
+    static X86Operand ofFrame(int32_t disp) { X86Operand o; o.kind = Kind::Mem; o.reg = X86Reg::RBP; o.value = disp; return o; }
+    static X86Operand ofElement(int32_t disp, X86Reg index, uint8_t scale) {
+        X86Operand o = ofFrame(disp);
+        o.index = index;
+        o.scale = scale;
+        return o;
+    }
+    static X86Operand ofLabel(int32_t id) { X86Operand o; o.kind = Kind::Label; o.value = id; return o; }
+};
+
+struct X86Inst {
+    X86Op op;
+    uint8_t width;  // operand size in bytes: 1, 4 or 8; 16 or 32 for vectors
+    X86Operand dst, src;
+    X86Cond cond = X86Cond::E;  // setcc, jcc
+    uint8_t imm = 0;            // pshufd
+};
+
+struct X86Function {
+    std::string name;
+    std::vector<X86Inst> code;
+    int32_t frameBytes = 0;  // below rbp, rounded up to 16
+    std::vector<std::string> callees;  // functions called, by first appearance
+};
+
+// Instruction selection and linear-scan register allocation for one function.
+X86Function selectX86(const IRFunction& fn);
+// GNU assembler syntax, as llc prints for x86_64-linux.
+std::string printX86(const std::vector<X86Function>& functions);
+// The pieces of printX86, for writing one function at a time.
+std::string printX86Prologue();
+std::string printX86Function(const X86Function& fn);
+std::string printX86Epilogue();
+// Parses, optimizes and lowers IR text; returns assembly or a "; error: ..." line.
+std::string compileToX86(const std::string& ir);
+// Lowers an already optimized module; "; error: ..." if a block lacks a terminator.
+std::string lowerToX86(const IRModule& module);
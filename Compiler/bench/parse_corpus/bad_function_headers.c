@@ -0,0 +1,5 @@
+int f(int a, float) { return a; }
+int g(int a int b) { return a; }
+int h(, ) { return 1; }
+int (int x) { return x; }
+int main() { return f(1) + g(1, 2) + h(); }
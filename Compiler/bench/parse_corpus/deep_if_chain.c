@@ -0,0 +1,5 @@
+int main() {
+    int x = 0;
+    if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) if (x < 1) x = 1;
+    return x;
+}
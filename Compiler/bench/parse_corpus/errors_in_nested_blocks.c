@@ -0,0 +1,15 @@
+int main() {
+    int x = 0;
+    for (int i = 0; i < 10; i = i + 1) {
+        if (i < 5) {
+            x = x + ;
+            y = 3;
+        } else {
+            while (x > 100 {
+                x = x - 1;
+            }
+        }
+        int z = (x + ;
+    }
+    return x;
+}
@@ -0,0 +1,3 @@
+= = + * / < > <= >= == != , ; ( [ { 1 2.5 'a' x y z
+int int float char return return while if else for
+int main() { = x + ; return + ; int = 3; float 2 = x; }
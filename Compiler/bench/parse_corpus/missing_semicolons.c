@@ -0,0 +1,6 @@
+int main() {
+    int x = 1
+    int y = x + 2
+    x = y * 3
+    return x + y
+}
@@ -0,0 +1,6 @@
+) ] } ) ] }
+int main() {
+    int x = 1; ) ]
+    return x;
+}
+} } ) ;
@@ -0,0 +1,6 @@
+int f(int a) { return ((a + 1) * (a - 1); }
+int main() {
+    int x = (1 + (2 * 3);
+    int y = 1 + 2) * 3;
+    return f((x + y);
+}
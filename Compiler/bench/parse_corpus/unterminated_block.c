@@ -0,0 +1,6 @@
+int main() {
+    int x = 1;
+    while (x < 10) {
+        x = x + 1;
+        if (x == 5) {
+            x = x * 2;
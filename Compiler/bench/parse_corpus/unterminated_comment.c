@@ -0,0 +1,5 @@
+int main() {
+    return 1; /* this comment never ends
+    int x = 2;
+    return x;
+}
@@ -0,0 +1,301 @@
+// Worst-case inputs for the front end: deep nesting, unterminated blocks and long runs of
+// the same token, generated at two sizes, plus the hand-written files in bench/parse_corpus.
+//
+// Each input is compiled as far as the AST dump and IR in a forked child with a CPU time
+// and address space limit, and its peak RSS is read back with wait4. An input fails the
+// benchmark if the child crashes or runs out of either limit, if the larger size of a
+// generated case takes more than --max-ratio times as long as the size four times smaller,
+// which any quadratic path in lexing, parsing or error recovery does, or if the diagnostics
+// are wrong: every input is malformed or past a nesting limit and has to draw at least one,
+// except the few generated cases marked well-formed, which have to draw none. Output is
+// tab-separated like phase_bench's. npm test runs it at a smaller size.
+//
+//   npm run bench:parse-stress -- --size 4M
+//   ./bench/parse_stress --time-limit 2 --memory-limit 512 bench/parse_corpus/deep_parens.c
+#include "../frontend/web_driver.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+struct Options {
+    std::string dir = "bench/parse_corpus";
+    std::vector<std::string> files;
+    size_t size = 1u << 20;
+    int timeLimit = 10;       // CPU seconds per input
+    size_t memoryLimit = 1024;  // MB of address space per input
+    double maxRatio = 8.0;
+};
+
+// What a child reports for one input, or why it did not.
+struct Outcome {
+    bool ok = false;
+    double ms = 0;
+    size_t errors = 0;
+    long peakKB = 0;
+    std::string failure;
+};
+
+// Repeats `unit` until the text is at least `bytes` long.
+std::string repeat(const std::string& unit, size_t bytes) {
+    std::string out;
+    out.reserve(bytes + unit.size());
+    while (out.size() < bytes) out += unit;
+    return out;
+}
+
+std::string inMain(const std::string& body) { return "int main() {\n" + body + "\n return 0;\n}\n"; }
+
+struct Case {
+    const char* name;
+    std::string (*generate)(size_t bytes);
+    bool wellFormed = false;
+};
+
+const Case kCases[] = {
+    {"deep_parens", [](size_t n) { return inMain(" return " + repeat("(", n / 2) + "1" + repeat(")", n / 2) + ";"); }},
+    {"deep_blocks", [](size_t n) { return inMain(repeat("{", n / 2) + repeat("}", n / 2)); }},
+    {"deep_if", [](size_t n) { return inMain(" int x = 0;\n" + repeat("if (x) ", n) + "x = 1;"); }},
+    {"deep_calls", [](size_t n) { return inMain(" return " + repeat("f(", n / 3) + "1" + repeat(")", n / 3) + ";"); }},
+    {"deep_index", [](size_t n) { return inMain(" int a[4];\n return " + repeat("a[", n / 3) + "0" + repeat("]", n / 3) + ";"); }},
+    {"long_chain", [](size_t n) { return inMain(" int x = 1;\n return x" + repeat(" + x", n) + ";"); }},
+    {"long_mixed_chain", [](size_t n) { return inMain(" int x = 1;\n return x" + repeat(" * x - x / 3 < x", n) + ";"); }},
+    {"wide_call", [](size_t n) { return inMain(" return f(1" + repeat(", 1", n) + ");"); }},
+    {"unterminated_blocks", [](size_t n) { return inMain(repeat(" int x = 1; {\n", n)); }},
+    {"unterminated_parens", [](size_t n) { return inMain(repeat(" x = f(1 + (2;\n", n)); }},
+    {"unterminated_functions", [](size_t n) { return repeat("int f(int a, int b) {\n return a + b;\n", n); }},
+    {"unterminated_comment", [](size_t n) { return inMain(" /*" + repeat(" int x = 1;", n)); }},
+    {"semicolon_run", [](size_t n) { return inMain(repeat(";", n)); }, true},
+    {"identifier_run", [](size_t n) { return inMain(repeat(" x", n)); }},
+    {"operator_run", [](size_t n) { return inMain(" int x = 1" + repeat(" +", n) + ";"); }},
+    {"closer_run", [](size_t n) { return repeat(") ] } ", n); }},
+    {"many_errors", [](size_t n) { return inMain(repeat(" int = ;\n x = * 2;\n", n)); }},
+    {"long_identifier", [](size_t n) { return inMain(" int " + repeat("a", n) + " = 1;"); }, true},
+    {"declarations", [](size_t n) {
+         std::string body = " int v0 = 1;\n";
+         char line[64];
+         for (size_t i = 1; body.size() < n; ++i) {
+             std::snprintf(line, sizeof line, " int v%zu = v%zu * 3 + (v%zu - 1);\n", i, i - 1, i - 1);
+             body += line;
+         }
+         return inMain(body);
+     },
+     true},
+};
+
+bool readFile(const std::string& path, std::string& out) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    std::ostringstream buf;
+    buf << in.rdbuf();
+    out = buf.str();
+    return true;
+}
+
+std::vector<std::string> listCorpus(const std::string& dir) {
+    std::vector<std::string> files;
+    if (DIR* d = opendir(dir.c_str())) {
+        while (dirent* entry = readdir(d)) {
+            size_t len = std::strlen(entry->d_name);
+            if (len > 2 && std::strcmp(entry->d_name + len - 2, ".c") == 0) files.push_back(dir + "/" + entry->d_name);
+        }
+        closedir(d);
+    }
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+std::string baseName(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+    return name.size() > 2 ? name.substr(0, name.size() - 2) : name;
+}
+
+// Compiles `src` in a child under the limits. The child writes "ms errors" to a pipe; a
+// child that never gets that far is described by how it ended.
+Outcome compileLimited(const std::string& src, const Options& opts) {
+    Outcome out;
+    int fds[2];
+    if (pipe(fds) != 0) {
+        out.failure = std::strerror(errno);
+        return out;
+    }
+    pid_t pid = fork();
+    if (pid < 0) {
+        out.failure = std::strerror(errno);
+        return out;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        struct rlimit cpu = {static_cast<rlim_t>(opts.timeLimit), static_cast<rlim_t>(opts.timeLimit)};
+        struct rlimit as = {static_cast<rlim_t>(opts.memoryLimit) << 20, static_cast<rlim_t>(opts.memoryLimit) << 20};
+        setrlimit(RLIMIT_CPU, &cpu);
+        setrlimit(RLIMIT_AS, &as);
+
+        auto start = std::chrono::steady_clock::now();
+        Compilation compilation(src);
+        compilation.tokens();
+        size_t errors = compilation.diagnostics().size();
+        compilation.astDump();
+        compilation.ir();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        char line[64];
+        int len = std::snprintf(line, sizeof line, "%.3f %zu\n", ms, errors);
+        _exit(write(fds[1], line, static_cast<size_t>(len)) == len ? 0 : 1);
+    }
+
+    close(fds[1]);
+    std::string reply;
+    char buf[64];
+    ssize_t n;
+    while ((n = read(fds[0], buf, sizeof buf)) > 0) reply.append(buf, static_cast<size_t>(n));
+    close(fds[0]);
+
+    int status = 0;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) < 0) {
+        out.failure = std::strerror(errno);
+        return out;
+    }
+    out.peakKB = usage.ru_maxrss;
+    if (WIFSIGNALED(status)) {
+        int sig = WTERMSIG(status);
+        out.failure = sig == SIGXCPU || sig == SIGKILL ? "time limit exceeded" : std::string("killed by ") + strsignal(sig);
+        // A failed allocation under RLIMIT_AS ends in std::bad_alloc and abort().
+        if (sig == SIGABRT) out.failure += " (out of memory?)";
+        return out;
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 || std::sscanf(reply.c_str(), "%lf %zu", &out.ms, &out.errors) != 2) {
+        out.failure = "no result";
+        return out;
+    }
+    out.ok = true;
+    return out;
+}
+
+// Prints the row for one input; false if it failed or its diagnostics were wrong.
+bool report(const std::string& name, size_t bytes, const Outcome& o, const char* ratio, bool wellFormed) {
+    if (!o.ok) {
+        std::printf("%s\t%zu\t-\t-\t%ld\t-\n", name.c_str(), bytes, o.peakKB);
+        std::fprintf(stderr, "%s (%zu bytes): %s\n", name.c_str(), bytes, o.failure.c_str());
+    } else {
+        std::printf("%s\t%zu\t%.3f\t%zu\t%ld\t%s\n", name.c_str(), bytes, o.ms, o.errors, o.peakKB, ratio);
+    }
+    std::fflush(stdout);
+    if (!o.ok) return false;
+    if (wellFormed && o.errors > 0) {
+        std::fprintf(stderr, "%s (%zu bytes): %zu diagnostics for well-formed input\n", name.c_str(), bytes, o.errors);
+        return false;
+    }
+    if (!wellFormed && o.errors == 0) {
+        std::fprintf(stderr, "%s (%zu bytes): no diagnostic for malformed input\n", name.c_str(), bytes);
+        return false;
+    }
+    return true;
+}
+
+// Runs a generated case at a quarter of the size and at the full size. Time under 5ms
+// is mostly process and allocator noise, so the ratio is only enforced above that.
+bool stressCase(const Case& c, const Options& opts) {
+    std::string name = c.name;
+    std::string small = c.generate(opts.size / 4), large = c.generate(opts.size);
+    Outcome a = compileLimited(small, opts);
+    if (!report(name, small.size(), a, "-", c.wellFormed)) return false;
+    Outcome b = compileLimited(large, opts);
+    if (!b.ok) return report(name, large.size(), b, "-", c.wellFormed);
+
+    double ratio = a.ms > 0.0 ? b.ms / a.ms : 0.0;
+    char text[32];
+    std::snprintf(text, sizeof text, "%.2f", ratio);
+    bool ok = report(name, large.size(), b, text, c.wellFormed);
+    if (b.ms > 5.0 && ratio > opts.maxRatio) {
+        std::fprintf(stderr, "%s: 4x the input took %.1fx as long\n", c.name, ratio);
+        return false;
+    }
+    return ok;
+}
+
+bool stressFile(const std::string& path, const Options& opts) {
+    std::string src;
+    if (!readFile(path, src)) {
+        std::fprintf(stderr, "cannot read %s\n", path.c_str());
+        return false;
+    }
+    return report(baseName(path), src.size(), compileLimited(src, opts), "-", false);
+}
+
+bool parseSize(const std::string& text, size_t& out) {
+    char* end = nullptr;
+    double v = std::strtod(text.c_str(), &end);
+    if (end == text.c_str() || v <= 0) return false;
+    size_t mult = 1;
+    if (*end == 'K' || *end == 'k') mult = 1u << 10, ++end;
+    else if (*end == 'M' || *end == 'm') mult = 1u << 20, ++end;
+    if (*end != '\0') return false;
+    out = static_cast<size_t>(v * mult);
+    return true;
+}
+
+void usage(const char* argv0) {
+    std::fprintf(stderr,
+                 "usage: %s [--size 1M] [--time-limit SECONDS] [--memory-limit MB] [--max-ratio R] [--dir DIR] "
+                 "[file.c ...]\n",
+                 argv0);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options opts;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--size" && i + 1 < argc) {
+            if (!parseSize(argv[++i], opts.size)) {
+                std::fprintf(stderr, "bad size '%s'\n", argv[i]);
+                return 2;
+            }
+        } else if (arg == "--time-limit" && i + 1 < argc) {
+            opts.timeLimit = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--memory-limit" && i + 1 < argc) {
+            opts.memoryLimit = std::max(16, std::atoi(argv[++i]));
+        } else if (arg == "--max-ratio" && i + 1 < argc) {
+            opts.maxRatio = std::atof(argv[++i]);
+        } else if (arg == "--dir" && i + 1 < argc) {
+            opts.dir = argv[++i];
+        } else if (!arg.empty() && arg[0] != '-') {
+            opts.files.push_back(arg);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    std::printf("# minic parse stress, time limit %ds, memory limit %zuMB, max ratio %.1f\n", opts.timeLimit,
+                opts.memoryLimit, opts.maxRatio);
+    std::printf("# input\tbytes\tms\terrors\tpeak_rss_kb\tratio\n");
+    std::fflush(stdout);
+
+    bool ok = true;
+    if (opts.files.empty()) {
+        for (const Case& c : kCases) ok = stressCase(c, opts) && ok;
+        opts.files = listCorpus(opts.dir);
+    }
+    for (const std::string& file : opts.files) ok = stressFile(file, opts) && ok;
+    return ok ? 0 : 1;
+}
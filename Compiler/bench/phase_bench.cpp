@@ -0,0 +1,438 @@
+// Native throughput benchmark for every compiler phase.
+//
+// Builds against the same sources that are compiled to WebAssembly, generates
+// deterministic synthetic Mini-C programs of increasing size and times each phase.
+// Output is tab-separated so runs from two commits can be diffed directly, or fed
+// back in with --baseline to flag regressions.
+//
+//   npm run bench:native -- --sizes 1K,1M,32M --repeat 3
+//   ./bench/phase_bench --baseline before.tsv --threshold 10
+#include "../frontend/web_driver.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+struct Options {
+    std::vector<size_t> sizes = {1u << 10, 64u << 10, 1u << 20, 16u << 20};
+    int repeat = 3;
+    std::string baseline;
+    double threshold = 10.0;
+};
+
+// One measured phase for one input size. Times are the best of all repeats.
+struct PhaseResult {
+    std::string phase;
+    double ms;
+    size_t items;
+    const char* unit;
+};
+
+// Small deterministic generator so every commit benchmarks byte-identical inputs.
+struct Lcg {
+    uint64_t state;
+    explicit Lcg(uint64_t seed) : state(seed) {}
+    uint32_t next() {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return static_cast<uint32_t>(state >> 33);
+    }
+    uint32_t below(uint32_t n) { return next() % n; }
+};
+
+// Emits small helper functions, kernels that loop over local arrays and call them, and a
+// main() that passes each kernel's result on to the next, so nothing folds to a constant
+// and exec runs every loop. The kernels take the shapes the loop passes look for: short
+// constant-trip loops (unroll), invariant helper calls in loop bodies (inline, licm),
+// element-wise array loops and reductions (vectorize) and multiples of the induction
+// variable (lsr).
+std::string generateProgram(size_t targetBytes) {
+    Lcg rng(0x5eed + targetBytes);
+    std::string src;
+    src.reserve(targetBytes + 256);
+    src += "// synthetic benchmark input\n";
+
+    std::string calls;
+    size_t helpers = 0, kernels = 0;
+    char text[1024];
+    while (src.size() + calls.size() < targetBytes) {
+        if (helpers == 0 || rng.below(4) == 0) {
+            std::snprintf(text, sizeof text, "int h%zu(int x, int y) {\n  return x * %u + y - %u;\n}\n", helpers,
+                          2 + rng.below(7), rng.below(100));
+            src += text;
+            ++helpers;
+            continue;
+        }
+        size_t h = helpers - 1 - rng.below(helpers < 8 ? helpers : 8);
+        switch (rng.below(4)) {
+            case 0:
+                std::snprintf(text, sizeof text,
+                              "int k%zu(int seed) {\n  int a[64];\n  int b[64];\n  int i;\n  int s = 0;\n"
+                              "  for (i = 0; i < 64; i = i + 1) {\n    b[i] = i * %u + seed;\n  }\n"
+                              "  for (i = 0; i < 64; i = i + 1) {\n    a[i] = b[i] * %u - %u;\n  }\n"
+                              "  for (i = 0; i < 64; i = i + 1) {\n    s = s + a[i];\n  }\n  return s;\n}\n",
+                              kernels, 1 + rng.below(9), 2 + rng.below(7), rng.below(100));
+                break;
+            case 1:
+                std::snprintf(text, sizeof text,
+                              "int k%zu(int seed) {\n  int s = seed;\n  int scale = seed - %u;\n  int i;\n"
+                              "  // invariant call\n  for (i = 0; i < 100; i = i + 1) {\n"
+                              "    int t = h%zu(scale, %u);\n    s = s + t + i * %u;\n"
+                              "    if (s > 100000) {\n      s = s - 100000;\n    }\n  }\n  return s;\n}\n",
+                              kernels, rng.below(50), h, rng.below(10), 3 + rng.below(13));
+                break;
+            case 2:
+                std::snprintf(text, sizeof text,
+                              "int k%zu(int seed) {\n  int c[4];\n  int i;\n  int s = seed;\n"
+                              "  for (i = 0; i < 4; i = i + 1) {\n    c[i] = h%zu(seed, i);\n  }\n"
+                              "  for (i = 0; i < 4; i = i + 1) {\n    s = s + c[i] * %u;\n  }\n  return s;\n}\n",
+                              kernels, h, 1 + rng.below(9));
+                break;
+            default:
+                std::snprintf(text, sizeof text,
+                              "int k%zu(int seed) {\n  float f[64];\n  float fs = 0.0;\n  int i;\n"
+                              "  /* scaled sum */\n  for (i = 0; i < 64; i = i + 1) {\n    f[i] = %u.%u;\n  }\n"
+                              "  for (i = 0; i < 64; i = i + 1) {\n    f[i] = f[i] * 2.0 + 1.0;\n  }\n"
+                              "  for (i = 0; i < 64; i = i + 1) {\n    fs = fs + f[i];\n  }\n  int r = seed;\n"
+                              "  while (fs > 1.0) {\n    fs = fs / 2.0;\n    r = r + 1;\n  }\n  return r;\n}\n",
+                              kernels, rng.below(4), rng.below(10));
+                break;
+        }
+        src += text;
+        std::snprintf(text, sizeof text, "  acc = k%zu(acc);\n", kernels);
+        calls += text;
+        ++kernels;
+    }
+
+    src += "int main() {\n  int acc = 1;\n";
+    src += calls;
+    src += "  return acc;\n}\n";
+    return src;
+}
+
+size_t countNodes(const ASTNode* node) {
+    if (!node) return 0;
+    size_t n = 1;
+    for (const ASTNode* child : *node) n += countNodes(child);
+    return n;
+}
+
+size_t countLines(const std::string& text) {
+    size_t n = 0;
+    for (char c : text) n += c == '\n';
+    return n;
+}
+
+template <typename F>
+double timeMs(F&& f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto stop = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(stop - start).count();
+}
+
+// Rows are keyed by phase name, so a phase one run skips (the JIT rows without a JIT)
+// does not shift the rows after it; they print in the order they were first recorded.
+void keepBest(std::vector<PhaseResult>& best, PhaseResult r) {
+    for (PhaseResult& row : best) {
+        if (row.phase == r.phase) {
+            if (r.ms < row.ms) row = r;
+            return;
+        }
+    }
+    best.push_back(r);
+}
+
+// Runs the whole pipeline `repeat` times on one input and returns per-phase minima.
+std::vector<PhaseResult> runPhases(const std::string& src, int repeat) {
+    std::vector<PhaseResult> best;
+    for (int r = 0; r < repeat; ++r) {
+        std::vector<Token> toks;
+        double ms = timeMs([&] { toks = tokenizeStructured(src); });
+        size_t tokenCount = toks.size();
+        keepBest(best, {"lex", ms, tokenCount, "tokens"});
+
+        CompileContext ctx;
+        Arena arena;
+        ASTNode* root = nullptr;
+        ms = timeMs([&] { root = parseTokens(ctx, toks, arena); });
+        size_t nodes = countNodes(root);
+        keepBest(best, {"parse", ms, nodes, "nodes"});
+
+        ctx.errors.clear();
+        ms = timeMs([&] { analyzeSemantics(ctx, root); });
+        keepBest(best, {"sema", ms, nodes, "nodes"});
+
+        std::string dump;
+        ms = timeMs([&] { dump = printASTTree(root); });
+        keepBest(best, {"ast_print", ms, dump.size(), "bytes"});
+
+        // The IR phases run as Compilation chains them: modules passed directly, text only
+        // printed for display.
+        IRModule module;
+        ms = timeMs([&] { module = buildIR(root); });
+        keepBest(best, {"irgen", ms, countInstructions(module), "insts"});
+
+        IRModule optimizedModule = module;
+        std::string optimized;
+        ms = timeMs([&] { optimized = optimizeIR(optimizedModule); });
+        keepBest(best, {"opt", ms, countInstructions(optimizedModule), "insts"});
+
+        std::string executed;
+        ms = timeMs([&] { executed = runCodegen(optimizedModule); });
+        keepBest(best, {"codegen", ms, countInstructions(optimizedModule), "insts"});
+
+        // exec includes compiling to bytecode; vm_run is the dispatch loop alone.
+        ms = timeMs([&] { execute(optimizedModule); });
+        keepBest(best, {"exec", ms, countInstructions(optimizedModule), "insts"});
+        Bytecode program = compileBytecode(optimizedModule);
+        ms = timeMs([&] { runBytecode(program); });
+        keepBest(best, {"vm_run", ms, program.code.size(), "insts"});
+
+        keepBest(best, {"ast_arena", 0.0, arena.bytesReserved() / 1024, "KB"});
+
+        // One-digit edit in the middle of an already-parsed session, as the editor
+        // sends on a keystroke.
+        Compilation session(src);
+        session.ast();
+        size_t at = src.find_first_of("0123456789", src.size() / 2);
+        if (at == std::string::npos) at = src.size();
+        ms = timeMs([&] {
+            session.applyEdit(at, at < src.size() ? 1 : 0, "7");
+            session.ast();
+        });
+        keepBest(best, {"edit", ms, session.tokens().size(), "tokens"});
+
+        // Typing on at the end of the next return statement, mean per keystroke. The edit
+        // above moved the session's buffers here, so each keystroke relexes and reparses one
+        // function at every size.
+        size_t spot = src.find(';', src.find("return", at));
+        const std::string typed = " + 1";
+        ms = timeMs([&] {
+            for (size_t i = 0; i < typed.size(); ++i) {
+                session.applyEdit(spot + i, 0, typed.substr(i, 1));
+                session.ast();
+            }
+            for (size_t i = typed.size(); i > 0; --i) {
+                session.applyEdit(spot + i - 1, 1, "");
+                session.ast();
+            }
+        });
+        keepBest(best, {"edit_keys", ms / (2 * typed.size()), session.tokens().size(), "tokens"});
+
+        std::string assembly;
+        ms = timeMs([&] { assembly = lowerToX86(optimizedModule); });
+        keepBest(best, {"asm", ms, countLines(assembly), "lines"});
+
+        std::string text;
+        ms = timeMs([&] { text = printIR(module); });
+        keepBest(best, {"ir_print", ms, text.size(), "bytes"});
+
+        IRModule reparsed;
+        std::string error;
+        ms = timeMs([&] { parseIR(text, reparsed, error); });
+        keepBest(best, {"ir_parse", ms, text.size(), "bytes"});
+
+        std::string binary;
+        ms = timeMs([&] { binary = serializeIR(module); });
+        keepBest(best, {"ir_encode", ms, binary.size(), "bytes"});
+
+        IRModule decoded;
+        ms = timeMs([&] { deserializeIR(binary, decoded, error); });
+        keepBest(best, {"ir_decode", ms, binary.size(), "bytes"});
+
+        // The unoptimized module, so the generated code still does the program's work.
+        if (jitAvailable()) {
+            JITResult run = runJIT(module);
+            keepBest(best, {"jit_compile", run.compileMs, run.codeBytes, "bytes"});
+            keepBest(best, {"jit_run", run.runMs, countInstructions(module), "insts"});
+        }
+
+        // Per-pass breakdown of "opt", named "opt.<pass>" as in a Compilation's phase events.
+        std::vector<PassStats> passes = optimizeModule(module);
+        for (size_t i = 0; i < passes.size(); ++i) {
+            keepBest(best, {std::string("opt.") + passes[i].pass, passes[i].ms, passes[i].count, "changes"});
+        }
+    }
+    return best;
+}
+
+std::string sizeLabel(size_t bytes) {
+    char buf[32];
+    if (bytes >= (1u << 20) && bytes % (1u << 20) == 0) std::snprintf(buf, sizeof buf, "%zuM", bytes >> 20);
+    else if (bytes >= (1u << 10) && bytes % (1u << 10) == 0) std::snprintf(buf, sizeof buf, "%zuK", bytes >> 10);
+    else std::snprintf(buf, sizeof buf, "%zu", bytes);
+    return buf;
+}
+
+bool parseSize(const std::string& text, size_t& out) {
+    char* end = nullptr;
+    double v = std::strtod(text.c_str(), &end);
+    if (end == text.c_str() || v <= 0) return false;
+    size_t mult = 1;
+    if (*end == 'K' || *end == 'k') mult = 1u << 10, ++end;
+    else if (*end == 'M' || *end == 'm') mult = 1u << 20, ++end;
+    if (*end != '\0') return false;
+    out = static_cast<size_t>(v * mult);
+    return true;
+}
+
+std::string formatRow(const std::string& label, size_t bytes, const PhaseResult& r) {
+    char buf[256];
+    if (r.ms > 0.0) {
+        double perSec = r.items / (r.ms / 1000.0);
+        std::snprintf(buf, sizeof buf, "%s\t%zu\t%s\t%.3f\t%zu\t%s\t%.0f\n", label.c_str(), bytes, r.phase.c_str(), r.ms,
+                      r.items, r.unit, perSec);
+    } else {
+        std::snprintf(buf, sizeof buf, "%s\t%zu\t%s\t-\t%zu\t%s\t-\n", label.c_str(), bytes, r.phase.c_str(), r.items, r.unit);
+    }
+    return buf;
+}
+
+// Each size runs in a forked child so its peak RSS is measured in isolation. The child
+// sends its rows back over a pipe; they are appended to `report`.
+bool benchSize(size_t bytes, int repeat, std::string& report) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        std::perror("pipe");
+        return false;
+    }
+    pid_t pid = fork();
+    if (pid < 0) {
+        std::perror("fork");
+        return false;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        std::string src = generateProgram(bytes);
+        std::string label = sizeLabel(bytes);
+        std::string rows;
+        for (const PhaseResult& r : runPhases(src, repeat)) rows += formatRow(label, bytes, r);
+        for (size_t off = 0; off < rows.size();) {
+            ssize_t n = write(fds[1], rows.data() + off, rows.size() - off);
+            if (n <= 0) _exit(1);
+            off += static_cast<size_t>(n);
+        }
+        _exit(0);
+    }
+
+    close(fds[1]);
+    std::string rows;
+    char buf[4096];
+    ssize_t n;
+    while ((n = read(fds[0], buf, sizeof buf)) > 0) rows.append(buf, static_cast<size_t>(n));
+    close(fds[0]);
+
+    int status = 0;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        std::fprintf(stderr, "benchmark for %s failed\n", sizeLabel(bytes).c_str());
+        return false;
+    }
+    rows += formatRow(sizeLabel(bytes), bytes, {"peak_rss", 0.0, static_cast<size_t>(usage.ru_maxrss), "KB"});
+    std::fputs(rows.c_str(), stdout);
+    std::fflush(stdout);
+    report += rows;
+    return true;
+}
+
+// Compares this run against a previous TSV and returns the number of regressions.
+int compareWithBaseline(const std::string& current, const Options& opts) {
+    std::ifstream in(opts.baseline);
+    if (!in) {
+        std::fprintf(stderr, "cannot read baseline %s\n", opts.baseline.c_str());
+        return 1;
+    }
+
+    auto load = [](std::istream& is) {
+        std::map<std::string, double> rows;
+        std::string line;
+        while (std::getline(is, line)) {
+            if (line.empty() || line[0] == '#') continue;
+            std::istringstream fields(line);
+            std::string label, bytes, phase, ms;
+            std::getline(fields, label, '\t');
+            std::getline(fields, bytes, '\t');
+            std::getline(fields, phase, '\t');
+            std::getline(fields, ms, '\t');
+            if (ms != "-" && !ms.empty()) rows[label + "/" + phase] = std::atof(ms.c_str());
+        }
+        return rows;
+    };
+
+    std::istringstream cur(current);
+    std::map<std::string, double> before = load(in), after = load(cur);
+
+    int regressions = 0;
+    std::fprintf(stderr, "\n%-24s %12s %12s %9s\n", "phase", "before_ms", "after_ms", "delta");
+    for (const auto& [key, ms] : after) {
+        auto it = before.find(key);
+        if (it == before.end() || it->second <= 0.0) continue;
+        double delta = (ms - it->second) / it->second * 100.0;
+        // Sub-50us phases are dominated by timer noise.
+        bool regressed = delta > opts.threshold && ms - it->second > 0.05;
+        regressions += regressed;
+        std::fprintf(stderr, "%-24s %12.3f %12.3f %+8.1f%%%s\n", key.c_str(), it->second, ms, delta,
+                     regressed ? "  REGRESSION" : "");
+    }
+    return regressions;
+}
+
+void usage(const char* argv0) {
+    std::fprintf(stderr,
+                 "usage: %s [--sizes 1K,64K,1M,16M] [--repeat N] [--baseline FILE] [--threshold PCT]\n", argv0);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options opts;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--sizes" && i + 1 < argc) {
+            opts.sizes.clear();
+            std::stringstream list(argv[++i]);
+            std::string item;
+            while (std::getline(list, item, ',')) {
+                size_t bytes;
+                if (!parseSize(item, bytes)) {
+                    std::fprintf(stderr, "bad size '%s'\n", item.c_str());
+                    return 2;
+                }
+                opts.sizes.push_back(bytes);
+            }
+        } else if (arg == "--repeat" && i + 1 < argc) {
+            opts.repeat = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--baseline" && i + 1 < argc) {
+            opts.baseline = argv[++i];
+        } else if (arg == "--threshold" && i + 1 < argc) {
+            opts.threshold = std::atof(argv[++i]);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    std::printf("# minic phase benchmark, repeat=%d (best of)\n", opts.repeat);
+    std::printf("# input\tbytes\tphase\tms\titems\tunit\tper_sec\n");
+    std::fflush(stdout);
+
+    std::string report;
+    bool ok = true;
+    for (size_t bytes : opts.sizes) ok = benchSize(bytes, opts.repeat, report) && ok;
+
+    if (!opts.baseline.empty() && compareWithBaseline(report, opts) > 0) return 1;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,177 @@
+// Scalar versus vectorized code for the kernels in bench/vector_kernels.
+//
+// Every kernel is compiled twice from the same IR, once through the whole pipeline and
+// once with the vectorize pass left out, and both are run in-process with the JIT. The
+// first line of each kernel is `// expect: N`, the value @main must return; a kernel
+// whose scalar or vector run returns anything else fails the benchmark. Output is
+// tab-separated like phase_bench's.
+//
+//   npm run bench:vector -- --repeat 9
+//   ./bench/vector_bench bench/vector_kernels/dot_int.c
+#include "../frontend/web_driver.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+
+namespace {
+
+struct Options {
+    std::string dir = "bench/vector_kernels";
+    std::vector<std::string> files;
+    int repeat = 5;
+};
+
+// Best-of-repeat run time and what the last run returned.
+struct Measurement {
+    double ms = 0;
+    int32_t value = 0;
+    bool ok = false;
+    std::string error;
+};
+
+bool readFile(const std::string& path, std::string& out) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) return false;
+    std::ostringstream buf;
+    buf << in.rdbuf();
+    out = buf.str();
+    return true;
+}
+
+// The kernels in `dir`, sorted so every run lists them in the same order.
+std::vector<std::string> listKernels(const std::string& dir) {
+    std::vector<std::string> files;
+    if (DIR* d = opendir(dir.c_str())) {
+        while (dirent* entry = readdir(d)) {
+            size_t len = std::strlen(entry->d_name);
+            if (len > 2 && std::strcmp(entry->d_name + len - 2, ".c") == 0) files.push_back(dir + "/" + entry->d_name);
+        }
+        closedir(d);
+    }
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+bool parseExpected(const std::string& src, int32_t& out) {
+    static const char kTag[] = "// expect:";
+    if (src.compare(0, sizeof kTag - 1, kTag) != 0) return false;
+    char* end = nullptr;
+    long v = std::strtol(src.c_str() + sizeof kTag - 1, &end, 10);
+    if (end == src.c_str() + sizeof kTag - 1) return false;
+    out = static_cast<int32_t>(v);
+    return true;
+}
+
+void keepBest(Measurement& best, const JITResult& run, bool first) {
+    if (!run.ok) {
+        best.ok = false;
+        best.error = run.error;
+        return;
+    }
+    if (first || run.runMs < best.ms) best.ms = run.runMs;
+    best.value = run.value;
+    best.ok = first || best.ok;
+}
+
+std::string baseName(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+    return name.size() > 2 ? name.substr(0, name.size() - 2) : name;
+}
+
+// Compiles and times one kernel. Scalar and vector runs alternate so that frequency
+// changes and noisy neighbours hit both about equally.
+bool benchKernel(const std::string& path, int repeat) {
+    std::string src;
+    if (!readFile(path, src)) {
+        std::fprintf(stderr, "cannot read %s\n", path.c_str());
+        return false;
+    }
+    int32_t expected;
+    if (!parseExpected(src, expected)) {
+        std::fprintf(stderr, "%s: first line must be '// expect: N'\n", path.c_str());
+        return false;
+    }
+    Compilation compilation(src);
+    if (!compilation.diagnostics().empty()) {
+        std::fprintf(stderr, "%s: %s\n", path.c_str(), compilation.diagnostics().front().c_str());
+        return false;
+    }
+
+    IRModule scalar = compilation.irModule(), vector = compilation.irModule();
+    optimizeModule(scalar, false);
+    uint32_t vectorized = 0;
+    for (const PassStats& pass : optimizeModule(vector)) {
+        if (std::strcmp(pass.pass, "vectorize") == 0) vectorized = pass.count;
+    }
+
+    Measurement slow, fast;
+    for (int r = 0; r < repeat; ++r) {
+        keepBest(slow, runJIT(scalar), r == 0);
+        keepBest(fast, runJIT(vector), r == 0);
+    }
+    std::string name = baseName(path);
+    for (const Measurement* m : {&slow, &fast}) {
+        if (!m->ok) {
+            std::fprintf(stderr, "%s: %s\n", name.c_str(), m->error.c_str());
+            return false;
+        }
+        if (m->value != expected) {
+            std::fprintf(stderr, "%s: %s code returned %d, expected %d\n", name.c_str(), m == &slow ? "scalar" : "vector",
+                         m->value, expected);
+            return false;
+        }
+    }
+    std::printf("%s\t%.3f\t%.3f\t%.2f\t%u\n", name.c_str(), slow.ms, fast.ms, fast.ms > 0.0 ? slow.ms / fast.ms : 0.0,
+                vectorized);
+    std::fflush(stdout);
+    return true;
+}
+
+void usage(const char* argv0) {
+    std::fprintf(stderr, "usage: %s [--dir DIR] [--repeat N] [kernel.c ...]\n", argv0);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options opts;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--dir" && i + 1 < argc) {
+            opts.dir = argv[++i];
+        } else if (arg == "--repeat" && i + 1 < argc) {
+            opts.repeat = std::max(1, std::atoi(argv[++i]));
+        } else if (!arg.empty() && arg[0] != '-') {
+            opts.files.push_back(arg);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (!jitAvailable()) {
+        std::fprintf(stderr, "the JIT is not available on this platform\n");
+        return 2;
+    }
+    if (opts.files.empty()) opts.files = listKernels(opts.dir);
+    if (opts.files.empty()) {
+        std::fprintf(stderr, "no kernels in %s\n", opts.dir.c_str());
+        return 2;
+    }
+
+    std::printf("# minic vector benchmark, repeat=%d (best of)\n", opts.repeat);
+    std::printf("# kernel\tscalar_ms\tvector_ms\tspeedup\tloops_vectorized\n");
+    std::fflush(stdout);
+
+    bool ok = true;
+    for (const std::string& file : opts.files) ok = benchKernel(file, opts.repeat) && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,31 @@
+// expect: 3
+// Several float streams at once: a difference, a quotient and a product per element.
+int main() {
+    float x[4000];
+    float y[4000];
+    float z[4000];
+    float v = 1.0;
+    for (int i = 0; i < 4000; i = i + 1) {
+        x[i] = v;
+        y[i] = 2.0;
+        z[i] = 0.0;
+        v = v + 0.5;
+    }
+    for (int r = 0; r < 2000; r = r + 1) {
+        for (int i = 0; i < 4000; i = i + 1) {
+            float d = x[i] - y[i];
+            float q = d / 4.0;
+            float p = q * 0.5;
+            z[i] = z[i] + p;
+        }
+    }
+    int result = 0;
+    float mid = z[2000];
+    if (mid > 240000.0) {
+        result = result + 1;
+    }
+    if (mid < 260000.0) {
+        result = result + 2;
+    }
+    return result;
+}
@@ -0,0 +1,20 @@
+// expect: 1064009728
+// Dot product: a lane-wise multiply feeding a sum reduction.
+int main() {
+    int x[4096];
+    int y[4096];
+    for (int i = 0; i < 4096; i = i + 1) {
+        int v = i * 3;
+        x[i] = v - 6000;
+        int w = i * 5;
+        y[i] = 11000 - w;
+    }
+    int s = 0;
+    for (int r = 0; r < 2000; r = r + 1) {
+        for (int i = 0; i < 4096; i = i + 1) {
+            int p = x[i] * y[i];
+            s = s + p;
+        }
+    }
+    return s;
+}
@@ -0,0 +1,21 @@
+// expect: 23285592
+// 4093 trips: 1023 vector iterations, then the scalar loop finishes the last one.
+int main() {
+    int x[4093];
+    int y[4093];
+    for (int i = 0; i < 4093; i = i + 1) {
+        x[i] = i;
+        y[i] = 0;
+    }
+    for (int r = 0; r < 2000; r = r + 1) {
+        for (int i = 0; i < 4093; i = i + 1) {
+            int t = x[i] - r;
+            y[i] = y[i] + t;
+        }
+    }
+    int s = 0;
+    for (int i = 0; i < 4093; i = i + 1) {
+        s = s - y[i];
+    }
+    return s;
+}
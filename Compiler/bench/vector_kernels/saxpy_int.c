@@ -0,0 +1,23 @@
+// expect: -1203470336
+// y = a * x + y with `a` loop-invariant, splatted once before the vector loop.
+int main() {
+    int x[4096];
+    int y[4096];
+    for (int i = 0; i < 4096; i = i + 1) {
+        x[i] = i;
+        int w = i * 2;
+        y[i] = w + 1;
+    }
+    int a = 3;
+    for (int r = 0; r < 2000; r = r + 1) {
+        for (int i = 0; i < 4096; i = i + 1) {
+            int t = x[i] * a;
+            y[i] = y[i] + t;
+        }
+    }
+    int s = 0;
+    for (int i = 0; i < 4096; i = i + 1) {
+        s = s + y[i];
+    }
+    return s;
+}
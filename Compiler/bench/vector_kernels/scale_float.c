@@ -0,0 +1,32 @@
+// expect: 7
+// z = x * 1.5 + z on <8 x float>. The language has no float-to-int conversion, so the
+// result is a set of comparisons.
+int main() {
+    float x[4096];
+    float z[4096];
+    float v = 0.0;
+    for (int i = 0; i < 4096; i = i + 1) {
+        x[i] = v;
+        z[i] = 1.0;
+        v = v + 0.25;
+    }
+    for (int r = 0; r < 2000; r = r + 1) {
+        for (int i = 0; i < 4096; i = i + 1) {
+            float t = x[i] * 1.5;
+            z[i] = z[i] + t;
+        }
+    }
+    int result = 0;
+    float last = z[4095];
+    float first = z[0];
+    if (first == 1.0) {
+        result = result + 1;
+    }
+    if (last > 3000000.0) {
+        result = result + 2;
+    }
+    if (last < 3100000.0) {
+        result = result + 4;
+    }
+    return result;
+}
@@ -0,0 +1,16 @@
+// expect: 1468334080
+// Integer sum reduction: four partial sums in one <4 x i32>, added up after the loop.
+int main() {
+    int x[4096];
+    for (int i = 0; i < 4096; i = i + 1) {
+        int v = i * 7;
+        x[i] = v - 9000;
+    }
+    int s = 0;
+    for (int r = 0; r < 4000; r = r + 1) {
+        for (int i = 0; i < 4096; i = i + 1) {
+            s = s + x[i];
+        }
+    }
+    return s;
+}
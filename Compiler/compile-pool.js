@@ -0,0 +1,175 @@
+// Runs llc for /compile-ir on a bounded set of runners. Each request pipes its IR through
+// llc's stdin and stdout, so concurrent requests never share files. Jobs beyond the queue
+// limit are rejected instead of piling up, and finished assembly is cached by a hash of
+// the IR so resubmitting a program does not spawn llc again. With a DiskCache the
+// assembly also survives restarts; its keys include `llc --version`, so upgrading llc
+// starts from an empty key space.
+const crypto = require("crypto");
+const os = require("os");
+const { spawn, spawnSync } = require("child_process");
+
+class QueueFullError extends Error {
+  constructor() {
+    super("compile queue is full, retry later");
+    this.code = "QUEUE_FULL";
+  }
+}
+
+class CompilePool {
+  constructor({
+    command = "llc",
+    args = ["-o", "-"],
+    concurrency = os.cpus().length,
+    maxQueue = 64,
+    timeoutMs = 10000,
+    cacheEntries = 512,
+    cacheBytes = 32 * 1024 * 1024,
+    diskCache = null,
+  } = {}) {
+    this.command = command;
+    this.args = args;
+    this.concurrency = Math.max(1, concurrency);
+    this.maxQueue = maxQueue;
+    this.timeoutMs = timeoutMs;
+    this.cacheEntries = cacheEntries;
+    this.cacheBytes = cacheBytes;
+    this.diskCache = diskCache;
+    this.identity = diskCache ? compilerIdentity(command) : "";
+
+    this.queue = [];
+    this.running = 0;
+    this.inFlight = new Map(); // hash -> promise, so identical concurrent requests compile once
+    this.cache = new Map();    // hash -> assembly, in least-recently-used order
+    this.cachedBytes = 0;
+    this.stats = { hits: 0, diskHits: 0, misses: 0, shared: 0, rejected: 0, failures: 0 };
+  }
+
+  key(ir) {
+    return crypto.createHash("sha256").update(this.identity).update("\0")
+      .update(this.args.join("\0")).update("\0").update(ir).digest("hex");
+  }
+
+  // Resolves with the assembly for `ir`, or rejects with llc's error output, a timeout,
+  // or a QueueFullError when the pool is saturated.
+  compile(ir) {
+    const hash = this.key(ir);
+    const cached = this.cache.get(hash);
+    if (cached !== undefined) {
+      this.cache.delete(hash);
+      this.cache.set(hash, cached);
+      this.stats.hits++;
+      return Promise.resolve(cached);
+    }
+    const pending = this.inFlight.get(hash);
+    if (pending) {
+      this.stats.shared++;
+      return pending;
+    }
+    if (!this.diskCache && this.queueFull()) {
+      this.stats.rejected++;
+      return Promise.reject(new QueueFullError());
+    }
+
+    const job = this.lookupDisk(hash).then((stored) => {
+      if (stored !== undefined) {
+        this.stats.diskHits++;
+        return stored;
+      }
+      if (this.queueFull()) {
+        this.stats.rejected++;
+        throw new QueueFullError();
+      }
+      this.stats.misses++;
+      return new Promise((resolve, reject) => {
+        this.queue.push({ ir, resolve, reject });
+        this.drain();
+      }).then((asm) => {
+        if (this.diskCache) this.diskCache.put(hash, "llc.s", asm).catch(() => {});
+        return asm;
+      });
+    }).then((asm) => {
+      this.remember(hash, asm);
+      return asm;
+    }).finally(() => {
+      this.inFlight.delete(hash);
+    });
+    this.inFlight.set(hash, job);
+    return job;
+  }
+
+  queueFull() {
+    return this.running >= this.concurrency && this.queue.length >= this.maxQueue;
+  }
+
+  lookupDisk(hash) {
+    return this.diskCache ? this.diskCache.get(hash, "llc.s") : Promise.resolve(undefined);
+  }
+
+  drain() {
+    while (this.running < this.concurrency && this.queue.length) {
+      const job = this.queue.shift();
+      this.running++;
+      this.run(job.ir).then(job.resolve, (err) => {
+        this.stats.failures++;
+        job.reject(err);
+      }).finally(() => {
+        this.running--;
+        this.drain();
+      });
+    }
+  }
+
+  run(ir) {
+    return new Promise((resolve, reject) => {
+      const child = spawn(this.command, this.args, { stdio: ["pipe", "pipe", "pipe"] });
+      const out = [];
+      const err = [];
+      const timer = setTimeout(() => child.kill("SIGKILL"), this.timeoutMs);
+      child.stdout.on("data", (chunk) => out.push(chunk));
+      child.stderr.on("data", (chunk) => err.push(chunk));
+      child.on("error", (e) => {
+        clearTimeout(timer);
+        reject(e);
+      });
+      child.on("close", (code, signal) => {
+        clearTimeout(timer);
+        const stderr = Buffer.concat(err).toString("utf8");
+        if (code === 0 && !stderr) resolve(Buffer.concat(out).toString("utf8"));
+        else if (signal) reject(new Error(`${this.command} killed by ${signal} after ${this.timeoutMs} ms`));
+        else reject(new Error(stderr || `${this.command} exited with code ${code}`));
+      });
+      child.stdin.on("error", () => {}); // llc may exit before reading everything; "close" reports it
+      child.stdin.end(ir);
+    });
+  }
+
+  remember(hash, asm) {
+    if (asm.length > this.cacheBytes) return;
+    this.cache.set(hash, asm);
+    this.cachedBytes += asm.length;
+    while (this.cache.size > this.cacheEntries || this.cachedBytes > this.cacheBytes) {
+      const [oldest, value] = this.cache.entries().next().value;
+      this.cache.delete(oldest);
+      this.cachedBytes -= value.length;
+    }
+  }
+
+  snapshot() {
+    return {
+      ...this.stats,
+      running: this.running,
+      queued: this.queue.length,
+      cacheEntries: this.cache.size,
+      cacheBytes: this.cachedBytes,
+      disk: this.diskCache ? this.diskCache.snapshot() : null,
+    };
+  }
+}
+
+// What produced the assembly: llc's version banner, or the command name if it will not say.
+function compilerIdentity(command) {
+  const result = spawnSync(command, ["--version"], { encoding: "utf8" });
+  return result.status === 0 && result.stdout ? result.stdout : command;
+}
+
+module.exports = { CompilePool, QueueFullError };
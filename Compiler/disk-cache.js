@@ -0,0 +1,133 @@
+// Persistent content-addressed cache for compiler outputs, in the same layout as the native
+// tools' ArtifactCache (tools/artifact_cache.h): DIR/<first two hex digits>/<key>.<artifact>.
+// Files are written under a temporary name and renamed into place, so several server
+// processes can share one directory. The total size is capped; a hit refreshes the file's
+// modification time and the least recently used files are deleted first.
+const fs = require("fs");
+const fsp = fs.promises;
+const path = require("path");
+
+class DiskCache {
+  constructor({ dir, maxBytes = 512 * 1024 * 1024 }) {
+    this.dir = dir;
+    this.maxBytes = maxBytes;
+    this.stats = { hits: 0, misses: 0, stores: 0, evictions: 0 };
+    this.evicting = null;
+    this.tempCounter = 0;
+
+    fs.mkdirSync(dir, { recursive: true });
+    // What is already on disk is counted in the background. The walk's total replaces the
+    // running count rather than adding to it, since it may already include stores made
+    // while it ran; eviction recounts the same way.
+    this.bytes = 0;
+    walk(dir).then((files) => {
+      this.bytes = totalSize(files);
+    });
+  }
+
+  file(key, artifact) {
+    return path.join(this.dir, key.slice(0, 2), `${key}.${artifact}`);
+  }
+
+  // Resolves with the stored text, or undefined on a miss.
+  async get(key, artifact) {
+    const file = this.file(key, artifact);
+    let data;
+    try {
+      data = await fsp.readFile(file, "utf8");
+    } catch {
+      this.stats.misses++;
+      return undefined;
+    }
+    const now = new Date();
+    fsp.utimes(file, now, now).catch(() => {});
+    this.stats.hits++;
+    return data;
+  }
+
+  async put(key, artifact, data) {
+    const size = Buffer.byteLength(data);
+    if (size > this.maxBytes) return;
+    const file = this.file(key, artifact);
+    const temp = `${file}.tmp.${process.pid}.${this.tempCounter++}`;
+    let replaced = 0;
+    try {
+      await fsp.mkdir(path.dirname(file), { recursive: true });
+      await fsp.writeFile(temp, data);
+      replaced = await fsp.stat(file).then((st) => st.size, () => 0);
+      await fsp.rename(temp, file);
+    } catch {
+      fsp.unlink(temp).catch(() => {});
+      return;
+    }
+    this.stats.stores++;
+    this.bytes += size - replaced;
+    if (this.bytes > this.maxBytes) await this.evict();
+  }
+
+  // Rescans the directory, which also counts what other processes have stored, and deletes
+  // the oldest files until the total is under 90% of the cap. Temporary files are writes
+  // still in progress, here or in another process, and are left alone.
+  evict() {
+    if (!this.evicting) {
+      this.evicting = (async () => {
+        const files = await walk(this.dir);
+        let total = totalSize(files);
+        files.sort((a, b) => a.mtimeMs - b.mtimeMs);
+        const target = this.maxBytes * 0.9;
+        for (const f of files) {
+          if (total <= target) break;
+          try {
+            await fsp.unlink(f.path);
+            total -= f.size;
+            this.stats.evictions++;
+          } catch {
+            // already removed by another process
+          }
+        }
+        this.bytes = total;
+      })().finally(() => {
+        this.evicting = null;
+      });
+    }
+    return this.evicting;
+  }
+
+  snapshot() {
+    return { ...this.stats, bytes: this.bytes, maxBytes: this.maxBytes };
+  }
+}
+
+// Every cache entry under `dir` with its size and modification time; temporary files are
+// skipped. Never rejects: a directory or file removed while scanning is left out.
+async function walk(dir) {
+  let entries;
+  try {
+    entries = await fsp.readdir(dir, { withFileTypes: true });
+  } catch {
+    return [];
+  }
+  const found = await Promise.all(entries.map(async (entry) => {
+    const full = path.join(dir, entry.name);
+    if (entry.isDirectory()) return walk(full);
+    if (!entry.isFile() || isTemporary(entry.name)) return [];
+    try {
+      const st = await fsp.stat(full);
+      return [{ path: full, size: st.size, mtimeMs: st.mtimeMs }];
+    } catch {
+      return [];
+    }
+  }));
+  return found.flat();
+}
+
+// Named by put() while being written: `<key>.<artifact>.tmp.<pid>.<n>`.
+function isTemporary(name) {
+  return name.includes(".tmp.");
+}
+
+function totalSize(files) {
+  return files.reduce((sum, f) => sum + f.size, 0);
+}
+
+module.exports = { DiskCache };
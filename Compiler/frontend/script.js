@@ -1,7 +1,5 @@
 // script.js
 
-let compileLexer, compileAST, compileIR, compileOptimizedIR, compileCodegen;
-
 function showStats(stage, timeMs = 0, success = true) {
   document.getElementById("status").textContent = `Status: ✅ ${stage} completed`;
   document.getElementById("performance").textContent = `Time: ${timeMs.toFixed(2)} ms`;
@@ -10,6 +8,229 @@ function showStats(stage, timeMs = 0, success = true) {
   document.getElementById("spaceComplexity").textContent = "Space Complexity: O(1)";
 }
 
+// Latest run of every phase the session has recorded, in pipeline order of first use.
+function showPhaseStats(statsJSON) {
+  const latest = new Map();
+  for (const event of JSON.parse(statsJSON).phases) {
+    latest.delete(event.phase);
+    latest.set(event.phase, event);
+  }
+  const rows = [...latest.values()].sort((a, b) => a.startMs - b.startMs).map((event) => {
+    const counters = Object.entries(event.counters).map(([name, value]) => `${name}: ${value}`).join(", ");
+    const nested = event.phase.includes(".") ? "phase-nested" : "";
+    return `<tr class="${nested}"><td>${event.phase}</td><td>${event.ms.toFixed(3)} ms</td><td>${counters}</td></tr>`;
+  });
+  document.getElementById("phaseStats").innerHTML = rows.length
+    ? `<table><tr><th>Phase</th><th>Time</th><th>Counters</th></tr>${rows.join("")}</table>`
+    : "";
+}
+
+// The compiler starts loading as soon as this script runs, in parallel with the page and
+// Monaco, and the buttons work from the start: a click before it is ready waits for it.
+let wasmModule = null; // compiled once; a replacement instance reuses it
+
+// The .wasm next to whichever build index.html loads: compiler.js (npm run build:wasm) or
+// compiler.startup.js (npm run build:wasm-startup).
+const compilerScript = document.querySelector('script[src^="compiler"]');
+const wasmURL = compilerScript ? compilerScript.getAttribute("src").replace(/\.js$/, ".wasm") : "compiler.wasm";
+
+// Emscripten's instantiateWasm hook. The first instance is compiled while the .wasm is
+// still downloading; later ones only instantiate the module already compiled. Emscripten
+// gives the hook no way to fail, so a failure goes to `fail` instead of leaving the
+// factory's promise pending.
+function instantiateWasm(imports, done, fail) {
+  const instantiated = wasmModule
+    ? WebAssembly.instantiate(wasmModule, imports).then((instance) => ({ module: wasmModule, instance }))
+    : WebAssembly.instantiateStreaming(fetch(wasmURL, { credentials: "same-origin" }), imports)
+      // instantiateStreaming needs an application/wasm response, which file:// and some
+      // static servers do not give.
+      .catch(() => fetch(wasmURL, { credentials: "same-origin" })
+        .then((response) => response.arrayBuffer())
+        .then((bytes) => WebAssembly.instantiate(bytes, imports)));
+  instantiated.then(({ module, instance }) => {
+    wasmModule = module;
+    done(instance, module);
+  }, fail);
+  return {};
+}
+
+let compilerReady = null;
+let compiler = null; // the bound exports once loaded
+let session = 0;
+
+function sessionCompiler(Module) {
+  return {
+    create: Module.cwrap('compilation_create', 'number', ['string']),
+    destroy: Module.cwrap('compilation_destroy', null, ['number']),
+    edit: Module.cwrap('compilation_edit', 'number', ['number', 'number', 'number', 'string']),
+    tokens: Module.cwrap('compilation_tokens', 'string', ['number']),
+    ast: Module.cwrap('compilation_ast', 'string', ['number']),
+    ir: Module.cwrap('compilation_ir', 'string', ['number']),
+    optimizedIR: Module.cwrap('compilation_optimized_ir', 'string', ['number']),
+    asm: Module.cwrap('compilation_asm', 'string', ['number']),
+    stats: Module.cwrap('compilation_stats', 'string', ['number']),
+  };
+}
+
+// The run_* exports return a malloc'd copy of their result, which is the caller's to free.
+// A compiler.js built without UTF8ToString in its runtime methods can only read it through
+// cwrap's 'string' return, which leaks the copy.
+function oneShotExport(Module, name) {
+  if (!Module.UTF8ToString) return Module.cwrap(name, 'string', ['string']);
+  const run = Module.cwrap(name, 'number', ['string']);
+  return (input) => {
+    const result = run(input);
+    try {
+      return Module.UTF8ToString(result);
+    } finally {
+      Module._free(result);
+    }
+  };
+}
+
+// A compiler.wasm built before the session API only has the one-shot run_* exports. This
+// gives them the same shape: a "session" is the source text, every phase compiles it
+// from scratch, and edits are refused so the next run starts over from the editor. One
+// built before the in-browser backend has no run_asm either, and its assembly comes from
+// llc on the server, as in the llc codegen mode.
+function oneShotCompiler(Module) {
+  const runLexer = oneShotExport(Module, 'run_lexer');
+  const runAST = oneShotExport(Module, 'run_ast');
+  const runIR = oneShotExport(Module, 'run_ir');
+  const runOptimizedIR = oneShotExport(Module, 'run_optimized_ir');
+  const runAsm = Module._run_asm ? oneShotExport(Module, 'run_asm') : null;
+  const sources = new Map();
+  let next = 1;
+  return {
+    create: (text) => {
+      sources.set(next, text);
+      return next++;
+    },
+    destroy: (handle) => sources.delete(handle),
+    edit: () => 0,
+    tokens: (handle) => runLexer(sources.get(handle)),
+    ast: (handle) => runAST(sources.get(handle)),
+    ir: (handle) => runIR(sources.get(handle)),
+    optimizedIR: (handle) => runOptimizedIR(runIR(sources.get(handle))),
+    asm: (handle) => runAsm
+      ? runAsm(runIR(sources.get(handle)))
+      : runCodegen(runOptimizedIR(runIR(sources.get(handle)))).then((asm) => asm.startsWith("Error")
+        ? asm
+        : "# from llc on the server: this compiler.wasm predates the in-browser backend\n" + asm),
+    stats: () => '{"phases":[]}',
+  };
+}
+
+// The session exports this page calls. A compiler.wasm without them was built from older
+// sources than the ones next to it, and the page says so rather than pass its output off
+// as theirs.
+const sessionExports = ["_compilation_create", "_compilation_edit", "_compilation_asm", "_compilation_stats"];
+
+function showCompilerNotice(text) {
+  document.getElementById("compilerNotice").textContent = text;
+}
+
+// Settles either way: a module that fails to download or instantiate rejects, and the
+// next call tries again.
+function loadCompiler() {
+  if (!compilerReady) {
+    let failed;
+    const failure = new Promise((_, reject) => { failed = reject; });
+    const factory = Module({ instantiateWasm: (imports, done) => instantiateWasm(imports, done, failed) });
+    compilerReady = Promise.race([factory, failure]).then((Module) => {
+      const missing = sessionExports.filter((name) => !Module[name]);
+      showCompilerNotice(missing.length
+        ? `⚠️ ${wasmURL} is out of date: it lacks ${missing.map((name) => name.slice(1)).join(", ")}, so it was ` +
+          "built from older sources than this page. Results come from that older compiler; rebuild it with npm run build:wasm."
+        : "");
+      compiler = Module._compilation_create ? sessionCompiler(Module) : oneShotCompiler(Module);
+      return compiler;
+    }).catch((error) => {
+      compilerReady = null;
+      throw error;
+    });
+  }
+  return compilerReady;
+}
+loadCompiler().catch((error) => showCompilerNotice(`❌ The compiler failed to load: ${error.message}`));
+
+// One compilation per editor session: the WASM side memoizes tokens, AST and IR,
+// and keystrokes are forwarded as edits so only the touched region is re-lexed
+// and re-parsed.
+const dropSession = () => {
+  if (session) compiler.destroy(session);
+  session = 0;
+};
+// Monaco reports offsets in UTF-16 code units while the compilation indexes
+// UTF-8 bytes; the two only agree for ASCII text. An edit is forwarded only if
+// the text was ASCII both before and after it, so anything else falls back to a
+// fresh compilation on the next request.
+const isAscii = (text) => !/[^\x00-\x7f]/.test(text);
+let sourceIsAscii = true; // of the text the session holds, i.e. before the next edit
+
+const currentSession = () => {
+  if (!session) {
+    const text = editor.getValue();
+    sourceIsAscii = isAscii(text);
+    session = compiler.create(text);
+  }
+  return session;
+};
+
+// A trap (out of memory, say) leaves the instance unusable. The session goes with it,
+// and the next run gets a fresh instance from the already compiled module.
+async function runPhase(stage, phase, format = (output) => output) {
+  if (!compiler) document.getElementById("status").textContent = "Status: 🕐 Loading compiler...";
+  try {
+    await loadCompiler();
+  } catch (error) {
+    document.getElementById("output").textContent = `Error: the compiler failed to load: ${error.message}`;
+    document.getElementById("status").textContent = `Status: ❌ ${stage} failed`;
+    return;
+  }
+  try {
+    const start = performance.now();
+    const output = await phase(currentSession());
+    const time = performance.now() - start;
+    document.getElementById("output").textContent = format(output);
+    showStats(stage, time, !output.startsWith("Error") && !output.startsWith("; error"));
+    showPhaseStats(compiler.stats(session));
+  } catch (error) {
+    if (!(error instanceof WebAssembly.RuntimeError)) throw error;
+    compilerReady = compiler = null;
+    session = 0;
+    document.getElementById("output").textContent = `Error: ${error.message}`;
+    showStats(stage, 0, false);
+  }
+}
+
+const compileLexer = () => runPhase("Token Generation", (s) => compiler.tokens(s));
+const compileAST = () => runPhase("AST Generation", (s) => compiler.ast(s));
+const compileIR = () => runPhase("IR Generation", (s) => compiler.ir(s), (ir) => "LLVM IR:\n" + ir);
+const compileOptimizedIR = () => runPhase("Optimized IR Generation", (s) => compiler.optimizedIR(s));
+
+// The in-browser backend is the default; llc on the server is kept to cross-check it.
+const compileCodegen = () => {
+  const mode = document.getElementById("codegenMode").value;
+  return runPhase(mode === "llc" ? "Assembly (llc)" : "Assembly", (s) =>
+    mode === "llc" ? runCodegen(compiler.optimizedIR(s)) : compiler.asm(s));
+};
+
+async function runCodegen(ir) {
+  try {
+    const response = await fetch('http://localhost:3000/compile-ir', {
+      method: 'POST',
+      headers: { 'Content-Type': 'application/json' },
+      body: JSON.stringify({ ir })
+    });
+    if (!response.ok) throw new Error(`HTTP error! Status: ${response.status}`);
+    const result = await response.json();
+    return result.asm ? result.asm.replace(/\t/g, '\t').replace(/\r\n|\n|\r/g, '\n') : `Error: ${result.error}`;
+  } catch (error) {
+    return `Error: ${error.message}`;
+  }
+}
+
 document.addEventListener("DOMContentLoaded", () => {
   // Monaco Editor Loader
   require.config({ paths: { vs: "https://cdnjs.cloudflare.com/ajax/libs/monaco-editor/0.44.0/min/vs" } });
@@ -21,77 +242,21 @@ document.addEventListener("DOMContentLoaded", () => {
       fontSize: 14,
       minimap: { enabled: false }
     });
-  });
 
-  Module().then((Module) => {
-    const runLexer = Module.cwrap('run_lexer', 'string', ['string']);
-    const runAST = Module.cwrap('run_ast', 'string', ['string']);
-    const runIR = Module.cwrap('run_ir', 'string', ['string']);
-    const runOptimizedIR = Module.cwrap('run_optimized_ir', 'string', ['string']);
-
-    compileLexer = () => {
-      const code = editor.getValue();
-      const start = performance.now();
-      const result = runLexer(code);
-      const time = performance.now() - start;
-      document.getElementById("output").textContent = result;
-      showStats("Token Generation", time);
-    };
-
-    compileAST = () => {
-      const code = editor.getValue();
-      const start = performance.now();
-      const result = runAST(code);
-      const time = performance.now() - start;
-      document.getElementById("output").textContent = result;
-      showStats("AST Generation", time);
-    };
-
-    compileIR = () => {
-      const code = editor.getValue();
-      const start = performance.now();
-      const result = runIR(code);
-      const time = performance.now() - start;
-      document.getElementById("output").textContent = "LLVM IR:\n" + result;
-      showStats("IR Generation", time);
-    };
-
-    compileOptimizedIR = () => {
-      const code = editor.getValue();
-      const start = performance.now();
-      const ir = runIR(code);
-      const optimized = runOptimizedIR(ir);
-      const time = performance.now() - start;
-      document.getElementById("output").textContent = optimized;
-      showStats("Optimized IR Generation", time);
-    };
-
-    compileCodegen = async () => {
-      const code = editor.getValue();
-      const start = performance.now();
-      const ir = runIR(code);
-      const optimized = runOptimizedIR(ir);
-      const output = await runCodegen(optimized);
-      const time = performance.now() - start;
-      document.getElementById("output").textContent = output;
-      const success = !output.includes("error") && output.includes("Execution result");
-      showStats("Code Execution", time, success);
-    };
-
-    async function runCodegen(ir) {
-      try {
-        const response = await fetch('http://localhost:3000/compile-ir', {
-          method: 'POST',
-          headers: { 'Content-Type': 'application/json' },
-          body: JSON.stringify({ ir })
-        });
-        if (!response.ok) throw new Error(`HTTP error! Status: ${response.status}`);
-        const result = await response.json();
-        return result.asm ? result.asm.replace(/\t/g, '\t').replace(/\r\n|\n|\r/g, '\n') : `Error: ${result.error}`;
-      } catch (error) {
-        return `Error: ${error.message}`;
+    editor.onDidChangeModelContent((e) => {
+      const wasAscii = sourceIsAscii;
+      sourceIsAscii = isAscii(editor.getValue());
+      if (!session) return;
+      if (!wasAscii || !sourceIsAscii) return dropSession();
+      // Changes in one event refer to the pre-edit text; applying them from the
+      // end backwards keeps the earlier offsets valid.
+      const changes = [...e.changes].sort((a, b) => b.rangeOffset - a.rangeOffset);
+      for (const change of changes) {
+        if (!compiler.edit(session, change.rangeOffset, change.rangeLength, change.text)) {
+          return dropSession();
+        }
       }
-    }
+    });
   });
 });
 
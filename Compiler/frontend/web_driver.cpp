@@ -1,813 +1,2516 @@
+#include "web_driver.h"
 #include <string>
-#include <sstream>
+#include <algorithm>
+#include <cstring>
+#include <iterator>
 #include <vector>
-#include <regex>
-#include <map>
-#include <iostream>
+#ifdef __EMSCRIPTEN__
 #include <emscripten/emscripten.h>
+#else
+#define EMSCRIPTEN_KEEPALIVE
+#endif
 #include <cstdio>
 #include <unordered_map>
-#include <iomanip>  // for std::setprecision, std::fixed
+#include <chrono>
+#include <cstdlib>
 
-std::unordered_map<std::string, std::string> globalSymbolTable;
-std::vector<std::string> semanticErrors;
-
-std::string result;
-std::map<std::string, std::string> namedValues;
 // -------------------- Lexer --------------------
-struct Token {
-    std::string type, value;
+const char* tokenKindName(TokenKind kind) {
+    switch (kind) {
+        case TokenKind::Keyword:    return "KEYWORD";
+        case TokenKind::Identifier: return "IDENTIFIER";
+        case TokenKind::Integer:    return "INTEGER";
+        case TokenKind::Float:      return "FLOAT";
+        case TokenKind::Char:       return "CHAR";
+        case TokenKind::Symbol:     return "SYMBOL";
+        case TokenKind::EndOfFile:  return "EOF";
+    }
+    return "UNKNOWN";
+}
+
+// Character classes driving the lexer DFA. Every byte maps to exactly one class.
+enum CharClass : uint8_t {
+    CC_Skip,      // bytes the language does not use; silently dropped
+    CC_Space,
+    CC_Digit,
+    CC_Ident,     // [a-zA-Z_]
+    CC_Single,    // + - * ( ) { } [ ] ; ,
+    CC_Pair,      // = < > !  (may be followed by '=')
+    CC_Slash,     // '/' : division or start of a comment
+    CC_Quote      // '\'' : char literal
 };
 
-std::string removeComments(const std::string& code) {
-    std::string result;
-    bool in_single = false, in_multi = false;
+struct CharClassTable {
+    CharClass cls[256];
+    constexpr CharClassTable() : cls() {
+        for (int c = 0; c < 256; ++c) cls[c] = CC_Skip;
+        cls[(unsigned char)' '] = cls[(unsigned char)'\t'] = cls[(unsigned char)'\n'] = CC_Space;
+        cls[(unsigned char)'\v'] = cls[(unsigned char)'\f'] = cls[(unsigned char)'\r'] = CC_Space;
+        for (int c = '0'; c <= '9'; ++c) cls[c] = CC_Digit;
+        for (int c = 'a'; c <= 'z'; ++c) cls[c] = CC_Ident;
+        for (int c = 'A'; c <= 'Z'; ++c) cls[c] = CC_Ident;
+        cls[(unsigned char)'_'] = CC_Ident;
+        for (char c : {'+', '-', '*', '(', ')', '{', '}', '[', ']', ';', ','}) cls[(unsigned char)c] = CC_Single;
+        for (char c : {'=', '<', '>', '!'}) cls[(unsigned char)c] = CC_Pair;
+        cls[(unsigned char)'/'] = CC_Slash;
+        cls[(unsigned char)'\''] = CC_Quote;
+    }
+};
 
-    for (size_t i = 0; i < code.size(); ++i) {
-        if (in_single && code[i] == '\n') { in_single = false; result += '\n'; continue; }
-        if (in_multi && code[i] == '*' && code[i+1] == '/') { in_multi = false; ++i; continue; }
+constexpr CharClassTable kCharClass;
 
-        if (!in_single && !in_multi) {
-            if (code[i] == '/' && code[i+1] == '/') { in_single = true; ++i; continue; }
-            if (code[i] == '/' && code[i+1] == '*') { in_multi = true; ++i; continue; }
-            result += code[i];
-        }
+inline CharClass charClass(char c) { return kCharClass.cls[(unsigned char)c]; }
+
+bool isKeyword(std::string_view word) {
+    switch (word.size()) {
+        case 2: return word == "if";
+        case 3: return word == "int" || word == "for";
+        case 4: return word == "char" || word == "else";
+        case 5: return word == "float" || word == "while";
+        case 6: return word == "return";
     }
-    return result;
+    return false;
 }
-// std::vector<Token> tokens;
-std::vector<Token> tokenizeStructured(const std::string& input) {
-    std::string clean = removeComments(input);
-    std::vector<Token> tokens;
 
-    // Match patterns: whitespace, float literals, char literals, multi-char symbols, integers, identifiers, single-char symbols
-    std::regex pattern(R"(\s+|==|!=|<=|>=|[+\-*/=<>(){};]|'[^']'|\d+\.\d+|\d+|[a-zA-Z_][a-zA-Z0-9_]*)");
-
-    std::map<std::string, std::string> keywords = {
-        {"int", "KEYWORD"},
-        {"float", "KEYWORD"},
-        {"char", "KEYWORD"},
-        {"return", "KEYWORD"},
-        {"if", "KEYWORD"},
-        {"else", "KEYWORD"},
-        {"while", "KEYWORD"},
-        {"for", "KEYWORD"}
-    };
+// Cursor over a source buffer. next() scans one token, skipping whitespace, comments and
+// bytes the language does not use, and returns false once the input is exhausted. Between
+// tokens the lexer carries no state, so any previous token start is a valid place to resume.
+struct Lexer {
+    const char* begin;
+    const char* end;
+    const char* p;
+
+    Lexer(std::string_view input, size_t pos = 0)
+        : begin(input.data()), end(input.data() + input.size()), p(input.data() + pos) {}
+
+    size_t position() const { return static_cast<size_t>(p - begin); }
+
+    bool next(Token& out) {
+        auto emit = [&](TokenKind kind, const char* start) {
+            out = {kind, std::string_view(start, p - start), static_cast<uint32_t>(start - begin)};
+            return true;
+        };
+
+        while (p < end) {
+            const char* start = p;
+            switch (charClass(*p)) {
+                case CC_Skip:
+                    ++p;
+                    break;
 
-    for (auto it = std::sregex_iterator(clean.begin(), clean.end(), pattern); it != std::sregex_iterator(); ++it) {
-        std::string tok = (*it).str();
-
-        // Skip whitespace
-        if (std::regex_match(tok, std::regex(R"(\s+)"))) continue;
-
-        std::string type;
-        if (keywords.count(tok)) {
-            type = keywords[tok];
-        } else if (std::regex_match(tok, std::regex(R"(\d+\.\d+)"))) {
-            type = "FLOAT";
-        } else if (std::regex_match(tok, std::regex(R"(\d+)"))) {
-            type = "INTEGER";
-        } else if (std::regex_match(tok, std::regex(R"('([^']|\\')')"))) {
-            type = "CHAR";
-        } else if (std::regex_match(tok, std::regex(R"([a-zA-Z_][a-zA-Z0-9_]*)"))) {
-            type = "IDENTIFIER";
-        } else {
-            type = "SYMBOL";
+                case CC_Space:
+                    while (p < end && charClass(*p) == CC_Space) ++p;
+                    break;
+
+                case CC_Digit:
+                    while (p < end && charClass(*p) == CC_Digit) ++p;
+                    if (p + 1 < end && *p == '.' && charClass(p[1]) == CC_Digit) {
+                        p += 2;
+                        while (p < end && charClass(*p) == CC_Digit) ++p;
+                        return emit(TokenKind::Float, start);
+                    }
+                    return emit(TokenKind::Integer, start);
+
+                case CC_Ident:
+                    while (p < end && (charClass(*p) == CC_Ident || charClass(*p) == CC_Digit)) ++p;
+                    return emit(isKeyword(std::string_view(start, p - start)) ? TokenKind::Keyword : TokenKind::Identifier, start);
+
+                case CC_Single:
+                    ++p;
+                    return emit(TokenKind::Symbol, start);
+
+                case CC_Pair:
+                    if (p + 1 < end && p[1] == '=') {
+                        p += 2;
+                        return emit(TokenKind::Symbol, start);
+                    }
+                    ++p;
+                    if (*start == '!') break; // a lone '!' is not an operator in this language
+                    return emit(TokenKind::Symbol, start);
+
+                case CC_Slash:
+                    if (p + 1 < end && p[1] == '/') {
+                        p += 2;
+                        while (p < end && *p != '\n') ++p;
+                    } else if (p + 1 < end && p[1] == '*') {
+                        p += 2;
+                        while (p + 1 < end && !(p[0] == '*' && p[1] == '/')) ++p;
+                        p = (p + 1 < end) ? p + 2 : end;
+                    } else {
+                        ++p;
+                        return emit(TokenKind::Symbol, start);
+                    }
+                    break;
+
+                case CC_Quote:
+                    if (p + 2 < end && p[1] != '\'' && p[2] == '\'') {
+                        p += 3;
+                        return emit(TokenKind::Char, start);
+                    }
+                    ++p;
+                    break;
+            }
         }
 
-        tokens.push_back({type, tok});
+        return false;
     }
+};
 
+// Single pass over the input: comments are skipped inline and each token is a view into `input`.
+std::vector<Token> tokenizeStructured(std::string_view input) {
+    std::vector<Token> tokens;
+    tokens.reserve(input.size() / 4 + 16);
+
+    Lexer lexer(input);
+    Token tok;
+    while (lexer.next(tok)) tokens.push_back(tok);
     return tokens;
 }
 
+void ChunkedLexer::feed(std::string_view chunk, std::vector<Token>& out) {
+    buffer.erase(0, consumed);
+    base += consumed;
+    consumed = 0;
+    buffer.append(chunk);
+    scan(false, out);
+}
+
+void ChunkedLexer::finish(std::vector<Token>& out) {
+    scan(true, out);
+    buffer.clear();
+    base += consumed;
+    consumed = 0;
+}
+
+// Lexer::next reads at most one byte past where it stops, so a scan that stops at least two
+// bytes before the end of the buffer sees exactly what it would with the rest of the input
+// appended. Anything closer to the end is rescanned once the next chunk arrives.
+void ChunkedLexer::scan(bool atEnd, std::vector<Token>& out) {
+    Lexer lexer(buffer, consumed);
+    Token tok;
+    for (;;) {
+        size_t before = lexer.position();
+        bool found = lexer.next(tok);
+        if (!atEnd && lexer.position() + 1 >= buffer.size()) {
+            consumed = before;
+            return;
+        }
+        if (!found) {
+            consumed = lexer.position();
+            return;
+        }
+        tok.offset = static_cast<uint32_t>(base + tok.offset);
+        out.push_back(tok);
+    }
+}
 
 std::string serializeTokens(const std::vector<Token>& tokens) {
-    std::stringstream ss;
-    for (const auto& t : tokens)
-        ss << "TOKEN(" << t.type << ", \"" << t.value << "\")\n";
-    return ss.str();
+    std::string out;
+    out.reserve(tokens.size() * 24);
+    for (const auto& t : tokens) {
+        out += "TOKEN(";
+        out += tokenKindName(t.kind);
+        out += ", \"";
+        out += t.value;
+        out += "\")\n";
+    }
+    return out;
 }
 
 // -------------------- AST --------------------
-struct ASTNode {
-    std::string type;
-    std::string value;
-    std::vector<ASTNode*> children;
-
-    // Optional metadata for semantic analysis
-    std::string inferredType;
-    bool isDeclared = false;
-
-    ASTNode(std::string t, std::string v = "") : type(t), value(v) {}
-    ~ASTNode() {
-        for (auto* child : children) delete child;
+const char* nodeKindName(NodeKind kind) {
+    switch (kind) {
+        case NodeKind::Root:       return "ROOT";
+        case NodeKind::Function:   return "Function";
+        case NodeKind::ReturnType: return "ReturnType";
+        case NodeKind::Param:      return "Param";
+        case NodeKind::Block:      return "Block";
+        case NodeKind::VarDecl:    return "VarDecl";
+        case NodeKind::Type:       return "Type";
+        case NodeKind::Name:       return "Name";
+        case NodeKind::Literal:    return "Literal";
+        case NodeKind::Identifier: return "Identifier";
+        case NodeKind::BinaryOp:   return "BinaryOp";
+        case NodeKind::Assignment: return "Assignment";
+        case NodeKind::Return:     return "Return";
+        case NodeKind::Call:       return "Call";
+        case NodeKind::If:         return "If";
+        case NodeKind::While:      return "While";
+        case NodeKind::For:        return "For";
+        case NodeKind::ArrayDecl:  return "ArrayDecl";
+        case NodeKind::Index:      return "Index";
     }
-};
+    return "Unknown";
+}
 
-size_t current = 0;
-std::vector<Token> tokens;
+bool isComparison(std::string_view op) {
+    return op == "<" || op == "<=" || op == ">" || op == ">=" || op == "==" || op == "!=";
+}
 
-Token peek() {
-    if (current < tokens.size()) return tokens[current];
-    return {"EOF", ""};
+namespace {
+uint64_t hashText(std::string_view text) {
+    uint64_t h = 1469598103934665603ull;  // FNV-1a
+    for (char c : text) h = (h ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+    h ^= h >> 33;  // fmix64 finalizer: FNV alone clusters badly for names like v1, v2, ...
+    h *= 0xff51afd7ed558ccdull;
+    return h ^ (h >> 33);
+}
 }
 
-Token advance() {
-    if (current < tokens.size()) return tokens[current++];
-    return {"EOF", ""};
+int32_t decodeIntLiteral(std::string_view text);
+
+// How tightly a binary operator binds, as in C, or 0 for a token that is not one. All of
+// them associate to the left.
+int precedence(const Token& tok) {
+    if (tok.kind != TokenKind::Symbol) return 0;
+    std::string_view op = tok.value;
+    if (op == "*" || op == "/") return 4;
+    if (op == "+" || op == "-") return 3;
+    if (op == "<" || op == "<=" || op == ">" || op == ">=") return 2;
+    if (op == "==" || op == "!=") return 1;
+    return 0;
 }
 
-bool check(const std::string& type) {
-    return peek().type == type || peek().value == type;
+// `left op right` for two int literals, as every backend would compute it at run time.
+// Comparisons are left to the optimizer, and so is a division that would trap.
+bool foldIntegers(std::string_view op, int32_t left, int32_t right, int32_t& out) {
+    auto wrap = [](uint32_t v) { return static_cast<int32_t>(v); };
+    if (op == "+") out = wrap(uint32_t(left) + uint32_t(right));
+    else if (op == "-") out = wrap(uint32_t(left) - uint32_t(right));
+    else if (op == "*") out = wrap(uint32_t(left) * uint32_t(right));
+    else if (op == "/" && right != 0 && !(right == -1 && left == INT32_MIN)) out = left / right;
+    else return false;
+    return true;
 }
 
-bool match(const std::string& expected) {
-    if (check(expected)) {
-        advance();
-        return true;
+// Recursive-descent parser over one token stream. All state lives here and in the
+// context it reports errors to, so separate compilations can parse on separate threads.
+struct Parser {
+    // The token stream being parsed; indexing records the furthest token looked at.
+    // Incremental reparsing uses that to tell which top-level items could be affected
+    // by a change further along the stream. Any index past the end reads as end of file.
+    // A Compilation's tokens have a gap of gapSize elements at gapBegin.
+    struct TokenSpan {
+        const Token* data = nullptr;
+        size_t count = 0;
+        size_t gapBegin = 0;
+        size_t gapSize = 0;
+        size_t* furthest = nullptr;
+        const Token& operator[](size_t i) const {
+            static const Token kEndOfFile{TokenKind::EndOfFile, "", 0};
+            if (i > *furthest) *furthest = i;
+            return i < count ? data[i < gapBegin ? i : i + gapSize] : kEndOfFile;
+        }
+        size_t size() const { return count; }
+    };
+
+    CompileContext& ctx;
+    Arena& arena;
+    size_t furthestToken = 0;
+    TokenSpan tokens;
+    size_t current = 0;
+    uint32_t depth = 0;  // statement bodies and brackets open around `current`
+    // Children of nodes still being parsed. Each parse function records the current size,
+    // pushes its children, then moves them into the arena with finishChildren.
+    std::vector<ASTNode*> childStack;
+    // Expression nodes made since the last declaration, by hash of kind, text and children,
+    // so that an expression written again gets the node already built for it. A declaration
+    // can change what a name means, and so can the end of a block, so both start afresh.
+    std::unordered_multimap<uint64_t, ASTNode*> expressions;
+
+    Parser(CompileContext& context, const std::vector<Token>& toks, Arena& a, size_t from = 0)
+        : ctx(context), arena(a), furthestToken(from), tokens{toks.data(), toks.size(), toks.size(), 0, &furthestToken},
+          current(from) {}
+    Parser(CompileContext& context, const GapBuffer<Token>& toks, Arena& a, size_t from = 0)
+        : ctx(context), arena(a), furthestToken(from),
+          tokens{toks.physical(), toks.size(), toks.gap(), toks.gapSize(), &furthestToken}, current(from) {}
+
+    // Copies `text` into the arena so the tree stays valid after the source buffer is edited.
+    std::string_view arenaText(std::string_view text) {
+        if (text.empty()) return {};
+        char* copy = arena.makeArray<char>(text.size());
+        std::memcpy(copy, text.data(), text.size());
+        return std::string_view(copy, text.size());
     }
-    return false;
-}
 
-bool consume(const std::string& expected) {
-    if (match(expected)) return true;
-    semanticErrors.push_back("Expected '" + expected + "' but got '" + peek().value + "'");
-    return false;
-}
+    ASTNode* makeNode(NodeKind kind, std::string_view value = {}) {
+        return arena.make<ASTNode>(kind, arenaText(value));
+    }
+
+    ASTNode* makeNode(NodeKind kind, std::string_view value, std::initializer_list<ASTNode*> kids) {
+        ASTNode* node = makeNode(kind, value);
+        node->children = arena.makeArray<ASTNode*>(kids.size());
+        for (ASTNode* kid : kids) node->children[node->childCount++] = kid;
+        return node;
+    }
 
-ASTNode* parsePrimary() {
-    if (tokens[current].type == "INTEGER") return new ASTNode("Literal", tokens[current++].value);
-    if (tokens[current].type == "IDENTIFIER") {
-        std::string id = tokens[current++].value;
-        if (tokens[current].value == "(") {
-            current++;
-            ASTNode* call = new ASTNode("Call", id);
-            while (tokens[current].value != ")") {
-                call->children.push_back(parsePrimary());
-                if (tokens[current].value == ",") current++;
+    // Starts the table of expressions afresh. Assigning frees the buckets, where clear()
+    // would walk all of them, however few expressions the table last held.
+    void forgetExpressions() {
+        if (!expressions.empty()) expressions = {};
+    }
+
+    // The expression node for `kind` with `value` over `kids`: one made earlier if there is
+    // an equal one, else a new node. Returns nullptr, after reporting it, if the expression
+    // would be more than kMaxExpressionDepth high.
+    ASTNode* expression(NodeKind kind, std::string_view value, ASTNode* const* kids, uint32_t count) {
+        uint32_t height = 1;
+        for (uint32_t i = 0; i < count; ++i) height = std::max(height, kids[i]->height + 1u);
+        if (height > kMaxExpressionDepth) {
+            ctx.errors.push_back("Expression is more than " + std::to_string(kMaxExpressionDepth) + " levels deep");
+            return nullptr;
+        }
+        uint64_t hash = hashText(value) + static_cast<uint64_t>(kind);
+        for (uint32_t i = 0; i < count; ++i) hash = (hash ^ reinterpret_cast<uintptr_t>(kids[i])) * 0x9e3779b97f4a7c15ull;
+        auto range = expressions.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it) {
+            ASTNode* node = it->second;
+            if (node->kind == kind && node->value == value && node->childCount == count &&
+                std::equal(kids, kids + count, node->children)) {
+                node->shared = true;
+                return node;
             }
-            current++; // skip ')'
-            return call;
         }
-        return new ASTNode("Identifier", id);
+        ASTNode* node = makeNode(kind, value);
+        node->height = static_cast<uint16_t>(height);
+        if (count) {
+            node->children = arena.makeArray<ASTNode*>(count);
+            std::copy(kids, kids + count, node->children);
+            node->childCount = count;
+        }
+        expressions.emplace(hash, node);
+        return node;
     }
-    return nullptr;
-}
-ASTNode* parseExpression() {
-    // Parse left operand
-    Token leftTok = advance();
-    ASTNode* left = nullptr;
 
-    if (leftTok.type == "IDENTIFIER") {
-        left = new ASTNode("Identifier", leftTok.value);
-    } else if (leftTok.type == "INTEGER" || leftTok.type == "FLOAT" || leftTok.type == "CHAR") {
-        left = new ASTNode("Literal", leftTok.value);
-    } else {
-        return nullptr;
+    // `left op right`, folded into a literal when both sides are int literals.
+    ASTNode* binary(std::string_view op, ASTNode* left, ASTNode* right) {
+        int32_t folded;
+        if (left->kind == NodeKind::Literal && right->kind == NodeKind::Literal &&
+            left->value.find('.') == std::string_view::npos && right->value.find('.') == std::string_view::npos &&
+            foldIntegers(op, decodeIntLiteral(left->value), decodeIntLiteral(right->value), folded)) {
+            std::string text = std::to_string(folded);
+            return expression(NodeKind::Literal, text, nullptr, 0);
+        }
+        ASTNode* kids[] = {left, right};
+        return expression(NodeKind::BinaryOp, op, kids, 2);
     }
 
-    // Check if next token is a binary operator
-    if (peek().type == "SYMBOL" && (peek().value == "+" || peek().value == "-" || peek().value == "*" || peek().value == "/")) {
-        Token opTok = advance();
-        Token rightTok = advance();
+    void finishChildren(ASTNode* node, size_t mark) {
+        size_t n = childStack.size() - mark;
+        node->children = arena.makeArray<ASTNode*>(n);
+        std::copy(childStack.begin() + mark, childStack.end(), node->children);
+        node->childCount = static_cast<uint32_t>(n);
+        childStack.resize(mark);
+    }
 
-        ASTNode* right = nullptr;
-        if (rightTok.type == "IDENTIFIER") {
-            right = new ASTNode("Identifier", rightTok.value);
-        } else if (rightTok.type == "INTEGER" || rightTok.type == "FLOAT" || rightTok.type == "CHAR") {
-            right = new ASTNode("Literal", rightTok.value);
-        } else {
-            return nullptr;
+    const Token& peek() {
+        return tokens[current];
+    }
+
+    // The current token, moving past it unless the input has ended.
+    const Token& advance() {
+        const Token& tok = tokens[current];
+        if (current < tokens.size()) ++current;
+        return tok;
+    }
+
+    // Holds one more level of statement bodies or brackets open while it lives, unless
+    // kMaxNesting are open already; then `ok` is false and the error has been reported.
+    struct Nested {
+        Parser& parser;
+        bool ok;
+        explicit Nested(Parser& p) : parser(p), ok(p.depth < kMaxNesting) {
+            if (ok) ++parser.depth;
+            else p.ctx.errors.push_back("Nesting is more than " + std::to_string(kMaxNesting) + " levels deep");
+        }
+        ~Nested() {
+            if (ok) --parser.depth;
         }
+    };
 
-        ASTNode* binOp = new ASTNode("BinaryOp", opTok.value);
-        binOp->children.push_back(left);
-        binOp->children.push_back(right);
-        return binOp;
+    // Panic-mode recovery after a construct that reported an error: skips through the next
+    // `;` outside brackets, a whole bracketed group if one starts here, or a braced body
+    // the skipped tokens opened. A closing bracket of an enclosing construct is left for
+    // it. Every token is skipped at most once, so recovery costs linear time overall.
+    void synchronize() {
+        bool group = check("(") || check("[") || check("{");
+        uint32_t open = 0;
+        while (current < tokens.size()) {
+            const Token& tok = tokens[current];
+            std::string_view v = tok.kind == TokenKind::Symbol ? tok.value : std::string_view();
+            if (v == "(" || v == "[" || v == "{") {
+                ++open;
+            } else if (v == ")" || v == "]" || v == "}") {
+                if (open == 0) return;
+                if (--open == 0 && (group || v == "}")) {
+                    ++current;
+                    return;
+                }
+            } else if (v == ";" && open == 0) {
+                ++current;
+                return;
+            }
+            ++current;
+        }
     }
 
-    return left; // no operator, just a single operand
-}
+    bool check(TokenKind kind) {
+        return peek().kind == kind;
+    }
 
+    bool check(std::string_view value) {
+        return peek().value == value;
+    }
 
+    bool match(std::string_view expected) {
+        if (check(expected)) {
+            advance();
+            return true;
+        }
+        return false;
+    }
 
+    // The current token as diagnostics quote it.
+    std::string quoted() {
+        if (check(TokenKind::EndOfFile)) return "end of input";
+        return "'" + std::string(peek().value) + "'";
+    }
 
+    bool consume(std::string_view expected) {
+        if (match(expected)) return true;
+        ctx.errors.push_back("Expected '" + std::string(expected) + "' but got " + quoted());
+        return false;
+    }
 
-ASTNode* parseVarDecl() {
-    // Check for variable type keyword
-    if (!(peek().value == "int" || peek().value == "float" || peek().value == "char")) return nullptr;
+    bool checkType() {
+        return check("int") || check("float") || check("char");
+    }
 
-    Token typeTok = advance(); // int, float, char
-    std:: cout<<typeTok.value;
-    Token nameTok = advance();
-    std::cout<<nameTok.value;
+    // Whether a statement of a function body, the empty one included, can start here.
+    bool atStatement() {
+        return check(";") || check("{") || check("if") || check("while") || check("for") || check("return") ||
+               checkType() || check(TokenKind::Identifier);
+    }
 
+    // Whether a function, declaration or statement of the top level can start here.
+    bool atTopLevelItem() {
+        return check(";") || check("return") || checkType() || check(TokenKind::Identifier);
+    }
 
-    if (nameTok.type != "IDENTIFIER") return nullptr;
+    // The `;` ending a statement. A statement missing it is still kept when another one
+    // starts right after, the usual slip; otherwise the caller drops it and resynchronizes.
+    bool endStatement() {
+        return consume(";") || check("}") || atStatement();
+    }
 
-    ASTNode* varDecl = new ASTNode("VarDecl");
-    varDecl->children.push_back(new ASTNode("Type", typeTok.value));
-    varDecl->children.push_back(new ASTNode("Name", nameTok.value));
+    // Reports a token that starts nothing where `expected` should be, and skips it with the
+    // run of such tokens after it, so that a run of stray tokens costs one diagnostic.
+    void skipStray(const char* expected, bool topLevel) {
+        ctx.errors.push_back(std::string("Expected ") + expected + " but got " + quoted());
+        do {
+            advance();
+        } while (!check(TokenKind::EndOfFile) && !(topLevel ? atTopLevelItem() : check("}") || atStatement()));
+    }
 
-    // Optional initialization
-    if (peek().value == "=") {
-        advance(); // consume '='
-        ASTNode* expr = parseExpression();
-        if (!expr) return nullptr;
-        varDecl->children.push_back(expr);
+    // `( args )` after a function name, each argument an expression.
+    ASTNode* parseCall(std::string_view name) {
+        Nested nested(*this);
+        if (!nested.ok) return nullptr;
+        advance();  // (
+        size_t mark = childStack.size();
+        if (!check(")")) {
+            do {
+                size_t errorMark = ctx.errors.size();
+                ASTNode* arg = parseExpression();
+                if (!arg) {
+                    if (ctx.errors.size() == errorMark) {
+                        ctx.errors.push_back("Expected an argument in the call to '" + std::string(name) + "'.");
+                    }
+                    childStack.resize(mark);
+                    return nullptr;
+                }
+                childStack.push_back(arg);
+            } while (match(","));
+        }
+        if (!consume(")")) {
+            childStack.resize(mark);
+            return nullptr;
+        }
+        ASTNode* call = expression(NodeKind::Call, name, childStack.data() + mark,
+                                   static_cast<uint32_t>(childStack.size() - mark));
+        childStack.resize(mark);
+        return call;
     }
 
-    if (!match(";")) return nullptr; // expect ';' at end
+    // `[ expr ]` after an array name.
+    ASTNode* parseIndex(std::string_view name) {
+        Nested nested(*this);
+        if (!nested.ok) return nullptr;
+        advance();  // [
+        size_t errorMark = ctx.errors.size();
+        ASTNode* index = parseExpression();
+        if (!index && ctx.errors.size() == errorMark) ctx.errors.push_back("Expected an index after '" + std::string(name) + "['.");
+        consume("]");
+        return index;
+    }
 
-    return varDecl;
-}
+    // A variable, an array element, a call, a literal or a parenthesized expression. A token
+    // that starts none of them is left for error recovery.
+    ASTNode* parseOperand() {
+        if (check("(")) {
+            Nested nested(*this);
+            if (!nested.ok) return nullptr;
+            advance();
+            size_t errorMark = ctx.errors.size();
+            ASTNode* inner = parseExpression();
+            if (!inner) {
+                if (ctx.errors.size() == errorMark) ctx.errors.push_back("Expected an expression after '('.");
+                return nullptr;
+            }
+            return consume(")") ? inner : nullptr;
+        }
+        Token tok = peek();
+        if (tok.kind == TokenKind::Identifier) {
+            advance();
+            if (check("(")) return parseCall(tok.value);
+            if (!check("[")) return expression(NodeKind::Identifier, tok.value, nullptr, 0);
+            ASTNode* index = parseIndex(tok.value);
+            return index ? expression(NodeKind::Index, tok.value, &index, 1) : nullptr;
+        }
+        if (tok.kind == TokenKind::Integer || tok.kind == TokenKind::Float || tok.kind == TokenKind::Char) {
+            advance();
+            return expression(NodeKind::Literal, tok.value, nullptr, 0);
+        }
+        return nullptr;
+    }
 
-ASTNode* parseStatement() {
-    if (match("int")) {
-        // Variable declaration
-        if (check("Identifier")) {
-            std::string varName = advance().value;
-            if (globalSymbolTable.count(varName)) {
-                semanticErrors.push_back("Variable '" + varName + "' re-declared.");
-            } else {
-                globalSymbolTable[varName] = "int";
+    // Precedence climbing: an operand followed by every operator that binds at least as
+    // tightly as `minPrecedence`, each with its own right-hand side parsed one level up.
+    ASTNode* parseBinary(int minPrecedence) {
+        ASTNode* left = parseOperand();
+        if (!left) return nullptr;
+        for (int prec; (prec = precedence(peek())) >= minPrecedence;) {
+            Token op = advance();
+            size_t errorMark = ctx.errors.size();
+            ASTNode* right = parseBinary(prec + 1);
+            if (!right) {
+                if (ctx.errors.size() == errorMark) ctx.errors.push_back("Expected an operand after '" + std::string(op.value) + "'.");
+                return nullptr;
             }
-            consume(";");
-            ASTNode* varDecl = new ASTNode("VarDecl", varName);
-            varDecl->children.push_back(new ASTNode("Type", "int"));
-            return varDecl;
-        } else {
-            semanticErrors.push_back("Expected variable name after 'int'.");
+            left = binary(op.value, left, right);
+            if (!left) return nullptr;
+        }
+        return left;
+    }
+
+    ASTNode* parseExpression() {
+        return parseBinary(1);
+    }
+
+    // `type name;`, `type name = expr;` or `type name[length];`, reporting what is wrong with
+    // one that is malformed and returning nullptr for the caller to resynchronize.
+    ASTNode* parseVarDecl() {
+        if (!checkType()) return nullptr;
+
+        Token typeTok = advance(); // int, float, char
+        if (!check(TokenKind::Identifier)) {
+            ctx.errors.push_back("Expected variable name after '" + std::string(typeTok.value) + "'.");
             return nullptr;
         }
-    } else if (check("Identifier")) {
-        // Assignment
-        std::string varName = advance().value;
-        if (!globalSymbolTable.count(varName)) {
-            semanticErrors.push_back("Undeclared variable: " + varName);
+        Token nameTok = advance();
+        forgetExpressions();
+
+        ASTNode* typeNode = makeNode(NodeKind::Type, typeTok.value);
+        ASTNode* nameNode = makeNode(NodeKind::Name, nameTok.value);
+
+        // `type name[length];`, uninitialized as in C
+        if (match("[")) {
+            Token lengthTok = advance();
+            if (lengthTok.kind != TokenKind::Integer) {
+                ctx.errors.push_back("Expected an array length after '" + std::string(nameTok.value) + "['.");
+                return nullptr;
+            }
+            if (!consume("]") || !endStatement()) return nullptr;
+            return makeNode(NodeKind::ArrayDecl, {}, {typeNode, nameNode, makeNode(NodeKind::Literal, lengthTok.value)});
         }
-        if (match("=")) {
+
+        // Optional initialization
+        ASTNode* expr = nullptr;
+        if (peek().value == "=") {
+            advance(); // consume '='
+            size_t errorMark = ctx.errors.size();
+            expr = parseExpression();
+            if (!expr) {
+                if (ctx.errors.size() == errorMark) {
+                    ctx.errors.push_back("Expected an expression after '" + std::string(nameTok.value) + " ='.");
+                }
+                return nullptr;
+            }
+        }
+
+        if (!endStatement()) return nullptr;
+
+        if (expr) return makeNode(NodeKind::VarDecl, {}, {typeNode, nameNode, expr});
+        return makeNode(NodeKind::VarDecl, {}, {typeNode, nameNode});
+    }
+
+    ASTNode* parseStatement() {
+        if (checkType()) {
+            // Variable declaration, with or without an initializer
+            return parseVarDecl();
+        } else if (check(TokenKind::Identifier)) {
+            // Assignment
+            std::string_view varName = advance().value;
+            if (match("=")) {
+                ASTNode* expr = parseExpression();
+                consume(";");
+                return makeNode(NodeKind::Assignment, varName, {expr});
+            } else {
+                ctx.errors.push_back("Expected '=' after identifier.");
+                return nullptr;
+            }
+        } else if (match("return")) {
+            // Return statement
             ASTNode* expr = parseExpression();
             consume(";");
-            ASTNode* assign = new ASTNode("Assignment", varName);
-            assign->children.push_back(expr);
-            return assign;
-        } else {
-            semanticErrors.push_back("Expected '=' after identifier.");
-            return nullptr;
+            return makeNode(NodeKind::Return, {}, {expr});
         }
-    } else if (match("return")) {
-        // Return statement
+        return nullptr;
+    }
+
+    ASTNode* parseReturn() {
+        current++; // skip 'return'
+        size_t errorMark = ctx.errors.size();
         ASTNode* expr = parseExpression();
+        if (!expr && ctx.errors.size() > errorMark) return nullptr;  // the caller skips the rest
+        if (!endStatement()) return nullptr;
+        if (expr) return makeNode(NodeKind::Return, {}, {expr});
+        return makeNode(NodeKind::Return);
+    }
+
+
+    // `name = expr` or `name[index] = expr`, with the `;` only when the assignment is a
+    // statement of its own (a for-loop step has none).
+    ASTNode* parseAssignment(bool statement) {
+        std::string_view varName = advance().value;
+        ASTNode* index = nullptr;
+        if (check("[") && !(index = parseIndex(varName))) return nullptr;
+        if (!consume("=")) return nullptr;
+        size_t errorMark = ctx.errors.size();
+        ASTNode* expr = parseExpression();
+        if (!expr) {
+            if (ctx.errors.size() == errorMark) {
+                ctx.errors.push_back("Expected an expression after '" + std::string(varName) + " ='.");
+            }
+            return nullptr;
+        }
+        if (statement) consume(";");
+        if (index) return makeNode(NodeKind::Assignment, varName, {expr, index});
+        return makeNode(NodeKind::Assignment, varName, {expr});
+    }
+
+    // `( expr )` after if and while.
+    ASTNode* parseCondition(std::string_view keyword) {
+        consume("(");
+        size_t errorMark = ctx.errors.size();
+        ASTNode* cond = parseExpression();
+        if (!cond) {
+            if (ctx.errors.size() == errorMark) ctx.errors.push_back("Expected a condition after '" + std::string(keyword) + " ('.");
+            synchronize();  // stops at the closing ')' if the rest is balanced
+            match(")");
+            return nullptr;
+        }
+        consume(")");
+        return cond;
+    }
+
+    // A missing statement or for-loop clause stands as an empty block, and so does one that
+    // failed to parse, once the rest of it has been skipped.
+    ASTNode* parseBodyOrEmpty() {
+        size_t errorMark = ctx.errors.size();
+        ASTNode* body = parseBodyStatement();
+        if (!body && ctx.errors.size() > errorMark) synchronize();
+        return body ? body : makeNode(NodeKind::Block);
+    }
+
+    // A statement whose condition failed to parse is dropped, but its bodies are still
+    // parsed so that recovery resumes after them.
+    ASTNode* parseIf() {
+        advance();  // if
+        ASTNode* cond = parseCondition("if");
+        ASTNode* then = parseBodyOrEmpty();
+        ASTNode* otherwise = match("else") ? parseBodyOrEmpty() : nullptr;
+        if (!cond) return makeNode(NodeKind::Block);
+        if (otherwise) return makeNode(NodeKind::If, {}, {cond, then, otherwise});
+        return makeNode(NodeKind::If, {}, {cond, then});
+    }
+
+    ASTNode* parseWhile() {
+        advance();  // while
+        ASTNode* cond = parseCondition("while");
+        ASTNode* body = parseBodyOrEmpty();
+        if (!cond) return makeNode(NodeKind::Block);
+        return makeNode(NodeKind::While, {}, {cond, body});
+    }
+
+    ASTNode* parseFor() {
+        advance();  // for
+        consume("(");
+        ASTNode* init = nullptr;
+        if (checkType()) init = parseVarDecl();  // takes the ';'
+        else if (check(TokenKind::Identifier)) init = parseAssignment(true);
+        else consume(";");
+        ASTNode* cond = check(";") ? nullptr : parseExpression();
         consume(";");
-        ASTNode* ret = new ASTNode("Return");
-        ret->children.push_back(expr);
-        return ret;
+        ASTNode* step = check(TokenKind::Identifier) ? parseAssignment(false) : nullptr;
+        consume(")");
+        ASTNode* body = parseBodyOrEmpty();
+        forgetExpressions();  // the scope of a declaration in `init` ends here
+        auto orEmpty = [&](ASTNode* n) { return n ? n : makeNode(NodeKind::Block); };
+        return makeNode(NodeKind::For, {}, {orEmpty(init), orEmpty(cond), orEmpty(step), body});
     }
-    return nullptr;
-}
 
-ASTNode* parseReturn() {
-    current++; // skip 'return'
-    ASTNode* ret = new ASTNode("Return");
-    ASTNode* expr = parseExpression();
-    if (expr) ret->children.push_back(expr);
-    if (tokens[current].value == ";") current++;
-    return ret;
-}
+    // One statement of a function body or nested block, or nullptr if none starts here. A
+    // statement nested too deeply is skipped whole and stands as an empty block.
+    ASTNode* parseBodyStatement() {
+        Nested nested(*this);
+        if (!nested.ok) {
+            synchronize();
+            return makeNode(NodeKind::Block);
+        }
+        if (check("{")) return parseBlock();
+        if (check("if")) return parseIf();
+        if (check("while")) return parseWhile();
+        if (check("for")) return parseFor();
+        if (check("return")) return parseReturn();
+        if (checkType()) return parseVarDecl();
+        if (check(TokenKind::Identifier) && (tokens[current + 1].value == "=" || tokens[current + 1].value == "[")) {
+            return parseAssignment(true);
+        }
+        if (check(TokenKind::Identifier) && tokens[current + 1].value == "(") {
+            // A call for its own sake; the value is dropped.
+            ASTNode* call = parseCall(advance().value);
+            consume(";");
+            return call;
+        }
+        if (check(TokenKind::Identifier)) {
+            ctx.errors.push_back("Expected '=' after identifier.");
+            return nullptr;
+        }
+        return nullptr;
+    }
 
+    // Statements up to the closing '}' (not consumed) or the end of input. Tokens that start
+    // no statement are reported and skipped, and so is the rest of a statement that failed.
+    void parseStatements(ASTNode* block) {
+        size_t mark = childStack.size();
+        while (!check("}") && !check(TokenKind::EndOfFile)) {
+            size_t start = current;
+            size_t errorMark = ctx.errors.size();
+            ASTNode* stmt = parseBodyStatement();
+            if (stmt) childStack.push_back(stmt);
+            else if (ctx.errors.size() > errorMark) synchronize();
+            else if (current == start && !match(";")) skipStray("a statement", false);
+        }
+        finishChildren(block, mark);
+    }
 
-ASTNode* parseBlock() {
-    current++; // skip {
-    ASTNode* block = new ASTNode("Block");
-    while (tokens[current].value != "}") {
-        if (tokens[current].value == "return") block->children.push_back(parseReturn());
-        else current++;
+    ASTNode* parseBlock() {
+        advance();  // {
+        ASTNode* block = makeNode(NodeKind::Block);
+        parseStatements(block);
+        consume("}");
+        forgetExpressions();
+        return block;
     }
-    current++; // skip }
-    return block;
-}
 
-ASTNode* parseFunction() {
-    if (!(peek().value == "int" && tokens[current + 1].value == "main")) return nullptr;
-    
-    advance(); // int
-    Token fname = advance(); // main
-    match("("); match(")"); match("{");
+    // `type name(type param, ...) { body }`. Anything else starting with a type is left
+    // for the declaration parsers.
+    ASTNode* parseFunction() {
+        if (!checkType() || tokens[current + 1].kind != TokenKind::Identifier ||
+            tokens[current + 2].value != "(") {
+            return nullptr;
+        }
 
-    ASTNode* func = new ASTNode("Function", fname.value);
-    func->children.push_back(new ASTNode("ReturnType", "int"));
+        Token typeTok = advance();
+        Token fname = advance();
+        advance();  // (
+        ASTNode* function = makeNode(NodeKind::Function, fname.value);
+        size_t mark = childStack.size();
+        childStack.push_back(makeNode(NodeKind::ReturnType, typeTok.value));
+        size_t errorMark = ctx.errors.size();
+        if (!check(")")) {
+            do {
+                Token paramType = advance();
+                Token paramName = advance();
+                if (!(paramType.value == "int" || paramType.value == "float" || paramType.value == "char") ||
+                    paramName.kind != TokenKind::Identifier) {
+                    ctx.errors.push_back("Expected a parameter type and name in '" + std::string(fname.value) + "'.");
+                    break;
+                }
+                childStack.push_back(makeNode(NodeKind::Param, {}, {makeNode(NodeKind::Type, paramType.value),
+                                                                     makeNode(NodeKind::Name, paramName.value)}));
+            } while (match(","));
+        }
+        if (ctx.errors.size() == errorMark) consume(")");
+        if (ctx.errors.size() > errorMark) {
+            // Skips the rest of a malformed parameter list, reported once, to the body.
+            while (!check(TokenKind::EndOfFile) && !check(")") && !check("{") && !check("}") && !check(";")) advance();
+            match(")");
+        }
+        if (!consume("{")) {
+            childStack.resize(mark);
+            return nullptr;  // the caller skips the rest
+        }
 
-    ASTNode* block = new ASTNode("Block");
+        ASTNode* block = makeNode(NodeKind::Block);
+        parseStatements(block);
+        childStack.push_back(block);
 
-    while (peek().value != "}") {
-        ASTNode* stmt = parseVarDecl();
-        if (!stmt) stmt = parseReturn();
-        if (stmt) block->children.push_back(stmt);
-        else current++; // skip unknown
+        consume("}");
+        finishChildren(function, mark);
+        return function;
     }
 
-    match("}"); // consume }
-    func->children.push_back(block);
-    return func;
-}
+    // One iteration of the top-level loop: a function, statement or declaration, or nullptr
+    // after skipping the rest of one that failed, or a run of tokens that start none of them.
+    ASTNode* parseTopLevelItem() {
+        forgetExpressions();
+        size_t start = current;
+        size_t errorMark = ctx.errors.size();
+        ASTNode* node = parseFunction();
+        if (!node && ctx.errors.size() == errorMark) node = parseStatement();
+        if (!node && ctx.errors.size() > errorMark) synchronize();
+        else if (!node && current == start && !match(";")) skipStray("a declaration or function", true);
+        return node;
+    }
 
+    // Runs parseTopLevelItem from the current position, recording each step with the errors
+    // it reported, until the input ends or `resync` returns true at a step boundary.
+    template <typename Resync>
+    void parseSteps(std::vector<ParseStep>& steps, Resync resync) {
+        while (current < tokens.size() && !resync(current)) {
+            ParseStep step;
+            step.begin = static_cast<uint32_t>(current);
+            furthestToken = current;
+            size_t errorMark = ctx.errors.size();
+            step.node = parseTopLevelItem();
+            step.end = static_cast<uint32_t>(current);
+            step.furthest = static_cast<uint32_t>(furthestToken);
+            step.errors.assign(std::make_move_iterator(ctx.errors.begin() + errorMark),
+                               std::make_move_iterator(ctx.errors.end()));
+            ctx.errors.resize(errorMark);
+            steps.push_back(std::move(step));
+        }
+    }
 
-std::string getNodeType(ASTNode* node) {
-    if (node->type == "Literal") {
-        if (node->value.find('.') != std::string::npos) return "float";
-        else return "int";
-    } else if (node->type == "Identifier") {
-        if (globalSymbolTable.count(node->value)) {
-            return globalSymbolTable[node->value];
-        } else {
-            return "unknown";
+    template <typename Steps>
+    ASTNode* buildRoot(const Steps& steps) {
+        ASTNode* root = makeNode(NodeKind::Root);
+        size_t mark = childStack.size();
+        for (size_t i = 0; i < steps.size(); ++i) {
+            if (steps[i].node) childStack.push_back(steps[i].node);
         }
-    } else if (node->type == "BinaryOp") {
-        std::string left = getNodeType(node->children[0]);
-        std::string right = getNodeType(node->children[1]);
-        if (left == "float" || right == "float") return "float";
-        if (left == "int" && right == "int") return "int";
-        return "unknown";
+        finishChildren(root, mark);
+        return root;
+    }
+};
+
+// -------------------- Symbols --------------------
+const char* valueTypeName(ValueType type) {
+    switch (type) {
+        case ValueType::Unknown: return "unknown";
+        case ValueType::Int:     return "int";
+        case ValueType::Float:   return "float";
+        case ValueType::Char:    return "char";
     }
     return "unknown";
 }
 
+ValueType parseValueType(std::string_view text) {
+    if (text == "int") return ValueType::Int;
+    if (text == "float") return ValueType::Float;
+    if (text == "char") return ValueType::Char;
+    return ValueType::Unknown;
+}
 
+uint32_t StringInterner::intern(std::string_view text) {
+    uint64_t hash = hashText(text);
+    size_t mask = table.size() - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        Slot& slot = table[i];
+        if (slot.id == kNone) {
+            slot = {hash, static_cast<uint32_t>(strings.size())};
+            strings.emplace_back(text);
+            if (strings.size() * 2 > table.size()) grow();
+            return static_cast<uint32_t>(strings.size() - 1);
+        }
+        if (slot.hash == hash && strings[slot.id] == text) return slot.id;
+    }
+}
 
+uint32_t StringInterner::find(std::string_view text) const {
+    uint64_t hash = hashText(text);
+    size_t mask = table.size() - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        const Slot& slot = table[i];
+        if (slot.id == kNone) return kNone;
+        if (slot.hash == hash && strings[slot.id] == text) return slot.id;
+    }
+}
 
-void analyzeSemantics(ASTNode* node) {
-    if (!node) return;
+void StringInterner::grow() {
+    std::vector<Slot> old(table.size() * 2);
+    old.swap(table);
+    size_t mask = table.size() - 1;
+    for (const Slot& slot : old) {
+        if (slot.id == kNone) continue;
+        size_t i = slot.hash & mask;
+        while (table[i].id != kNone) i = (i + 1) & mask;
+        table[i] = slot;
+    }
+}
 
-    if (node->type == "VarDecl") {
-        // Expect children: [Type, Name, OptionalInitializer]
-        if (node->children.size() < 2) return;
+void StringInterner::clear() {
+    table.assign(64, Slot());
+    strings.clear();
+}
 
-        std::string varType = node->children[0]->value;  // Type node
-        std::string varName = node->children[1]->value;  // Name node
+uint32_t SymbolTable::declare(uint32_t name, ValueType type, uint32_t length) {
+    if (name >= visible.size()) visible.resize(name + 1, kNone);
+    uint32_t hidden = visible[name];
+    if (hidden != kNone && symbols[hidden].scope == depth()) return kNone;
+    uint32_t id = static_cast<uint32_t>(symbols.size());
+    symbols.push_back({name, type, depth(), hidden, length});
+    visible[name] = id;
+    return id;
+}
 
-        if (globalSymbolTable.count(varName)) {
-            semanticErrors.push_back("Variable '" + varName + "' re-declared.");
-        } else {
-            globalSymbolTable[varName] = varType;
-        }
+uint32_t SymbolTable::lookup(uint32_t name) const {
+    return name < visible.size() ? visible[name] : kNone;
+}
 
-        // Analyze initializer if it exists
-        if (node->children.size() > 2) {
-            ASTNode* expr = node->children[2];
-            analyzeSemantics(expr);
+void SymbolTable::exitScope() {
+    size_t mark = scopeMarks.back();
+    scopeMarks.pop_back();
+    while (symbols.size() > mark) {
+        visible[symbols.back().name] = symbols.back().shadows;
+        symbols.pop_back();
+    }
+}
 
-            std::string exprType = getNodeType(expr);
-            if (exprType != varType) {
-                semanticErrors.push_back("Type mismatch in initialization of '" + varName + "': expected " + varType + ", got " + exprType);
-            }
-        }
+void SymbolTable::clear() {
+    symbols.clear();
+    visible.clear();
+    scopeMarks.clear();
+}
+
+// -------------------- Semantic analysis --------------------
+namespace {
+const Symbol* findSymbol(CompileContext& ctx, std::string_view name) {
+    uint32_t id = ctx.symbols.lookup(ctx.names.find(name));
+    return id == SymbolTable::kNone ? nullptr : &ctx.symbols[id];
+}
+
+// Declares `name` in the innermost scope, or reports a redeclaration. Variables outside
+// every function are reported too: only function bodies are lowered, so they would have
+// no storage. They are still declared so that their uses are not reported again.
+void declareVariable(CompileContext& ctx, std::string_view name, ValueType type, uint32_t length = 0) {
+    if (ctx.symbols.depth() == 0) {
+        ctx.errors.push_back("File-scope variable '" + std::string(name) +
+                             "' is not supported; declare it inside a function.");
     }
+    if (ctx.symbols.declare(ctx.names.intern(name), type, length) == SymbolTable::kNone) {
+        ctx.errors.push_back("Variable '" + std::string(name) + "' re-declared.");
+    }
+}
+}
 
-    else if (node->type == "Identifier") {
-        if (globalSymbolTable.count(node->value) == 0) {
-            semanticErrors.push_back("Undeclared variable: " + node->value);
-        }
+// The length an ArrayDecl asks for, saturating just above kMaxArrayLength.
+uint32_t requestedLength(const ASTNode* decl) {
+    uint32_t length = 0;
+    for (char c : decl->child(2)->value) {
+        if (c < '0' || c > '9') break;
+        length = std::min(length * 10 + static_cast<uint32_t>(c - '0'), kMaxArrayLength + 1);
     }
+    return length;
+}
 
-    else if (node->type == "BinaryOp") {
-        if (node->children.size() < 2) return;
+namespace {
+ValueType literalType(std::string_view text) {
+    return text.find('.') != std::string_view::npos ? ValueType::Float : ValueType::Int;
+}
 
-        ASTNode* left = node->children[0];
-        ASTNode* right = node->children[1];
+ValueType binaryType(ValueType left, ValueType right) {
+    if (left == ValueType::Float || right == ValueType::Float) return ValueType::Float;
+    if (left == ValueType::Int && right == ValueType::Int) return ValueType::Int;
+    return ValueType::Unknown;
+}
 
-        analyzeSemantics(left);
-        analyzeSemantics(right);
+ValueType analyzeNode(CompileContext& ctx, ASTNode* node);
+
+// Analyzes the index of an element of array `name` and returns the element type, or
+// Unknown if `name` is not an array. A literal index is checked against the length.
+ValueType analyzeElement(CompileContext& ctx, std::string_view name, ASTNode* index) {
+    ValueType indexType = analyzeNode(ctx, index);
+    const Symbol* symbol = findSymbol(ctx, name);
+    if (!symbol) return ValueType::Unknown;  // reported by the caller
+    if (!symbol->length) {
+        ctx.errors.push_back("Indexing non-array variable: " + std::string(name));
+        return ValueType::Unknown;
+    }
+    if (indexType != ValueType::Int) {
+        ctx.errors.push_back("Index into '" + std::string(name) + "' must be int, got " + valueTypeName(indexType));
+    } else if (index->kind == NodeKind::Literal &&
+               (index->value.size() > 9 || static_cast<uint32_t>(decodeIntLiteral(index->value)) >= symbol->length)) {
+        ctx.errors.push_back("Index " + std::string(index->value) + " is out of bounds for '" + std::string(name) +
+                             "' of length " + std::to_string(symbol->length));
+    }
+    return symbol->type;
+}
+
+// Analyzes `node` and everything under it, each node exactly once, and returns its type.
+ValueType analyzeNode(CompileContext& ctx, ASTNode* node) {
+    if (!node) return ValueType::Unknown;
+    if (node->shared && !ctx.analyzedShared.insert(node).second) return node->inferredType;
+    ValueType type = ValueType::Unknown;
+
+    switch (node->kind) {
+    case NodeKind::Literal:
+        type = literalType(node->value);
+        break;
+
+    case NodeKind::Identifier: {
+        const Symbol* symbol = findSymbol(ctx, node->value);
+        node->isDeclared = symbol != nullptr;
+        if (symbol) type = symbol->type;
+        else ctx.errors.push_back("Undeclared variable: " + std::string(node->value));
+        if (symbol && symbol->length) ctx.errors.push_back("Array '" + std::string(node->value) + "' used without an index");
+        break;
+    }
+
+    case NodeKind::Index:
+        node->isDeclared = findSymbol(ctx, node->value) != nullptr;
+        if (!node->isDeclared) ctx.errors.push_back("Undeclared variable: " + std::string(node->value));
+        type = analyzeElement(ctx, node->value, node->child(0));
+        break;
+
+    case NodeKind::ArrayDecl: {
+        // [Type, Name, Literal length]
+        std::string_view varName = node->child(1)->value;
+        type = parseValueType(node->child(0)->value);
+        uint32_t length = requestedLength(node);
+        if (length == 0 || length > kMaxArrayLength) {
+            ctx.errors.push_back("Array '" + std::string(varName) + "' must have 1 to " + std::to_string(kMaxArrayLength) +
+                                 " elements");
+            length = std::clamp(length, 1u, kMaxArrayLength);
+        }
+        declareVariable(ctx, varName, type, length);
+        break;
+    }
 
-        std::string leftType = getNodeType(left);
-        std::string rightType = getNodeType(right);
+    case NodeKind::VarDecl: {
+        // Expect children: [Type, Name, OptionalInitializer]
+        if (node->childCount < 2) break;
+
+        std::string_view typeName = node->child(0)->value;  // Type node
+        std::string_view varName = node->child(1)->value;   // Name node
+        type = parseValueType(typeName);
+        declareVariable(ctx, varName, type);
+
+        if (node->childCount > 2) {
+            ValueType exprType = analyzeNode(ctx, node->child(2));
+            if (exprType != type) {
+                ctx.errors.push_back("Type mismatch in initialization of '" + std::string(varName) + "': expected " +
+                                     std::string(typeName) + ", got " + valueTypeName(exprType));
+            }
+        }
+        break;
+    }
+
+    case NodeKind::BinaryOp: {
+        if (node->childCount < 2) break;
+        ValueType leftType = analyzeNode(ctx, node->child(0));
+        ValueType rightType = analyzeNode(ctx, node->child(1));
         if (leftType != rightType) {
-            semanticErrors.push_back("Type mismatch in binary operation: " + leftType + " vs " + rightType);
+            ctx.errors.push_back(std::string("Type mismatch in binary operation: ") + valueTypeName(leftType) + " vs " +
+                                 valueTypeName(rightType));
         }
+        // A comparison yields an int whatever it compares.
+        if (isComparison(node->value)) type = leftType == rightType && leftType != ValueType::Unknown ? ValueType::Int : ValueType::Unknown;
+        else type = binaryType(leftType, rightType);
+        break;
     }
 
-    else if (node->type == "Assignment") {
-        std::string varName = node->value;
-        if (globalSymbolTable.count(varName) == 0) {
-            semanticErrors.push_back("Assignment to undeclared variable: " + varName);
-        } else {
-            ASTNode* expr = node->children[0];
-            analyzeSemantics(expr);
+    case NodeKind::Assignment: {
+        std::string varName(node->value);
+        const Symbol* symbol = findSymbol(ctx, varName);
+        if (!symbol) {
+            ctx.errors.push_back("Assignment to undeclared variable: " + varName);
+            for (ASTNode* child : *node) analyzeNode(ctx, child);
+            break;
+        }
+        type = symbol->type;
+        bool array = symbol->length != 0;
+        ValueType actual = analyzeNode(ctx, node->child(0));
+        if (node->childCount > 1) analyzeElement(ctx, varName, node->child(1));
+        else if (array) ctx.errors.push_back("Cannot assign to array '" + varName + "'; assign to its elements");
+        if (type != actual) {
+            ctx.errors.push_back("Type mismatch in assignment to '" + varName + "': expected " + valueTypeName(type) +
+                                 ", got " + valueTypeName(actual));
+        }
+        break;
+    }
+
+    case NodeKind::Function: {
+        // [ReturnType, Param..., Block]. The signature is recorded before the body is
+        // analyzed, so the body may call the function itself. Parameters and the body's own
+        // declarations share one scope, as in C.
+        std::string name(node->value);
+        FunctionSignature signature{parseValueType(node->child(0)->value), {}};
+        ctx.symbols.enterScope();
+        for (uint32_t i = 1; i + 1 < node->childCount; ++i) {
+            ASTNode* param = node->child(i);
+            param->inferredType = parseValueType(param->child(0)->value);
+            declareVariable(ctx, param->child(1)->value, param->inferredType);
+            signature.params.push_back(param->inferredType);
+        }
+        if (signature.params.size() > kMaxParams) {
+            ctx.errors.push_back("Function '" + name + "' has more than " + std::to_string(kMaxParams) + " parameters");
+        }
+        if (!ctx.functions.emplace(ctx.names.intern(name), signature).second) {
+            ctx.errors.push_back("Function '" + name + "' re-defined.");
+        }
+        type = signature.returnType;
+        ctx.returnType = type;
+        ASTNode* body = node->child(node->childCount - 1);
+        for (ASTNode* stmt : *body) analyzeNode(ctx, stmt);
+        ctx.symbols.exitScope();
+        ctx.returnType = ValueType::Unknown;
+        break;
+    }
 
-            std::string expected = globalSymbolTable[varName];
-            std::string actual = getNodeType(expr);
-            if (expected != actual) {
-                semanticErrors.push_back("Type mismatch in assignment to '" + varName + "': expected " + expected + ", got " + actual);
+    case NodeKind::Call: {
+        auto it = ctx.functions.find(ctx.names.find(node->value));
+        std::vector<ValueType> args;
+        for (ASTNode* arg : *node) args.push_back(analyzeNode(ctx, arg));
+        if (it == ctx.functions.end()) {
+            ctx.errors.push_back("Function not defined: " + std::string(node->value));
+            break;
+        }
+        const FunctionSignature& callee = it->second;
+        type = callee.returnType;
+        if (args.size() != callee.params.size()) {
+            ctx.errors.push_back("Function '" + std::string(node->value) + "' takes " + std::to_string(callee.params.size()) +
+                                 " arguments, got " + std::to_string(args.size()));
+            break;
+        }
+        for (size_t i = 0; i < args.size(); ++i) {
+            if (args[i] != callee.params[i]) {
+                ctx.errors.push_back("Type mismatch in argument " + std::to_string(i + 1) + " of '" + std::string(node->value) +
+                                     "': expected " + valueTypeName(callee.params[i]) + ", got " + valueTypeName(args[i]));
             }
         }
+        break;
     }
 
-    else if (node->type == "Function") {
-        std::string funcName = node->value;
-        if (funcName != "main" && funcName != "add" && funcName != "sub") {
-            semanticErrors.push_back("Function not defined: " + funcName);
+    case NodeKind::Return: {
+        // A bare `return;` is let through and returns 0, as it always has in main.
+        if (!node->childCount) break;
+        ValueType actual = analyzeNode(ctx, node->child(0));
+        if (ctx.returnType != ValueType::Unknown && actual != ctx.returnType) {
+            ctx.errors.push_back(std::string("Type mismatch in return: expected ") + valueTypeName(ctx.returnType) + ", got " +
+                                 valueTypeName(actual));
         }
+        break;
     }
 
-    // Recurse on children
-    for (ASTNode* child : node->children) {
-        analyzeSemantics(child);
+    case NodeKind::Block:
+    case NodeKind::For:
+        // Declarations inside a block, or in a for-loop header, are local to it and may
+        // shadow outer ones.
+        ctx.symbols.enterScope();
+        for (ASTNode* child : *node) analyzeNode(ctx, child);
+        ctx.symbols.exitScope();
+        break;
+
+    default:
+        for (ASTNode* child : *node) analyzeNode(ctx, child);
+        break;
     }
+
+    node->inferredType = type;
+    return type;
+}
+}
+
+void analyzeSemantics(CompileContext& ctx, ASTNode* node) {
+    ctx.analyzedShared = {};  // frees the buckets instead of clearing each one
+    analyzeNode(ctx, node);
 }
 
 
 
+namespace {
 
-std::string printASTTree(ASTNode* node, int indent = 0) {
-    std::stringstream ss;
-    if (!node) return "";
+// Appends to one string, so a deep tree is not copied once per level on the way up.
+void appendASTTree(const ASTNode* node, int indent, std::string& out) {
+    if (!node) return;
 
     // Indent based on tree depth
-    ss << std::string(indent * 2, ' ') << "• " << node->type;
+    out.append(static_cast<size_t>(indent) * 2, ' ');
+    out += "• ";
+    out += nodeKindName(node->kind);
 
     // Include value if present
     if (!node->value.empty()) {
-        ss << ": " << node->value;
+        out += ": ";
+        out += node->value;
     }
 
-    ss << "\n";
+    out += '\n';
 
     // Recurse for all children
-    for (ASTNode* child : node->children) {
-        ss << printASTTree(child, indent + 1);
+    for (const ASTNode* child : *node) appendASTTree(child, indent + 1, out);
+}
+
+}  // namespace
+
+std::string printASTTree(ASTNode* node, int indent) {
+    std::string out;
+    appendASTTree(node, indent, out);
+    return out;
+}
+
+// Literal text to an int: the integer part of integer and float literals, wrapping on
+// overflow, and the character code of a char literal. Only constant folding makes
+// literals with a leading '-'.
+int32_t decodeIntLiteral(std::string_view text) {
+    if (!text.empty() && text[0] == '\'') return text.size() > 1 ? static_cast<unsigned char>(text[1]) : 0;
+    bool negative = !text.empty() && text[0] == '-';
+    uint32_t value = 0;
+    for (char c : text.substr(negative)) {
+        if (c < '0' || c > '9') break;
+        value = value * 10 + static_cast<uint32_t>(c - '0');
     }
+    return static_cast<int32_t>(negative ? 0u - value : value);
+}
+
+
+// Parses `toks` into a tree allocated from `arena`. Node text is copied into the arena,
+// so only the arena has to outlive the returned tree.
+ASTNode* parseTokens(CompileContext& ctx, const std::vector<Token>& toks, Arena& arena) {
+    Parser parser(ctx, toks, arena);
 
-    return ss.str();
+    ASTNode* root = parser.makeNode(NodeKind::Root);
+    size_t mark = parser.childStack.size();
+
+    while (parser.current < parser.tokens.size()) {
+        ASTNode* node = parser.parseTopLevelItem();
+        if (node) parser.childStack.push_back(node);
+    }
+
+    parser.finishChildren(root, mark);
+    return root;
 }
 
-std::unordered_map<std::string, int> runtimeValues;
+ASTNode* parseProgram(CompileContext& ctx, std::string_view input, Arena& arena) {
+    std::vector<Token> toks = tokenizeStructured(input);
+    return parseTokens(ctx, toks, arena);
+}
 
-int evaluate(ASTNode* node) {
-    if (!node) return 0;
+std::string sanitizeVarName(std::string_view name) {
+    std::string clean(name);
+    clean.erase(std::remove_if(clean.begin(), clean.end(), ::isspace), clean.end());
+    return clean;
+}
 
-    if (node->type == "Literal") {
-        return std::stoi(node->value);
+// IR type for a source type; anything unresolved is lowered as i32.
+IRType irTypeFor(ValueType type) {
+    switch (type) {
+        case ValueType::Float: return IRType::Float;
+        case ValueType::Char:  return IRType::I8;
+        default:               return IRType::I32;
     }
+}
 
-    if (node->type == "Identifier") {
-        return runtimeValues[node->value];  // assume declared and initialized
+// Lowers one Function node straight into an IRFunction. Variables live in allocas, which
+// mem2reg turns into SSA values and phis. Allocas go to the entry block, so a declaration
+// inside a loop does not grow the frame on every iteration. A declaration hides an outer
+// one of the same name until its block closes.
+struct FunctionLowering {
+    IRFunction& fn;
+    std::unordered_map<std::string, uint32_t> allocas;
+    std::vector<std::pair<uint32_t, uint32_t>> hidden;  // an alloca and the one it hid, or UINT32_MAX
+    std::unordered_map<std::string, int> labels{{"entry", 1}};
+    uint32_t block = 0;       // where instructions are appended
+    bool terminated = false;  // `block` already ends in ret or br
+    std::vector<uint32_t> layout{0};  // blocks in the order code went into them
+    // Values of shared expression nodes already computed in `block`, each with the number
+    // of stores lowered before it. One stays usable until the block ends or a store changes
+    // a variable it reads; calls cannot reach locals.
+    std::unordered_map<const ASTNode*, std::pair<IRValue, uint32_t>> available;
+    std::unordered_map<std::string_view, uint32_t> lastStore;  // variable -> stores lowered up to its last one
+    uint32_t stores = 0;
+
+    uint32_t add(IRInst inst) {
+        uint32_t id = static_cast<uint32_t>(fn.insts.size());
+        fn.insts.push_back(std::move(inst));
+        fn.blocks[block].insts.push_back(id);
+        return id;
     }
 
-    if (node->type == "BinaryOp") {
-        int left = evaluate(node->children[0]);
-        int right = evaluate(node->children[1]);
-        std::string op = node->value;
-        if (op == "+") return left + right;
-        if (op == "-") return left - right;
-        if (op == "*") return left * right;
-        if (op == "/") return right != 0 ? left / right : 0;
+    // A block labeled `base`, numbered as clang does when the label is already taken.
+    uint32_t newBlock(const char* base) {
+        int& uses = labels[base];
+        fn.blocks.push_back({uses ? base + std::to_string(uses) : std::string(base), {}});
+        ++uses;
+        return static_cast<uint32_t>(fn.blocks.size() - 1);
     }
 
-    return 0;
-}
+    void startBlock(uint32_t b) {
+        block = b;
+        terminated = false;
+        layout.push_back(b);
+        if (!available.empty()) available = {};
+    }
 
-void execute(ASTNode* node) {
-    if (!node) return;
+    // Whether a variable `expr` reads was stored to after the first `before` stores. The walk
+    // is as long as the source text of `expr`, which lowering it would cost anyway.
+    bool storedSince(const ASTNode* expr, uint32_t before) const {
+        if (expr->kind == NodeKind::Identifier || expr->kind == NodeKind::Index) {
+            auto it = lastStore.find(expr->value);
+            if (it != lastStore.end() && it->second > before) return true;
+        }
+        for (ASTNode* child : *expr) {
+            if (storedSince(child, before)) return true;
+        }
+        return false;
+    }
+
+    void branch(uint32_t target) {
+        if (terminated) return;
+        IRInst br{};
+        br.op = IROp::Br;
+        br.type = IRType::Void;
+        br.target[0] = target;
+        add(br);
+        terminated = true;
+    }
+
+    void branch(IRValue cond, uint32_t ifTrue, uint32_t ifFalse) {
+        IRInst br{};
+        br.op = IROp::CondBr;
+        br.type = IRType::Void;
+        br.a = cond;
+        br.target[0] = ifTrue;
+        br.target[1] = ifFalse;
+        add(br);
+        terminated = true;
+    }
+
+    // An expression result: an instruction, or a literal whose value depends on the type of
+    // the instruction that uses it.
+    struct Operand {
+        IRValue value;
+        ASTNode* literal = nullptr;
+    };
 
-    if (node->type == "VarDecl") {
-        std::string varName = node->children[1]->value;
-        if (node->children.size() > 2) {
-            int val = evaluate(node->children[2]);
-            runtimeValues[varName] = val;
+    static IRValue typed(const Operand& operand, IRType type) {
+        if (!operand.literal) return operand.value;
+        std::string_view text = operand.literal->value;
+        bool isFloat = operand.literal->inferredType == ValueType::Float;
+        if (type == IRType::Float) {
+            return IRValue::ofFloat(isFloat ? std::strtof(std::string(text).c_str(), nullptr)
+                                            : static_cast<float>(decodeIntLiteral(text)));
         }
+        return IRValue::ofInt(wrapToType(decodeIntLiteral(text), type));
     }
 
-    for (ASTNode* child : node->children) {
-        execute(child);
+    // A binary operation takes the type of its first operand that is not a literal, since
+    // a literal's type depends on where it is used; failing that, of the literals.
+    static IRType operandType(ASTNode* left, ASTNode* right) {
+        if (left->kind != NodeKind::Literal) return valueType(left);
+        if (right->kind != NodeKind::Literal) return valueType(right);
+        if (left->inferredType == ValueType::Float) return IRType::Float;
+        return IRType::I32;
     }
-}
 
+    // The type an expression is computed, passed or returned as. Arithmetic on chars is
+    // done in i8 even though the analyzer leaves its type unresolved.
+    static IRType valueType(ASTNode* expr) {
+        if (expr->kind == NodeKind::Literal) return expr->inferredType == ValueType::Float ? IRType::Float : IRType::I32;
+        if (expr->kind == NodeKind::BinaryOp && !isComparison(expr->value)) return operandType(expr->child(0), expr->child(1));
+        return irTypeFor(expr->inferredType);
+    }
 
-std::string generateAST(const std::string& input) {
-    tokens = tokenizeStructured(input);
-    current = 0;
-    semanticErrors.clear();
-    globalSymbolTable.clear();
+    // An i1 for a comparison node.
+    IRValue compare(ASTNode* expr) {
+        ASTNode* left = expr->child(0);
+        ASTNode* right = expr->child(1);
+        Operand lhs = expression(left);
+        Operand rhs = expression(right);
+        IRInst cmp{};
+        cmp.type = operandType(left, right);
+        bool isFloat = cmp.type == IRType::Float;
+        cmp.op = isFloat ? IROp::FCmp : IROp::ICmp;
+        std::string_view op = expr->value;
+        if (op == "==") cmp.pred = isFloat ? IRPred::OEQ : IRPred::EQ;
+        else if (op == "!=") cmp.pred = isFloat ? IRPred::UNE : IRPred::NE;
+        else if (op == "<") cmp.pred = isFloat ? IRPred::OLT : IRPred::SLT;
+        else if (op == "<=") cmp.pred = isFloat ? IRPred::OLE : IRPred::SLE;
+        else if (op == ">") cmp.pred = isFloat ? IRPred::OGT : IRPred::SGT;
+        else cmp.pred = isFloat ? IRPred::OGE : IRPred::SGE;
+        cmp.a = typed(lhs, cmp.type);
+        cmp.b = typed(rhs, cmp.type);
+        return IRValue::ofInst(add(cmp));
+    }
 
-    ASTNode* root = new ASTNode("ROOT");
+    // Any expression as a branch condition: a comparison directly, anything else against 0.
+    IRValue condition(ASTNode* expr) {
+        if (expr->kind == NodeKind::BinaryOp && isComparison(expr->value)) return compare(expr);
+        IRInst cmp{};
+        cmp.type = valueType(expr);
+        bool isFloat = cmp.type == IRType::Float;
+        cmp.op = isFloat ? IROp::FCmp : IROp::ICmp;
+        cmp.pred = isFloat ? IRPred::UNE : IRPred::NE;
+        cmp.a = typed(expression(expr), cmp.type);
+        cmp.b = isFloat ? IRValue::ofFloat(0.0f) : IRValue::ofInt(0);
+        return IRValue::ofInst(add(cmp));
+    }
 
-    while (current < tokens.size()) {
-        ASTNode* node = parseFunction();
-        if (!node) node = parseStatement();
-        if (!node) node = parseVarDecl();
-        if (node) root->children.push_back(node);
-        else current++;
+    // Common subexpression elimination: a shared node computed earlier in the block is not
+    // computed again.
+    Operand expression(ASTNode* expr) {
+        if (!expr || !expr->shared || expr->kind == NodeKind::Literal) return evaluate(expr);
+        auto it = available.find(expr);
+        if (it != available.end() && (it->second.second == stores || !storedSince(expr, it->second.second))) {
+            return {it->second.first};
+        }
+        Operand result = evaluate(expr);
+        available[expr] = {result.value, stores};
+        return result;
     }
 
-    // Perform semantic analysis
-    analyzeSemantics(root);
+    Operand evaluate(ASTNode* expr) {
+        if (!expr) return {IRValue::ofInt(0)};
+        switch (expr->kind) {
+        case NodeKind::Literal:
+            return {IRValue(), expr};
+
+        case NodeKind::Identifier: {
+            // A name with no alloca yet reads as undef; the analyzer has already reported it.
+            auto it = allocas.find(sanitizeVarName(expr->value));
+            if (it == allocas.end()) return {IRValue::undef()};
+            IRInst load{};
+            load.op = IROp::Load;
+            load.type = irTypeFor(expr->inferredType);
+            load.a = IRValue::ofInst(it->second);
+            return {IRValue::ofInst(add(load))};
+        }
+
+        case NodeKind::Index: {
+            IRValue address = element(expr->value, expr->child(0));
+            if (address.kind == IRValue::Kind::None) return {IRValue::undef()};
+            IRInst load{};
+            load.op = IROp::Load;
+            load.type = fn.insts[address.inst].type;
+            load.a = address;
+            return {IRValue::ofInst(add(load))};
+        }
+
+        case NodeKind::BinaryOp: {
+            if (isComparison(expr->value)) {
+                IRInst zext{};
+                zext.op = IROp::ZExt;
+                zext.type = IRType::I32;
+                zext.a = compare(expr);
+                return {IRValue::ofInst(add(zext))};
+            }
+            ASTNode* left = expr->child(0);
+            ASTNode* right = expr->child(1);
+            Operand lhs = expression(left);
+            Operand rhs = expression(right);
+
+            IRType type = operandType(left, right);
+            bool isFloat = type == IRType::Float;
+            std::string_view op = expr->value;
+            IRInst inst{};
+            if (op == "-") inst.op = isFloat ? IROp::FSub : IROp::Sub;
+            else if (op == "*") inst.op = isFloat ? IROp::FMul : IROp::Mul;
+            else if (op == "/") inst.op = isFloat ? IROp::FDiv : IROp::SDiv;
+            else inst.op = isFloat ? IROp::FAdd : IROp::Add;
+            inst.type = type;
+            inst.a = typed(lhs, type);
+            inst.b = typed(rhs, type);
+            return {IRValue::ofInst(add(inst))};
+        }
+
+        case NodeKind::Call: {
+            IRInst call{};
+            call.op = IROp::Call;
+            call.type = irTypeFor(expr->inferredType);
+            call.name = std::string(expr->value);
+            for (ASTNode* arg : *expr) {
+                IRType type = valueType(arg);
+                call.args.push_back({type, typed(expression(arg), type)});
+            }
+            return {IRValue::ofInst(add(std::move(call)))};
+        }
 
-    if (semanticErrors.empty()) {
-        execute(root);              // Runtime simulation
-        std::cout << "Value of c: " << runtimeValues["c"] << std::endl; // should output 30
+        default:
+            return {IRValue::ofInt(0)};
+        }
     }
 
-    // Creates a string stream ss, which is used to build a multi-line string output. It works like std::cout, but writes to a string buffer.
+    // The address of element `index` of `array`, or none if `array` is not one (which the
+    // analyzer has reported).
+    IRValue element(std::string_view array, ASTNode* index) {
+        auto it = allocas.find(sanitizeVarName(array));
+        if (it == allocas.end() || fn.insts[it->second].b.kind != IRValue::Kind::Int) return IRValue();
+        IRInst gep{};
+        gep.op = IROp::GEP;
+        gep.type = fn.insts[it->second].type;
+        gep.a = IRValue::ofInst(it->second);
+        gep.b = typed(expression(index), IRType::I32);
+        return IRValue::ofInst(add(gep));
+    }
 
-    std::stringstream ss;
-    ss << printASTTree(root);
-    //Checks if any semantic errors were collected during semantic analysis.
-    if (!semanticErrors.empty()) {
-        ss << "\n--- Semantic Errors ---\n";
-        for (const std::string& err : semanticErrors) {
-            ss << "❌ " << err << "\n";
+    void declare(ASTNode* decl) {
+        // VarDecl children: [Type, Name, optional Expr]; ArrayDecl: [Type, Name, length]
+        IRInst alloca{};
+        alloca.op = IROp::Alloca;
+        alloca.type = irTypeFor(decl->inferredType);
+        alloca.name = sanitizeVarName(decl->child(1)->value);
+        if (decl->kind == NodeKind::ArrayDecl) alloca.b = IRValue::ofInt(static_cast<int32_t>(std::clamp(requestedLength(decl), 1u, kMaxArrayLength)));
+        uint32_t slot = static_cast<uint32_t>(fn.insts.size());
+        fn.insts.push_back(std::move(alloca));
+        std::vector<uint32_t>& entry = fn.blocks[0].insts;
+        entry.insert(block == 0 && !terminated ? entry.end() : entry.end() - 1, slot);
+
+        auto [it, fresh] = allocas.try_emplace(fn.insts[slot].name, slot);
+        hidden.emplace_back(slot, fresh ? UINT32_MAX : it->second);
+        it->second = slot;
+
+        if (decl->kind == NodeKind::VarDecl && decl->childCount == 3) {
+            IRInst store{};
+            store.op = IROp::Store;
+            store.type = fn.insts[slot].type;
+            store.a = typed(expression(decl->child(2)), store.type);
+            store.b = IRValue::ofInst(slot);
+            add(store);
         }
-    } else {
-        ss << "\n✅ Semantic analysis passed.\n";
     }
 
-    delete root;
-    return ss.str(); //Returns the entire formatted string (AST + semantic messages) as a std::string.
-}
+    // Makes the names declared since `mark` refer to what they hid again.
+    void closeScope(size_t mark) {
+        while (hidden.size() > mark) {
+            auto [slot, previous] = hidden.back();
+            if (previous == UINT32_MAX) allocas.erase(fn.insts[slot].name);
+            else allocas[fn.insts[slot].name] = previous;
+            hidden.pop_back();
+        }
+    }
 
+    void statements(ASTNode* list) {
+        size_t mark = hidden.size();
+        // Anything after a return is unreachable and would be invalid IR.
+        for (uint32_t i = 0; i < list->childCount && !terminated; ++i) statement(list->child(i));
+        closeScope(mark);
+    }
 
+    void statement(ASTNode* stmt) {
+        switch (stmt->kind) {
+        case NodeKind::VarDecl:
+            if (stmt->childCount >= 2) declare(stmt);
+            break;
+
+        case NodeKind::ArrayDecl:
+            declare(stmt);
+            break;
+
+        case NodeKind::Assignment: {
+            auto it = allocas.find(sanitizeVarName(stmt->value));
+            if (it == allocas.end()) break;  // reported by the analyzer
+            IRInst store{};
+            store.op = IROp::Store;
+            store.type = fn.insts[it->second].type;
+            store.a = typed(expression(stmt->childCount ? stmt->child(0) : nullptr), store.type);
+            store.b = stmt->childCount > 1 ? element(stmt->value, stmt->child(1)) : IRValue::ofInst(it->second);
+            if (store.b.kind != IRValue::Kind::None) add(store);
+            lastStore[stmt->value] = ++stores;
+            break;
+        }
 
-std::string sanitizeVarName(const std::string& name) {
-    std::string clean = name;
-    clean.erase(std::remove_if(clean.begin(), clean.end(), ::isspace), clean.end());
-    return clean;
-}
+        case NodeKind::Return: {
+            IRInst ret{};
+            ret.op = IROp::Ret;
+            ret.type = fn.returnType;
+            ret.a = stmt->childCount ? typed(expression(stmt->child(0)), ret.type) : zero(ret.type);
+            add(ret);
+            terminated = true;
+            break;
+        }
 
-// Helper function to recursively generate IR for expressions
-std::string generateIRForExpr(ASTNode* expr, std::stringstream& ir,
-    std::map<std::string, std::string>& varRegs, int& regCount,
-    const std::map<std::string, std::string>& varTypes) {
-
-    if (expr->type == "Literal") {
-        // Check if the literal is a float (contains '.')
-        if (expr->value.find('.') != std::string::npos) {
-            float floatVal = std::stof(expr->value);
-            std::ostringstream formatted;
-            formatted << std::scientific << std::setprecision(6) << floatVal;
-            return formatted.str();
-        }
-        else {
-            // Handle char literal (single character string)
-            if (expr->value.size() == 1 && !isdigit(expr->value[0])) {
-                // Convert char to ASCII integer
-                int asciiVal = static_cast<int>(expr->value[0]);
-                return std::to_string(asciiVal);
+        case NodeKind::Call:
+            expression(stmt);
+            break;
+
+        case NodeKind::Block:
+            statements(stmt);
+            break;
+
+        case NodeKind::If: {
+            uint32_t then = newBlock("if.then");
+            uint32_t otherwise = stmt->childCount > 2 ? newBlock("if.else") : 0;
+            uint32_t end = newBlock("if.end");
+            branch(condition(stmt->child(0)), then, otherwise ? otherwise : end);
+            startBlock(then);
+            statement(stmt->child(1));
+            branch(end);
+            if (otherwise) {
+                startBlock(otherwise);
+                statement(stmt->child(2));
+                branch(end);
             }
-            // Otherwise, treat as integer literal
-            return expr->value;
+            startBlock(end);
+            break;
+        }
+
+        case NodeKind::While: {
+            uint32_t cond = newBlock("while.cond");
+            uint32_t body = newBlock("while.body");
+            uint32_t end = newBlock("while.end");
+            branch(cond);
+            startBlock(cond);
+            branch(condition(stmt->child(0)), body, end);
+            startBlock(body);
+            statement(stmt->child(1));
+            branch(cond);
+            startBlock(end);
+            break;
+        }
+
+        case NodeKind::For: {
+            // [init, condition, step, body]; an empty Block condition loops forever.
+            size_t mark = hidden.size();
+            statement(stmt->child(0));
+            uint32_t cond = newBlock("for.cond");
+            uint32_t body = newBlock("for.body");
+            uint32_t step = newBlock("for.inc");
+            uint32_t end = newBlock("for.end");
+            branch(cond);
+            startBlock(cond);
+            ASTNode* test = stmt->child(1);
+            if (test->kind == NodeKind::Block) branch(body);
+            else branch(condition(test), body, end);
+            startBlock(body);
+            statement(stmt->child(3));
+            branch(step);
+            startBlock(step);
+            statement(stmt->child(2));
+            branch(cond);
+            startBlock(end);
+            closeScope(mark);
+            break;
+        }
+
+        default:
+            break;
+        }
+    }
+
+    static IRValue zero(IRType type) { return type == IRType::Float ? IRValue::ofFloat(0.0f) : IRValue::ofInt(0); }
+
+    // Like clang, each parameter gets an alloca of its own (`%x.addr`) that it is stored to
+    // on entry, so the body may assign to it; mem2reg turns the loads back into uses of the
+    // parameter.
+    void parameters(ASTNode* function) {
+        for (ASTNode* c : *function) {
+            if (c->kind != NodeKind::Param) continue;
+            IRInst alloca{};
+            alloca.op = IROp::Alloca;
+            alloca.type = irTypeFor(c->inferredType);
+            alloca.name = sanitizeVarName(c->child(1)->value) + ".addr";
+            fn.params.push_back({alloca.type, sanitizeVarName(c->child(1)->value)});
+            allocas[fn.params.back().name] = add(std::move(alloca));
+        }
+        for (uint32_t k = 0; k < fn.params.size(); ++k) {
+            IRInst store{};
+            store.op = IROp::Store;
+            store.type = fn.params[k].type;
+            store.a = IRValue::ofArg(k);
+            store.b = IRValue::ofInst(allocas[fn.params[k].name]);
+            add(store);
         }
     }
 
-    else if (expr->type == "Identifier") {
-        std::string varName = expr->value;
-        std::string llvmType = varTypes.at(varName);
+    void function(ASTNode* function) {
+        fn.name = std::string(function->value);
+        fn.returnType = irTypeFor(function->inferredType);
+        fn.blocks.emplace_back();
+        parameters(function);
+
+        // The body's own scope ends with the function, so it is not closed name by name.
+        for (ASTNode* c : *function) {
+            if (c->kind != NodeKind::Block) continue;
+            for (uint32_t i = 0; i < c->childCount && !terminated; ++i) statement(c->child(i));
+            break;
+        }
+
+        // Falling off the end of a function returns 0, and every block needs a terminator.
+        if (!terminated) {
+            IRInst ret{};
+            ret.op = IROp::Ret;
+            ret.type = fn.returnType;
+            ret.a = zero(fn.returnType);
+            add(ret);
+        }
+        // Branches need a name for the entry block; a straight-line function prints as before.
+        if (fn.blocks.size() == 1) return;
+        fn.blocks[0].label = "entry";
+
+        // Like clang, lay blocks out in the order they were filled, so a loop's exit block
+        // follows its body rather than the condition that created it.
+        reorderBlocks(fn, layout);
+    }
+};
+
+IRFunction buildFunctionIR(ASTNode* function) {
+    IRFunction fn;
+    FunctionLowering lowering{fn};
+    lowering.function(function);
+    return fn;
+}
 
-        std::string cleanVar = sanitizeVarName(varName);
-        std::string reg = "%" + std::to_string(regCount++);
-        ir << "  " << reg << " = load " << llvmType << ", " << llvmType << "* %" << cleanVar << "\n";
-        return reg;
+IRModule buildIR(ASTNode* root) {
+    IRModule module;
+    for (ASTNode* child : *root) {
+        if (child->kind == NodeKind::Function) module.functions.push_back(buildFunctionIR(child));
     }
+    return module;
+}
+
+std::string generateIR(ASTNode* root) {
+    return printIR(buildIR(root));
+}
+
 
-    else if (expr->type == "BinaryOp") {
-        ASTNode* left = expr->children[0];
-        ASTNode* right = expr->children[1];
 
-        std::string leftReg = generateIRForExpr(left, ir, varRegs, regCount, varTypes);
-        std::string rightReg = generateIRForExpr(right, ir, varRegs, regCount, varTypes);
 
-        // Infer type from one of the operands (you can improve this by checking both)
-        std::string inferredType;
-        if (left->type == "Identifier") inferredType = varTypes.at(left->value);
-        else if (right->type == "Identifier") inferredType = varTypes.at(right->value);
-        else if (left->type == "Literal" && left->value.find('.') != std::string::npos)
-            inferredType = "float";
-        else
-            inferredType = "i32";
 
-        std::string reg = "%" + std::to_string(regCount++);
-        std::string op = expr->value;
+// -------------------- Compilation session --------------------
+namespace {
+// Older events are dropped in halves once this many have been recorded.
+constexpr size_t kMaxPhaseEvents = 1024;
 
-        std::string llvmOp;
-        if (op == "+") llvmOp = (inferredType == "float") ? "fadd" : "add";
-        else if (op == "-") llvmOp = (inferredType == "float") ? "fsub" : "sub";
-        else if (op == "*") llvmOp = (inferredType == "float") ? "fmul" : "mul";
-        else if (op == "/") llvmOp = (inferredType == "float") ? "fdiv" : "sdiv";
-        else llvmOp = (inferredType == "float") ? "fadd" : "add";
+uint64_t countNodes(const ASTNode* node) {
+    if (!node) return 0;
+    uint64_t count = 1;
+    for (const ASTNode* child : *node) count += countNodes(child);
+    return count;
+}
 
-        ir << "  " << reg << " = " << llvmOp << " " << inferredType << " " << leftReg << ", " << rightReg << "\n";
-        return reg;
+// Lines that start with `prefix` and are not assembler directives or labels.
+uint64_t countLines(const std::string& text, std::string_view prefix) {
+    uint64_t count = 0;
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = text.find('\n', start);
+        if (end == std::string::npos) end = text.size();
+        std::string_view line(text.data() + start, end - start);
+        if (line.substr(0, prefix.size()) == prefix && line.size() > prefix.size() && line[prefix.size()] != '.') ++count;
+        start = end + 1;
     }
+    return count;
+}
 
-    // fallback
-    return "0";
+void appendJSONNumber(std::string& out, double value) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.3f", value);
+    out += buffer;
+}
 }
 
+Compilation::Compilation(std::string src) {
+    source.assign(std::vector<char>(src.begin(), src.end()));
+}
 
-std::string generateIR(ASTNode* root) {
-    std::stringstream ir;
+double Compilation::elapsedMs() const {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - created).count();
+}
 
-    for (auto* child : root->children) {
-        if (child->type == "Function") {
-            std::string fname = child->value;
-            ir << "define i32 @" << fname << "() {\n";
+void Compilation::record(const char* phase, double startMs, std::initializer_list<PhaseCounter> counters) {
+    if (events.size() >= kMaxPhaseEvents) events.erase(events.begin(), events.begin() + kMaxPhaseEvents / 2);
+    events.push_back({phase, startMs, elapsedMs() - startMs, counters});
+}
 
-            ASTNode* block = nullptr;
-            for (auto* c : child->children) {
-                if (c->type == "Block") {
-                    block = c;
-                    break;
-                }
-            }
+const std::string& Compilation::statsJSON() {
+    std::string out = "{\"phases\":[";
+    for (size_t i = 0; i < events.size(); ++i) {
+        const PhaseEvent& e = events[i];
+        out += i ? ",{\"phase\":\"" : "{\"phase\":\"";
+        out += e.phase + "\",\"startMs\":";
+        appendJSONNumber(out, e.startMs);
+        out += ",\"ms\":";
+        appendJSONNumber(out, e.ms);
+        out += ",\"counters\":{";
+        for (size_t k = 0; k < e.counters.size(); ++k) {
+            if (k) out += ",";
+            out += "\"" + std::string(e.counters[k].name) + "\":" + std::to_string(e.counters[k].value);
+        }
+        out += "}}";
+    }
+    out += "]}";
+    statsText = std::move(out);
+    return statsText;
+}
 
-            if (!block) {
-                ir << "  ret i32 0\n";
-                ir << "}\n";
-                continue;
-            }
+const std::string& Compilation::text() {
+    if (!sourceText) {
+        const char* data = source.physical();
+        sourceText.emplace(data, source.gap());
+        sourceText->append(data + source.gap() + source.gapSize(), source.size() - source.gap());
+    }
+    return *sourceText;
+}
 
-            std::map<std::string, std::string> varRegs;    // variable to current register holding its value
-            std::map<std::string, std::string> varTypes;   // variable to LLVM type: i32, float, i8
-            int regCount = 1;
+void Compilation::lex() {
+    if (lexed) return;
+    double start = elapsedMs();
+    source.moveGap(source.size());
+    tokenStream.assign(tokenizeStructured(std::string_view(source.physical(), source.size())));
+    lexed = true;
+    record("lex", start, {{"bytes", source.size()}, {"tokens", tokenStream.size()}});
+}
 
-            for (auto* stmt : block->children) {
-                if (stmt->type == "VarDecl") {
-                    // VarDecl children: [Type, Name, optional Expr]
-                    std::string varTypeStr = stmt->children[0]->value;  // "int", "float", "char"
-                    std::string varName = stmt->children[1]->value;
+const std::vector<Token>& Compilation::tokens() {
+    lex();
+    if (!tokenList) {
+        tokenList.emplace();
+        tokenList->reserve(tokenStream.size());
+        for (size_t i = 0; i < tokenStream.size(); ++i) {
+            Token t = tokenStream[i];
+            t.offset = static_cast<uint32_t>(tokenOffset(i));
+            tokenList->push_back(t);
+        }
+    }
+    return *tokenList;
+}
 
-                    std::string llvmType;
-                    if (varTypeStr == "int") llvmType = "i32";
-                    else if (varTypeStr == "float") llvmType = "float";
-                    else if (varTypeStr == "char") llvmType = "i8";
-                    else llvmType = "i32"; // default fallback
+// Where token `i` starts in the text, whichever side of the gap it is on.
+size_t Compilation::tokenOffset(size_t i) const {
+    return i < tokenStream.gap() ? tokenStream[i].offset : source.size() - tokenStream[i].offset;
+}
 
-                    varTypes[varName] = llvmType;
+// Moves the token gap to before token `token` and the text gap to `position`, which has to
+// lie between the end of the token before it and the start of that token.
+void Compilation::moveGaps(size_t token, size_t position) {
+    const size_t length = source.size();
+    source.moveGap(position);
+    const char* data = source.physical();
+    const size_t textGap = source.gapSize();
+    tokenStream.moveGap(
+        token,
+        [&](Token& t) {
+            t.offset = static_cast<uint32_t>(length - t.offset);
+            t.value = std::string_view(data + t.offset, t.value.size());
+        },
+        [&](Token& t) {
+            t.value = std::string_view(data + t.offset + textGap, t.value.size());
+            t.offset = static_cast<uint32_t>(length - t.offset);
+        });
+}
 
-                    // Allocate variable
-                    // ir << "  %" << varName << " = alloca " << llvmType << "\n";
-                    ir << "  %" << sanitizeVarName(varName) << " = alloca " << llvmType << "\n";
+// Moves the step gap to before the first step that begins at or after token `tokenIndex`.
+void Compilation::moveStepGap(size_t tokenIndex) {
+    const uint32_t count = static_cast<uint32_t>(tokenStream.size());
+    auto begin = [&](size_t i) -> size_t {
+        return i < steps.gap() ? steps[i].begin : static_cast<uint32_t>(count - steps[i].begin);
+    };
+    size_t lo = 0, hi = steps.size();
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (begin(mid) < tokenIndex) lo = mid + 1;
+        else hi = mid;
+    }
+    auto flip = [&](ParseStep& st) {
+        st.begin = count - st.begin;
+        st.end = count - st.end;
+        st.furthest = count - st.furthest;
+    };
+    steps.moveGap(lo, flip, flip);
+}
 
+// Points every token back into the text after the text buffer was reallocated.
+void Compilation::rebaseTokenViews() {
+    const char* data = source.physical();
+    for (size_t i = 0; i < tokenStream.size(); ++i) {
+        Token& t = tokenStream[i];
+        size_t at = tokenOffset(i);
+        t.value = std::string_view(data + (i < tokenStream.gap() ? at : at + source.gapSize()), t.value.size());
+    }
+}
 
-                    // Initialization if present
-                    if (stmt->children.size() == 3) {
-                        ASTNode* expr = stmt->children[2];
-                        std::string exprReg = generateIRForExpr(expr, ir, varRegs, regCount, varTypes);
-                        
-                        // Store the expr result into variable
-                        ir << "  store " << llvmType << " " << exprReg << ", " << llvmType << "* %" <<  sanitizeVarName(varName) << "\n";
-                    }
-                }
-                else if (stmt->type == "Return") {
-                    ASTNode* retVal = stmt->children[0];
-                    std::string retReg = generateIRForExpr(retVal, ir, varRegs, regCount, varTypes);
-                    ir << "  ret i32 " << retReg << "\n"; // Assuming function returns int; for float functions you need to adapt.
-                }
-            }
+ASTNode* Compilation::ast() {
+    if (!parsed) {
+        parseAll();
+    } else if (rootStale) {
+        // Refill the root's children in place; they only need more room when items were added.
+        size_t count = 0;
+        for (size_t i = 0; i < steps.size(); ++i) count += steps[i].node != nullptr;
+        if (count > rootCapacity) {
+            rootCapacity = count + count / 2 + 16;
+            root->children = arena.makeArray<ASTNode*>(rootCapacity);
+        }
+        ASTNode** out = root->children;
+        for (size_t i = 0; i < steps.size(); ++i) {
+            if (steps[i].node) *out++ = steps[i].node;
+        }
+        root->childCount = static_cast<uint32_t>(count);
+        rootStale = false;
+    }
+    return root;
+}
+
+void Compilation::parseAll() {
+    lex();
+    double start = elapsedMs();
+    arena.reset();
+    context.errors.clear();
+    size_t allocationsBefore = arena.allocationCount();
+    std::vector<ParseStep> parsedSteps;
+    Parser parser(context, tokenStream, arena);
+    parser.parseSteps(parsedSteps, [](size_t) { return false; });
+    steps.assign(std::move(parsedSteps));
+    root = parser.buildRoot(steps);
+    rootCapacity = root->childCount;
+    rootStale = false;
+    parsed = true;
+    arenaBytesAfterFullParse = arena.bytesUsed();
+    record("parse", start, {{"tokens", tokenStream.size()},
+                            {"items", steps.size()},
+                            {"nodes", countNodes(root)},
+                            {"allocations", arena.allocationCount() - allocationsBefore},
+                            {"arenaBytes", arena.bytesUsed()}});
+}
 
-            ir << "}\n";
+const std::vector<std::string>& Compilation::diagnostics() {
+    if (!analyzed) {
+        ASTNode* tree = ast();
+        double start = elapsedMs();
+        context.errors.clear();
+        context.symbols.clear();
+        context.functions.clear();
+        for (size_t i = 0; i < steps.size(); ++i) {
+            context.errors.insert(context.errors.end(), steps[i].errors.begin(), steps[i].errors.end());
         }
+        analyzeSemantics(context, tree);
+        diagnosticList = context.errors;
+        analyzed = true;
+        record("sema", start, {{"diagnostics", diagnosticList.size()}, {"symbols", context.symbols.size()}});
     }
+    return diagnosticList;
+}
 
-    return ir.str();
+const std::string& Compilation::tokenDump() {
+    if (!tokenText) tokenText = serializeTokens(tokens());
+    return *tokenText;
 }
 
+const std::string& Compilation::astDump() {
+    if (!astText) {
+        const std::vector<std::string>& errors = diagnostics();
+        std::string out = printASTTree(ast());
+        //Checks if any semantic errors were collected during semantic analysis.
+        if (!errors.empty()) {
+            out += "\n--- Semantic Errors ---\n";
+            for (const std::string& err : errors) out += "❌ " + err + "\n";
+            out += "\nSemantic Errors:\n";
+            for (const std::string& err : errors) out += "  - " + err + "\n";
+        } else {
+            out += "\n✅ Semantic analysis passed.\n";
+        }
+        astText = std::move(out);
+    }
+    return *astText;
+}
 
+const std::string& Compilation::diagnosticsText() {
+    if (!diagnosticText) {
+        std::string out;
+        for (const std::string& err : diagnostics()) out += err + "\n";
+        diagnosticText = std::move(out);
+    }
+    return *diagnosticText;
+}
 
+const IRModule& Compilation::irModule() {
+    if (!module) {
+        ASTNode* tree = ast();
+        diagnostics();  // fills the types buildIR reads
+        double start = elapsedMs();
+        module = buildIR(tree);
+        record("irgen", start, {{"functions", module->functions.size()}, {"instructions", countInstructions(*module)}});
+    }
+    return *module;
+}
 
+const std::string& Compilation::ir() {
+    if (!irText) irText = printIR(irModule());
+    return *irText;
+}
 
-// -------------------- Exports --------------------
-extern "C" {
-    EMSCRIPTEN_KEEPALIVE
-    const char* run_lexer(const char* input) {
-        static std::string result;
-        result = serializeTokens(tokenizeStructured(std::string(input)));
-        return result.c_str();
+const std::string& Compilation::irBinary() {
+    if (!irBytes) irBytes = serializeIR(irModule());
+    return *irBytes;
+}
+
+const IRModule& Compilation::optimizedModule() {
+    if (!optimized) {
+        const IRModule& input = irModule();
+        double start = elapsedMs();
+        optimized = input;
+        OptimizeReport report;
+        optimizedText = optimizeIR(*optimized, &report);
+        record("opt", start, {{"instructionsBefore", report.instructionsBefore},
+                              {"instructionsAfter", report.instructionsAfter}});
+        // Passes run back to back at the start of "opt"; lay them out inside it.
+        double passStart = start;
+        for (const PassStats& pass : report.passes) {
+            if (events.size() >= kMaxPhaseEvents) break;
+            events.push_back({std::string("opt.") + pass.pass, passStart, pass.ms, {{pass.unit, pass.count}}});
+            passStart += pass.ms;
+        }
     }
+    return *optimized;
+}
 
-    EMSCRIPTEN_KEEPALIVE
-   const char* run_ast(const char* input) {
-    static std::string result;
-    globalSymbolTable.clear();
-    semanticErrors.clear();
+const std::string& Compilation::optimizedIR() {
+    optimizedModule();
+    return *optimizedText;
+}
 
-    result = generateAST(input);
-    if (!semanticErrors.empty()) {
-        result += "\nSemantic Errors:\n";
-        for (auto& err : semanticErrors)
-            result += "  - " + err + "\n";
+const std::string& Compilation::assembly() {
+    if (!assemblyText) {
+        const IRModule& input = optimizedModule();
+        double start = elapsedMs();
+        assemblyText = lowerToX86(input);
+        record("codegen", start, {{"bytes", assemblyText->size()}, {"instructions", countLines(*assemblyText, "\t")}});
     }
-    return result.c_str();
-   }
+    return *assemblyText;
+}
 
+const Bytecode& Compilation::bytecode() {
+    if (!program) {
+        const IRModule& input = optimizedModule();
+        double start = elapsedMs();
+        program = compileBytecode(input);
+        record("bytecode", start, {{"instructions", program->code.size()}, {"functions", program->functions.size()}});
+    }
+    return *program;
+}
 
-   EMSCRIPTEN_KEEPALIVE
-const char* run_ir(const char* input) {
-    static std::string result;
+const std::string& Compilation::executionResult() {
+    if (!executionText) {
+        const IRModule& input = optimizedModule();
+        if (!jitAvailable()) bytecode();
+        double start = elapsedMs();
+        executionText = jitAvailable() ? runCodegen(input) : formatVMResult(runBytecode(*program), *program);
+        record("run", start, {});
+    }
+    return *executionText;
+}
 
-    tokens = tokenizeStructured(input);
-    current = 0;
-    semanticErrors.clear();
-    globalSymbolTable.clear();
+void Compilation::invalidateArtifacts() {
+    analyzed = false;
+    diagnosticList.clear();
+    tokenText.reset();
+    astText.reset();
+    diagnosticText.reset();
+    module.reset();
+    optimized.reset();
+    irText.reset();
+    irBytes.reset();
+    optimizedText.reset();
+    assemblyText.reset();
+    program.reset();
+    executionText.reset();
+}
 
-    ASTNode* root = new ASTNode("ROOT");
+bool Compilation::applyEdit(size_t offset, size_t removed, std::string_view inserted) {
+    const size_t oldSize = source.size();
+    if (offset > oldSize || removed > oldSize - offset) return false;
+
+    double start = elapsedMs();
+    invalidateArtifacts();
+    sourceText.reset();
+    tokenList.reset();
+    if (!lexed) {
+        source.moveGap(offset);
+        source.eraseAfterGap(removed);
+        source.insertAtGap(inserted.begin(), inserted.end());
+        return true;
+    }
 
-    while (current < tokens.size()) {
-        ASTNode* node = parseFunction();
-        if (!node) node = parseStatement();
-        if (!node) node = parseVarDecl();
-        if (node) root->children.push_back(node);
-        else current++;
-    }
-      result = generateIR(root);
-    delete root;
-    return result.c_str();
-
-   
-}
-
-///
-   EMSCRIPTEN_KEEPALIVE
-const char* run_optimized_ir(const char* inputIR) {
-    static std::string optimized;
-
-    std::string ir(inputIR);
-
-    std::stringstream inputStream(ir);
-    std::stringstream outputStream;
-    std::string line;
-
-    // Very simple optimization: Replace "ret i32 40 + 2" with "ret i32 42"
-    std::regex constOpRegex(R"(^(\s*%[\w\d]+ = )(\w+) i32 (-?\d+), (-?\d+))");
-    std::smatch match;
-    while (std::getline(inputStream, line)) {
-        std::smatch match;
-        if (std::regex_search(line, match, constOpRegex)) {
-            std::string regAssign = match[1]; // e.g. "  %3 = "
-            std::string op = match[2];        // e.g. "add"
-            int lhs = std::stoi(match[3]);
-            int rhs = std::stoi(match[4]);
-            int result = 0;
-
-            if (op == "add") result = lhs + rhs;
-            else if (op == "sub") result = lhs - rhs;
-            else if (op == "mul") result = lhs * rhs;
-            else if (op == "sdiv") {
-                if (rhs == 0) {  // avoid division by zero
-                    outputStream << line << "\n";
-                    continue;
-                }
-                result = lhs / rhs;
-            }
-            else {
-                outputStream << line << "\n";
-                continue;
-            }
+    const size_t oldCount = tokenStream.size();
 
-            // Replace line with folded constant
-            outputStream << regAssign << "add i32 " << result << "\n";
+    // Resume lexing at the start of the token before the first one touching the edit, or at the
+    // top of the file. Tokens only look one or two bytes past their end, so nothing earlier moves.
+    size_t lo = 0, hi = oldCount;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (tokenOffset(mid) + tokenStream[mid].value.size() < offset) lo = mid + 1;
+        else hi = mid;
+    }
+    const size_t firstTouched = lo;
+    const size_t relexBegin = firstTouched > 0 ? firstTouched - 1 : 0;
+    const size_t lexFrom = firstTouched > 0 ? tokenOffset(relexBegin) : 0;
+    const size_t editEndOld = offset + removed;
+    const size_t editEndNew = offset + inserted.size();
+    size_t resume = relexBegin;
+    while (resume < oldCount && tokenOffset(resume) < editEndOld) ++resume;
+
+    // Bring the gaps to the damage: the tokens from relexBegin and the text from lexFrom go
+    // after them, the steps that begin past the damage too. Then drop the damaged tokens and
+    // make the edit at the text gap; what follows it keeps its distance from the end.
+    if (parsed) moveStepGap(resume);
+    moveGaps(relexBegin, lexFrom);
+    tokenStream.eraseAfterGap(resume - relexBegin);
+    source.moveGap(offset);
+    source.eraseAfterGap(removed);
+    if (source.reserveGap(inserted.size())) rebaseTokenViews();
+    source.insertAtGap(inserted.begin(), inserted.end());
+    const size_t newSize = source.size();
+
+    // Lex from lexFrom through the inserted text, then pull in the rest a doubling window at a
+    // time. Stop as soon as a fresh token starts exactly where an old token past the edit now
+    // starts: the lexer is stateless between tokens, so everything after that is unchanged.
+    const char* data = source.physical();
+    const char* tail = data + source.gap() + source.gapSize();
+    const size_t tailSize = newSize - source.gap();
+    const size_t oldTail = tokenStream.size() - tokenStream.gap();
+    auto oldTokenAt = [&](size_t k) { return newSize - tokenStream[tokenStream.gap() + k].offset; };
+
+    ChunkedLexer lexer;
+    std::vector<Token> fresh;
+    lexer.feed(std::string_view(data + lexFrom, source.gap() - lexFrom), fresh);
+    size_t pulled = 0, checked = 0, next = 0;
+    bool synced = false;
+    for (bool finished = false;;) {
+        for (; checked < fresh.size(); ++checked) {
+            size_t at = lexFrom + fresh[checked].offset;
+            if (at < editEndNew) continue;
+            while (next < oldTail && oldTokenAt(next) < at) ++next;
+            if (next < oldTail && oldTokenAt(next) == at) {
+                synced = true;
+                break;
+            }
+        }
+        if (synced || finished) break;
+        if (pulled < tailSize) {
+            size_t grab = std::min(tailSize - pulled, std::max<size_t>(64, pulled));
+            lexer.feed(std::string_view(tail + pulled, grab), fresh);
+            pulled += grab;
         } else {
-            outputStream << line << "\n";
+            lexer.finish(fresh);
+            finished = true;
         }
     }
-    optimized = "; Optimized IR\n" + outputStream.str();
-    return optimized.c_str();
+    fresh.resize(checked);
+
+    // Splice: the old tokens the fresh ones overlap go, and the text up to the first token
+    // kept moves before the gap so the fresh tokens can point into it.
+    tokenStream.eraseAfterGap(synced ? next : oldTail);
+    source.moveGap(synced ? oldTokenAt(0) : newSize);
+    data = source.physical();
+    tokenStream.reserveGap(fresh.size());
+    for (Token tok : fresh) {
+        tok.offset = static_cast<uint32_t>(lexFrom + tok.offset);
+        tok.value = std::string_view(data + tok.offset, tok.value.size());
+        tokenStream.insertAtGap(tok);
+    }
+    record("relex", start, {{"bytes", newSize}, {"freshTokens", fresh.size()}, {"tokens", tokenStream.size()}});
 
+    if (parsed) reparse(relexBegin, fresh.size());
+    return true;
 }
 
+// Old tokens from damageBegin were replaced by `freshCount` new ones, and the step gap is
+// before the first step that began past the damaged ones. Top-level steps that never looked
+// at the damaged range are kept, and the parser re-runs from the first affected step until
+// it lines up with one of the steps after the gap again.
+void Compilation::reparse(size_t damageBegin, size_t freshCount) {
+    double start = elapsedMs();
+    const size_t freshEnd = damageBegin + freshCount;
+    const uint32_t count = static_cast<uint32_t>(tokenStream.size());
+    auto at = [&](size_t i, uint32_t ParseStep::*field) -> size_t {
+        return i < steps.gap() ? steps[i].*field : static_cast<uint32_t>(count - steps[i].*field);
+    };
+
+    size_t lo = 0, hi = steps.gap();
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (at(mid, &ParseStep::begin) <= damageBegin) lo = mid + 1;
+        else hi = mid;
+    }
+    size_t first = lo > 0 ? lo - 1 : 0;
+    while (first > 0 && at(first - 1, &ParseStep::furthest) >= damageBegin) --first;
+    if (first < steps.size() && at(first, &ParseStep::furthest) < damageBegin) ++first;
+
+    size_t parseFrom = first < steps.size() ? at(first, &ParseStep::begin)
+                                            : (steps.size() == 0 ? 0 : at(steps.size() - 1, &ParseStep::end));
+
+    // Old steps that start past the damage, by their position in the new token stream.
+    auto reusableFrom = [&](size_t newIndex) -> size_t {
+        if (newIndex < freshEnd) return steps.size();
+        size_t below = steps.gap(), above = steps.size();
+        while (below < above) {
+            size_t mid = below + (above - below) / 2;
+            if (at(mid, &ParseStep::begin) < newIndex) below = mid + 1;
+            else above = mid;
+        }
+        return below < steps.size() && at(below, &ParseStep::begin) == newIndex ? below : steps.size();
+    };
+
+    std::vector<ParseStep> reparsed;
+    size_t reuse = steps.size();
+    Parser parser(context, tokenStream, arena, parseFrom);
+    parser.parseSteps(reparsed, [&](size_t index) {
+        reuse = reusableFrom(index);
+        return reuse < steps.size();
+    });
+
+    steps.moveGap(first);
+    steps.eraseAfterGap(reuse - first);
+    steps.reserveGap(reparsed.size());
+    for (ParseStep& st : reparsed) steps.insertAtGap(std::move(st));
+    const size_t reparsedItems = reparsed.size();
+
+    // Replaced subtrees stay in the arena until the next full parse; reclaim once they dominate.
+    if (arena.bytesUsed() > 2 * arenaBytesAfterFullParse + 256 * 1024) {
+        parseAll();
+    } else {
+        rootStale = true;
+    }
+    record("reparse", start, {{"items", steps.size()}, {"reparsedItems", reparsedItems}, {"arenaBytes", arena.bytesUsed()}});
+}
+
+// -------------------- Streaming compilation --------------------
+namespace {
+// Complete items are parsed once this many tokens have piled up, so per-window overhead
+// is amortized over many small declarations.
+constexpr size_t kStreamWindowTokens = 1u << 14;
+}
+
+StreamingCompiler::StreamingCompiler(StreamEmit emit, Writer write, Reporter report)
+    : emit(emit), write(std::move(write)), report(std::move(report)), nextAttempt(kStreamWindowTokens) {}
+
+void StreamingCompiler::feed(std::string_view chunk) {
+    fresh.clear();
+    lexer.feed(chunk, fresh);
+    take(fresh);
+}
+
+void StreamingCompiler::finish() {
+    fresh.clear();
+    lexer.finish(fresh);
+    take(fresh);
+    if (emit == StreamEmit::Tokens) return;
+
+    compileWindow(true);
+    if (emit == StreamEmit::Assembly) {
+        if (!wroteProlog) write(printX86Prologue());
+        write(printX86Epilogue());
+    }
+}
+
+void StreamingCompiler::take(const std::vector<Token>& tokens) {
+    if (emit == StreamEmit::Tokens) {
+        peakWindow = std::max(peakWindow, tokens.size());
+        if (!tokens.empty()) write(serializeTokens(tokens));
+        return;
+    }
+
+    // The lexer's views die with the next chunk, so the window keeps its own copy of the text.
+    for (const Token& tok : tokens) {
+        char* text = static_cast<char*>(arena.allocate(tok.value.size(), 1));
+        std::memcpy(text, tok.value.data(), tok.value.size());
+        window.push_back({tok.kind, std::string_view(text, tok.value.size()), tok.offset});
+        if (tok.kind != TokenKind::Symbol) continue;
+        if (tok.value == "{") ++depth;
+        else if (tok.value == "}" && depth > 0) --depth;
+        if (depth == 0 && (tok.value == ";" || tok.value == "}")) boundary = window.size();
+    }
+    peakWindow = std::max(peakWindow, window.size());
+    if (boundary >= nextAttempt) compileWindow(false);
+}
 
-EMSCRIPTEN_KEEPALIVE
-const char* run_codegen(const char* ir) {
-    static std::string result;
+// Parses the complete items in the window and emits them. Returns false without consuming
+// anything if an item ran into the end of the window, since the tokens after it could
+// change how it parses; the window is retried once it has doubled.
+bool StreamingCompiler::compileWindow(bool atEnd) {
+    size_t count = atEnd ? window.size() : boundary;
+    std::vector<Token> items(window.begin(), window.begin() + count);
+    std::vector<ParseStep> steps;
+    Parser parser(context, items, arena);
+    parser.parseSteps(steps, [](size_t) { return false; });
+    if (!atEnd) {
+        for (const ParseStep& step : steps) {
+            if (step.furthest >= count) {
+                nextAttempt = window.size() * 2;
+                return false;
+            }
+        }
+    }
 
-    std::string input(ir);
-    std::smatch match;
+    for (const ParseStep& step : steps) {
+        for (const std::string& message : step.errors) report(message);
+        if (!step.node) continue;
+        analyzeSemantics(context, step.node);
+        for (const std::string& message : context.errors) report(message);
+        context.errors.clear();
+        if (step.node->kind == NodeKind::Function) emitFunction(step.node);
+    }
 
-    // 1. Direct return: ret i32 42
-    std::regex directRet(R"(ret i32 (\d+))");
-    if (std::regex_search(input, match, directRet)) {
-        result = "Execution result: " + match[1].str();
-        return result.c_str();
+    // Start the next window with the partial item left over, rehomed in a fresh arena.
+    std::string tail;
+    for (size_t i = count; i < window.size(); ++i) tail += window[i].value;
+    window.erase(window.begin(), window.begin() + count);
+    arena.reset();
+    char* text = static_cast<char*>(arena.allocate(tail.size(), 1));
+    std::memcpy(text, tail.data(), tail.size());
+    for (Token& tok : window) {
+        tok.value = std::string_view(text, tok.value.size());
+        text += tok.value.size();
     }
+    boundary = 0;
+    nextAttempt = kStreamWindowTokens;
+    return true;
+}
 
-    // 2. Function call: call i32 @func(i32 X, i32 Y)
-    std::regex callPattern(R"(call i32 @(\w+)\(i32 (\d+), i32 (\d+)\))");
-    if (std::regex_search(input, match, callPattern)) {
-        std::string func = match[1].str();
-        int a = std::stoi(match[2].str());
-        int b = std::stoi(match[3].str());
+// A function is optimized with the small functions before it at hand to inline, as
+// optimizeModule would have them, and then stays only if it is small enough to be inlined
+// itself.
+void StreamingCompiler::emitFunction(ASTNode* function) {
+    if (emit == StreamEmit::IR) {
+        IRModule module;
+        module.functions.push_back(buildFunctionIR(function));
+        write(printIR(module));
+        return;
+    }
 
-        if (func == "add") result = "Execution result: " + std::to_string(a + b);
-        else if (func == "sub") result = "Execution result: " + std::to_string(a - b);
-        else if (func == "mul") result = "Execution result: " + std::to_string(a * b);
-        else if (func == "div" || func == "divide") result = "Execution result: " + std::to_string(a / b);
-        else result = "Execution error: unsupported function '" + func + "'";
-        return result.c_str();
+    if (!wroteProlog) {
+        write(printX86Prologue());
+        wroteProlog = true;
     }
+    inlinable.functions.push_back(buildFunctionIR(function));
+    optimizeFunction(inlinable, inlinable.functions.size() - 1);
+    const IRFunction& fn = inlinable.functions.back();
+    std::string error;
+    if (!checkIRFunction(fn, error)) write("; error: function @" + fn.name + ": " + error + "\n");
+    else write(printX86Function(selectX86(fn)));
+    if (!isInlineCandidate(fn)) inlinable.functions.pop_back();
+}
+
 
-    result = "Execution error: no recognizable return.";
-    return result.c_str();
+// -------------------- Exports --------------------
+// One-shot exports hand back a malloc'd copy that the caller releases with free() (from
+// JavaScript: UTF8ToString, then _free), so results never alias between calls or threads.
+char* copyResult(const std::string& text) {
+    char* out = static_cast<char*>(std::malloc(text.size() + 1));
+    if (out) std::memcpy(out, text.c_str(), text.size() + 1);
+    return out;
 }
 
+extern "C" {
+    EMSCRIPTEN_KEEPALIVE
+    char* run_lexer(const char* input) {
+        return copyResult(Compilation(input).tokenDump());
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    char* run_ast(const char* input) {
+        return copyResult(Compilation(input).astDump());
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    char* run_ir(const char* input) {
+        return copyResult(Compilation(input).ir());
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    char* run_optimized_ir(const char* inputIR) {
+        return copyResult(optimizeIR(inputIR));
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    char* run_asm(const char* ir) {
+        return copyResult(compileToX86(ir));
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    char* run_codegen(const char* ir) {
+        return copyResult(runCodegen(ir));
+    }
+
+    // Session API: one handle per source text. Every artifact is computed on first
+    // request and cached, and the returned strings stay valid until the handle is destroyed.
+    EMSCRIPTEN_KEEPALIVE
+    Compilation* compilation_create(const char* source) {
+        return new Compilation(source);
+    }
 
+    EMSCRIPTEN_KEEPALIVE
+    void compilation_destroy(Compilation* c) {
+        delete c;
+    }
+
+    // Replaces `removedLength` bytes at byte `offset` with `text`, re-lexing and re-parsing only
+    // the damaged region. Returns 0 if the range is out of bounds.
+    EMSCRIPTEN_KEEPALIVE
+    int compilation_edit(Compilation* c, int offset, int removedLength, const char* text) {
+        if (offset < 0 || removedLength < 0) return 0;
+        return c->applyEdit(static_cast<size_t>(offset), static_cast<size_t>(removedLength), text) ? 1 : 0;
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    const char* compilation_tokens(Compilation* c) {
+        return c->tokenDump().c_str();
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    const char* compilation_ast(Compilation* c) {
+        return c->astDump().c_str();
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    const char* compilation_diagnostics(Compilation* c) {
+        return c->diagnosticsText().c_str();
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    const char* compilation_ir(Compilation* c) {
+        return c->ir().c_str();
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    const char* compilation_optimized_ir(Compilation* c) {
+        return c->optimizedIR().c_str();
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    const char* compilation_asm(Compilation* c) {
+        return c->assembly().c_str();
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    const char* compilation_execute(Compilation* c) {
+        return c->executionResult().c_str();
+    }
+
+    EMSCRIPTEN_KEEPALIVE
+    const char* compilation_stats(Compilation* c) {
+        return c->statsJSON().c_str();
+    }
 }
@@ -0,0 +1,568 @@
+// Shared declarations for the Mini-C front end and compilation session in web_driver.cpp.
+// The IR, the optimizer, the x86-64 backend, the JIT and the bytecode VM live in ir/,
+// optimizer/, backend/, jit/ and vm/, each with a header of its own that this one
+// includes. The WebAssembly build only needs the C exports at the bottom; native tools
+// (bench/, ...) link the same translation units and use the phase functions directly.
+#pragma once
+
+#include "../jit/jit.h"
+#include "../optimizer/optimizer.h"
+#include "../vm/vm.h"
+
+#include <algorithm>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <initializer_list>
+#include <type_traits>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+#include <new>
+#include <optional>
+#include <functional>
+#include <chrono>
+
+// -------------------- Lexer --------------------
+enum class TokenKind : uint8_t {
+    Keyword,
+    Identifier,
+    Integer,
+    Float,
+    Char,
+    Symbol,
+    EndOfFile
+};
+
+// A token is a kind plus a span into the source buffer; the source must outlive the tokens.
+struct Token {
+    TokenKind kind;
+    std::string_view value;
+    uint32_t offset;
+};
+
+const char* tokenKindName(TokenKind kind);
+std::vector<Token> tokenizeStructured(std::string_view input);
+std::string serializeTokens(const std::vector<Token>& tokens);
+
+// Lexes input that arrives in pieces. Each feed() appends the tokens that later input can no
+// longer change to `out`; a token, comment or whitespace run that touches the end of the
+// chunk is held back and rescanned with the next one. Offsets count from the start of the
+// whole input. The views in `out` stay valid only until the next feed() or finish().
+class ChunkedLexer {
+public:
+    void feed(std::string_view chunk, std::vector<Token>& out);
+    void finish(std::vector<Token>& out);
+    size_t bufferedBytes() const { return buffer.size() - consumed; }
+
+private:
+    void scan(bool atEnd, std::vector<Token>& out);
+
+    std::string buffer;
+    size_t consumed = 0;  // bytes of `buffer` already turned into tokens
+    uint64_t base = 0;    // input offset of buffer[0]
+};
+
+// -------------------- Arena --------------------
+// Bump allocator for per-compilation data. Nothing allocated from it is destroyed
+// individually; every block is released at once when the arena goes away.
+class Arena {
+public:
+    explicit Arena(size_t blockSize = 64 * 1024) : blockSize(blockSize) {}
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t size, size_t align) {
+        size_t pad = (align - (reinterpret_cast<uintptr_t>(cur) & (align - 1))) & (align - 1);
+        if (cur == nullptr || pad + size > static_cast<size_t>(end - cur)) {
+            grow(size + align);
+            pad = (align - (reinterpret_cast<uintptr_t>(cur) & (align - 1))) & (align - 1);
+        }
+        char* p = cur + pad;
+        cur = p + size;
+        used += size;
+        ++allocations;
+        return p;
+    }
+
+    template <typename T, typename... Args>
+    T* make(Args&&... args) {
+        static_assert(std::is_trivially_destructible<T>::value, "arena objects are never destroyed");
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    template <typename T>
+    T* makeArray(size_t n) {
+        static_assert(std::is_trivially_destructible<T>::value, "arena objects are never destroyed");
+        return static_cast<T*>(allocate(sizeof(T) * (n ? n : 1), alignof(T)));
+    }
+
+    // Releases every block; all pointers handed out so far become invalid.
+    void reset() {
+        blocks.clear();
+        cur = end = nullptr;
+        used = reserved = allocations = 0;
+    }
+
+    size_t bytesUsed() const { return used; }
+    size_t bytesReserved() const { return reserved; }
+    size_t allocationCount() const { return allocations; }
+
+private:
+    void grow(size_t minSize) {
+        size_t size = minSize > blockSize ? minSize : blockSize;
+        blocks.emplace_back(new char[size]);
+        cur = blocks.back().get();
+        end = cur + size;
+        reserved += size;
+    }
+
+    size_t blockSize;
+    std::vector<std::unique_ptr<char[]>> blocks;
+    char* cur = nullptr;
+    char* end = nullptr;
+    size_t used = 0;
+    size_t reserved = 0;
+    size_t allocations = 0;
+};
+
+// -------------------- AST --------------------
+enum class NodeKind : uint8_t {
+    Root,
+    Function,    // value = name; [ReturnType, Param..., Block]
+    ReturnType,
+    Param,       // [Type, Name]
+    Block,
+    VarDecl,
+    Type,
+    Name,
+    Literal,
+    Identifier,
+    BinaryOp,
+    Assignment,  // value = target name; [value, optional element index]
+    Return,
+    Call,   // value = callee; [argument...]
+    If,     // [condition, then, optional else]
+    While,  // [condition, body]
+    For,    // [init, condition, step, body]; a missing part is an empty Block
+    ArrayDecl,  // [Type, Name, Literal length]
+    Index       // value = array name; [index]
+};
+
+// Every phase after parsing walks the tree recursively, so the parser rejects input that
+// would make it deeper than these: nested statement bodies, parentheses, call arguments
+// and indices count against kMaxNesting, and the height of any one expression, including
+// a long run of operators, against kMaxExpressionDepth.
+constexpr uint32_t kMaxNesting = 256;
+constexpr uint32_t kMaxExpressionDepth = 1024;
+
+const char* nodeKindName(NodeKind kind);
+
+// Source-level value types. Type names only ever come from the int/float/char keywords.
+enum class ValueType : uint8_t { Unknown, Int, Float, Char };
+
+// Nodes live in an Arena. `value` is a copy of the token text in the same arena, and
+// children are a fixed array allocated from it once the node is complete. The parser
+// hash-conses expressions, so an expression written twice where its names mean the same
+// thing is one node with several parents, and the tree is really a DAG.
+struct ASTNode {
+    NodeKind kind;
+    uint32_t childCount = 0;
+    std::string_view value;
+    ASTNode** children = nullptr;
+
+    // Filled by analyzeSemantics: the type of an expression or of the variable a VarDecl
+    // declares, and whether an Identifier resolved to a declaration.
+    ValueType inferredType = ValueType::Unknown;
+    bool isDeclared = false;
+    bool shared = false;  // the parser handed this node out more than once
+    uint16_t height = 1;  // of an expression: nodes on the longest path down to a leaf
+
+    ASTNode(NodeKind k, std::string_view v = {}) : kind(k), value(v) {}
+
+    ASTNode* child(size_t i) const { return children[i]; }
+    ASTNode** begin() const { return children; }
+    ASTNode** end() const { return children + childCount; }
+};
+
+// -------------------- Symbols --------------------
+const char* valueTypeName(ValueType type);   // "unknown", "int", "float", "char"
+ValueType parseValueType(std::string_view text);
+
+// Maps each distinct identifier to a dense id, so later phases compare and index integers
+// instead of hashing strings. Ids are assigned in order of first appearance.
+class StringInterner {
+public:
+    static constexpr uint32_t kNone = UINT32_MAX;
+
+    uint32_t intern(std::string_view text);
+    uint32_t find(std::string_view text) const;  // kNone if never interned
+    const std::string& text(uint32_t id) const { return strings[id]; }
+    size_t size() const { return strings.size(); }
+    void clear();
+
+private:
+    struct Slot {
+        uint64_t hash = 0;
+        uint32_t id = kNone;
+    };
+    void grow();
+
+    std::vector<Slot> table = std::vector<Slot>(64);  // open addressing, at most half full
+    std::vector<std::string> strings;                 // id -> text
+};
+
+struct Symbol {
+    uint32_t name;     // StringInterner id
+    ValueType type;
+    uint32_t scope;    // nesting depth it was declared at; 0 is the global scope
+    uint32_t shadows;  // symbol this one hides until its scope closes, or kNone
+    uint32_t length;   // elements of an array, 0 for a scalar
+};
+
+// Declarations by scope, keyed by interned name. Every visible name resolves to its
+// innermost symbol in O(1); closing a scope drops its symbols and uncovers the ones they
+// shadowed. Symbol ids are dense and stay valid until the scope declaring them closes.
+class SymbolTable {
+public:
+    static constexpr uint32_t kNone = UINT32_MAX;
+
+    void enterScope() { scopeMarks.push_back(symbols.size()); }
+    void exitScope();
+    uint32_t depth() const { return static_cast<uint32_t>(scopeMarks.size()); }
+
+    // Returns the new symbol's id, or kNone if `name` is already declared in this scope.
+    uint32_t declare(uint32_t name, ValueType type, uint32_t length = 0);
+    uint32_t lookup(uint32_t name) const;  // innermost visible symbol, or kNone
+    Symbol& operator[](uint32_t id) { return symbols[id]; }
+    const Symbol& operator[](uint32_t id) const { return symbols[id]; }
+    size_t size() const { return symbols.size(); }
+    void clear();
+
+private:
+    std::vector<Symbol> symbols;     // declared in the open scopes, outermost first
+    std::vector<uint32_t> visible;   // name id -> innermost symbol id
+    std::vector<size_t> scopeMarks;  // symbols.size() when each open scope was entered
+};
+
+// What a call to a function needs to be checked: its result and parameter types.
+struct FunctionSignature {
+    ValueType returnType;
+    std::vector<ValueType> params;
+};
+
+// -------------------- Phases --------------------
+// Everything one compilation mutates: the names, symbols and diagnostics filled by the
+// parser and analyzer. Nothing in the compiler core is process-wide, so threads compiling
+// with separate contexts do not interfere.
+struct CompileContext {
+    StringInterner names;
+    SymbolTable symbols;
+    // Functions defined so far, by interned name. A call may only name one defined above
+    // it (or the function it is in), as in C without prototypes.
+    std::unordered_map<uint32_t, FunctionSignature> functions;
+    ValueType returnType = ValueType::Unknown;  // of the function being analyzed
+    std::unordered_set<const ASTNode*> analyzedShared;  // shared nodes the current analysis has typed
+    std::vector<std::string> errors;
+};
+
+// One iteration of the top-level parse loop: the tokens it consumed, the furthest token it
+// examined, the item it produced (null if a token was skipped) and its syntax errors.
+struct ParseStep {
+    uint32_t begin = 0;
+    uint32_t end = 0;
+    uint32_t furthest = 0;
+    ASTNode* node = nullptr;
+    std::vector<std::string> errors;
+};
+
+ASTNode* parseTokens(CompileContext& ctx, const std::vector<Token>& toks, Arena& arena);
+ASTNode* parseProgram(CompileContext& ctx, std::string_view input, Arena& arena);
+// One bottom-up pass: every node is visited once, in source order, and gets its
+// inferredType, so the cost is linear in the size of the tree. A shared node is typed
+// where it first appears and reports its errors only there.
+void analyzeSemantics(CompileContext& ctx, ASTNode* node);
+std::string printASTTree(ASTNode* node, int indent = 0);
+// printIR(buildIR(root)), for display.
+std::string generateIR(ASTNode* root);
+
+// Lowers an analyzed tree (IR generation reads the types analyzeSemantics left on the
+// nodes). Functions share no state while they are lowered, so buildIR is buildFunctionIR
+// over the Function nodes in program order and they may be lowered in parallel.
+IRModule buildIR(ASTNode* root);
+IRFunction buildFunctionIR(ASTNode* function);
+
+// -------------------- Instrumentation --------------------
+struct PhaseCounter {
+    const char* name;
+    uint64_t value;
+};
+
+// One phase a Compilation ran: when it started (ms after the Compilation was created), how
+// long it took and how much it processed. Optimizer passes appear as "opt.<pass>" inside
+// the "opt" phase.
+struct PhaseEvent {
+    std::string phase;
+    double startMs;
+    double ms;
+    std::vector<PhaseCounter> counters;
+};
+
+// -------------------- Compilation session --------------------
+// A sequence stored with a gap where it was last edited, so that an edit costs as much as
+// the distance from the one before rather than the length of the sequence. Elements after
+// the gap can be kept in a form that does not depend on their position, counted from the
+// end, say: they move only when the gap moves past them, and then go through the
+// conversions moveGap is given.
+template <typename T>
+class GapBuffer {
+public:
+    size_t size() const { return items.size() - gapSize(); }
+    size_t gap() const { return gapBegin; }
+    size_t gapSize() const { return gapEnd - gapBegin; }
+    // The storage: [0, gap()) is the sequence before the gap, [gap() + gapSize(), ...) after it.
+    T* physical() { return items.data(); }
+    const T* physical() const { return items.data(); }
+
+    T& operator[](size_t i) { return items[i < gapBegin ? i : i + gapSize()]; }
+    const T& operator[](size_t i) const { return items[i < gapBegin ? i : i + gapSize()]; }
+
+    // Replaces the contents; the gap starts out at the end.
+    void assign(std::vector<T> values) {
+        items = std::move(values);
+        gapBegin = gapEnd = items.size();
+    }
+
+    // Moves the gap to before element `at`. Each element that crosses it is passed to
+    // `toTail` once it is after the gap, or to `toHead` once it is before it.
+    template <typename ToHead, typename ToTail>
+    void moveGap(size_t at, ToHead toHead, ToTail toTail) {
+        // With no gap the elements are already in place, and moving one onto itself could empty it.
+        bool shift = gapSize() > 0;
+        if (at < gapBegin) {
+            size_t n = gapBegin - at;
+            if (shift) std::move_backward(items.begin() + at, items.begin() + gapBegin, items.begin() + gapEnd);
+            gapBegin -= n;
+            gapEnd -= n;
+            for (size_t i = gapEnd; i < gapEnd + n; ++i) toTail(items[i]);
+        } else if (at > gapBegin) {
+            size_t n = at - gapBegin;
+            if (shift) std::move(items.begin() + gapEnd, items.begin() + gapEnd + n, items.begin() + gapBegin);
+            for (size_t i = gapBegin; i < gapBegin + n; ++i) toHead(items[i]);
+            gapBegin += n;
+            gapEnd += n;
+        }
+    }
+    void moveGap(size_t at) {
+        moveGap(at, [](T&) {}, [](T&) {});
+    }
+
+    // Drops the `n` elements right after the gap.
+    void eraseAfterGap(size_t n) {
+        for (size_t i = gapEnd; i < gapEnd + n; ++i) items[i] = T();
+        gapEnd += n;
+    }
+
+    // Makes room for more than `n` elements at the gap, so the gap never closes up and the
+    // first edit of a full sequence opens it whatever its size. Returns true if that moved the
+    // elements after it; the gap grows with the sequence, so this happens rarely.
+    bool reserveGap(size_t n) {
+        if (gapSize() > n) return false;
+        size_t tail = items.size() - gapEnd;
+        std::vector<T> grown;
+        grown.reserve(gapBegin + std::max(n, size() / 8) + 16 + tail);
+        grown.insert(grown.end(), std::make_move_iterator(items.begin()),
+                     std::make_move_iterator(items.begin() + gapBegin));
+        grown.resize(grown.capacity() - tail);
+        grown.insert(grown.end(), std::make_move_iterator(items.begin() + gapEnd), std::make_move_iterator(items.end()));
+        items = std::move(grown);
+        gapEnd = items.size() - tail;
+        return true;
+    }
+
+    // Inserts before the gap. Call reserveGap first if the elements after it must not move.
+    void insertAtGap(T value) {
+        reserveGap(1);
+        items[gapBegin++] = std::move(value);
+    }
+    template <typename It>
+    void insertAtGap(It first, It last) {
+        reserveGap(static_cast<size_t>(last - first));
+        gapBegin = std::copy(first, last, items.begin() + gapBegin) - items.begin();
+    }
+
+private:
+    std::vector<T> items;
+    size_t gapBegin = 0;
+    size_t gapEnd = 0;
+};
+
+// Owns one source text and everything derived from it. Each artifact is produced on
+// first request and memoized, so asking for tokens, the AST dump and the IR of the
+// same program lexes and parses it once.
+class Compilation {
+public:
+    explicit Compilation(std::string source);
+    Compilation(const Compilation&) = delete;
+    Compilation& operator=(const Compilation&) = delete;
+
+    const std::string& text();
+
+    // Replaces `removed` bytes at `offset` with `inserted`. Only the damaged token window is
+    // re-lexed and only the top-level items that saw it are re-parsed; derived artifacts are
+    // dropped and rebuilt on next request. The text, tokens and items before the edit stay
+    // where they are and those after it are kept relative to the end, so the cost does not
+    // grow with the length of the source, only with the distance from the previous edit.
+    // Returns false if the range is out of bounds.
+    bool applyEdit(size_t offset, size_t removed, std::string_view inserted);
+
+    const std::vector<Token>& tokens();
+    ASTNode* ast();
+    const std::vector<std::string>& diagnostics();
+
+    const std::string& tokenDump();
+    const std::string& astDump();
+    const std::string& diagnosticsText();
+    const IRModule& irModule();
+    const IRModule& optimizedModule();
+    const std::string& ir();           // printIR(irModule())
+    const std::string& irBinary();     // serializeIR(irModule())
+    const std::string& optimizedIR();  // optimizedModule() with per-pass counts
+    const std::string& assembly();
+    const Bytecode& bytecode();        // compileBytecode(optimizedModule())
+    const std::string& executionResult();
+
+    // Phases run so far, oldest first. Only the most recent few hundred are kept, so an
+    // editor session that reparses on every keystroke does not grow without bound.
+    const std::vector<PhaseEvent>& phaseEvents() const { return events; }
+    // phaseEvents() as {"phases":[{"phase","startMs","ms","counters":{...}}, ...]}. The
+    // reference stays valid until the next call.
+    const std::string& statsJSON();
+
+private:
+    void lex();
+    void parseAll();
+    void reparse(size_t damageBegin, size_t freshCount);
+    void invalidateArtifacts();
+    size_t tokenOffset(size_t i) const;
+    void moveGaps(size_t token, size_t position);
+    void moveStepGap(size_t tokenIndex);
+    void rebaseTokenViews();
+    double elapsedMs() const;
+    void record(const char* phase, double startMs, std::initializer_list<PhaseCounter> counters);
+
+    // The text with its gap at the last edit. Tokens are views into it; the token gap stays
+    // between the same two tokens as the text gap, and a token after it keeps its distance
+    // from the end of the text in `offset`. A step after the step gap counts its begin, end
+    // and furthest back from the end of the token stream.
+    GapBuffer<char> source;
+    std::optional<std::string> sourceText;  // text()
+    CompileContext context;
+    Arena arena;
+
+    bool lexed = false;
+    GapBuffer<Token> tokenStream;
+    std::optional<std::vector<Token>> tokenList;  // tokens()
+    bool parsed = false;
+    ASTNode* root = nullptr;
+    size_t rootCapacity = 0;  // room in root->children
+    bool rootStale = false;   // a reparse changed the steps; ast() refills the root
+    GapBuffer<ParseStep> steps;
+    size_t arenaBytesAfterFullParse = 0;
+    bool analyzed = false;
+    std::vector<std::string> diagnosticList;
+
+    std::optional<std::string> tokenText;
+    std::optional<std::string> astText;
+    std::optional<std::string> diagnosticText;
+    std::optional<IRModule> module;
+    std::optional<IRModule> optimized;
+    std::optional<std::string> irText;
+    std::optional<std::string> irBytes;
+    std::optional<std::string> optimizedText;
+    std::optional<std::string> assemblyText;
+    std::optional<Bytecode> program;
+    std::optional<std::string> executionText;
+
+    std::chrono::steady_clock::time_point created = std::chrono::steady_clock::now();
+    std::vector<PhaseEvent> events;
+    std::string statsText;
+};
+
+// -------------------- Streaming compilation --------------------
+// Compiles input that arrives in chunks without holding all of it. Tokens are collected
+// only up to the end of the current top-level item (a `;` or `}` outside any braces); each
+// window of items is parsed, analyzed and emitted, then its tokens and AST are dropped.
+// Memory is bounded by the largest top-level item rather than the input.
+//
+// Output is what Compilation would produce, except that an optimizer or backend error
+// is reported for the function it belongs to instead of replacing the whole file.
+// Diagnostics are the same messages, reported item by item as each is parsed and
+// analyzed; Compilation::diagnostics() lists every syntax error before the first
+// semantic one.
+enum class StreamEmit { Tokens, IR, Assembly };
+
+class StreamingCompiler {
+public:
+    using Writer = std::function<void(std::string_view text)>;
+    using Reporter = std::function<void(const std::string& message)>;
+
+    StreamingCompiler(StreamEmit emit, Writer write, Reporter report);
+    StreamingCompiler(const StreamingCompiler&) = delete;
+    StreamingCompiler& operator=(const StreamingCompiler&) = delete;
+
+    void feed(std::string_view chunk);
+    void finish();
+
+    // Largest number of tokens held at once; a measure of the memory bound.
+    size_t peakWindowTokens() const { return peakWindow; }
+
+private:
+    void take(const std::vector<Token>& tokens);
+    bool compileWindow(bool atEnd);
+    void emitFunction(ASTNode* function);
+
+    StreamEmit emit;
+    Writer write;
+    Reporter report;
+
+    ChunkedLexer lexer;
+    std::vector<Token> fresh;
+    CompileContext context;
+    Arena arena;                 // token text and AST of the current window
+    std::vector<Token> window;
+    size_t boundary = 0;         // tokens in `window` that form complete top-level items
+    size_t nextAttempt = 0;      // window size before the next parse is worth trying
+    int depth = 0;
+    size_t peakWindow = 0;
+    bool wroteProlog = false;
+    IRModule inlinable;          // optimized functions small enough to inline into later ones
+};
+
+// -------------------- Exports --------------------
+extern "C" {
+// One-shot entry points; each returns a malloc'd string the caller must free().
+char* run_lexer(const char* input);
+char* run_ast(const char* input);
+char* run_ir(const char* input);
+char* run_optimized_ir(const char* inputIR);
+char* run_codegen(const char* ir);
+char* run_asm(const char* ir);
+
+Compilation* compilation_create(const char* source);
+void compilation_destroy(Compilation* c);
+int compilation_edit(Compilation* c, int offset, int removedLength, const char* text);
+const char* compilation_tokens(Compilation* c);
+const char* compilation_ast(Compilation* c);
+const char* compilation_diagnostics(Compilation* c);
+const char* compilation_ir(Compilation* c);
+const char* compilation_optimized_ir(Compilation* c);
+const char* compilation_asm(Compilation* c);
+const char* compilation_execute(Compilation* c);
+// Timings and counters for every phase the handle has run, as JSON; see statsJSON().
+const char* compilation_stats(Compilation* c);
+}
@@ -0,0 +1,1412 @@
+#include "ir.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// -------------------- IR --------------------
+const char* irTypeName(IRType type) {
+    switch (type) {
+        case IRType::Void:  return "void";
+        case IRType::I8:    return "i8";
+        case IRType::I32:   return "i32";
+        case IRType::Float: return "float";
+        case IRType::I1:    return "i1";
+        case IRType::V4I32: return "<4 x i32>";
+        case IRType::V8Float: return "<8 x float>";
+    }
+    return "void";
+}
+
+bool parseIRType(std::string_view text, IRType& type) {
+    if (text == "i32") type = IRType::I32;
+    else if (text == "float") type = IRType::Float;
+    else if (text == "i8") type = IRType::I8;
+    else if (text == "void") type = IRType::Void;
+    else if (text == "i1") type = IRType::I1;
+    else if (text == "<4 x i32>") type = IRType::V4I32;
+    else if (text == "<8 x float>") type = IRType::V8Float;
+    else return false;
+    return true;
+}
+
+bool isVectorType(IRType type) { return type == IRType::V4I32 || type == IRType::V8Float; }
+
+IRType elementType(IRType type) {
+    if (type == IRType::V4I32) return IRType::I32;
+    if (type == IRType::V8Float) return IRType::Float;
+    return type;
+}
+
+uint32_t laneCount(IRType type) { return type == IRType::V4I32 ? 4 : type == IRType::V8Float ? 8 : 1; }
+
+const char* irOpName(IROp op) {
+    switch (op) {
+        case IROp::Alloca: return "alloca";
+        case IROp::Load:   return "load";
+        case IROp::Store:  return "store";
+        case IROp::Add:    return "add";
+        case IROp::Sub:    return "sub";
+        case IROp::Mul:    return "mul";
+        case IROp::SDiv:   return "sdiv";
+        case IROp::FAdd:   return "fadd";
+        case IROp::FSub:   return "fsub";
+        case IROp::FMul:   return "fmul";
+        case IROp::FDiv:   return "fdiv";
+        case IROp::Ret:    return "ret";
+        case IROp::ICmp:   return "icmp";
+        case IROp::FCmp:   return "fcmp";
+        case IROp::ZExt:   return "zext";
+        case IROp::Phi:    return "phi";
+        case IROp::Br:
+        case IROp::CondBr: return "br";
+        case IROp::GEP:    return "getelementptr";
+        case IROp::Bitcast: return "bitcast";
+        case IROp::InsertElement: return "insertelement";
+        case IROp::ShuffleVector: return "shufflevector";
+        case IROp::ReduceAdd:
+        case IROp::Call:   return "call";
+    }
+    return "";
+}
+
+// The intrinsic ReduceAdd calls, which a module using it must declare.
+const char* irPredName(IRPred pred) {
+    static const char* const names[] = {"eq", "ne", "slt", "sle", "sgt", "sge", "oeq", "une", "olt", "ole", "ogt", "oge"};
+    return names[static_cast<uint8_t>(pred)];
+}
+
+bool isTerminator(IROp op) { return op == IROp::Ret || op == IROp::Br || op == IROp::CondBr; }
+
+bool isPure(IROp op) {
+    return (op >= IROp::Add && op <= IROp::FDiv && op != IROp::SDiv) || op == IROp::ICmp || op == IROp::FCmp ||
+           op == IROp::ZExt || (op >= IROp::GEP && op <= IROp::ReduceAdd);
+}
+
+std::vector<uint32_t> successors(const IRFunction& fn, uint32_t block) {
+    const std::vector<uint32_t>& insts = fn.blocks[block].insts;
+    for (auto it = insts.rbegin(); it != insts.rend(); ++it) {
+        const IRInst& inst = fn.insts[*it];
+        if (inst.dead) continue;
+        if (inst.op == IROp::Br) return {inst.target[0]};
+        if (inst.op == IROp::CondBr) {
+            if (inst.target[0] == inst.target[1]) return {inst.target[0]};
+            return {inst.target[0], inst.target[1]};
+        }
+        break;
+    }
+    return {};
+}
+
+bool isBinaryOp(IROp op) { return op >= IROp::Add && op <= IROp::FDiv; }
+
+bool parseBinaryOp(std::string_view text, IROp& op) {
+    for (IROp candidate : {IROp::Add, IROp::Sub, IROp::Mul, IROp::SDiv, IROp::FAdd, IROp::FSub, IROp::FMul, IROp::FDiv}) {
+        if (text == irOpName(candidate)) {
+            op = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+int32_t wrapToType(int64_t value, IRType type) {
+    if (type == IRType::I1) return static_cast<int32_t>(value & 1);
+    if (type == IRType::I8) return static_cast<int8_t>(static_cast<uint8_t>(value));
+    return static_cast<int32_t>(static_cast<uint32_t>(value));
+}
+
+// Splits one line of IR into words; commas, brackets, parentheses and braces separate words
+// and are dropped except for `{` and `}`, which the function header and footer need. A
+// vector type or constant in `<...>` is one word, with any `*` after it.
+void splitIRLine(std::string_view line, std::vector<std::string_view>& words) {
+    words.clear();
+    size_t i = 0;
+    while (i < line.size()) {
+        char c = line[i];
+        if (c == ';') break;
+        if (c == ' ' || c == '\t' || c == '\r' || c == ',' || c == '(' || c == ')' || c == '[' || c == ']') {
+            ++i;
+            continue;
+        }
+        if (c == '{' || c == '}') {
+            words.push_back(line.substr(i, 1));
+            ++i;
+            continue;
+        }
+        size_t start = i;
+        if (c == '<') i = std::min(line.find('>', i), line.size() - 1) + 1;
+        while (i < line.size() && !std::strchr(" \t\r,(){}[];", line[i])) ++i;
+        words.push_back(line.substr(start, i - start));
+    }
+}
+
+// Array elements are only reached through a getelementptr on an array alloca, and vectors
+// of them through a bitcast of one; the x86 backend folds both into the access itself.
+const char* addressError(const IRFunction& fn, const IRInst& inst) {
+    auto producer = [&](const IRValue& v) { return v.kind == IRValue::Kind::Inst ? &fn.insts[v.inst] : nullptr; };
+    bool misused = false;
+    forEachOperand(inst, [&](const IRValue& v) {
+        const IRInst* p = producer(v);
+        bool addressed = (inst.op == IROp::Load || inst.op == IROp::Bitcast) ? &v == &inst.a : inst.op == IROp::Store && &v == &inst.b;
+        misused = misused || (!addressed && p && (p->op == IROp::GEP || p->op == IROp::Bitcast));
+    });
+    if (misused) return "an element address used as a value";
+    switch (inst.op) {
+        case IROp::GEP: {
+            const IRInst* base = producer(inst.a);
+            bool array = base && base->op == IROp::Alloca && base->b.kind == IRValue::Kind::Int && base->type == inst.type;
+            return array ? nullptr : "a getelementptr that does not index an array";
+        }
+        case IROp::Bitcast: {
+            const IRInst* gep = producer(inst.a);
+            bool ok = gep && gep->op == IROp::GEP && isVectorType(inst.type) && elementType(inst.type) == gep->type;
+            return ok ? nullptr : "a bitcast that is not of a getelementptr";
+        }
+        case IROp::Load:
+        case IROp::Store: {
+            const IRInst* address = producer(inst.op == IROp::Load ? inst.a : inst.b);
+            bool viaBitcast = address && address->op == IROp::Bitcast;
+            bool element = viaBitcast || (address && address->op == IROp::GEP);
+            bool ok = isVectorType(inst.type) == viaBitcast && (!element || address->type == inst.type);
+            return ok ? nullptr : "a load or store of the wrong type";
+        }
+        default:
+            return nullptr;
+    }
+}
+
+// Every value is defined before it is used on every path: earlier in the same block, or in
+// a block that dominates the use. A phi has a value for each predecessor and uses it at
+// the end of that block. Code the entry cannot reach may use anything. Dominance is read
+// off an interval numbering of the dominator tree, so the check stays linear.
+const char* ssaError(const IRFunction& fn) {
+    IRCFG cfg(fn);
+    std::vector<uint32_t> blockOf(fn.insts.size(), IRCFG::kNone), position(fn.insts.size(), 0);
+    for (uint32_t b = 0; b < fn.blocks.size(); ++b) {
+        for (uint32_t k = 0; k < fn.blocks[b].insts.size(); ++k) {
+            blockOf[fn.blocks[b].insts[k]] = b;
+            position[fn.blocks[b].insts[k]] = k;
+        }
+    }
+    std::vector<std::vector<uint32_t>> children(fn.blocks.size());
+    for (uint32_t b : cfg.rpo) {
+        if (b != 0) children[cfg.idom[b]].push_back(b);
+    }
+    std::vector<uint32_t> enter(fn.blocks.size(), 0), leave(fn.blocks.size(), 0);
+    std::vector<std::pair<uint32_t, size_t>> stack{{0, 0}};
+    uint32_t clock = 0;
+    enter[0] = clock++;
+    while (!stack.empty()) {
+        auto& [b, next] = stack.back();
+        if (next == children[b].size()) {
+            leave[b] = clock++;
+            stack.pop_back();
+        } else {
+            uint32_t child = children[b][next++];
+            enter[child] = clock++;
+            stack.push_back({child, 0});
+        }
+    }
+    // Whether the value `v` is available at instruction `k` of block `b` (k past the end
+    // for the end of the block).
+    auto available = [&](const IRValue& v, uint32_t b, uint32_t k) {
+        if (v.kind != IRValue::Kind::Inst) return true;
+        uint32_t d = blockOf[v.inst];
+        if (d == IRCFG::kNone || !cfg.reachable(d)) return false;
+        if (d == b) return position[v.inst] < k;
+        return enter[d] <= enter[b] && leave[b] <= leave[d];
+    };
+    for (uint32_t b : cfg.rpo) {
+        const std::vector<uint32_t>& insts = fn.blocks[b].insts;
+        for (uint32_t k = 0; k < insts.size(); ++k) {
+            const IRInst& inst = fn.insts[insts[k]];
+            if (inst.dead) continue;
+            bool ok = available(inst.a, b, k) && available(inst.b, b, k);
+            for (const IRArgument& arg : inst.args) ok = ok && available(arg.value, b, k);
+            for (const IRIncoming& in : inst.incoming) {
+                if (in.block < fn.blocks.size() && cfg.reachable(in.block)) {
+                    ok = ok && available(in.value, in.block, static_cast<uint32_t>(fn.blocks[in.block].insts.size()));
+                }
+            }
+            if (!ok) return "a value used where its definition does not reach";
+            if (inst.op != IROp::Phi) continue;
+            for (uint32_t p : cfg.preds[b]) {
+                bool found = false;
+                for (const IRIncoming& in : inst.incoming) found = found || in.block == p;
+                if (!found) return "a phi without a value for one of its predecessors";
+            }
+        }
+    }
+    return nullptr;
+}
+
+// Passes read a block's successors off its last instruction and expect phis at the top.
+// Nothing may branch to the entry block, which has no predecessors, or to a block a pass
+// emptied (those stay in place so block numbers do not change).
+bool checkIRFunction(const IRFunction& fn, std::string& error) {
+    if (fn.blocks.empty()) {
+        error = "no entry block";
+        return false;
+    }
+    auto isScalar = [](IRType type) { return type == IRType::I8 || type == IRType::I32 || type == IRType::Float; };
+    if (fn.params.size() > kMaxParams) {
+        error = "more than " + std::to_string(kMaxParams) + " parameters";
+        return false;
+    }
+    for (const IRParam& param : fn.params) {
+        if (!isScalar(param.type)) {
+            error = "a parameter of type " + std::string(irTypeName(param.type));
+            return false;
+        }
+    }
+    for (size_t b = 0; b < fn.blocks.size(); ++b) {
+        const IRBlock& block = fn.blocks[b];
+        std::string name = block.label.empty() ? "entry block" : "block " + block.label;
+        if (block.insts.empty() && b != 0) continue;
+        if (block.insts.empty() || !isTerminator(fn.insts[block.insts.back()].op)) {
+            error = name + " does not end in a terminator";
+            return false;
+        }
+        for (size_t k = 0; k < block.insts.size(); ++k) {
+            const IRInst& inst = fn.insts[block.insts[k]];
+            if (isTerminator(inst.op) && k + 1 != block.insts.size()) {
+                error = name + " continues after a terminator";
+                return false;
+            }
+            if (inst.op == IROp::Phi && (b == 0 || (k != 0 && fn.insts[block.insts[k - 1]].op != IROp::Phi))) {
+                error = name + " has a misplaced phi";
+                return false;
+            }
+            if (const char* bad = addressError(fn, inst)) {
+                error = name + " has " + bad;
+                return false;
+            }
+            bool badArg = false;
+            forEachOperand(inst, [&](const IRValue& v) { badArg = badArg || (v.kind == IRValue::Kind::Arg && v.inst >= fn.params.size()); });
+            if (badArg) {
+                error = name + " uses a parameter the function does not have";
+                return false;
+            }
+            if (inst.op == IROp::Call) {
+                bool ok = isScalar(inst.type) && inst.args.size() <= kMaxParams;
+                for (const IRArgument& arg : inst.args) ok = ok && isScalar(arg.type);
+                if (!ok) {
+                    error = name + " has an unsupported call to @" + inst.name;
+                    return false;
+                }
+            }
+            for (int t = 0; t < (inst.op == IROp::CondBr ? 2 : inst.op == IROp::Br ? 1 : 0); ++t) {
+                if (inst.target[t] == 0 || fn.blocks[inst.target[t]].insts.empty()) {
+                    error = name + " branches to " + (inst.target[t] == 0 ? "the entry block" : "an empty block");
+                    return false;
+                }
+            }
+        }
+    }
+    if (const char* bad = ssaError(fn)) {
+        error = bad;
+        return false;
+    }
+    return true;
+}
+
+bool checkIRCalls(const IRModule& module, std::string& error) {
+    std::unordered_map<std::string_view, const IRFunction*> byName;
+    for (const IRFunction& fn : module.functions) byName.emplace(fn.name, &fn);
+    for (const IRFunction& fn : module.functions) {
+        for (const IRBlock& block : fn.blocks) {
+            for (uint32_t id : block.insts) {
+                const IRInst& inst = fn.insts[id];
+                if (inst.dead || inst.op != IROp::Call) continue;
+                auto it = byName.find(inst.name);
+                bool ok = it != byName.end() && it->second->returnType == inst.type &&
+                          it->second->params.size() == inst.args.size();
+                for (size_t k = 0; ok && k < inst.args.size(); ++k) ok = inst.args[k].type == it->second->params[k].type;
+                if (!ok) {
+                    error = "function @" + fn.name + ": " +
+                            (it == byName.end() ? "call to undefined function @" : "call does not match the definition of @") +
+                            inst.name;
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+
+struct IRFunctionParser {
+    IRFunction& fn;
+    // %N temporaries are dense, so they are looked up by number; named values (views into
+    // the IR text) go through the map.
+    std::vector<uint32_t> numbered;
+    std::unordered_map<std::string_view, uint32_t> named;
+    std::unordered_map<std::string_view, uint32_t> params;  // name -> index
+    // Branches may name blocks further down and phis may use values defined further down
+    // (around a loop); those references are resolved when the function ends.
+    std::unordered_map<std::string_view, uint32_t> blockIds;
+    struct LabelUse {
+        uint32_t inst;
+        size_t slot;  // 0 and 1 are branch targets, 2 + k the block of phi operand k
+        std::string_view label;
+    };
+    struct ValueUse {
+        uint32_t inst;
+        size_t incoming;
+        std::string_view text;
+    };
+    std::vector<LabelUse> labelUses;
+    std::vector<ValueUse> forwardValues;
+
+    bool label(std::string_view name, std::string& error) {
+        // The unlabeled block every function starts with takes the first label.
+        if (fn.blocks.size() != 1 || !fn.blocks[0].insts.empty() || !fn.blocks[0].label.empty()) {
+            fn.blocks.push_back({});
+        }
+        fn.blocks.back().label = std::string(name);
+        if (!blockIds.emplace(name, static_cast<uint32_t>(fn.blocks.size() - 1)).second) {
+            return fail(error, "duplicate label " + std::string(name));
+        }
+        return true;
+    }
+
+    uint32_t lookupLocal(std::string_view local) const {
+        size_t n;
+        if (number(local, n)) return n < numbered.size() ? numbered[n] : UINT32_MAX;
+        auto it = named.find(local);
+        return it == named.end() ? UINT32_MAX : it->second;
+    }
+
+    bool finish(std::string& error) {
+        for (const LabelUse& use : labelUses) {
+            auto it = blockIds.find(use.label.substr(1));
+            if (use.label.empty() || use.label[0] != '%' || it == blockIds.end()) {
+                return fail(error, "undefined label " + std::string(use.label));
+            }
+            IRInst& inst = fn.insts[use.inst];
+            if (use.slot < 2) inst.target[use.slot] = it->second;
+            else inst.incoming[use.slot - 2].block = it->second;
+        }
+        for (const ValueUse& use : forwardValues) {
+            uint32_t id = lookupLocal(use.text.substr(1));
+            if (id == UINT32_MAX) return fail(error, "use of undefined value " + std::string(use.text));
+            fn.insts[use.inst].incoming[use.incoming].value = IRValue::ofInst(id);
+        }
+        return checkIRFunction(fn, error);
+    }
+
+    static bool number(std::string_view local, size_t& n) {
+        if (local.empty() || local.size() > 9) return false;
+        n = 0;
+        for (char c : local) {
+            if (c < '0' || c > '9') return false;
+            n = n * 10 + static_cast<size_t>(c - '0');
+        }
+        return true;
+    }
+
+    uint32_t add(IRInst inst, std::string_view result) {
+        uint32_t id = static_cast<uint32_t>(fn.insts.size());
+        if (!result.empty()) {
+            std::string_view local = result.substr(1);
+            size_t n;
+            if (number(local, n)) {
+                if (numbered.size() <= n) numbered.resize(n + 1, UINT32_MAX);
+                numbered[n] = id;
+            } else {
+                if (inst.op == IROp::Alloca || inst.op == IROp::Phi) inst.name = std::string(local);
+                named[local] = id;
+            }
+        }
+        fn.insts.push_back(std::move(inst));
+        fn.blocks.back().insts.push_back(id);
+        return id;
+    }
+
+    bool value(std::string_view text, IRType type, IRValue& out, std::string& error) {
+        if (text.empty()) {
+            error = "missing operand";
+            return false;
+        }
+        if (text[0] == '%') {
+            auto param = params.find(text.substr(1));
+            if (param != params.end()) {
+                out = IRValue::ofArg(param->second);
+                return true;
+            }
+            uint32_t id = lookupLocal(text.substr(1));
+            if (id == UINT32_MAX) {
+                error = "use of undefined value " + std::string(text);
+                return false;
+            }
+            out = IRValue::ofInst(id);
+            return true;
+        }
+        if (text == "undef") {
+            out = IRValue::undef();
+            return true;
+        }
+        if (type == IRType::I1 && (text == "true" || text == "false")) {
+            out = IRValue::ofInt(text == "true");
+            return true;
+        }
+        if (isVectorType(type)) return splat(text, type, out, error);
+        std::string literal(text);
+        char* end = nullptr;
+        if (type == IRType::Float) {
+            double d;
+            if (literal.size() > 2 && literal[0] == '0' && (literal[1] == 'x' || literal[1] == 'X')) {
+                uint64_t bits = std::strtoull(literal.c_str() + 2, &end, 16);
+                std::memcpy(&d, &bits, sizeof d);
+            } else {
+                d = std::strtod(literal.c_str(), &end);
+            }
+            if (*end) {
+                error = "bad float constant " + literal;
+                return false;
+            }
+            out = IRValue::ofFloat(static_cast<float>(d));
+            return true;
+        }
+        long long v = std::strtoll(literal.c_str(), &end, 10);
+        if (*end || end == literal.c_str()) {
+            error = "bad " + std::string(irTypeName(type)) + " constant " + literal;
+            return false;
+        }
+        out = IRValue::ofInt(wrapToType(v, type));
+        return true;
+    }
+
+    // A vector constant is zeroinitializer or the same element in every lane, which is
+    // all the vectorizer writes.
+    bool splat(std::string_view text, IRType type, IRValue& out, std::string& error) {
+        IRType element = elementType(type);
+        if (text == "zeroinitializer") {
+            out = element == IRType::Float ? IRValue::ofFloat(0.0f) : IRValue::ofInt(0);
+            return true;
+        }
+        if (text.size() < 2 || text.front() != '<' || text.back() != '>') return fail(error, "bad vector constant " + std::string(text));
+        std::string_view lanes = text.substr(1, text.size() - 2);
+        uint32_t count = 0;
+        while (!lanes.empty()) {
+            size_t comma = std::min(lanes.find(','), lanes.size());
+            std::string_view lane = lanes.substr(0, comma);
+            lanes.remove_prefix(std::min(comma + 1, lanes.size()));
+            while (!lane.empty() && lane.front() == ' ') lane.remove_prefix(1);
+            while (!lane.empty() && lane.back() == ' ') lane.remove_suffix(1);
+            size_t space = lane.find(' ');
+            IRType laneType;
+            IRValue v;
+            if (space == std::string_view::npos || !parseIRType(lane.substr(0, space), laneType) || laneType != element ||
+                !value(lane.substr(space + 1), element, v, error) || !v.isConstant()) {
+                return fail(error, "bad vector constant " + std::string(text));
+            }
+            if (count++ && !sameValue(v, out)) return fail(error, "only splat vector constants are supported");
+            out = v;
+        }
+        if (count != laneCount(type)) return fail(error, "bad vector constant " + std::string(text));
+        return true;
+    }
+
+    // Accepts `<type>*` naming a pointer to `type`.
+    static bool pointerTo(std::string_view text, IRType type) {
+        IRType pointee;
+        return !text.empty() && text.back() == '*' && parseIRType(text.substr(0, text.size() - 1), pointee) && pointee == type;
+    }
+
+    bool instruction(const std::vector<std::string_view>& w, std::string& error) {
+        std::string_view result;
+        size_t i = 0;
+        if (w.size() >= 2 && w[0][0] == '%' && w[1] == "=") {
+            result = w[0];
+            i = 2;
+        }
+        auto at = [&](size_t k) { return k < w.size() ? w[k] : std::string_view(); };
+        std::string_view opcode = at(i);
+        IRInst inst{};
+
+        if (opcode == "alloca" && !result.empty()) {
+            inst.op = IROp::Alloca;
+            if (!parseIRType(at(i + 1), inst.type) || inst.type == IRType::Void || isVectorType(inst.type)) {
+                return fail(error, "bad alloca type");
+            }
+            // An array: `alloca T, i32 N`
+            if (at(i + 2) == "i32" && (!value(at(i + 3), IRType::I32, inst.b, error) || inst.b.kind != IRValue::Kind::Int ||
+                                       inst.b.i < 1 || static_cast<uint32_t>(inst.b.i) > kMaxArrayLength)) {
+                return fail(error, "bad array length");
+            }
+            add(inst, result);
+            return true;
+        }
+        if (opcode == "getelementptr" && !result.empty()) {
+            inst.op = IROp::GEP;
+            size_t k = at(i + 1) == "inbounds" ? i + 2 : i + 1;
+            if (!parseIRType(at(k), inst.type) || !pointerTo(at(k + 1), inst.type) || at(k + 3) != "i32" || w.size() != k + 5) {
+                return fail(error, "bad getelementptr");
+            }
+            if (!value(at(k + 2), inst.type, inst.a, error) || !value(at(k + 4), IRType::I32, inst.b, error)) return false;
+            add(inst, result);
+            return true;
+        }
+        if (opcode == "bitcast" && !result.empty()) {
+            inst.op = IROp::Bitcast;
+            std::string_view to = at(i + 4);
+            if (to.empty() || to.back() != '*' || !parseIRType(to.substr(0, to.size() - 1), inst.type) || !isVectorType(inst.type) ||
+                !pointerTo(at(i + 1), elementType(inst.type)) || at(i + 3) != "to" || w.size() != i + 5) {
+                return fail(error, "bad bitcast");
+            }
+            if (!value(at(i + 2), inst.type, inst.a, error)) return false;
+            add(inst, result);
+            return true;
+        }
+        if (opcode == "insertelement" && !result.empty()) {
+            // Only into lane 0 of undef, the first half of a splat.
+            inst.op = IROp::InsertElement;
+            if (!parseIRType(at(i + 1), inst.type) || !isVectorType(inst.type) || at(i + 2) != "undef" ||
+                at(i + 3) != irTypeName(elementType(inst.type)) || at(i + 5) != "i32" || at(i + 6) != "0" || w.size() != i + 7) {
+                return fail(error, "unsupported insertelement");
+            }
+            inst.a = IRValue::undef();
+            if (!value(at(i + 4), elementType(inst.type), inst.b, error)) return false;
+            add(inst, result);
+            return true;
+        }
+        if (opcode == "shufflevector" && !result.empty()) {
+            // Only the zero mask, which copies lane 0 everywhere.
+            inst.op = IROp::ShuffleVector;
+            if (!parseIRType(at(i + 1), inst.type) || !isVectorType(inst.type) || at(i + 3) != at(i + 1) || at(i + 4) != "undef" ||
+                at(i + 5) != "<" + std::to_string(laneCount(inst.type)) + " x i32>" || at(i + 6) != "zeroinitializer" ||
+                w.size() != i + 7) {
+                return fail(error, "unsupported shufflevector");
+            }
+            if (!value(at(i + 2), inst.type, inst.a, error)) return false;
+            add(inst, result);
+            return true;
+        }
+        if (opcode == "call" && !result.empty() && at(i + 2) == kReduceAddV4I32) {
+            inst.op = IROp::ReduceAdd;
+            inst.type = IRType::I32;
+            if (at(i + 1) != "i32" || at(i + 3) != "<4 x i32>" || w.size() != i + 5) return fail(error, "unsupported call");
+            if (!value(at(i + 4), IRType::V4I32, inst.a, error)) return false;
+            add(inst, result);
+            return true;
+        }
+        if (opcode == "call" && !result.empty()) {
+            // `call T @f(T a, ...)`; which functions exist is checked once the module is read.
+            inst.op = IROp::Call;
+            if (!parseIRType(at(i + 1), inst.type) || at(i + 2).size() < 2 || at(i + 2)[0] != '@' || (w.size() - i) % 2 != 1) {
+                return fail(error, "unsupported call");
+            }
+            inst.name = std::string(at(i + 2).substr(1));
+            for (size_t k = i + 3; k < w.size(); k += 2) {
+                IRArgument arg{IRType::Void, IRValue()};
+                if (!parseIRType(w[k], arg.type) || !value(w[k + 1], arg.type, arg.value, error)) {
+                    return fail(error, "bad argument in call to @" + inst.name);
+                }
+                inst.args.push_back(arg);
+            }
+            add(inst, result);
+            return true;
+        }
+        if (opcode == "load" && !result.empty()) {
+            inst.op = IROp::Load;
+            if (!parseIRType(at(i + 1), inst.type) || !pointerTo(at(i + 2), inst.type)) return fail(error, "bad load type");
+            if (!value(at(i + 3), inst.type, inst.a, error)) return false;
+            add(inst, result);
+            return true;
+        }
+        if (opcode == "store" && result.empty()) {
+            inst.op = IROp::Store;
+            if (!parseIRType(at(i + 1), inst.type) || !pointerTo(at(i + 3), inst.type)) return fail(error, "bad store type");
+            if (!value(at(i + 2), inst.type, inst.a, error) || !value(at(i + 4), inst.type, inst.b, error)) return false;
+            add(inst, result);
+            return true;
+        }
+        if (opcode == "ret" && result.empty()) {
+            inst.op = IROp::Ret;
+            if (!parseIRType(at(i + 1), inst.type) || isVectorType(inst.type)) return fail(error, "bad return type");
+            if (inst.type != IRType::Void && !value(at(i + 2), inst.type, inst.a, error)) return false;
+            add(inst, result);
+            return true;
+        }
+        if (opcode == "br" && result.empty()) {
+            inst.type = IRType::Void;
+            uint32_t id = static_cast<uint32_t>(fn.insts.size());
+            if (at(i + 1) == "label" && w.size() == i + 3) {
+                inst.op = IROp::Br;
+                labelUses.push_back({id, 0, at(i + 2)});
+            } else if (at(i + 1) == "i1" && at(i + 3) == "label" && at(i + 5) == "label" && w.size() == i + 7) {
+                inst.op = IROp::CondBr;
+                if (!value(at(i + 2), IRType::I1, inst.a, error)) return false;
+                labelUses.push_back({id, 0, at(i + 4)});
+                labelUses.push_back({id, 1, at(i + 6)});
+            } else {
+                return fail(error, "bad branch");
+            }
+            add(inst, result);
+            return true;
+        }
+        if ((opcode == "icmp" || opcode == "fcmp") && !result.empty()) {
+            inst.op = opcode == "icmp" ? IROp::ICmp : IROp::FCmp;
+            bool found = false;
+            for (uint8_t p = 0; p <= static_cast<uint8_t>(IRPred::OGE) && !found; ++p) {
+                found = at(i + 1) == irPredName(static_cast<IRPred>(p));
+                if (found) inst.pred = static_cast<IRPred>(p);
+            }
+            bool floatPred = inst.pred >= IRPred::OEQ;
+            if (!found || floatPred != (inst.op == IROp::FCmp)) return fail(error, "bad " + std::string(opcode) + " predicate");
+            if (!parseIRType(at(i + 2), inst.type) || inst.type == IRType::Void || isVectorType(inst.type) ||
+                (inst.type == IRType::Float) != floatPred) {
+                return fail(error, "bad operand type");
+            }
+            if (!value(at(i + 3), inst.type, inst.a, error) || !value(at(i + 4), inst.type, inst.b, error)) return false;
+            add(inst, result);
+            return true;
+        }
+        if (opcode == "zext" && !result.empty()) {
+            inst.op = IROp::ZExt;
+            if (at(i + 1) != "i1" || at(i + 3) != "to" || !parseIRType(at(i + 4), inst.type) ||
+                (inst.type != IRType::I8 && inst.type != IRType::I32)) {
+                return fail(error, "bad zext");
+            }
+            if (!value(at(i + 2), IRType::I1, inst.a, error)) return false;
+            add(inst, result);
+            return true;
+        }
+        if (opcode == "phi" && !result.empty()) {
+            inst.op = IROp::Phi;
+            if (!parseIRType(at(i + 1), inst.type) || inst.type == IRType::Void) return fail(error, "bad phi type");
+            uint32_t id = static_cast<uint32_t>(fn.insts.size());
+            for (size_t k = i + 2; k < w.size(); k += 2) {
+                if (k + 1 >= w.size()) return fail(error, "phi operand without a block");
+                IRIncoming in{0, IRValue()};
+                if (!value(w[k], inst.type, in.value, error)) {
+                    if (w[k][0] != '%') return false;
+                    forwardValues.push_back({id, inst.incoming.size(), w[k]});
+                }
+                labelUses.push_back({id, 2 + inst.incoming.size(), w[k + 1]});
+                inst.incoming.push_back(in);
+            }
+            add(inst, result);
+            return true;
+        }
+        if (parseBinaryOp(opcode, inst.op) && !result.empty()) {
+            ++i;
+            while (at(i) == "nsw" || at(i) == "nuw" || at(i) == "exact") ++i;
+            if (!parseIRType(at(i), inst.type) || inst.type == IRType::Void) return fail(error, "bad operand type");
+            bool floatOp = inst.op >= IROp::FAdd;
+            if (floatOp != (elementType(inst.type) == IRType::Float) || (inst.op == IROp::SDiv && isVectorType(inst.type))) {
+                return fail(error, std::string(opcode) + " on " + irTypeName(inst.type));
+            }
+            if (!value(at(i + 1), inst.type, inst.a, error) || !value(at(i + 2), inst.type, inst.b, error)) return false;
+            add(inst, result);
+            return true;
+        }
+        return fail(error, "unsupported instruction '" + std::string(opcode) + "'");
+    }
+
+    static bool fail(std::string& error, std::string message) {
+        error = std::move(message);
+        return false;
+    }
+};
+
+bool parseIR(std::string_view text, IRModule& module, std::string& error) {
+    module.functions.clear();
+    std::optional<IRFunctionParser> fn;
+    size_t lineNo = 0;
+    size_t pos = 0;
+    std::vector<std::string_view> w;
+    while (pos < text.size()) {
+        size_t eol = text.find('\n', pos);
+        if (eol == std::string_view::npos) eol = text.size();
+        std::string_view line = text.substr(pos, eol - pos);
+        pos = eol + 1;
+        ++lineNo;
+
+        splitIRLine(line, w);
+        if (w.empty()) continue;
+        std::string lineError;
+        if (!fn) {
+            // define T @f(T %a, ...) {
+            IRType returnType;
+            if (w.size() >= 4 && w.size() % 2 == 0 && w[0] == "define" && parseIRType(w[1], returnType) &&
+                !isVectorType(returnType) && w[2][0] == '@' && w.back() == "{") {
+                module.functions.push_back({std::string(w[2].substr(1)), returnType, {}, {}, {{}}});
+                fn.emplace(IRFunctionParser{module.functions.back(), {}, {}});
+                IRFunction& defined = module.functions.back();
+                for (size_t k = 3; k + 1 < w.size(); k += 2) {
+                    IRParam param{IRType::Void, std::string(w[k + 1].substr(1))};
+                    if (!parseIRType(w[k], param.type) || w[k + 1].size() < 2 || w[k + 1][0] != '%' ||
+                        !fn->params.emplace(w[k + 1].substr(1), static_cast<uint32_t>(defined.params.size())).second) {
+                        lineError = "bad parameter " + std::string(w[k + 1]);
+                        break;
+                    }
+                    defined.params.push_back(std::move(param));
+                }
+                if (lineError.empty()) continue;
+            } else if (w.size() == 4 && w[0] == "declare" && w[1] == "i32" && w[2] == kReduceAddV4I32 && w[3] == "<4 x i32>") {
+                // printIR declares the intrinsics it calls.
+                continue;
+            } else {
+                lineError = "expected a function definition";
+            }
+        } else if (w.size() == 1 && w[0] == "}") {
+            if (fn->finish(lineError)) {
+                fn.reset();
+                continue;
+            }
+        } else if (w.size() == 1 && w[0].back() == ':') {
+            if (fn->label(w[0].substr(0, w[0].size() - 1), lineError)) continue;
+        } else if (fn->instruction(w, lineError)) {
+            continue;
+        }
+        error = "line " + std::to_string(lineNo) + ": " + lineError;
+        return false;
+    }
+    if (fn) {
+        error = "unterminated function @" + fn->fn.name;
+        return false;
+    }
+    return checkIRCalls(module, error);
+}
+
+// Prints a float constant so that llc accepts it: LLVM only takes a decimal constant for
+// `float` if it is exactly representable, so anything else is written as hex.
+std::string formatIRFloat(float f) {
+    char buf[32];
+    std::snprintf(buf, sizeof buf, "%.6e", static_cast<double>(f));
+    if (std::strtod(buf, nullptr) == static_cast<double>(f)) return buf;
+    double d = f;
+    uint64_t bits;
+    std::memcpy(&bits, &d, sizeof bits);
+    std::snprintf(buf, sizeof buf, "0x%016llX", static_cast<unsigned long long>(bits));
+    return buf;
+}
+
+std::string printIR(const IRModule& module) {
+    std::string out;
+    bool callsReduceAdd = false;
+    for (const IRFunction& fn : module.functions) {
+        // Temporaries are renumbered densely in order of appearance, as LLVM requires;
+        // the unlabeled entry block takes %0. Duplicate names, and names a parameter has
+        // already, get a numeric suffix.
+        std::vector<std::string> names(fn.insts.size());
+        std::unordered_map<std::string, int> taken;
+        for (const IRParam& param : fn.params) ++taken[param.name];
+        uint32_t next = fn.blocks.empty() || !fn.blocks[0].label.empty() ? 0 : 1;
+        for (const IRBlock& block : fn.blocks) {
+            for (uint32_t id : block.insts) {
+                const IRInst& inst = fn.insts[id];
+                if (inst.dead || inst.op == IROp::Store || isTerminator(inst.op)) continue;
+                if (inst.name.empty() || inst.op == IROp::Call) {
+                    names[id] = "%" + std::to_string(next++);
+                } else {
+                    int& uses = taken[inst.name];
+                    names[id] = "%" + inst.name + (uses ? "." + std::to_string(uses) : "");
+                    ++uses;
+                }
+            }
+        }
+        auto operand = [&](const IRValue& v) -> std::string {
+            switch (v.kind) {
+                case IRValue::Kind::Inst:  return names[v.inst];
+                case IRValue::Kind::Int:   return std::to_string(v.i);
+                case IRValue::Kind::Float: return formatIRFloat(v.f);
+                case IRValue::Kind::Undef: return "undef";
+                case IRValue::Kind::Arg:   return "%" + fn.params[v.inst].name;
+                case IRValue::Kind::None:  break;
+            }
+            return "undef";
+        };
+        // A constant operand of vector type stands for the same value in every lane.
+        auto typed = [&](const IRValue& v, IRType type) -> std::string {
+            if (!isVectorType(type) || !v.isConstant()) return operand(v);
+            if (v.kind == IRValue::Kind::Int ? v.i == 0 : sameValue(v, IRValue::ofFloat(0.0f))) return "zeroinitializer";
+            std::string lane = std::string(irTypeName(elementType(type))) + " " + operand(v);
+            std::string out = "<" + lane;
+            for (uint32_t k = 1; k < laneCount(type); ++k) out += ", " + lane;
+            return out + ">";
+        };
+
+        auto label = [&](uint32_t block) { return "%" + fn.blocks[block].label; };
+        auto flag = [&](const IRValue& v) -> std::string {
+            if (v.kind == IRValue::Kind::Int) return v.i ? "true" : "false";
+            return operand(v);
+        };
+
+        out += "define " + std::string(irTypeName(fn.returnType)) + " @" + fn.name + "(";
+        for (size_t k = 0; k < fn.params.size(); ++k) {
+            out += std::string(k ? ", " : "") + irTypeName(fn.params[k].type) + " %" + fn.params[k].name;
+        }
+        out += ") {\n";
+        for (const IRBlock& block : fn.blocks) {
+            if (block.insts.empty()) continue;  // removed by a pass
+            if (!block.label.empty()) out += block.label + ":\n";
+            for (uint32_t id : block.insts) {
+                const IRInst& inst = fn.insts[id];
+                if (inst.dead) continue;
+                std::string type = irTypeName(inst.type);
+                std::string element = irTypeName(elementType(inst.type));
+                out += "  ";
+                switch (inst.op) {
+                    case IROp::Alloca:
+                        out += names[id] + " = alloca " + type;
+                        if (inst.b.kind == IRValue::Kind::Int) out += ", i32 " + operand(inst.b);
+                        break;
+                    // A vector is only as aligned as the array element it starts at.
+                    case IROp::Load:
+                        out += names[id] + " = load " + type + ", " + type + "* " + operand(inst.a);
+                        if (isVectorType(inst.type)) out += ", align 4";
+                        break;
+                    case IROp::Store:
+                        out += "store " + type + " " + typed(inst.a, inst.type) + ", " + type + "* " + operand(inst.b);
+                        if (isVectorType(inst.type)) out += ", align 4";
+                        break;
+                    case IROp::GEP:
+                        out += names[id] + " = getelementptr inbounds " + type + ", " + type + "* " + operand(inst.a) + ", i32 " +
+                               operand(inst.b);
+                        break;
+                    case IROp::Bitcast:
+                        out += names[id] + " = bitcast " + element + "* " + operand(inst.a) + " to " + type + "*";
+                        break;
+                    case IROp::InsertElement:
+                        out += names[id] + " = insertelement " + type + " undef, " + element + " " + operand(inst.b) + ", i32 0";
+                        break;
+                    case IROp::ShuffleVector:
+                        out += names[id] + " = shufflevector " + type + " " + typed(inst.a, inst.type) + ", " + type + " undef, <" +
+                               std::to_string(laneCount(inst.type)) + " x i32> zeroinitializer";
+                        break;
+                    case IROp::ReduceAdd:
+                        out += names[id] + " = call i32 " + kReduceAddV4I32 + "(<4 x i32> " + typed(inst.a, IRType::V4I32) + ")";
+                        callsReduceAdd = true;
+                        break;
+                    case IROp::Call:
+                        out += names[id] + " = call " + type + " @" + inst.name + "(";
+                        for (size_t k = 0; k < inst.args.size(); ++k) {
+                            out += std::string(k ? ", " : "") + irTypeName(inst.args[k].type) + " " + operand(inst.args[k].value);
+                        }
+                        out += ")";
+                        break;
+                    case IROp::Ret:
+                        out += inst.type == IRType::Void ? "ret void" : "ret " + type + " " + operand(inst.a);
+                        break;
+                    case IROp::ICmp:
+                    case IROp::FCmp:
+                        out += names[id] + " = " + irOpName(inst.op) + " " + irPredName(inst.pred) + " " + type + " " +
+                               operand(inst.a) + ", " + operand(inst.b);
+                        break;
+                    case IROp::ZExt:
+                        out += names[id] + " = zext i1 " + flag(inst.a) + " to " + type;
+                        break;
+                    case IROp::Phi:
+                        out += names[id] + " = phi " + type;
+                        for (size_t k = 0; k < inst.incoming.size(); ++k) {
+                            out += std::string(k ? ", [ " : " [ ") + typed(inst.incoming[k].value, inst.type) + ", " +
+                                   label(inst.incoming[k].block) + " ]";
+                        }
+                        break;
+                    case IROp::Br:
+                        out += "br label " + label(inst.target[0]);
+                        break;
+                    case IROp::CondBr:
+                        out += "br i1 " + flag(inst.a) + ", label " + label(inst.target[0]) + ", label " + label(inst.target[1]);
+                        break;
+                    default:
+                        out += names[id] + " = " + irOpName(inst.op) + " " + type + " " + typed(inst.a, inst.type) + ", " +
+                               typed(inst.b, inst.type);
+                        break;
+                }
+                out += "\n";
+            }
+        }
+        out += "}\n";
+    }
+    if (callsReduceAdd) out += "\ndeclare i32 " + std::string(kReduceAddV4I32) + "(<4 x i32>)\n";
+    return out;
+}
+
+namespace {
+constexpr char kIRMagic[4] = {'M', 'C', 'I', 'R'};
+constexpr uint8_t kIRVersion = 4;
+
+void putVarint(std::string& out, uint64_t v) {
+    while (v >= 0x80) {
+        out += static_cast<char>((v & 0x7f) | 0x80);
+        v >>= 7;
+    }
+    out += static_cast<char>(v);
+}
+
+void putText(std::string& out, const std::string& text) {
+    putVarint(out, text.size());
+    out += text;
+}
+
+// Reads what putVarint/putText wrote; every accessor fails instead of reading past the end.
+struct IRReader {
+    std::string_view data;
+    size_t pos = 0;
+
+    bool byte(uint8_t& v) {
+        if (pos >= data.size()) return false;
+        v = static_cast<uint8_t>(data[pos++]);
+        return true;
+    }
+
+    bool varint(uint64_t& v) {
+        v = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7) {
+            uint8_t b;
+            if (!byte(b)) return false;
+            v |= static_cast<uint64_t>(b & 0x7f) << shift;
+            if (!(b & 0x80)) return true;
+        }
+        return false;
+    }
+
+    // Counts are checked against the bytes left, so a corrupt count cannot make us reserve
+    // gigabytes.
+    bool count(uint64_t& v) { return varint(v) && v <= data.size() - pos; }
+
+    bool text(std::string& out) {
+        uint64_t n;
+        if (!count(n)) return false;
+        out.assign(data.substr(pos, n));
+        pos += n;
+        return true;
+    }
+};
+
+// What parseIR accepts for each opcode, for an instruction read from binary IR: the
+// operands the opcode has are present and the others None, constants have the kind of the
+// type they are read as, and the type is one the text form can spell for that opcode.
+bool decodedInstOK(const IRInst& inst) {
+    auto none = [](const IRValue& v) { return v.kind == IRValue::Kind::None; };
+    auto fits = [](const IRValue& v, IRType type) {
+        switch (v.kind) {
+            case IRValue::Kind::None:  return false;
+            case IRValue::Kind::Int:   return type != IRType::Void && elementType(type) != IRType::Float;
+            case IRValue::Kind::Float: return elementType(type) == IRType::Float;
+            default:                   return true;
+        }
+    };
+    // Addresses are always named values; parseIR reads a constant there as a number.
+    auto address = [](const IRValue& v) { return v.kind == IRValue::Kind::Inst; };
+    bool vector = isVectorType(inst.type);
+    bool scalar = inst.type != IRType::Void && !vector;
+    bool ok = false;
+    switch (inst.op) {
+        case IROp::Alloca:
+            ok = scalar && none(inst.a) &&
+                 (none(inst.b) || (inst.b.kind == IRValue::Kind::Int && inst.b.i >= 1 &&
+                                   static_cast<uint32_t>(inst.b.i) <= kMaxArrayLength));
+            break;
+        case IROp::Load:
+        case IROp::Bitcast:
+            ok = inst.type != IRType::Void && (inst.op == IROp::Load || vector) && address(inst.a) && none(inst.b);
+            break;
+        case IROp::Store:
+            ok = inst.type != IRType::Void && fits(inst.a, inst.type) && address(inst.b);
+            break;
+        case IROp::Ret:
+            ok = !vector && none(inst.b) && (inst.type == IRType::Void ? none(inst.a) : fits(inst.a, inst.type));
+            break;
+        case IROp::ICmp:
+        case IROp::FCmp: {
+            bool floatPred = inst.pred >= IRPred::OEQ;
+            ok = scalar && floatPred == (inst.op == IROp::FCmp) && floatPred == (inst.type == IRType::Float) &&
+                 fits(inst.a, inst.type) && fits(inst.b, inst.type);
+            break;
+        }
+        case IROp::ZExt:
+            ok = (inst.type == IRType::I8 || inst.type == IRType::I32) && fits(inst.a, IRType::I1) && none(inst.b);
+            break;
+        case IROp::Phi:
+            ok = inst.type != IRType::Void && none(inst.a) && none(inst.b);
+            for (const IRIncoming& in : inst.incoming) ok = ok && fits(in.value, inst.type);
+            break;
+        case IROp::Br:
+            ok = inst.type == IRType::Void && none(inst.a) && none(inst.b);
+            break;
+        case IROp::CondBr:
+            ok = inst.type == IRType::Void && fits(inst.a, IRType::I1) && none(inst.b);
+            break;
+        case IROp::GEP:
+            ok = scalar && address(inst.a) && fits(inst.b, IRType::I32);
+            break;
+        case IROp::InsertElement:
+            ok = vector && inst.a.kind == IRValue::Kind::Undef && fits(inst.b, elementType(inst.type));
+            break;
+        case IROp::ShuffleVector:
+            ok = vector && fits(inst.a, inst.type) && none(inst.b);
+            break;
+        case IROp::ReduceAdd:
+            ok = inst.type == IRType::I32 && fits(inst.a, IRType::V4I32) && none(inst.b);
+            break;
+        case IROp::Call:
+            ok = !inst.name.empty() && none(inst.a) && none(inst.b);
+            for (const IRArgument& arg : inst.args) ok = ok && fits(arg.value, arg.type);
+            break;
+        default:  // binary ops
+            ok = inst.type != IRType::Void && (inst.op >= IROp::FAdd) == (elementType(inst.type) == IRType::Float) &&
+                 !(inst.op == IROp::SDiv && vector) && fits(inst.a, inst.type) && fits(inst.b, inst.type);
+            break;
+    }
+    return ok;
+}
+
+bool hasValue(const IRInst& inst) {
+    return inst.op != IROp::Store && inst.op != IROp::Br && inst.op != IROp::CondBr && inst.op != IROp::Ret;
+}
+}
+
+std::string serializeIR(const IRModule& module) {
+    std::string out(kIRMagic, sizeof kIRMagic);
+    out += static_cast<char>(kIRVersion);
+    putVarint(out, module.functions.size());
+    for (const IRFunction& fn : module.functions) {
+        std::vector<uint32_t> renumbered(fn.insts.size(), UINT32_MAX);
+        uint32_t live = 0;
+        for (const IRBlock& block : fn.blocks) {
+            for (uint32_t id : block.insts) {
+                if (!fn.insts[id].dead) renumbered[id] = live++;
+            }
+        }
+        auto operand = [&](const IRValue& v) {
+            IRValue::Kind kind = v.kind;
+            if (kind == IRValue::Kind::Inst && renumbered[v.inst] == UINT32_MAX) kind = IRValue::Kind::Undef;
+            out += static_cast<char>(kind);
+            switch (kind) {
+                case IRValue::Kind::Inst:
+                    putVarint(out, renumbered[v.inst]);
+                    break;
+                case IRValue::Kind::Arg:
+                    putVarint(out, v.inst);
+                    break;
+                case IRValue::Kind::Int:  // zigzag, so small negative constants stay short
+                    putVarint(out, (static_cast<uint32_t>(v.i) << 1) ^ static_cast<uint32_t>(v.i >> 31));
+                    break;
+                case IRValue::Kind::Float: {
+                    uint32_t bits;
+                    std::memcpy(&bits, &v.f, sizeof bits);
+                    for (int i = 0; i < 4; ++i) out += static_cast<char>(bits >> (8 * i));
+                    break;
+                }
+                default:
+                    break;
+            }
+        };
+
+        putText(out, fn.name);
+        out += static_cast<char>(fn.returnType);
+        putVarint(out, fn.params.size());
+        for (const IRParam& param : fn.params) {
+            out += static_cast<char>(param.type);
+            putText(out, param.name);
+        }
+        putVarint(out, live);
+        putVarint(out, fn.blocks.size());
+        for (const IRBlock& block : fn.blocks) {
+            putText(out, block.label);
+            uint32_t count = 0;
+            for (uint32_t id : block.insts) count += fn.insts[id].dead ? 0 : 1;
+            putVarint(out, count);
+            for (uint32_t id : block.insts) {
+                const IRInst& inst = fn.insts[id];
+                if (inst.dead) continue;
+                out += static_cast<char>(inst.op);
+                out += static_cast<char>(inst.type);
+                operand(inst.a);
+                operand(inst.b);
+                putText(out, inst.name);
+                switch (inst.op) {
+                    case IROp::ICmp:
+                    case IROp::FCmp:
+                        out += static_cast<char>(inst.pred);
+                        break;
+                    case IROp::CondBr:
+                        putVarint(out, inst.target[1]);
+                        [[fallthrough]];
+                    case IROp::Br:
+                        putVarint(out, inst.target[0]);
+                        break;
+                    case IROp::Phi:
+                        putVarint(out, inst.incoming.size());
+                        for (const IRIncoming& in : inst.incoming) {
+                            putVarint(out, in.block);
+                            operand(in.value);
+                        }
+                        break;
+                    case IROp::Call:
+                        putVarint(out, inst.args.size());
+                        for (const IRArgument& arg : inst.args) {
+                            out += static_cast<char>(arg.type);
+                            operand(arg.value);
+                        }
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+    }
+    return out;
+}
+
+bool deserializeIR(std::string_view data, IRModule& module, std::string& error) {
+    module.functions.clear();
+    if (data.size() < sizeof kIRMagic + 1 || data.compare(0, sizeof kIRMagic, std::string_view(kIRMagic, sizeof kIRMagic)) != 0) {
+        error = "not a binary IR module";
+        return false;
+    }
+    if (static_cast<uint8_t>(data[sizeof kIRMagic]) != kIRVersion) {
+        error = "unsupported binary IR version " + std::to_string(static_cast<uint8_t>(data[sizeof kIRMagic]));
+        return false;
+    }
+    IRReader in{data, sizeof kIRMagic + 1};
+    auto truncated = [&] {
+        error = "truncated or corrupt binary IR at byte " + std::to_string(in.pos);
+        return false;
+    };
+
+    uint64_t functionCount;
+    if (!in.count(functionCount)) return truncated();
+    module.functions.resize(functionCount);
+    for (IRFunction& fn : module.functions) {
+        uint8_t returnType;
+        uint64_t paramCount, instCount, blockCount;
+        if (!in.text(fn.name) || !in.byte(returnType) || returnType > static_cast<uint8_t>(IRType::Float) ||
+            !in.count(paramCount)) {
+            return truncated();
+        }
+        fn.returnType = static_cast<IRType>(returnType);
+        fn.params.resize(paramCount);
+        for (IRParam& param : fn.params) {
+            uint8_t type;
+            if (!in.byte(type) || type > static_cast<uint8_t>(IRType::Float) || !in.text(param.name)) return truncated();
+            param.type = static_cast<IRType>(type);
+        }
+        if (!in.count(instCount) || !in.count(blockCount)) return truncated();
+        fn.insts.reserve(instCount);
+        fn.blocks.resize(blockCount);
+
+        auto operand = [&](IRValue& v) {
+            uint8_t kind;
+            if (!in.byte(kind) || kind > static_cast<uint8_t>(IRValue::Kind::Arg)) return false;
+            v.kind = static_cast<IRValue::Kind>(kind);
+            uint64_t n;
+            switch (v.kind) {
+                case IRValue::Kind::Inst:
+                    if (!in.varint(n) || n >= instCount) return false;
+                    v.inst = static_cast<uint32_t>(n);
+                    return true;
+                case IRValue::Kind::Arg:
+                    if (!in.varint(n) || n >= paramCount) return false;
+                    v.inst = static_cast<uint32_t>(n);
+                    return true;
+                case IRValue::Kind::Int:
+                    if (!in.varint(n) || n > UINT32_MAX) return false;
+                    v.i = static_cast<int32_t>(static_cast<uint32_t>(n >> 1) ^ (0u - static_cast<uint32_t>(n & 1)));
+                    return true;
+                case IRValue::Kind::Float: {
+                    uint32_t bits = 0;
+                    for (int i = 0; i < 4; ++i) {
+                        uint8_t b;
+                        if (!in.byte(b)) return false;
+                        bits |= static_cast<uint32_t>(b) << (8 * i);
+                    }
+                    std::memcpy(&v.f, &bits, sizeof bits);
+                    return true;
+                }
+                default:
+                    return true;
+            }
+        };
+
+        for (IRBlock& block : fn.blocks) {
+            uint64_t count;
+            if (!in.text(block.label) || !in.count(count) || fn.insts.size() + count > instCount) return truncated();
+            for (uint64_t k = 0; k < count; ++k) {
+                IRInst inst{};
+                uint8_t op, type;
+                if (!in.byte(op) || op > static_cast<uint8_t>(IROp::Call) || !in.byte(type) ||
+                    type > static_cast<uint8_t>(IRType::V8Float) || !operand(inst.a) || !operand(inst.b) || !in.text(inst.name)) {
+                    return truncated();
+                }
+                inst.op = static_cast<IROp>(op);
+                inst.type = static_cast<IRType>(type);
+                auto blockIndex = [&](uint32_t& out) {
+                    uint64_t b;
+                    if (!in.varint(b) || b >= blockCount) return false;
+                    out = static_cast<uint32_t>(b);
+                    return true;
+                };
+                bool ok = true;
+                switch (inst.op) {
+                    case IROp::ICmp:
+                    case IROp::FCmp: {
+                        uint8_t pred = 0;
+                        ok = in.byte(pred) && pred <= static_cast<uint8_t>(IRPred::OGE);
+                        inst.pred = static_cast<IRPred>(pred);
+                        break;
+                    }
+                    case IROp::CondBr:
+                        ok = blockIndex(inst.target[1]) && blockIndex(inst.target[0]);
+                        break;
+                    case IROp::Br:
+                        ok = blockIndex(inst.target[0]);
+                        break;
+                    case IROp::Phi: {
+                        uint64_t n;
+                        ok = in.count(n);
+                        for (uint64_t k = 0; ok && k < n; ++k) {
+                            IRIncoming incoming{0, IRValue()};
+                            ok = blockIndex(incoming.block) && operand(incoming.value);
+                            inst.incoming.push_back(incoming);
+                        }
+                        break;
+                    }
+                    case IROp::Call: {
+                        uint64_t n;
+                        ok = in.count(n);
+                        for (uint64_t k = 0; ok && k < n; ++k) {
+                            IRArgument arg{IRType::Void, IRValue()};
+                            uint8_t argType = 0;
+                            ok = in.byte(argType) && argType <= static_cast<uint8_t>(IRType::V8Float) && operand(arg.value);
+                            arg.type = static_cast<IRType>(argType);
+                            inst.args.push_back(arg);
+                        }
+                        break;
+                    }
+                    default:
+                        break;
+                }
+                if (!ok) return truncated();
+                // As in the text form, only a phi may name a value defined after it.
+                bool earlier = true;
+                if (inst.op != IROp::Phi) {
+                    forEachOperand(inst, [&](const IRValue& v) {
+                        earlier = earlier && (v.kind != IRValue::Kind::Inst || (v.inst < fn.insts.size() && hasValue(fn.insts[v.inst])));
+                    });
+                }
+                if (!decodedInstOK(inst) || !earlier) {
+                    error = "malformed " + std::string(irOpName(inst.op)) + " instruction before byte " + std::to_string(in.pos);
+                    return false;
+                }
+                block.insts.push_back(static_cast<uint32_t>(fn.insts.size()));
+                fn.insts.push_back(std::move(inst));
+            }
+        }
+        if (fn.insts.size() != instCount) return truncated();
+        for (const IRInst& inst : fn.insts) {
+            for (const IRIncoming& incoming : inst.incoming) {
+                if (incoming.value.kind == IRValue::Kind::Inst && !hasValue(fn.insts[incoming.value.inst])) {
+                    error = "function @" + fn.name + ": a phi names an instruction without a value";
+                    return false;
+                }
+            }
+        }
+        if (!checkIRFunction(fn, error)) {
+            error = "function @" + fn.name + ": " + error;
+            return false;
+        }
+    }
+    if (in.pos != data.size()) {
+        error = "trailing bytes after binary IR module";
+        return false;
+    }
+    return checkIRCalls(module, error);
+}
+
+bool sameValue(const IRValue& a, const IRValue& b) {
+    if (a.kind != b.kind) return false;
+    switch (a.kind) {
+        case IRValue::Kind::Inst:
+        case IRValue::Kind::Arg:   return a.inst == b.inst;
+        case IRValue::Kind::Int:   return a.i == b.i;
+        case IRValue::Kind::Float: return std::memcmp(&a.f, &b.f, sizeof a.f) == 0;
+        default:                   return true;
+    }
+}
+
+IRValue incomingFrom(const IRInst& phi, uint32_t block) {
+    for (const IRIncoming& in : phi.incoming) {
+        if (in.block == block) return in.value;
+    }
+    return IRValue();
+}
+
+IRCFG::IRCFG(const IRFunction& fn)
+    : succs(fn.blocks.size()), preds(fn.blocks.size()), order(fn.blocks.size(), kNone), idom(fn.blocks.size(), kNone) {
+    for (uint32_t b = 0; b < fn.blocks.size(); ++b) succs[b] = successors(fn, b);
+    std::vector<uint32_t> postorder;
+    std::vector<std::pair<uint32_t, size_t>> stack{{0, 0}};
+    std::vector<char> seen(fn.blocks.size(), 0);
+    seen[0] = 1;
+    while (!stack.empty()) {
+        uint32_t b = stack.back().first;
+        size_t next = stack.back().second++;
+        if (next == succs[b].size()) {
+            postorder.push_back(b);
+            stack.pop_back();
+        } else if (!seen[succs[b][next]]) {
+            seen[succs[b][next]] = 1;
+            stack.push_back({succs[b][next], 0});
+        }
+    }
+    rpo.assign(postorder.rbegin(), postorder.rend());
+    for (uint32_t k = 0; k < rpo.size(); ++k) order[rpo[k]] = k;
+    for (uint32_t b : rpo) {
+        for (uint32_t s : succs[b]) preds[s].push_back(b);
+    }
+
+    idom[0] = 0;
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (size_t k = 1; k < rpo.size(); ++k) {
+            uint32_t b = rpo[k], dom = kNone;
+            for (uint32_t p : preds[b]) {
+                if (idom[p] != kNone) dom = dom == kNone ? p : intersect(p, dom);
+            }
+            if (idom[b] != dom) {
+                idom[b] = dom;
+                changed = true;
+            }
+        }
+    }
+}
+
+uint32_t IRCFG::intersect(uint32_t a, uint32_t b) const {
+    while (a != b) {
+        while (order[a] > order[b]) a = idom[a];
+        while (order[b] > order[a]) b = idom[b];
+    }
+    return a;
+}
+
+bool IRCFG::dominates(uint32_t a, uint32_t b) const {
+    if (!reachable(a) || !reachable(b)) return false;
+    while (order[b] > order[a]) b = idom[b];
+    return a == b;
+}
+
+void reorderBlocks(IRFunction& fn, const std::vector<uint32_t>& order) {
+    std::vector<uint32_t> position(fn.blocks.size());
+    std::vector<IRBlock> blocks;
+    blocks.reserve(order.size());
+    for (uint32_t b : order) {
+        position[b] = static_cast<uint32_t>(blocks.size());
+        blocks.push_back(std::move(fn.blocks[b]));
+    }
+    fn.blocks = std::move(blocks);
+    for (IRInst& inst : fn.insts) {
+        inst.target[0] = position[inst.target[0]];
+        inst.target[1] = position[inst.target[1]];
+        for (IRIncoming& in : inst.incoming) in.block = position[in.block];
+    }
+}
@@ -0,0 +1,188 @@
+// The compiler's intermediate representation and what every phase after IR generation
+// shares: parsing, printing, checking and the binary encoding of modules, plus the small
+// queries on instructions and the CFG that the optimizer and the backends are built on.
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Arrays live in the stack frame, so their length is capped.
+constexpr uint32_t kMaxArrayLength = 65536;
+// Arguments are only ever passed in registers, which leaves room for six of each kind.
+constexpr uint32_t kMaxParams = 6;
+
+// -------------------- IR --------------------
+// The compiler's intermediate representation: an in-memory form of a small LLVM subset.
+// A function owns one array of instructions that refer to each other by index, so passes
+// rewrite operands without touching strings; each block lists the instructions it
+// executes, in order. Phases hand modules to each other directly; LLVM text is only
+// printed for display and for llc, and parsed back for .ll input.
+// V4I32 and V8Float are <4 x i32> and <8 x float>, which only the vectorizer creates.
+enum class IRType : uint8_t { Void, I8, I32, Float, I1, V4I32, V8Float };
+
+enum class IROp : uint8_t {
+    Alloca,  // type = allocated type; b = element count for an array
+    Load,    // a = pointer
+    Store,   // a = value, b = pointer; type = stored type
+    Add,
+    Sub,
+    Mul,
+    SDiv,
+    FAdd,
+    FSub,
+    FMul,
+    FDiv,
+    Ret,     // a = returned value, none for `ret void`
+    ICmp,    // i1 = a `pred` b; type = operand type
+    FCmp,
+    ZExt,    // type = result type, a = i1 value
+    Phi,     // one incoming value per predecessor
+    Br,      // jump to target[0]
+    CondBr,  // a = i1 condition; target[0] if true, target[1] if false
+    GEP,            // a = array alloca, b = i32 index; type = element type
+    Bitcast,        // a = getelementptr; type = vector type it is read as
+    InsertElement,  // a = vector (undef), b = scalar put in lane 0; type = vector type
+    ShuffleVector,  // a = vector; every lane takes lane 0 of a
+    ReduceAdd,      // a = vector; type = element type; the sum of the lanes
+    Call            // name = callee, args; type = return type
+};
+
+enum class IRPred : uint8_t { EQ, NE, SLT, SLE, SGT, SGE, OEQ, UNE, OLT, OLE, OGT, OGE };
+
+// An Arg is a parameter of the function, numbered from 0 in `inst`.
+struct IRValue {
+    enum class Kind : uint8_t { None, Inst, Int, Float, Undef, Arg };
+    Kind kind = Kind::None;
+    uint32_t inst = 0;
+    int32_t i = 0;
+    float f = 0.0f;
+
+    static IRValue ofInst(uint32_t id) { IRValue v; v.kind = Kind::Inst; v.inst = id; return v; }
+    static IRValue ofInt(int32_t value) { IRValue v; v.kind = Kind::Int; v.i = value; return v; }
+    static IRValue ofFloat(float value) { IRValue v; v.kind = Kind::Float; v.f = value; return v; }
+    static IRValue undef() { IRValue v; v.kind = Kind::Undef; return v; }
+    static IRValue ofArg(uint32_t index) { IRValue v; v.kind = Kind::Arg; v.inst = index; return v; }
+    bool isConstant() const { return kind == Kind::Int || kind == Kind::Float; }
+};
+
+struct IRIncoming {
+    uint32_t block;
+    IRValue value;
+};
+
+struct IRArgument {
+    IRType type;
+    IRValue value;
+};
+
+struct IRInst {
+    IROp op;
+    IRType type;
+    IRPred pred = IRPred::EQ;  // icmp, fcmp
+    bool dead = false;
+    IRValue a, b;
+    std::string name;  // source-level name of the result (allocas, phis) or the callee of a call
+    uint32_t target[2] = {0, 0};       // br, condbr: block indices
+    std::vector<IRIncoming> incoming;  // phi
+    std::vector<IRArgument> args;      // call
+};
+
+// A block ends in ret, br or condbr. Only the entry block of a single-block function is
+// unlabeled. Passes that remove a block leave it empty rather than renumbering the rest.
+struct IRBlock {
+    std::string label;
+    std::vector<uint32_t> insts;
+};
+
+struct IRParam {
+    IRType type;
+    std::string name;
+};
+
+struct IRFunction {
+    std::string name;
+    IRType returnType = IRType::I32;
+    std::vector<IRParam> params;
+    std::vector<IRInst> insts;
+    std::vector<IRBlock> blocks;
+};
+
+struct IRModule {
+    std::vector<IRFunction> functions;
+};
+
+// Parses printIR-style text; on failure returns false and describes the first bad line.
+bool parseIR(std::string_view text, IRModule& module, std::string& error);
+std::string printIR(const IRModule& module);
+// Every non-empty block ends in exactly one terminator, phis come first, no branch
+// targets the entry block or an emptied one, array elements are only reached through a
+// getelementptr on an array alloca, and definitions dominate their uses. parseIR,
+// deserializeIR and the x86 lowering check this, so passes and instruction selection can
+// rely on it.
+bool checkIRFunction(const IRFunction& fn, std::string& error);
+// Every call names a function of the module and passes it arguments of its parameter
+// types. parseIR and deserializeIR check this too; a module built a function at a time
+// (streaming, batch) may call functions it does not hold.
+bool checkIRCalls(const IRModule& module, std::string& error);
+
+// Binary form of a module, for caches and for passing IR between processes: "MCIR", a
+// version byte, then LEB128 varints. Dead instructions are dropped and the rest numbered
+// in block order, so an operand is that number and a block is a count of instructions.
+std::string serializeIR(const IRModule& module);
+// Validates as it reads; on failure returns false and says where the data went wrong.
+bool deserializeIR(std::string_view data, IRModule& module, std::string& error);
+
+// -------------------- Instruction queries --------------------
+const char* irTypeName(IRType type);
+bool isVectorType(IRType type);
+// The type of one lane; a scalar type is its own element type.
+IRType elementType(IRType type);
+uint32_t laneCount(IRType type);
+const char* irOpName(IROp op);
+const char* irPredName(IRPred pred);
+constexpr const char* kReduceAddV4I32 = "@llvm.vector.reduce.add.v4i32";
+bool isTerminator(IROp op);
+// Instructions that only compute a value: no memory access, no control flow, and nothing
+// that can trap (sdiv may divide by zero). Computing an address is not an access.
+bool isPure(IROp op);
+bool isBinaryOp(IROp op);
+// Integer constants wrap to the width of their type, as LLVM's own parser does.
+int32_t wrapToType(int64_t value, IRType type);
+bool sameValue(const IRValue& a, const IRValue& b);
+// The value a phi takes when entered from `block`; none if it has no such edge.
+IRValue incomingFrom(const IRInst& phi, uint32_t block);
+
+// Calls `f` on every value operand: a, b, the incoming values of a phi and the arguments
+// of a call.
+template <typename Inst, typename F>
+void forEachOperand(Inst& inst, F f) {
+    f(inst.a);
+    f(inst.b);
+    for (auto& in : inst.incoming) f(in.value);
+    for (auto& arg : inst.args) f(arg.value);
+}
+
+// Successor blocks of `block`, read off its last live instruction.
+std::vector<uint32_t> successors(const IRFunction& fn, uint32_t block);
+// Puts the blocks of `fn` in `order`, a permutation of their indices, and renumbers branch
+// targets and phi operands to match.
+void reorderBlocks(IRFunction& fn, const std::vector<uint32_t>& order);
+
+// Successors, predecessors, reverse postorder and immediate dominators (the iterative
+// algorithm of Cooper, Harvey and Kennedy). Blocks the entry cannot reach have no place in
+// the order and appear in no predecessor list.
+struct IRCFG {
+    static constexpr uint32_t kNone = UINT32_MAX;
+    std::vector<std::vector<uint32_t>> succs, preds;
+    std::vector<uint32_t> rpo;    // reachable blocks, entry first
+    std::vector<uint32_t> order;  // block -> position in rpo
+    std::vector<uint32_t> idom;
+
+    explicit IRCFG(const IRFunction& fn);
+    uint32_t intersect(uint32_t a, uint32_t b) const;
+    bool reachable(uint32_t b) const { return order[b] != kNone; }
+    // Whether every path from the entry to `b` passes through `a`.
+    bool dominates(uint32_t a, uint32_t b) const;
+};
@@ -0,0 +1,527 @@
+#include "jit.h"
+#include "../vm/vm.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#if defined(__x86_64__) && defined(__unix__) && !defined(__EMSCRIPTEN__)
+#include <csetjmp>
+#include <mutex>
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#define MINICC_HAS_JIT 1
+#endif
+
+// -------------------- JIT --------------------
+namespace {
+unsigned hwReg(X86Reg reg) { return static_cast<unsigned>(reg) & 15; }
+
+bool isXMM(X86Reg reg) { return reg >= X86Reg::XMM0; }
+
+bool fitsInt8(int32_t v) { return v >= -128 && v <= 127; }
+
+struct X86Encoder {
+    std::vector<uint8_t> code;
+
+    void byte(uint8_t b) { code.push_back(b); }
+
+    void imm32(int32_t v) {
+        for (int i = 0; i < 4; ++i) byte(static_cast<uint8_t>(static_cast<uint32_t>(v) >> (8 * i)));
+    }
+
+    // Register numbers 8-15 of the ModRM base and the SIB index, which REX or VEX extend.
+    static unsigned baseOf(const X86Operand& rm) { return rm.kind == X86Operand::Kind::Reg ? hwReg(rm.reg) : 5; }
+    static unsigned indexOf(const X86Operand& rm) { return rm.kind == X86Operand::Kind::Mem ? hwReg(rm.index) : 0; }
+
+    // ModRM, then a SIB byte for an array element, then the displacement. Frame slots are
+    // disp(%rbp) and elements disp(%rbp,index,scale); an index of rsp means none.
+    void operands(unsigned reg, const X86Operand& rm) {
+        uint8_t field = static_cast<uint8_t>((reg & 7) << 3);
+        if (rm.kind == X86Operand::Kind::Reg) return byte(0xC0 | field | (hwReg(rm.reg) & 7));
+        bool indexed = rm.index != X86Reg::RSP;
+        uint8_t mod = fitsInt8(rm.value) ? 0x40 : 0x80;
+        byte(mod | field | (indexed ? 4 : 5));
+        if (indexed) {
+            uint8_t scale = rm.scale == 8 ? 3 : rm.scale == 4 ? 2 : rm.scale == 2 ? 1 : 0;
+            byte(static_cast<uint8_t>(scale << 6 | (hwReg(rm.index) & 7) << 3 | 5));
+        }
+        if (mod == 0x40) byte(static_cast<uint8_t>(rm.value));
+        else imm32(rm.value);
+    }
+
+    // Mandatory prefix, REX, opcode and ModRM for `reg` against a register or memory `rm`.
+    // A byte-sized `reg` or `rm` forces a REX so that numbers 4-7 mean spl/bpl/sil/dil.
+    void modrm(std::initializer_list<uint8_t> opcode, unsigned reg, const X86Operand& rm,
+               bool wide = false, uint8_t prefix = 0, bool byteReg = false, bool byteRm = false) {
+        if (prefix) byte(prefix);
+        unsigned base = baseOf(rm), index = indexOf(rm);
+        uint8_t rex = 0x40 | (wide ? 8 : 0) | ((reg >> 3) << 2) | ((index >> 3) << 1) | (base >> 3);
+        bool rmIsReg = rm.kind == X86Operand::Kind::Reg;
+        bool lowByteReg = (byteReg && reg >= 4 && reg < 8) || (byteRm && rmIsReg && base >= 4 && base < 8);
+        if (rex != 0x40 || lowByteReg) byte(rex);
+        for (uint8_t b : opcode) byte(b);
+        operands(reg, rm);
+    }
+
+    // A 256-bit VEX instruction: the two-byte form when the map is 0F and nothing needs
+    // X or B, the three-byte one otherwise. `map` is 1 for 0F and 2 for 0F38, `pp` 0 for no
+    // prefix and 1 for 66, `vvvv` the extra source register or 0 when there is none.
+    void vex(uint8_t map, uint8_t pp, uint8_t opcode, unsigned reg, unsigned vvvv, const X86Operand& rm) {
+        unsigned base = baseOf(rm), index = indexOf(rm);
+        uint8_t tail = static_cast<uint8_t>((~vvvv & 15) << 3 | 4 | pp);  // L = 1
+        uint8_t r = (reg >> 3) ? 0 : 0x80;
+        if (map == 1 && !(index >> 3) && !(base >> 3)) {
+            byte(0xC5);
+            byte(r | tail);
+        } else {
+            byte(0xC4);
+            byte(static_cast<uint8_t>(r | ((index >> 3) ? 0 : 0x40) | ((base >> 3) ? 0 : 0x20) | map));
+            byte(tail);
+        }
+        byte(opcode);
+        operands(reg, rm);
+    }
+
+    // movdqa, vmovaps and the like: `load` takes the register from `rm`, `store` writes it there.
+    void vectorMove(const X86Inst& inst, uint8_t load, uint8_t store, uint8_t prefix, bool avx) {
+        bool toMemory = inst.dst.kind == X86Operand::Kind::Mem;
+        // Like the assembler, take the store form between registers when that lets VEX
+        // fit in two bytes.
+        bool swap = toMemory || (avx && inst.src.kind == X86Operand::Kind::Reg && hwReg(inst.src.reg) >= 8 &&
+                                 hwReg(inst.dst.reg) < 8);
+        unsigned reg = hwReg(swap ? inst.src.reg : inst.dst.reg);
+        const X86Operand& rm = swap ? inst.dst : inst.src;
+        if (avx) return vex(1, 0, swap ? store : load, reg, 0, rm);
+        modrm({0x0F, swap ? store : load}, reg, rm, false, prefix);
+    }
+
+    // add/sub: `regToRm` and `rmToReg` opcodes, `ext` for the immediate group.
+    void arith(const X86Inst& inst, uint8_t regToRm, uint8_t rmToReg, unsigned ext) {
+        bool wide = inst.width == 8;
+        if (inst.src.kind == X86Operand::Kind::Imm) {
+            bool small = fitsInt8(inst.src.value);
+            modrm({static_cast<uint8_t>(small ? 0x83 : 0x81)}, ext, inst.dst, wide);
+            if (small) byte(static_cast<uint8_t>(inst.src.value));
+            else imm32(inst.src.value);
+        } else if (inst.src.kind == X86Operand::Kind::Reg) {
+            modrm({regToRm}, hwReg(inst.src.reg), inst.dst, wide);
+        } else {
+            modrm({rmToReg}, hwReg(inst.dst.reg), inst.src, wide);
+        }
+    }
+
+    void mov(const X86Inst& inst) {
+        bool wide = inst.width == 8, narrow = inst.width == 1;
+        if (inst.src.kind == X86Operand::Kind::Imm && inst.dst.kind == X86Operand::Kind::Reg && inst.width == 4) {
+            if (hwReg(inst.dst.reg) >= 8) byte(0x41);
+            byte(static_cast<uint8_t>(0xB8 + (hwReg(inst.dst.reg) & 7)));
+            imm32(inst.src.value);
+        } else if (inst.src.kind == X86Operand::Kind::Imm) {
+            modrm({static_cast<uint8_t>(narrow ? 0xC6 : 0xC7)}, 0, inst.dst, wide);
+            if (narrow) byte(static_cast<uint8_t>(inst.src.value));
+            else imm32(inst.src.value);
+        } else if (inst.src.kind == X86Operand::Kind::Reg) {
+            modrm({static_cast<uint8_t>(narrow ? 0x88 : 0x89)}, hwReg(inst.src.reg), inst.dst, wide, 0, narrow, narrow);
+        } else {
+            modrm({static_cast<uint8_t>(narrow ? 0x8A : 0x8B)}, hwReg(inst.dst.reg), inst.src, wide, 0, narrow, narrow);
+        }
+    }
+
+    void sse(uint8_t opcode, const X86Inst& inst) {
+        modrm({0x0F, opcode}, hwReg(inst.dst.reg), inst.src, false, 0xF3);
+    }
+
+    // eax = eax / src, with x / 0 = 0 and x / -1 = -x for the cases idiv traps on.
+    void guardedDivide(const X86Operand& divisor) {
+        auto jump = [&](uint8_t opcode) {
+            byte(opcode);
+            byte(0);
+            return code.size();
+        };
+        auto land = [&](size_t from) { code[from - 1] = static_cast<uint8_t>(code.size() - from); };
+
+        modrm({0x83}, 7, divisor);  // cmp $0, divisor
+        byte(0);
+        size_t toZero = jump(0x74);  // je
+        modrm({0x83}, 7, divisor);  // cmp $-1, divisor
+        byte(0xFF);
+        size_t toDivide = jump(0x75);  // jne
+        byte(0xF7);                    // neg %eax
+        byte(0xD8);
+        size_t negDone = jump(0xEB);
+        land(toZero);
+        byte(0x31);                    // xor %eax, %eax
+        byte(0xC0);
+        size_t zeroDone = jump(0xEB);
+        land(toDivide);
+        modrm({0xF7}, 7, divisor);     // idiv divisor
+        land(negDone);
+        land(zeroDone);
+    }
+
+    void encode(const X86Inst& inst) {
+        switch (inst.op) {
+            case X86Op::Mov:    return mov(inst);
+            case X86Op::MovSX8: return modrm({0x0F, 0xBE}, hwReg(inst.dst.reg), inst.src, false, 0, false, true);
+            case X86Op::MovD:
+                if (inst.dst.kind == X86Operand::Kind::Reg && isXMM(inst.dst.reg)) {
+                    return modrm({0x0F, 0x6E}, hwReg(inst.dst.reg), inst.src, false, 0x66);
+                }
+                return modrm({0x0F, 0x7E}, hwReg(inst.src.reg), inst.dst, false, 0x66);
+            case X86Op::Add:    return arith(inst, 0x01, 0x03, 0);
+            case X86Op::Sub:    return arith(inst, 0x29, 0x2B, 5);
+            case X86Op::IMul:
+                if (inst.src.kind != X86Operand::Kind::Imm) return modrm({0x0F, 0xAF}, hwReg(inst.dst.reg), inst.src);
+                if (fitsInt8(inst.src.value)) {
+                    modrm({0x6B}, hwReg(inst.dst.reg), inst.dst);
+                    return byte(static_cast<uint8_t>(inst.src.value));
+                }
+                modrm({0x69}, hwReg(inst.dst.reg), inst.dst);
+                return imm32(inst.src.value);
+            case X86Op::Cdq:    return byte(0x99);
+            case X86Op::IDiv:   return guardedDivide(inst.src);
+            case X86Op::MovSS:
+                if (inst.dst.kind == X86Operand::Kind::Mem) return modrm({0x0F, 0x11}, hwReg(inst.src.reg), inst.dst, false, 0xF3);
+                return sse(0x10, inst);
+            case X86Op::AddSS:  return sse(0x58, inst);
+            case X86Op::SubSS:  return sse(0x5C, inst);
+            case X86Op::MulSS:  return sse(0x59, inst);
+            case X86Op::DivSS:  return sse(0x5E, inst);
+            case X86Op::Push:
+            case X86Op::Pop:
+                if (hwReg(inst.src.reg) >= 8) byte(0x41);
+                return byte(static_cast<uint8_t>((inst.op == X86Op::Push ? 0x50 : 0x58) + (hwReg(inst.src.reg) & 7)));
+            case X86Op::Ret:    return byte(0xC3);
+            case X86Op::Cmp:    return arith(inst, 0x39, 0x3B, 7);
+            case X86Op::Test:   return modrm({0x85}, hwReg(inst.src.reg), inst.dst, inst.width == 8);
+            case X86Op::UComiSS: return modrm({0x0F, 0x2E}, hwReg(inst.dst.reg), inst.src);
+            case X86Op::SetCC:
+                return modrm({0x0F, static_cast<uint8_t>(0x90 + static_cast<uint8_t>(inst.cond))}, 0, inst.dst, false, 0, false, true);
+            case X86Op::MovZX8: return modrm({0x0F, 0xB6}, hwReg(inst.dst.reg), inst.src, false, 0, false, true);
+            case X86Op::And:    return arith(inst, 0x21, 0x23, 4);
+            case X86Op::Or:     return arith(inst, 0x09, 0x0B, 1);
+            case X86Op::Jmp:
+            case X86Op::Jcc:
+            case X86Op::Label:
+                return;  // laid out by encodeX86 once every label's position is known
+            case X86Op::MovDQA: return vectorMove(inst, 0x6F, 0x7F, 0x66, false);
+            case X86Op::MovDQU: return vectorMove(inst, 0x6F, 0x7F, 0xF3, false);
+            case X86Op::PAddD:  return modrm({0x0F, 0xFE}, hwReg(inst.dst.reg), inst.src, false, 0x66);
+            case X86Op::PSubD:  return modrm({0x0F, 0xFA}, hwReg(inst.dst.reg), inst.src, false, 0x66);
+            case X86Op::PMulLD: return modrm({0x0F, 0x38, 0x40}, hwReg(inst.dst.reg), inst.src, false, 0x66);
+            case X86Op::PXor:   return modrm({0x0F, 0xEF}, hwReg(inst.dst.reg), inst.src, false, 0x66);
+            case X86Op::PShufD:
+                modrm({0x0F, 0x70}, hwReg(inst.dst.reg), inst.src, false, 0x66);
+                return byte(inst.imm);
+            case X86Op::VMovAPS: return vectorMove(inst, 0x28, 0x29, 0, true);
+            case X86Op::VMovUPS: return vectorMove(inst, 0x10, 0x11, 0, true);
+            case X86Op::VAddPS: return vex(1, 0, 0x58, hwReg(inst.dst.reg), hwReg(inst.dst.reg), inst.src);
+            case X86Op::VSubPS: return vex(1, 0, 0x5C, hwReg(inst.dst.reg), hwReg(inst.dst.reg), inst.src);
+            case X86Op::VMulPS: return vex(1, 0, 0x59, hwReg(inst.dst.reg), hwReg(inst.dst.reg), inst.src);
+            case X86Op::VDivPS: return vex(1, 0, 0x5E, hwReg(inst.dst.reg), hwReg(inst.dst.reg), inst.src);
+            case X86Op::VXorPS: return vex(1, 0, 0x57, hwReg(inst.dst.reg), hwReg(inst.dst.reg), inst.src);
+            case X86Op::VBroadcastSS: return vex(2, 1, 0x18, hwReg(inst.dst.reg), 0, inst.src);
+            case X86Op::VZeroUpper:
+                byte(0xC5);
+                byte(0xF8);
+                return byte(0x77);
+            case X86Op::Call:
+                byte(0xE8);
+                return imm32(0);
+        }
+    }
+
+    // jmp or jcc to `displacement` bytes past the end of the jump.
+    void jump(const X86Inst& inst, bool isLong, int32_t displacement) {
+        if (!isLong) {
+            byte(inst.op == X86Op::Jmp ? 0xEB : static_cast<uint8_t>(0x70 + static_cast<uint8_t>(inst.cond)));
+            return byte(static_cast<uint8_t>(displacement));
+        }
+        if (inst.op == X86Op::Jmp) {
+            byte(0xE9);
+        } else {
+            byte(0x0F);
+            byte(static_cast<uint8_t>(0x80 + static_cast<uint8_t>(inst.cond)));
+        }
+        imm32(displacement);
+    }
+};
+
+#ifdef MINICC_HAS_JIT
+// Code copied into its own pages, made executable and unmapped on destruction.
+class ExecutableCode {
+public:
+    explicit ExecutableCode(const std::vector<uint8_t>& code) {
+        size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        size = (code.size() + page - 1) / page * page;
+        void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) return;
+        std::memcpy(p, code.data(), code.size());
+        if (mprotect(p, size, PROT_READ | PROT_EXEC) != 0) {
+            munmap(p, size);
+            return;
+        }
+        memory = p;
+    }
+    ExecutableCode(const ExecutableCode&) = delete;
+    ExecutableCode& operator=(const ExecutableCode&) = delete;
+    ~ExecutableCode() {
+        if (memory) munmap(memory, size);
+    }
+
+    void* entry() const { return memory; }
+
+private:
+    void* memory = nullptr;
+    size_t size = 0;
+};
+
+// SIGSEGV is how running out of stack shows. The handler is installed once for the process
+// and jumps back only on a thread that is inside runGuarded, each with its own jump buffer;
+// a fault anywhere else goes to whatever handled SIGSEGV before.
+struct sigaction previousAction;
+thread_local sigjmp_buf crashJump;
+thread_local bool guarded = false;
+
+void onCrash(int signal, siginfo_t* info, void* context) {
+    if (guarded) {
+        guarded = false;
+        siglongjmp(crashJump, 1);
+    }
+    if (previousAction.sa_flags & SA_SIGINFO) {
+        previousAction.sa_sigaction(signal, info, context);
+    } else if (previousAction.sa_handler != SIG_DFL && previousAction.sa_handler != SIG_IGN) {
+        previousAction.sa_handler(signal);
+    } else {
+        // Returning runs the faulting instruction again, now with the default action.
+        struct sigaction fallback{};
+        fallback.sa_handler = SIG_DFL;
+        sigaction(signal, &fallback, nullptr);
+    }
+}
+
+void installCrashHandler() {
+    static std::once_flag once;
+    std::call_once(once, [] {
+        struct sigaction action{};
+        action.sa_sigaction = onCrash;
+        action.sa_flags = SA_SIGINFO | SA_ONSTACK;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGSEGV, &action, &previousAction);
+    });
+}
+
+// The handler needs a stack of its own, since the one that overflowed has no room left for
+// it. Each thread sets one up the first time it runs guarded code and takes it down when it
+// exits; a thread that already has one (a sanitizer's, say) keeps it.
+struct HandlerStack {
+    std::vector<char> memory;
+
+    HandlerStack() {
+        stack_t current{};
+        if (sigaltstack(nullptr, &current) == 0 && !(current.ss_flags & SS_DISABLE)) return;
+        memory.resize(1 << 16);
+        stack_t alternate{};
+        alternate.ss_sp = memory.data();
+        alternate.ss_size = memory.size();
+        if (sigaltstack(&alternate, nullptr) != 0) memory.clear();
+    }
+    ~HandlerStack() {
+        if (memory.empty()) return;
+        stack_t disable{};
+        disable.ss_flags = SS_DISABLE;
+        sigaltstack(&disable, nullptr);
+    }
+};
+
+// Calls `entry` with SIGSEGV caught.
+bool runGuarded(int32_t (*entry)(), int32_t& value) {
+    installCrashHandler();
+    thread_local HandlerStack handlerStack;
+    bool returned = sigsetjmp(crashJump, 1) == 0;
+    if (returned) {
+        guarded = true;
+        value = entry();
+    }
+    guarded = false;
+    return returned;
+}
+#endif
+}  // namespace
+
+// Everything but jumps is encoded once. Jumps start short and any that cannot reach its
+// label becomes long, which can push other labels out of reach, so layout repeats until
+// nothing grows.
+std::vector<uint8_t> encodeX86(const X86Function& fn, std::vector<X86Relocation>* calls) {
+    const size_t count = fn.code.size();
+    X86Encoder fixed;
+    std::vector<size_t> start(count + 1);
+    size_t labels = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const X86Inst& inst = fn.code[i];
+        start[i] = fixed.code.size();
+        if (inst.op == X86Op::Label) labels = std::max(labels, static_cast<size_t>(inst.dst.value) + 1);
+        fixed.encode(inst);
+    }
+    start[count] = fixed.code.size();
+    auto listCalls = [&](const std::vector<size_t>& at) {
+        for (size_t i = 0; calls && i < count; ++i) {
+            if (fn.code[i].op == X86Op::Call) calls->push_back({at[i] + 1, static_cast<uint32_t>(fn.code[i].dst.value)});
+        }
+    };
+    if (labels == 0) {  // straight-line code: nothing to relax
+        listCalls(start);
+        return std::move(fixed.code);
+    }
+
+    auto isJump = [&](size_t i) { return fn.code[i].op == X86Op::Jmp || fn.code[i].op == X86Op::Jcc; };
+    std::vector<char> isLong(count, 0);
+    auto size = [&](size_t i) -> size_t {
+        if (!isJump(i)) return start[i + 1] - start[i];
+        if (!isLong[i]) return 2;
+        return fn.code[i].op == X86Op::Jmp ? 5 : 6;
+    };
+    std::vector<size_t> offset(count + 1), labelAt(labels);
+    auto displacement = [&](size_t i) {
+        return static_cast<int64_t>(labelAt[fn.code[i].dst.value]) - static_cast<int64_t>(offset[i] + size(i));
+    };
+    for (bool grew = true; grew;) {
+        grew = false;
+        size_t at = 0;
+        for (size_t i = 0; i < count; ++i) {
+            offset[i] = at;
+            if (fn.code[i].op == X86Op::Label) labelAt[fn.code[i].dst.value] = at;
+            at += size(i);
+        }
+        offset[count] = at;
+        for (size_t i = 0; i < count; ++i) {
+            if (!isJump(i) || isLong[i]) continue;
+            int64_t d = displacement(i);
+            if (d < -128 || d > 127) {
+                isLong[i] = 1;
+                grew = true;
+            }
+        }
+    }
+
+    X86Encoder encoder;
+    encoder.code.reserve(offset[count]);
+    for (size_t i = 0; i < count; ++i) {
+        if (isJump(i)) encoder.jump(fn.code[i], isLong[i], static_cast<int32_t>(displacement(i)));
+        else encoder.code.insert(encoder.code.end(), fixed.code.begin() + start[i], fixed.code.begin() + start[i + 1]);
+    }
+    listCalls(offset);
+    return std::move(encoder.code);
+}
+
+bool jitAvailable() {
+#ifdef MINICC_HAS_JIT
+    return true;
+#else
+    return false;
+#endif
+}
+
+JITResult runJIT(const IRModule& module) {
+    JITResult result;
+#ifdef MINICC_HAS_JIT
+    auto start = std::chrono::steady_clock::now();
+    // @main goes first, so the code starts with it.
+    std::vector<const IRFunction*> functions;
+    for (const IRFunction& fn : module.functions) {
+        if (fn.name == "main") functions.insert(functions.begin(), &fn);
+        else functions.push_back(&fn);
+    }
+    if (functions.empty() || functions[0]->name != "main") {
+        result.error = "no @main to run";
+        return result;
+    }
+    if (functions[0]->returnType != IRType::I32 || !functions[0]->params.empty()) {
+        result.error = "@main is not `i32 ()`";
+        return result;
+    }
+    for (const IRFunction* fn : functions) {
+        if (!checkIRFunction(*fn, result.error)) {
+            result.error = "@" + fn->name + ": " + result.error;
+            return result;
+        }
+    }
+    if (!checkIRCalls(module, result.error)) return result;
+
+    // Functions are laid out one after another, 16-byte aligned like the assembler's
+    // .p2align, and every call is patched with the distance to its callee.
+    std::vector<uint8_t> code;
+    std::unordered_map<std::string, size_t> entryOf;
+    std::vector<std::pair<size_t, std::string>> calls;  // rel32 offset, callee
+    bool sse41 = false, avx2 = false;
+    for (const IRFunction* fn : functions) {
+        X86Function selected = selectX86(*fn);
+        if (selected.frameBytes > kMaxJITFrameBytes) {
+            result.error = "@" + fn->name + " needs a " + std::to_string(selected.frameBytes) +
+                           "-byte frame, more than the JIT's " + std::to_string(kMaxJITFrameBytes);
+            return result;
+        }
+        for (const X86Inst& inst : selected.code) {
+            sse41 = sse41 || inst.op == X86Op::PMulLD;
+            avx2 = avx2 || (inst.op >= X86Op::VMovAPS && inst.op <= X86Op::VZeroUpper);
+        }
+        code.resize((code.size() + 15) & ~size_t{15}, 0xCC);
+        entryOf[fn->name] = code.size();
+        std::vector<X86Relocation> relocations;
+        std::vector<uint8_t> bytes = encodeX86(selected, &relocations);
+        for (const X86Relocation& r : relocations) calls.push_back({code.size() + r.offset, selected.callees[r.callee]});
+        code.insert(code.end(), bytes.begin(), bytes.end());
+    }
+    if ((sse41 && !__builtin_cpu_supports("sse4.1")) || (avx2 && !__builtin_cpu_supports("avx2"))) {
+        result.error = std::string("this CPU lacks ") + (avx2 ? "AVX2" : "SSE4.1") + ", which the vectorized code needs";
+        return result;
+    }
+    for (const auto& [at, callee] : calls) {
+        int32_t rel = static_cast<int32_t>(static_cast<int64_t>(entryOf.at(callee)) - static_cast<int64_t>(at + 4));
+        std::memcpy(&code[at], &rel, sizeof rel);
+    }
+
+    ExecutableCode executable(code);
+    if (!executable.entry()) {
+        result.error = "could not map executable memory";
+        return result;
+    }
+    result.codeBytes = code.size();
+    auto called = std::chrono::steady_clock::now();
+    result.compileMs = std::chrono::duration<double, std::milli>(called - start).count();
+
+    if (!runGuarded(reinterpret_cast<int32_t (*)()>(executable.entry()), result.value)) {
+        result.error = "the program crashed, most likely by running out of stack in deep recursion";
+        return result;
+    }
+    result.runMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - called).count();
+    result.ok = true;
+#else
+    (void)module;
+    result.error = "no JIT in this build";
+#endif
+    return result;
+}
+
+// Text that does not parse is reported as such; nothing is guessed from it.
+std::string runCodegen(const std::string& ir) {
+    IRModule module;
+    std::string error;
+    if (!parseIR(ir, module, error)) return "Execution error: " + error + ".";
+    return runCodegen(module);
+}
+
+std::string runCodegen(const IRModule& module) {
+    if (!jitAvailable()) {
+        Bytecode program = compileBytecode(module);
+        return formatVMResult(runBytecode(program), program);
+    }
+    JITResult run = runJIT(module);
+    if (!run.ok) return "Execution error: " + run.error + ".";
+    char timing[96];
+    std::snprintf(timing, sizeof timing, "\nExecution time: %.4f ms (JIT, %zu bytes of code)", run.runMs, run.codeBytes);
+    return "Execution result: " + std::to_string(run.value) + timing;
+}
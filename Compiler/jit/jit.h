@@ -0,0 +1,46 @@
+// Runs optimized modules in-process by encoding the selected x86-64 code into executable
+// memory.
+#pragma once
+
+#include "../backend/x86.h"
+
+#include <cstddef>
+
+// -------------------- JIT --------------------
+// A call whose rel32, at `offset` in the encoded function, is to reach callees[callee].
+struct X86Relocation {
+    size_t offset;
+    uint32_t callee;
+};
+
+// Machine code for one selected function. Operands are registers, immediates and
+// rbp-relative memory only and jumps are relative, so the bytes run wherever they are
+// copied. Jumps take the short form unless the target is out of reach, as with the GNU
+// assembler. idiv is guarded: division by zero yields 0 and x / -1 wraps, instead of
+// raising SIGFPE. Calls are left with a zero displacement, as the
+// assembler leaves them for the linker, and listed in `calls` when it is given.
+std::vector<uint8_t> encodeX86(const X86Function& fn, std::vector<X86Relocation>* calls = nullptr);
+
+struct JITResult {
+    bool ok = false;
+    int32_t value = 0;     // what @main returned
+    double compileMs = 0;  // instruction selection, encoding and mapping the code
+    double runMs = 0;      // the call itself
+    size_t codeBytes = 0;
+    std::string error;
+};
+
+// True in native x86-64 builds that can map executable memory; the WebAssembly build
+// cannot, and runJIT then only reports that.
+bool jitAvailable();
+// Compiles an optimized module into executable memory, calls @main and unmaps it. Frames
+// live on the caller's stack, so one above kMaxJITFrameBytes is refused, as is vector code
+// this CPU cannot run. Recursion that runs out of stack is reported as an error rather
+// than taking the process down.
+constexpr int32_t kMaxJITFrameBytes = 1 << 20;
+JITResult runJIT(const IRModule& module);
+
+// Runs the program and reports what it returns, from optimized IR text or an optimized
+// module: with runJIT where it is available, otherwise in the bytecode VM (vm/vm.h).
+std::string runCodegen(const std::string& ir);
+std::string runCodegen(const IRModule& module);
@@ -0,0 +1,338 @@
+#include "optimizer.h"
+#include "passes.h"
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// -------------------- Inlining and tail calls --------------------
+constexpr int kInlineThreshold = 40;
+constexpr uint32_t kMaxInlinedCallerInsts = 2000;
+
+uint32_t liveInstructions(const IRFunction& fn) {
+    uint32_t count = 0;
+    for (const IRBlock& block : fn.blocks) {
+        for (uint32_t id : block.insts) count += fn.insts[id].dead ? 0 : 1;
+    }
+    return count;
+}
+
+bool callsItself(const IRFunction& fn) {
+    for (const IRBlock& block : fn.blocks) {
+        for (uint32_t id : block.insts) {
+            if (fn.insts[id].op == IROp::Call && fn.insts[id].name == fn.name) return true;
+        }
+    }
+    return false;
+}
+
+// What copying `callee` into a caller costs, in instructions: its body, less the call it
+// replaces and less every use of a parameter the call binds to a constant, since those
+// fold away; without `args`, every parameter counts as constant. Allocas, phis and
+// branches are free; the CFG cleanup removes most of them. A callee whose entry block is
+// a branch target has no place for the caller's values to come in, so it is never inlined.
+bool inlineCost(const IRFunction& callee, const std::vector<IRArgument>* args, int& cost) {
+    cost = -1 - static_cast<int>(callee.params.size());
+    for (const IRBlock& block : callee.blocks) {
+        for (uint32_t id : block.insts) {
+            const IRInst& inst = callee.insts[id];
+            if (inst.op == IROp::Br || inst.op == IROp::CondBr) {
+                if (inst.target[0] == 0 || (inst.op == IROp::CondBr && inst.target[1] == 0)) return false;
+            }
+            if (inst.op != IROp::Alloca && inst.op != IROp::Phi && inst.op != IROp::Br) ++cost;
+            forEachOperand(inst, [&](const IRValue& v) {
+                if (v.kind == IRValue::Kind::Arg && (!args || (*args)[v.inst].value.isConstant())) --cost;
+            });
+        }
+    }
+    return true;
+}
+
+bool isInlineCandidate(const IRFunction& fn) {
+    int cost;
+    return !callsItself(fn) && inlineCost(fn, nullptr, cost) && cost <= kInlineThreshold;
+}
+
+// Replaces the call `call` in block `at` of `fn` with a copy of `callee`. The block is
+// split after the call; its first half jumps to the copy of the callee's entry, every
+// return becomes a jump to the second half, and a phi there merges the returned values
+// when there is more than one. The callee's allocas join the caller's in its entry block.
+void inlineCall(IRFunction& fn, uint32_t at, uint32_t call, const IRFunction& callee) {
+    const uint32_t oldBlocks = static_cast<uint32_t>(fn.blocks.size());
+    if (fn.blocks[0].label.empty()) fn.blocks[0].label = freshLabel(fn, "entry");
+    auto append = [&](IRInst inst) {
+        fn.insts.push_back(std::move(inst));
+        return static_cast<uint32_t>(fn.insts.size() - 1);
+    };
+
+    // The second half of the split block takes over its successors' phi edges.
+    std::vector<uint32_t> after = successors(fn, at);
+    std::vector<uint32_t>& split = fn.blocks[at].insts;
+    auto it = std::find(split.begin(), split.end(), call);
+    std::vector<uint32_t> rest(it + 1, split.end());
+    split.erase(it, split.end());
+    for (uint32_t s : after) {
+        for (uint32_t id : fn.blocks[s].insts) {
+            for (IRIncoming& in : fn.insts[id].incoming) {
+                if (in.block == at) in.block = oldBlocks;
+            }
+        }
+    }
+    IRBlock exit;
+    exit.label = freshLabel(fn, callee.name + ".exit");
+    fn.blocks.push_back(std::move(exit));
+
+    std::vector<uint32_t> blockMap(callee.blocks.size(), 0), instMap(callee.insts.size(), 0);
+    for (uint32_t b = 0; b < callee.blocks.size(); ++b) {
+        blockMap[b] = static_cast<uint32_t>(fn.blocks.size());
+        IRBlock copy;
+        const std::string& label = callee.blocks[b].label;
+        copy.label = freshLabel(fn, callee.name + "." + (label.empty() ? "entry" : label));
+        fn.blocks.push_back(std::move(copy));
+    }
+    uint32_t next = static_cast<uint32_t>(fn.insts.size());
+    for (const IRBlock& block : callee.blocks) {
+        for (uint32_t id : block.insts) instMap[id] = next++;
+    }
+
+    const std::vector<IRArgument> args = fn.insts[call].args;
+    auto map = [&](IRValue& v) {
+        if (v.kind == IRValue::Kind::Inst) v = IRValue::ofInst(instMap[v.inst]);
+        else if (v.kind == IRValue::Kind::Arg) v = args[v.inst].value;
+    };
+    std::vector<IRIncoming> returned;
+    std::vector<uint32_t> allocas;
+    for (uint32_t b = 0; b < callee.blocks.size(); ++b) {
+        for (uint32_t id : callee.blocks[b].insts) {
+            IRInst inst = callee.insts[id];
+            forEachOperand(inst, map);
+            inst.target[0] = blockMap[inst.target[0]];
+            inst.target[1] = blockMap[inst.target[1]];
+            for (IRIncoming& in : inst.incoming) in.block = blockMap[in.block];
+            if (inst.op == IROp::Ret) {
+                returned.push_back({blockMap[b], inst.a});
+                inst = IRInst{IROp::Br, IRType::Void};
+                inst.target[0] = oldBlocks;
+            }
+            uint32_t copy = append(std::move(inst));
+            if (fn.insts[copy].op == IROp::Alloca) allocas.push_back(copy);
+            else fn.blocks[blockMap[b]].insts.push_back(copy);
+        }
+    }
+
+    IRInst enter{IROp::Br, IRType::Void};
+    enter.target[0] = blockMap[0];
+    fn.blocks[at].insts.push_back(append(std::move(enter)));
+    IRValue result = returned.empty() ? IRValue::undef() : returned[0].value;
+    if (returned.size() > 1) {
+        IRInst phi{IROp::Phi, fn.insts[call].type};
+        phi.incoming = returned;
+        result = IRValue::ofInst(append(std::move(phi)));
+        fn.blocks[oldBlocks].insts.push_back(result.inst);
+    }
+    fn.blocks[oldBlocks].insts.insert(fn.blocks[oldBlocks].insts.end(), rest.begin(), rest.end());
+    std::vector<uint32_t>& entry = fn.blocks[0].insts;
+    entry.insert(entry.begin(), allocas.begin(), allocas.end());
+
+    std::vector<IRValue> replaced(fn.insts.size());
+    replaced[call] = result;
+    fn.insts[call].dead = true;
+    resolveAll(fn, replaced);
+
+    // The copy goes right after the block it was called from, then the rest of that block.
+    std::vector<uint32_t> order;
+    for (uint32_t b = 0; b <= at; ++b) order.push_back(b);
+    for (uint32_t b = oldBlocks + 1; b < fn.blocks.size(); ++b) order.push_back(b);
+    order.push_back(oldBlocks);
+    for (uint32_t b = at + 1; b < oldBlocks; ++b) order.push_back(b);
+    reorderBlocks(fn, order);
+}
+
+// Inlines calls to functions of `module` that inlineCost finds cheap enough. Calls the
+// copies bring in are left alone, and recursive callees are never copied, so this always
+// terminates; the callers' own growth is capped as well.
+uint32_t inlineCalls(const IRModule& module, IRFunction& fn) {
+    std::vector<uint32_t> calls;
+    for (const IRBlock& block : fn.blocks) {
+        for (uint32_t id : block.insts) {
+            if (fn.insts[id].op == IROp::Call && fn.insts[id].name != fn.name) calls.push_back(id);
+        }
+    }
+    if (calls.empty()) return 0;
+
+    // Only the callees are looked up. The front end makes a function call only the ones above
+    // it, so the search walks back from `fn` and looks past it only for what it did not find;
+    // a module of many small functions then costs no more than the calls in it.
+    std::unordered_map<std::string_view, const IRFunction*> byName;
+    for (uint32_t call : calls) byName.emplace(fn.insts[call].name, nullptr);
+    const size_t count = module.functions.size();
+    const IRFunction* first = module.functions.data();
+    std::less<const IRFunction*> below;
+    size_t self = !below(&fn, first) && below(&fn, first + count) ? static_cast<size_t>(&fn - first) : count;
+    size_t pending = byName.size();
+    auto visit = [&](size_t i) {
+        auto it = byName.find(module.functions[i].name);
+        if (it != byName.end() && !it->second) {
+            it->second = &module.functions[i];
+            --pending;
+        }
+    };
+    for (size_t i = self; i-- > 0 && pending > 0;) visit(i);
+    for (size_t i = self + 1; i < count && pending > 0; ++i) visit(i);
+
+    uint32_t inlined = 0, size = liveInstructions(fn);
+    for (uint32_t call : calls) {
+        auto found = byName.find(fn.insts[call].name);
+        if (found == byName.end() || !found->second || found->second == &fn) continue;
+        const IRFunction& callee = *found->second;
+        int cost;
+        if (callsItself(callee) || !inlineCost(callee, &fn.insts[call].args, cost) || cost > kInlineThreshold ||
+            size + liveInstructions(callee) > kMaxInlinedCallerInsts) {
+            continue;
+        }
+        for (uint32_t b = 0; b < fn.blocks.size(); ++b) {
+            const std::vector<uint32_t>& insts = fn.blocks[b].insts;
+            if (std::find(insts.begin(), insts.end(), call) == insts.end()) continue;
+            inlineCall(fn, b, call, callee);
+            size += liveInstructions(callee);
+            ++inlined;
+            break;
+        }
+    }
+    return inlined;
+}
+
+// Turns self-recursive calls in tail position into jumps back to the top of the function.
+// The old entry block moves to a `tailrecurse` block behind one that keeps only the
+// allocas, and each parameter becomes a phi there, fed by the entry and by every tail
+// call. A call whose result is only added to or multiplied by some other value before
+// being returned counts as well, with an accumulator phi that starts at 0 or 1 and
+// collects the other operands; every other return then returns the accumulator combined
+// with its value. Integer addition and multiplication wrap, so the regrouping does not
+// change any result.
+uint32_t eliminateTailCalls(IRFunction& fn) {
+    struct Site {
+        uint32_t block, call, combine;  // combine: UINT32_MAX for a plain `ret (call)`
+    };
+    std::vector<Site> sites;
+    IROp accumulate = IROp::Ret;  // Add or Mul once an accumulating site is found
+    for (uint32_t b = 0; b < fn.blocks.size(); ++b) {
+        const std::vector<uint32_t>& insts = fn.blocks[b].insts;
+        size_t n = insts.size();
+        if (n < 2) continue;
+        const IRInst& ret = fn.insts[insts[n - 1]];
+        if (ret.op != IROp::Ret || ret.a.kind != IRValue::Kind::Inst) continue;
+        auto isSelfCall = [&](uint32_t id) { return fn.insts[id].op == IROp::Call && fn.insts[id].name == fn.name; };
+        if (ret.a.inst == insts[n - 2] && isSelfCall(insts[n - 2])) {
+            sites.push_back({b, insts[n - 2], UINT32_MAX});
+            continue;
+        }
+        if (n < 3 || ret.a.inst != insts[n - 2] || !isSelfCall(insts[n - 3])) continue;
+        const IRInst& combine = fn.insts[insts[n - 2]];
+        IRValue call = IRValue::ofInst(insts[n - 3]);
+        if ((combine.op != IROp::Add && combine.op != IROp::Mul) || combine.type != IRType::I32) continue;
+        if (sameValue(combine.a, call) == sameValue(combine.b, call)) continue;
+        if (accumulate != IROp::Ret && accumulate != combine.op) continue;
+        accumulate = combine.op;
+        sites.push_back({b, insts[n - 3], insts[n - 2]});
+    }
+    if (sites.empty()) return 0;
+
+    auto append = [&](IRInst inst) {
+        fn.insts.push_back(std::move(inst));
+        return static_cast<uint32_t>(fn.insts.size() - 1);
+    };
+    const uint32_t top = static_cast<uint32_t>(fn.blocks.size());
+    if (fn.blocks[0].label.empty()) fn.blocks[0].label = freshLabel(fn, "entry");
+    IRBlock loop;
+    loop.label = freshLabel(fn, "tailrecurse");
+    std::vector<uint32_t>& entry = fn.blocks[0].insts;
+    auto firstMoved = std::stable_partition(entry.begin(), entry.end(), [&](uint32_t id) { return fn.insts[id].op == IROp::Alloca; });
+    loop.insts.assign(firstMoved, entry.end());
+    entry.erase(firstMoved, entry.end());
+    fn.blocks.push_back(std::move(loop));
+    for (uint32_t s : successors(fn, top)) {
+        for (uint32_t id : fn.blocks[s].insts) {
+            for (IRIncoming& in : fn.insts[id].incoming) {
+                if (in.block == 0) in.block = top;
+            }
+        }
+    }
+    for (Site& site : sites) {
+        if (site.block == 0) site.block = top;
+    }
+
+    // Parameters are read through their phis from here on.
+    std::vector<uint32_t> phis;
+    for (uint32_t k = 0; k < fn.params.size(); ++k) phis.push_back(static_cast<uint32_t>(fn.insts.size() + k));
+    for (IRInst& inst : fn.insts) {
+        forEachOperand(inst, [&](IRValue& v) {
+            if (v.kind == IRValue::Kind::Arg) v = IRValue::ofInst(phis[v.inst]);
+        });
+    }
+    for (uint32_t k = 0; k < fn.params.size(); ++k) {
+        IRInst phi{IROp::Phi, fn.params[k].type};
+        phi.incoming.push_back({0, IRValue::ofArg(k)});
+        append(std::move(phi));
+    }
+    uint32_t acc = UINT32_MAX;
+    if (accumulate != IROp::Ret) {
+        IRInst phi{IROp::Phi, IRType::I32};
+        phi.name = "accumulator";
+        phi.incoming.push_back({0, IRValue::ofInt(accumulate == IROp::Add ? 0 : 1)});
+        acc = append(std::move(phi));
+        phis.push_back(acc);
+
+        // Returns other than the tail calls hand back the accumulated value too.
+        for (uint32_t b = 1; b <= top; ++b) {
+            std::vector<uint32_t>& insts = fn.blocks[b].insts;
+            if (insts.empty() || fn.insts[insts.back()].op != IROp::Ret) continue;
+            if (std::any_of(sites.begin(), sites.end(), [&](const Site& s) { return s.block == b; })) continue;
+            IRInst combine{accumulate, IRType::I32};
+            combine.a = IRValue::ofInst(acc);
+            combine.b = fn.insts[insts.back()].a;
+            uint32_t id = append(std::move(combine));
+            insts.insert(insts.end() - 1, id);
+            fn.insts[insts.back()].a = IRValue::ofInst(id);
+        }
+    }
+    fn.blocks[top].insts.insert(fn.blocks[top].insts.begin(), phis.begin(), phis.end());
+    IRInst enter{IROp::Br, IRType::Void};
+    enter.target[0] = top;
+    fn.blocks[0].insts.push_back(append(std::move(enter)));
+
+    for (const Site& site : sites) {
+        std::vector<uint32_t>& insts = fn.blocks[site.block].insts;
+        const std::vector<IRArgument> args = fn.insts[site.call].args;
+        for (uint32_t k = 0; k < fn.params.size(); ++k) fn.insts[phis[k]].incoming.push_back({site.block, args[k].value});
+        IRValue other;
+        if (site.combine != UINT32_MAX) {
+            const IRInst& combine = fn.insts[site.combine];
+            other = sameValue(combine.a, IRValue::ofInst(site.call)) ? combine.b : combine.a;
+        }
+        size_t tail = site.combine == UINT32_MAX ? 2 : 3;
+        for (size_t k = insts.size() - tail; k < insts.size(); ++k) fn.insts[insts[k]].dead = true;
+        insts.resize(insts.size() - tail);
+        if (acc != UINT32_MAX) {
+            IRValue carried = IRValue::ofInst(acc);
+            if (site.combine != UINT32_MAX) {
+                IRInst combine{accumulate, IRType::I32};
+                combine.a = carried;
+                combine.b = other;
+                carried = IRValue::ofInst(append(std::move(combine)));
+                insts.push_back(carried.inst);
+            }
+            fn.insts[acc].incoming.push_back({site.block, carried});
+        }
+        IRInst back{IROp::Br, IRType::Void};
+        back.target[0] = top;
+        insts.push_back(append(std::move(back)));
+    }
+
+    std::vector<uint32_t> order{0, top};
+    for (uint32_t b = 1; b < top; ++b) order.push_back(b);
+    reorderBlocks(fn, order);
+    return static_cast<uint32_t>(sites.size());
+}
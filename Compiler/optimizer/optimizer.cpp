@@ -0,0 +1,859 @@
+#include "optimizer.h"
+#include "passes.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// -------------------- Optimizer --------------------
+IRValue resolveValue(const std::vector<IRValue>& replaced, IRValue v) {
+    while (v.kind == IRValue::Kind::Inst && replaced[v.inst].kind != IRValue::Kind::None) v = replaced[v.inst];
+    return v;
+}
+
+void resolveOperands(IRInst& inst, const std::vector<IRValue>& replaced) {
+    forEachOperand(inst, [&](IRValue& v) { v = resolveValue(replaced, v); });
+}
+
+void resolveAll(IRFunction& fn, const std::vector<IRValue>& replaced) {
+    for (IRInst& inst : fn.insts) {
+        if (!inst.dead) resolveOperands(inst, replaced);
+    }
+}
+
+std::vector<IRLoop> findLoops(const IRFunction& fn, const IRCFG& cfg) {
+    std::vector<IRLoop> loops;
+    for (uint32_t h : cfg.rpo) {
+        IRLoop loop;
+        loop.header = h;
+        for (uint32_t p : cfg.preds[h]) {
+            if (cfg.dominates(h, p)) loop.latches.push_back(p);
+        }
+        if (loop.latches.empty()) continue;
+        loop.contains.assign(fn.blocks.size(), 0);
+        loop.contains[h] = 1;
+        std::vector<uint32_t> work(loop.latches);
+        while (!work.empty()) {
+            uint32_t b = work.back();
+            work.pop_back();
+            if (loop.contains[b]) continue;
+            loop.contains[b] = 1;
+            work.insert(work.end(), cfg.preds[b].begin(), cfg.preds[b].end());
+        }
+        for (uint32_t b : cfg.rpo) {
+            if (loop.contains[b]) loop.blocks.push_back(b);
+        }
+        uint32_t outside = IRCFG::kNone, entries = 0;
+        for (uint32_t p : cfg.preds[h]) {
+            if (!loop.contains[p]) {
+                outside = p;
+                ++entries;
+            }
+        }
+        if (entries == 1 && cfg.succs[outside].size() == 1) loop.preheader = outside;
+        loops.push_back(std::move(loop));
+    }
+    std::stable_sort(loops.begin(), loops.end(),
+                     [](const IRLoop& a, const IRLoop& b) { return a.blocks.size() < b.blocks.size(); });
+    return loops;
+}
+
+std::vector<uint32_t> blockOfInsts(const IRFunction& fn) {
+    std::vector<uint32_t> blockOf(fn.insts.size(), IRCFG::kNone);
+    for (uint32_t b = 0; b < fn.blocks.size(); ++b) {
+        for (uint32_t id : fn.blocks[b].insts) blockOf[id] = b;
+    }
+    return blockOf;
+}
+
+// Promotes allocas that are only loaded from and stored to into SSA values (Cytron et
+// al.): phis go on the iterated dominance frontier of the blocks storing to an alloca, then
+// a walk down the dominator tree replaces each load with the value reaching it, undef
+// before the first store. A single-block function needs no phis and takes one sweep.
+uint32_t promoteAllocas(IRFunction& fn) {
+    std::vector<char> promotable(fn.insts.size(), 0);
+    for (size_t id = 0; id < fn.insts.size(); ++id) promotable[id] = fn.insts[id].op == IROp::Alloca && !fn.insts[id].dead;
+    for (const IRInst& inst : fn.insts) {
+        if (inst.dead) continue;
+        // Any use other than as the address of a load or store lets the pointer escape.
+        auto escapes = [&](const IRValue& v) {
+            if (v.kind == IRValue::Kind::Inst) promotable[v.inst] = 0;
+        };
+        if (inst.op == IROp::Load) continue;
+        if (inst.op == IROp::Store) escapes(inst.a);
+        else forEachOperand(inst, escapes);
+    }
+
+    std::vector<uint32_t> slot(fn.insts.size(), IRCFG::kNone);  // alloca -> index into `allocas`
+    std::vector<uint32_t> allocas;
+    for (uint32_t id = 0; id < fn.insts.size(); ++id) {
+        if (!promotable[id]) continue;
+        slot[id] = static_cast<uint32_t>(allocas.size());
+        allocas.push_back(id);
+    }
+    if (allocas.empty()) return 0;
+    auto slotOf = [&](const IRValue& v) { return v.kind == IRValue::Kind::Inst ? slot[v.inst] : IRCFG::kNone; };
+
+    IRCFG cfg(fn);
+    size_t blockCount = fn.blocks.size();
+    std::vector<uint32_t> phiSlot(fn.insts.size(), IRCFG::kNone);
+    std::vector<std::vector<uint32_t>> phis(blockCount);
+    if (blockCount > 1) {
+        std::vector<std::vector<uint32_t>> frontier(blockCount);
+        for (uint32_t b : cfg.rpo) {
+            if (cfg.preds[b].size() < 2) continue;
+            for (uint32_t p : cfg.preds[b]) {
+                for (uint32_t runner = p; runner != cfg.idom[b]; runner = cfg.idom[runner]) {
+                    if (frontier[runner].empty() || frontier[runner].back() != b) frontier[runner].push_back(b);
+                }
+            }
+        }
+        std::vector<std::vector<uint32_t>> storeBlocks(allocas.size());
+        for (uint32_t b : cfg.rpo) {
+            for (uint32_t id : fn.blocks[b].insts) {
+                const IRInst& inst = fn.insts[id];
+                uint32_t s = inst.op == IROp::Store && !inst.dead ? slotOf(inst.b) : IRCFG::kNone;
+                if (s != IRCFG::kNone && (storeBlocks[s].empty() || storeBlocks[s].back() != b)) storeBlocks[s].push_back(b);
+            }
+        }
+        std::vector<uint32_t> placed(blockCount, IRCFG::kNone), queued(blockCount, IRCFG::kNone);
+        for (uint32_t s = 0; s < allocas.size(); ++s) {
+            std::vector<uint32_t> work = storeBlocks[s];
+            for (uint32_t b : work) queued[b] = s;
+            while (!work.empty()) {
+                uint32_t b = work.back();
+                work.pop_back();
+                for (uint32_t d : frontier[b]) {
+                    if (placed[d] == s) continue;
+                    placed[d] = s;
+                    IRInst phi{IROp::Phi, fn.insts[allocas[s]].type};
+                    phi.name = fn.insts[allocas[s]].name;
+                    phis[d].push_back(static_cast<uint32_t>(fn.insts.size()));
+                    phiSlot.push_back(s);
+                    fn.insts.push_back(std::move(phi));
+                    if (queued[d] != s) {
+                        queued[d] = s;
+                        work.push_back(d);
+                    }
+                }
+            }
+        }
+        for (uint32_t b = 0; b < blockCount; ++b) {
+            fn.blocks[b].insts.insert(fn.blocks[b].insts.begin(), phis[b].begin(), phis[b].end());
+        }
+        slot.resize(fn.insts.size(), IRCFG::kNone);
+    }
+
+    std::vector<IRValue> replaced(fn.insts.size());
+    std::vector<IRValue> current(allocas.size(), IRValue::undef());
+    std::vector<std::pair<uint32_t, IRValue>> undo;  // earlier values of `current`, restored on leaving a subtree
+    uint32_t promoted = 0;
+    auto rewrite = [&](uint32_t id, bool reachable) {
+        IRInst& inst = fn.insts[id];
+        if (inst.dead) return;
+        if (inst.op != IROp::Phi) resolveOperands(inst, replaced);
+        if (phiSlot[id] != IRCFG::kNone) {
+            undo.push_back({phiSlot[id], current[phiSlot[id]]});
+            current[phiSlot[id]] = IRValue::ofInst(id);
+        } else if (slot[id] != IRCFG::kNone) {
+            inst.dead = true;
+            ++promoted;
+        } else if (inst.op == IROp::Store && slotOf(inst.b) != IRCFG::kNone) {
+            undo.push_back({slotOf(inst.b), current[slotOf(inst.b)]});
+            current[slotOf(inst.b)] = inst.a;
+            inst.dead = true;
+        } else if (inst.op == IROp::Load && slotOf(inst.a) != IRCFG::kNone) {
+            replaced[id] = reachable ? current[slotOf(inst.a)] : IRValue::undef();
+            inst.dead = true;
+        }
+    };
+
+    std::vector<std::vector<uint32_t>> children(blockCount);
+    for (size_t k = 1; k < cfg.rpo.size(); ++k) children[cfg.idom[cfg.rpo[k]]].push_back(cfg.rpo[k]);
+    struct Visit {
+        uint32_t block;
+        size_t mark;  // undo log size on entry, or SIZE_MAX when entering
+    };
+    std::vector<Visit> stack{{0, SIZE_MAX}};
+    while (!stack.empty()) {
+        Visit visit = stack.back();
+        stack.pop_back();
+        if (visit.mark != SIZE_MAX) {
+            for (; undo.size() > visit.mark; undo.pop_back()) current[undo.back().first] = undo.back().second;
+            continue;
+        }
+        uint32_t b = visit.block;
+        stack.push_back({b, undo.size()});
+        for (uint32_t id : fn.blocks[b].insts) rewrite(id, true);
+        for (uint32_t s : cfg.succs[b]) {
+            for (uint32_t phi : phis[s]) fn.insts[phi].incoming.push_back({b, current[phiSlot[phi]]});
+        }
+        for (uint32_t child : children[b]) stack.push_back({child, SIZE_MAX});
+    }
+    for (uint32_t b = 0; b < blockCount; ++b) {
+        if (cfg.reachable(b)) continue;
+        for (uint32_t id : fn.blocks[b].insts) rewrite(id, false);
+    }
+    if (blockCount > 1) resolveAll(fn, replaced);
+    return promoted;
+}
+
+// Within each block, forwards the last value stored to or loaded from an address to later
+// loads of it. Distinct allocas never alias, so a store to one only clobbers its own
+// address; two element addresses may be the same slot, so a store through one forgets
+// every other.
+uint32_t eliminateRedundantLoads(IRFunction& fn) {
+    std::vector<IRValue> replaced(fn.insts.size());
+    uint32_t removed = 0;
+    for (IRBlock& block : fn.blocks) {
+        std::unordered_map<uint32_t, IRValue> known;
+        std::vector<uint32_t> elements;  // keys of `known` that are not allocas
+        for (uint32_t id : block.insts) {
+            IRInst& inst = fn.insts[id];
+            if (inst.dead) continue;
+            resolveOperands(inst, replaced);
+            const IRValue& address = inst.op == IROp::Store ? inst.b : inst.a;
+            bool element = address.kind == IRValue::Kind::Inst && fn.insts[address.inst].op != IROp::Alloca;
+            if (inst.op == IROp::Store && inst.b.kind == IRValue::Kind::Inst) {
+                if (element) {
+                    for (uint32_t key : elements) known.erase(key);
+                    elements.assign(1, inst.b.inst);
+                }
+                known[inst.b.inst] = inst.a;
+            } else if (inst.op == IROp::Load && inst.a.kind == IRValue::Kind::Inst) {
+                auto it = known.find(inst.a.inst);
+                if (it != known.end()) {
+                    replaced[id] = it->second;
+                    inst.dead = true;
+                    ++removed;
+                } else {
+                    known[inst.a.inst] = IRValue::ofInst(id);
+                    if (element) elements.push_back(inst.a.inst);
+                }
+            }
+        }
+    }
+    if (fn.blocks.size() > 1) resolveAll(fn, replaced);
+    return removed;
+}
+
+// Folds a binary operation on two constants. Division by zero and INT_MIN / -1 are left
+// alone: they are undefined at run time and must not become a compile-time value.
+bool foldBinary(IROp op, IRType type, const IRValue& a, const IRValue& b, IRValue& out) {
+    if (elementType(type) == IRType::Float) {
+        float l = a.f, r = b.f;
+        switch (op) {
+            case IROp::FAdd: out = IRValue::ofFloat(l + r); return true;
+            case IROp::FSub: out = IRValue::ofFloat(l - r); return true;
+            case IROp::FMul: out = IRValue::ofFloat(l * r); return true;
+            case IROp::FDiv: out = IRValue::ofFloat(l / r); return true;
+            default: return false;
+        }
+    }
+    int64_t l = a.i, r = b.i;
+    switch (op) {
+        case IROp::Add: out = IRValue::ofInt(wrapToType(l + r, type)); return true;
+        case IROp::Sub: out = IRValue::ofInt(wrapToType(l - r, type)); return true;
+        case IROp::Mul: out = IRValue::ofInt(wrapToType(l * r, type)); return true;
+        case IROp::SDiv: {
+            int64_t min = type == IRType::I8 ? INT8_MIN : INT32_MIN;
+            if (r == 0 || (l == min && r == -1)) return false;
+            out = IRValue::ofInt(wrapToType(l / r, type));
+            return true;
+        }
+        default: return false;
+    }
+}
+
+// Ordered float predicates are false when either side is NaN; une is true.
+bool foldCompare(IRPred pred, const IRValue& a, const IRValue& b, IRValue& out) {
+    bool r;
+    switch (pred) {
+        case IRPred::EQ:  r = a.i == b.i; break;
+        case IRPred::NE:  r = a.i != b.i; break;
+        case IRPred::SLT: r = a.i < b.i; break;
+        case IRPred::SLE: r = a.i <= b.i; break;
+        case IRPred::SGT: r = a.i > b.i; break;
+        case IRPred::SGE: r = a.i >= b.i; break;
+        case IRPred::OEQ: r = a.f == b.f; break;
+        case IRPred::UNE: r = !(a.f == b.f); break;
+        case IRPred::OLT: r = a.f < b.f; break;
+        case IRPred::OLE: r = a.f <= b.f; break;
+        case IRPred::OGT: r = a.f > b.f; break;
+        case IRPred::OGE: r = a.f >= b.f; break;
+        default: return false;
+    }
+    out = IRValue::ofInt(r);
+    return true;
+}
+
+// Folds `inst` as if its operands were `a` and `b`, when those are constants.
+bool foldConstant(const IRInst& inst, const IRValue& a, const IRValue& b, IRValue& out) {
+    if (isBinaryOp(inst.op)) return a.isConstant() && b.isConstant() && foldBinary(inst.op, inst.type, a, b, out);
+    if (inst.op == IROp::ICmp || inst.op == IROp::FCmp) return a.isConstant() && b.isConstant() && foldCompare(inst.pred, a, b, out);
+    if (inst.op == IROp::ZExt && a.kind == IRValue::Kind::Int) {
+        out = IRValue::ofInt(a.i);
+        return true;
+    }
+    return false;
+}
+
+// Integer identities that hold for every operand value: x+0, 0+x, x-0, x*1, 1*x, x/1 and
+// x*0, 0*x. Float identities are skipped because of signed zeros and NaNs.
+bool simplifyBinary(const IRInst& inst, IRValue& out) {
+    if (elementType(inst.type) == IRType::Float) return false;
+    auto is = [](const IRValue& v, int32_t c) { return v.kind == IRValue::Kind::Int && v.i == c; };
+    switch (inst.op) {
+        case IROp::Add:
+            if (is(inst.b, 0)) { out = inst.a; return true; }
+            if (is(inst.a, 0)) { out = inst.b; return true; }
+            return false;
+        case IROp::Sub:
+            if (is(inst.b, 0)) { out = inst.a; return true; }
+            return false;
+        case IROp::Mul:
+            if (is(inst.b, 1)) { out = inst.a; return true; }
+            if (is(inst.a, 1)) { out = inst.b; return true; }
+            if (is(inst.a, 0) || is(inst.b, 0)) { out = IRValue::ofInt(0); return true; }
+            return false;
+        case IROp::SDiv:
+            if (is(inst.b, 1)) { out = inst.a; return true; }
+            return false;
+        default:
+            return false;
+    }
+}
+
+// The one value a phi takes when its operands other than itself agree. Undef operands are
+// skipped when the rest agree on a constant, which is available everywhere.
+bool simplifyPhi(uint32_t id, const IRInst& phi, IRValue& out) {
+    IRValue value;
+    bool sawUndef = false;
+    for (const IRIncoming& in : phi.incoming) {
+        const IRValue& v = in.value;
+        if (v.kind == IRValue::Kind::Inst && v.inst == id) continue;
+        if (v.kind == IRValue::Kind::Undef) {
+            sawUndef = true;
+        } else if (value.kind == IRValue::Kind::None) {
+            value = v;
+        } else if (!sameValue(value, v)) {
+            return false;
+        }
+    }
+    if (value.kind == IRValue::Kind::None) value = IRValue::undef();
+    if (sawUndef && value.kind == IRValue::Kind::Inst) return false;
+    out = value;
+    return true;
+}
+
+void removeIncoming(IRFunction& fn, uint32_t block, uint32_t pred) {
+    for (uint32_t id : fn.blocks[block].insts) {
+        std::vector<IRIncoming>& in = fn.insts[id].incoming;
+        in.erase(std::remove_if(in.begin(), in.end(), [&](const IRIncoming& e) { return e.block == pred; }), in.end());
+    }
+}
+
+// Folds instructions whose operands are constant and substitutes the result into every
+// later use, so constants flow through whole chains of arithmetic in one sweep. A branch on
+// a constant becomes a jump and drops this edge from the other successor's phis. Loop phis
+// only see their back-edge operand after the loop body, so sweeps repeat until nothing
+// folds.
+uint32_t propagateConstants(IRFunction& fn) {
+    std::vector<IRValue> replaced(fn.insts.size());
+    uint32_t folded = 0;
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (uint32_t b = 0; b < fn.blocks.size(); ++b) {
+            for (uint32_t id : fn.blocks[b].insts) {
+                IRInst& inst = fn.insts[id];
+                if (inst.dead) continue;
+                resolveOperands(inst, replaced);
+                if (inst.op == IROp::CondBr && inst.a.kind == IRValue::Kind::Int) {
+                    uint32_t taken = inst.target[inst.a.i ? 0 : 1], untaken = inst.target[inst.a.i ? 1 : 0];
+                    if (untaken != taken) removeIncoming(fn, untaken, b);
+                    inst.op = IROp::Br;
+                    inst.a = IRValue();
+                    inst.target[0] = taken;
+                    ++folded;
+                    changed = true;
+                    continue;
+                }
+                IRValue value;
+                bool done = inst.op == IROp::Phi ? simplifyPhi(id, inst, value)
+                                                 : foldConstant(inst, inst.a, inst.b, value) ||
+                                                       (isBinaryOp(inst.op) && simplifyBinary(inst, value));
+                if (done) {
+                    replaced[id] = value;
+                    inst.dead = true;
+                    ++folded;
+                    changed = true;
+                }
+            }
+        }
+        if (fn.blocks.size() == 1) break;
+    }
+    return folded;
+}
+
+// Deletes blocks the entry no longer reaches and the phi operands of edges that are gone,
+// then merges each block into its only predecessor when that predecessor jumps nowhere
+// else. Returns the number of blocks removed.
+uint32_t simplifyCFG(IRFunction& fn) {
+    if (fn.blocks.size() == 1) return 0;
+    IRCFG cfg(fn);
+    uint32_t removed = 0;
+    for (uint32_t b = 0; b < fn.blocks.size(); ++b) {
+        if (cfg.reachable(b) || fn.blocks[b].insts.empty()) continue;
+        for (uint32_t id : fn.blocks[b].insts) fn.insts[id].dead = true;
+        fn.blocks[b].insts.clear();
+        ++removed;
+    }
+
+    std::vector<IRValue> replaced(fn.insts.size());
+    for (uint32_t b : cfg.rpo) {
+        for (uint32_t id : fn.blocks[b].insts) {
+            IRInst& inst = fn.insts[id];
+            if (inst.op != IROp::Phi) break;
+            const std::vector<uint32_t>& preds = cfg.preds[b];
+            inst.incoming.erase(std::remove_if(inst.incoming.begin(), inst.incoming.end(),
+                                               [&](const IRIncoming& in) {
+                                                   return std::find(preds.begin(), preds.end(), in.block) == preds.end();
+                                               }),
+                                inst.incoming.end());
+            if (inst.incoming.size() <= 1) {
+                replaced[id] = inst.incoming.empty() ? IRValue::undef() : inst.incoming[0].value;
+                inst.dead = true;
+            }
+        }
+    }
+
+    for (uint32_t b : cfg.rpo) {
+        while (!fn.blocks[b].insts.empty() && cfg.succs[b].size() == 1) {
+            uint32_t s = cfg.succs[b][0];
+            if (s == b || s == 0 || cfg.preds[s].size() != 1) break;
+            std::vector<uint32_t>& into = fn.blocks[b].insts;
+            fn.insts[into.back()].dead = true;
+            into.pop_back();
+            into.insert(into.end(), fn.blocks[s].insts.begin(), fn.blocks[s].insts.end());
+            fn.blocks[s].insts.clear();
+            ++removed;
+            for (uint32_t t : cfg.succs[s]) {
+                for (uint32_t id : fn.blocks[t].insts) {
+                    for (IRIncoming& in : fn.insts[id].incoming) {
+                        if (in.block == s) in.block = b;
+                    }
+                }
+                std::replace(cfg.preds[t].begin(), cfg.preds[t].end(), s, b);
+            }
+            cfg.succs[b] = cfg.succs[s];
+        }
+    }
+    resolveAll(fn, replaced);
+
+    bool straightLine = true;
+    for (size_t b = 1; b < fn.blocks.size(); ++b) straightLine = straightLine && fn.blocks[b].insts.empty();
+    if (straightLine) fn.blocks[0].label.clear();
+    return removed;
+}
+
+constexpr uint32_t kMaxUnrollTrips = 16;
+constexpr uint32_t kMaxUnrolledInsts = 256;
+
+// Fully unrolls a loop with a constant trip count whose header exits through a condbr and
+// whose body is a chain of blocks back to the header. The iterations are first replayed on
+// constants to find the trip count, then the header and body are copied into the
+// preheader once per iteration, plus a last header for the exiting test.
+bool unrollLoop(IRFunction& fn, const IRCFG& cfg, const IRLoop& loop) {
+    if (loop.preheader == IRCFG::kNone || loop.latches.size() != 1) return false;
+    uint32_t header = loop.header, latch = loop.latches[0];
+    const IRInst& exitBranch = fn.insts[fn.blocks[header].insts.back()];
+    if (exitBranch.op != IROp::CondBr) return false;
+    bool stayOnTrue = loop.contains[exitBranch.target[0]];
+    if (stayOnTrue == static_cast<bool>(loop.contains[exitBranch.target[1]])) return false;
+    uint32_t exit = exitBranch.target[stayOnTrue ? 1 : 0];
+    IRValue condition = exitBranch.a;
+
+    std::vector<uint32_t> body{header};
+    for (uint32_t b = exitBranch.target[stayOnTrue ? 0 : 1]; b != header; b = cfg.succs[b][0]) {
+        if (cfg.preds[b].size() != 1 || cfg.succs[b].size() != 1 || body.size() == loop.blocks.size()) return false;
+        body.push_back(b);
+    }
+    if (body.size() != loop.blocks.size()) return false;
+
+    std::vector<uint32_t> phis, work;  // work: everything but phis and terminators, in order
+    size_t headerWork = 0;
+    for (size_t k = 0; k < body.size(); ++k) {
+        for (uint32_t id : fn.blocks[body[k]].insts) {
+            const IRInst& inst = fn.insts[id];
+            if (inst.op == IROp::Phi) {
+                if (k != 0 || incomingFrom(inst, loop.preheader).kind == IRValue::Kind::None ||
+                    incomingFrom(inst, latch).kind == IRValue::Kind::None) {
+                    return false;
+                }
+                phis.push_back(id);
+            } else if (inst.op == IROp::Alloca) {
+                return false;
+            } else if (!isTerminator(inst.op)) {
+                work.push_back(id);
+            }
+        }
+        if (k == 0) headerWork = work.size();
+    }
+
+    std::vector<IRValue> known(fn.insts.size());
+    auto lookup = [&](const IRValue& v) { return v.kind == IRValue::Kind::Inst ? known[v.inst] : v; };
+    auto evaluate = [&](uint32_t id) {
+        const IRInst& inst = fn.insts[id];
+        IRValue out;
+        known[id] = foldConstant(inst, lookup(inst.a), lookup(inst.b), out) ? out : IRValue();
+    };
+    for (uint32_t phi : phis) known[phi] = lookup(incomingFrom(fn.insts[phi], loop.preheader));
+    uint32_t trips = 0;
+    for (;; ++trips) {
+        for (size_t j = 0; j < headerWork; ++j) evaluate(work[j]);
+        IRValue taken = lookup(condition);
+        if (taken.kind != IRValue::Kind::Int) return false;
+        if ((taken.i != 0) != stayOnTrue) break;
+        if (trips == kMaxUnrollTrips || (trips + 2) * work.size() > kMaxUnrolledInsts) return false;
+        for (size_t j = headerWork; j < work.size(); ++j) evaluate(work[j]);
+        std::vector<IRValue> next;
+        for (uint32_t phi : phis) next.push_back(lookup(incomingFrom(fn.insts[phi], latch)));
+        for (size_t k = 0; k < phis.size(); ++k) known[phis[k]] = next[k];
+    }
+
+    std::vector<char> inLoop(fn.insts.size(), 0);
+    for (uint32_t b : body) {
+        for (uint32_t id : fn.blocks[b].insts) inLoop[id] = 1;
+    }
+    std::vector<IRValue> mapped(fn.insts.size());  // loop value -> its copy in the current iteration
+    auto map = [&](const IRValue& v) { return v.kind == IRValue::Kind::Inst && inLoop[v.inst] ? mapped[v.inst] : v; };
+    std::vector<uint32_t> copies;
+    auto copy = [&](uint32_t id) {
+        IRInst inst = fn.insts[id];
+        forEachOperand(inst, [&](IRValue& v) { v = map(v); });
+        mapped[id] = IRValue::ofInst(static_cast<uint32_t>(fn.insts.size()));
+        copies.push_back(static_cast<uint32_t>(fn.insts.size()));
+        fn.insts.push_back(std::move(inst));
+    };
+    for (uint32_t phi : phis) mapped[phi] = incomingFrom(fn.insts[phi], loop.preheader);
+    for (uint32_t k = 0;; ++k) {
+        for (size_t j = 0; j < headerWork; ++j) copy(work[j]);
+        if (k == trips) break;
+        for (size_t j = headerWork; j < work.size(); ++j) copy(work[j]);
+        std::vector<IRValue> next;
+        for (uint32_t phi : phis) next.push_back(map(incomingFrom(fn.insts[phi], latch)));
+        for (size_t i = 0; i < phis.size(); ++i) mapped[phis[i]] = next[i];
+    }
+
+    std::vector<uint32_t>& pre = fn.blocks[loop.preheader].insts;
+    pre.insert(pre.end() - 1, copies.begin(), copies.end());
+    fn.insts[pre.back()].target[0] = fn.insts[pre.back()].target[1] = exit;
+    // Code after the loop sees the values of the exiting test.
+    std::vector<IRValue> replaced(fn.insts.size());
+    for (uint32_t b : body) {
+        for (uint32_t id : fn.blocks[b].insts) {
+            replaced[id] = mapped[id];
+            fn.insts[id].dead = true;
+        }
+        fn.blocks[b].insts.clear();
+    }
+    for (uint32_t id : fn.blocks[exit].insts) {
+        for (IRIncoming& in : fn.insts[id].incoming) {
+            if (in.block == header) in.block = loop.preheader;
+        }
+    }
+    resolveAll(fn, replaced);
+    return true;
+}
+
+// Loops are found again after each one unrolled, since unrolling changes the CFG.
+uint32_t unrollLoops(IRFunction& fn) {
+    uint32_t unrolled = 0;
+    for (bool progress = fn.blocks.size() > 1; progress;) {
+        IRCFG cfg(fn);
+        progress = false;
+        for (const IRLoop& loop : findLoops(fn, cfg)) {
+            if (unrollLoop(fn, cfg, loop)) {
+                ++unrolled;
+                progress = true;
+                break;
+            }
+        }
+    }
+    return unrolled;
+}
+
+// Moves loop-invariant computations into the preheader, inner loops first so a value can
+// climb several levels. Only what cannot trap is moved: a division qualifies when its
+// divisor is a constant other than 0 and -1.
+uint32_t hoistLoopInvariants(IRFunction& fn) {
+    if (fn.blocks.size() == 1) return 0;
+    IRCFG cfg(fn);
+    std::vector<uint32_t> blockOf = blockOfInsts(fn);
+    uint32_t hoisted = 0;
+    for (const IRLoop& loop : findLoops(fn, cfg)) {
+        if (loop.preheader == IRCFG::kNone) continue;
+        std::vector<uint32_t>& pre = fn.blocks[loop.preheader].insts;
+        for (uint32_t b : loop.blocks) {
+            std::vector<uint32_t>& insts = fn.blocks[b].insts;
+            size_t kept = 0;
+            for (uint32_t id : insts) {
+                const IRInst& inst = fn.insts[id];
+                bool invariant = isPure(inst.op) ||
+                                 (inst.op == IROp::SDiv && inst.b.kind == IRValue::Kind::Int && inst.b.i != 0 && inst.b.i != -1);
+                forEachOperand(inst, [&](const IRValue& v) {
+                    if (v.kind == IRValue::Kind::Inst && loop.contains[blockOf[v.inst]]) invariant = false;
+                });
+                if (invariant) {
+                    pre.insert(pre.end() - 1, id);
+                    blockOf[id] = loop.preheader;
+                    ++hoisted;
+                } else {
+                    insts[kept++] = id;
+                }
+            }
+            insts.resize(kept);
+        }
+    }
+    return hoisted;
+}
+
+std::string freshLabel(const IRFunction& fn, const std::string& base) {
+    auto taken = [&](const std::string& label) {
+        for (const IRBlock& block : fn.blocks) {
+            if (block.label == label) return true;
+        }
+        return false;
+    };
+    std::string label = base;
+    for (uint32_t k = 1; taken(label); ++k) label = base + std::to_string(k);
+    return label;
+}
+
+// Strength reduction of induction variables: where `i` is an i32 phi stepped by a constant
+// on every trip around the loop, `i * k` becomes a phi of its own that starts at init * k
+// and is stepped by step * k right after i's increment.
+uint32_t reduceStrength(IRFunction& fn) {
+    if (fn.blocks.size() == 1) return 0;
+    IRCFG cfg(fn);
+    std::vector<uint32_t> blockOf = blockOfInsts(fn);
+    std::vector<IRValue> replaced(fn.insts.size());
+    uint32_t reduced = 0;
+    auto append = [&](IRInst inst, uint32_t block) {
+        uint32_t id = static_cast<uint32_t>(fn.insts.size());
+        fn.insts.push_back(std::move(inst));
+        blockOf.push_back(block);
+        return id;
+    };
+    for (const IRLoop& loop : findLoops(fn, cfg)) {
+        if (loop.preheader == IRCFG::kNone || loop.latches.size() != 1) continue;
+        uint32_t latch = loop.latches[0];
+        std::vector<uint32_t> ivs;
+        for (uint32_t id : fn.blocks[loop.header].insts) {
+            if (fn.insts[id].op != IROp::Phi) break;
+            if (fn.insts[id].type == IRType::I32 && fn.insts[id].incoming.size() == 2) ivs.push_back(id);
+        }
+        for (uint32_t iv : ivs) {
+            IRValue init = incomingFrom(fn.insts[iv], loop.preheader), next = incomingFrom(fn.insts[iv], latch);
+            if (init.kind == IRValue::Kind::None || next.kind != IRValue::Kind::Inst) continue;
+            uint32_t increment = next.inst;
+            const IRInst& inc = fn.insts[increment];
+            auto isIV = [&](const IRValue& v) { return v.kind == IRValue::Kind::Inst && v.inst == iv; };
+            auto isInt = [](const IRValue& v) { return v.kind == IRValue::Kind::Int; };
+            int64_t step;
+            if (inc.op == IROp::Add && isIV(inc.a) && isInt(inc.b)) step = inc.b.i;
+            else if (inc.op == IROp::Add && isInt(inc.a) && isIV(inc.b)) step = inc.a.i;
+            else if (inc.op == IROp::Sub && isIV(inc.a) && isInt(inc.b)) step = -static_cast<int64_t>(inc.b.i);
+            else continue;
+            if (!loop.contains[blockOf[increment]] || !cfg.dominates(blockOf[increment], latch)) continue;
+
+            std::vector<std::pair<uint32_t, int32_t>> products;
+            for (uint32_t b : loop.blocks) {
+                for (uint32_t id : fn.blocks[b].insts) {
+                    const IRInst& mul = fn.insts[id];
+                    if (mul.op != IROp::Mul || mul.dead) continue;
+                    if (isIV(mul.a) && isInt(mul.b)) products.push_back({id, mul.b.i});
+                    else if (isInt(mul.a) && isIV(mul.b)) products.push_back({id, mul.a.i});
+                }
+            }
+            std::unordered_map<int32_t, uint32_t> scaled;  // k -> phi standing for iv * k
+            for (auto [id, k] : products) {
+                auto it = scaled.find(k);
+                if (it == scaled.end()) {
+                    IRValue start;
+                    std::vector<uint32_t>& pre = fn.blocks[loop.preheader].insts;
+                    if (init.kind == IRValue::Kind::Int) {
+                        start = IRValue::ofInt(wrapToType(static_cast<int64_t>(init.i) * k, IRType::I32));
+                    } else {
+                        IRInst mul{IROp::Mul, IRType::I32};
+                        mul.a = init;
+                        mul.b = IRValue::ofInt(k);
+                        start = IRValue::ofInst(append(std::move(mul), loop.preheader));
+                        pre.insert(pre.end() - 1, start.inst);
+                    }
+                    uint32_t phiId = static_cast<uint32_t>(fn.insts.size());
+                    IRInst bump{IROp::Add, IRType::I32};
+                    bump.a = IRValue::ofInst(phiId);
+                    bump.b = IRValue::ofInt(wrapToType(step * k, IRType::I32));
+                    IRInst phi{IROp::Phi, IRType::I32};
+                    phi.incoming = {{loop.preheader, start}, {latch, IRValue::ofInst(phiId + 1)}};
+                    append(std::move(phi), loop.header);
+                    uint32_t bumpId = append(std::move(bump), blockOf[increment]);
+                    std::vector<uint32_t>& headerInsts = fn.blocks[loop.header].insts;
+                    headerInsts.insert(headerInsts.begin(), phiId);
+                    std::vector<uint32_t>& stepInsts = fn.blocks[blockOf[increment]].insts;
+                    stepInsts.insert(std::find(stepInsts.begin(), stepInsts.end(), increment) + 1, bumpId);
+                    it = scaled.emplace(k, phiId).first;
+                }
+                replaced[id] = IRValue::ofInst(it->second);
+                fn.insts[id].dead = true;
+                ++reduced;
+            }
+        }
+    }
+    replaced.resize(fn.insts.size());
+    resolveAll(fn, replaced);
+    return reduced;
+}
+
+// Keeps what feeds a return, a branch, a call or a store whose alloca is read somewhere,
+// marking backwards from those; everything else goes, including cycles of phis and
+// increments that nothing reads and allocas that are only ever stored to. Calls always
+// stay, since the callee might never return.
+uint32_t eliminateDeadCode(IRFunction& fn) {
+    std::vector<char> live(fn.insts.size(), 0), readable(fn.insts.size(), 0);
+    std::unordered_map<uint32_t, std::vector<uint32_t>> storesTo;
+    std::vector<uint32_t> worklist;
+    auto mark = [&](uint32_t id) {
+        if (live[id]) return;
+        live[id] = 1;
+        worklist.push_back(id);
+    };
+    for (uint32_t id = 0; id < fn.insts.size(); ++id) {
+        const IRInst& inst = fn.insts[id];
+        if (inst.dead) continue;
+        bool localStore = inst.op == IROp::Store && inst.b.kind == IRValue::Kind::Inst && fn.insts[inst.b.inst].op == IROp::Alloca;
+        if (localStore) storesTo[inst.b.inst].push_back(id);
+        else if (inst.op == IROp::Store || inst.op == IROp::Call || isTerminator(inst.op)) mark(id);
+    }
+    while (!worklist.empty()) {
+        const IRInst& inst = fn.insts[worklist.back()];
+        worklist.pop_back();
+        forEachOperand(inst, [&](const IRValue& v) {
+            if (v.kind != IRValue::Kind::Inst) return;
+            mark(v.inst);
+            bool address = inst.op == IROp::Store && &v == &inst.b;
+            if (address || readable[v.inst] || fn.insts[v.inst].op != IROp::Alloca) return;
+            readable[v.inst] = 1;
+            auto it = storesTo.find(v.inst);
+            if (it != storesTo.end()) {
+                for (uint32_t store : it->second) mark(store);
+            }
+        });
+    }
+
+    uint32_t removed = 0;
+    for (uint32_t id = 0; id < fn.insts.size(); ++id) {
+        if (fn.insts[id].dead || live[id]) continue;
+        fn.insts[id].dead = true;
+        ++removed;
+    }
+    return removed;
+}
+
+void compactBlocks(IRFunction& fn) {
+    for (IRBlock& block : fn.blocks) {
+        block.insts.erase(std::remove_if(block.insts.begin(), block.insts.end(),
+                                         [&](uint32_t id) { return fn.insts[id].dead; }),
+                          block.insts.end());
+    }
+}
+
+namespace {
+struct Pass {
+    const char* name;
+    const char* unit;
+    uint32_t (*run)(IRFunction&);
+    uint32_t (*runInModule)(const IRModule&, IRFunction&);  // for passes that look at other functions
+};
+
+const Pass kPipeline[] = {
+    {"mem2reg", "allocas promoted", promoteAllocas, nullptr},
+    {"inline", "calls inlined", nullptr, inlineCalls},
+    {"tailcall", "calls eliminated", eliminateTailCalls, nullptr},
+    {"rle", "loads removed", eliminateRedundantLoads, nullptr},
+    {"unroll", "loops unrolled", unrollLoops, nullptr},
+    {"constprop", "instructions folded", propagateConstants, nullptr},
+    {"simplifycfg", "blocks removed", simplifyCFG, nullptr},
+    {"licm", "instructions hoisted", hoistLoopInvariants, nullptr},
+    {"vectorize", "loops vectorized", vectorizeLoops, nullptr},
+    {"lsr", "multiplications reduced", reduceStrength, nullptr},
+    {"dce", "instructions removed", eliminateDeadCode, nullptr},
+};
+}
+
+std::vector<PassStats> optimizeFunction(IRModule& module, size_t index, bool vectorize) {
+    std::vector<PassStats> stats;
+    IRFunction& fn = module.functions[index];
+    for (const Pass& pass : kPipeline) {
+        auto start = std::chrono::steady_clock::now();
+        uint32_t count = 0;
+        if (vectorize || pass.run != vectorizeLoops) {
+            count = pass.run ? pass.run(fn) : pass.runInModule(module, fn);
+            compactBlocks(fn);
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        stats.push_back({pass.name, pass.unit, count, ms});
+    }
+    return stats;
+}
+
+std::vector<PassStats> optimizeModule(IRModule& module, bool vectorize) {
+    std::vector<PassStats> stats;
+    for (const Pass& pass : kPipeline) stats.push_back({pass.name, pass.unit, 0, 0.0});
+    for (size_t i = 0; i < module.functions.size(); ++i) {
+        std::vector<PassStats> one = optimizeFunction(module, i, vectorize);
+        for (size_t k = 0; k < stats.size(); ++k) {
+            stats[k].count += one[k].count;
+            stats[k].ms += one[k].ms;
+        }
+    }
+    return stats;
+}
+
+uint32_t countInstructions(const IRModule& module) {
+    uint32_t count = 0;
+    for (const IRFunction& fn : module.functions) {
+        for (const IRBlock& block : fn.blocks) {
+            for (uint32_t id : block.insts) count += fn.insts[id].dead ? 0 : 1;
+        }
+    }
+    return count;
+}
+
+std::string optimizeIR(const std::string& ir, OptimizeReport* report) {
+    auto start = std::chrono::steady_clock::now();
+    IRModule module;
+    std::string error;
+    if (!parseIR(ir, module, error)) return "; Optimized IR\n; optimizer skipped: " + error + "\n" + ir;
+    double parseMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::string out = optimizeIR(module, report);
+    if (report) report->parseMs = parseMs;
+    return out;
+}
+
+std::string optimizeIR(IRModule& module, OptimizeReport* report) {
+    if (report) report->instructionsBefore = countInstructions(module);
+    std::vector<PassStats> stats = optimizeModule(module);
+    std::string out = "; Optimized IR\n";
+    for (const PassStats& s : stats) {
+        out += "; " + std::string(s.pass) + ": " + std::to_string(s.count) + " " + s.unit + "\n";
+    }
+    if (report) {
+        report->instructionsAfter = countInstructions(module);
+        report->passes = std::move(stats);
+    }
+    return out + printIR(module);
+}
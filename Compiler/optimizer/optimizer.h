@@ -0,0 +1,41 @@
+// The optimizer: a fixed pipeline of passes over IR modules, run one function at a time.
+#pragma once
+
+#include "../ir/ir.h"
+
+#include <cstddef>
+
+// What one optimization pass did to a module: `count` things of kind `unit`.
+struct PassStats {
+    const char* pass;
+    const char* unit;
+    uint32_t count;
+    double ms;
+};
+
+struct OptimizeReport {
+    double parseMs = 0;
+    uint32_t instructionsBefore = 0;
+    uint32_t instructionsAfter = 0;
+    std::vector<PassStats> passes;
+};
+
+// mem2reg, inlining, tail-call elimination, redundant load elimination, full unrolling of
+// short constant-trip loops, constant propagation and branch folding, CFG simplification,
+// loop-invariant code motion, loop vectorization (skipped when `vectorize` is false),
+// induction-variable strength reduction and dead code elimination; returns one entry per
+// pass in pipeline order. Functions go through the whole pipeline one at a time in module
+// order, so a function is already optimized when the ones after it inline it.
+std::vector<PassStats> optimizeModule(IRModule& module, bool vectorize = true);
+// The pipeline for module.functions[index] alone; calls inline from the rest of `module`.
+std::vector<PassStats> optimizeFunction(IRModule& module, size_t index, bool vectorize = true);
+// Whether the inliner would copy `fn` into a caller that passes only constant arguments,
+// the most it can ever save; a function that fails this is never inlined anywhere.
+bool isInlineCandidate(const IRFunction& fn);
+uint32_t countInstructions(const IRModule& module);
+// Optimizes `module` in place and prints it with a header of per-pass counts.
+std::string optimizeIR(IRModule& module, OptimizeReport* report = nullptr);
+
+// `report`, if given, receives instruction counts and per-pass statistics; it is left
+// untouched when the IR does not parse and the text is returned unoptimized.
+std::string optimizeIR(const std::string& ir, OptimizeReport* report = nullptr);
@@ -0,0 +1,42 @@
+// What the optimizer's translation units share: the loop analysis, the helpers passes use
+// to rewrite a function, and the entry points of the passes kept in files of their own.
+// Not part of the optimizer's interface; only optimizer/*.cpp include it.
+#pragma once
+
+#include "../ir/ir.h"
+
+#include <string>
+#include <vector>
+
+// A natural loop: the header plus every block that reaches one of its back edges without
+// passing through it.
+struct IRLoop {
+    uint32_t header = 0;
+    std::vector<uint32_t> blocks;  // in reverse postorder, header first
+    std::vector<char> contains;    // by block
+    std::vector<uint32_t> latches;
+    uint32_t preheader = IRCFG::kNone;  // the one predecessor outside, if it jumps only to the header
+};
+
+// Loops sharing a header are one loop. Smaller loops come first, so inner loops are
+// handled before the loops around them.
+std::vector<IRLoop> findLoops(const IRFunction& fn, const IRCFG& cfg);
+// The block each instruction is listed in; IRCFG::kNone for one in no block.
+std::vector<uint32_t> blockOfInsts(const IRFunction& fn);
+
+// Follows replacements left by earlier rewrites until reaching a value that stands for itself.
+IRValue resolveValue(const std::vector<IRValue>& replaced, IRValue v);
+// Resolves every live instruction once a pass is done, for uses that come before the
+// replaced value in block order (phi operands on back edges).
+void resolveAll(IRFunction& fn, const std::vector<IRValue>& replaced);
+// A label not yet used in `fn`: `base`, then base1, base2, and so on.
+std::string freshLabel(const IRFunction& fn, const std::string& base);
+uint32_t eliminateDeadCode(IRFunction& fn);
+// Drops dead instructions from the block lists so later passes and the printer skip them.
+void compactBlocks(IRFunction& fn);
+
+// optimizer/inliner.cpp
+uint32_t inlineCalls(const IRModule& module, IRFunction& fn);
+uint32_t eliminateTailCalls(IRFunction& fn);
+// optimizer/vectorizer.cpp
+uint32_t vectorizeLoops(IRFunction& fn);
@@ -0,0 +1,306 @@
+#include "passes.h"
+#include <algorithm>
+#include <vector>
+
+// -------------------- Loop vectorization --------------------
+// Vectorizes a counted loop of two blocks, a header that only tests `i` against a constant
+// bound and a body ending in `i = i + 1`, when everything the body computes is a lane-wise
+// function of a[i] over arrays indexed by `i`. Such a loop touches a different element on
+// every trip, so doing VF trips at once in vector registers gives the same memory. i32
+// loops run four lanes and float loops eight. Integer sums into a header phi become a
+// vector of partial sums added up once after the loop; float sums are left alone, since
+// reassociating them changes the rounding. The vector loop runs the trips that fill whole
+// vectors and the original loop, entered with i at the first trip left over, serves as
+// the epilogue; when the trip count is a multiple of VF the original loop is deleted.
+bool vectorizeLoop(IRFunction& fn, const IRCFG& cfg, const IRLoop& loop) {
+    if (loop.preheader == IRCFG::kNone || loop.blocks.size() != 2 || loop.latches.size() != 1) return false;
+    uint32_t header = loop.header, body = loop.latches[0], pre = loop.preheader;
+    if (body == header || cfg.preds[body].size() != 1) return false;
+    std::vector<uint32_t> headerInsts = fn.blocks[header].insts;
+    const IRInst& exitBranch = fn.insts[headerInsts.back()];
+    if (exitBranch.op != IROp::CondBr || exitBranch.a.kind != IRValue::Kind::Inst) return false;
+    bool stayOnTrue = exitBranch.target[0] == body;
+    if (exitBranch.target[stayOnTrue ? 0 : 1] != body || exitBranch.target[stayOnTrue ? 1 : 0] == body) return false;
+    uint32_t exit = exitBranch.target[stayOnTrue ? 1 : 0];
+    if (headerInsts.size() < 2 || headerInsts[headerInsts.size() - 2] != exitBranch.a.inst) return false;
+    const IRInst& cmp = fn.insts[exitBranch.a.inst];
+    if (cmp.op != IROp::ICmp) return false;
+
+    std::vector<uint32_t> blockOf = blockOfInsts(fn);
+    std::vector<std::vector<uint32_t>> users(fn.insts.size());
+    for (const IRBlock& block : fn.blocks) {
+        for (uint32_t id : block.insts) {
+            forEachOperand(fn.insts[id], [&](const IRValue& v) {
+                if (v.kind == IRValue::Kind::Inst) users[v.inst].push_back(id);
+            });
+        }
+    }
+    auto inBody = [&](const IRValue& v) { return v.kind == IRValue::Kind::Inst && blockOf[v.inst] == body; };
+    auto isInst = [](const IRValue& v, uint32_t id) { return v.kind == IRValue::Kind::Inst && v.inst == id; };
+    auto isOne = [](const IRValue& v) { return v.kind == IRValue::Kind::Int && v.i == 1; };
+    if (users[exitBranch.a.inst].size() != 1) return false;
+
+    // The induction variable: a phi starting at a constant and stepped by one at the end of the body.
+    std::vector<uint32_t> phis(headerInsts.begin(), headerInsts.end() - 2);
+    uint32_t iv = IRCFG::kNone, increment = IRCFG::kNone;
+    for (uint32_t id : phis) {
+        const IRInst& phi = fn.insts[id];
+        if (phi.op != IROp::Phi || phi.incoming.size() != 2) return false;
+        IRValue init = incomingFrom(phi, pre), next = incomingFrom(phi, body);
+        if (iv != IRCFG::kNone || phi.type != IRType::I32 || init.kind != IRValue::Kind::Int || !inBody(next)) continue;
+        const IRInst& inc = fn.insts[next.inst];
+        if (inc.op == IROp::Add && ((isInst(inc.a, id) && isOne(inc.b)) || (isOne(inc.a) && isInst(inc.b, id)))) {
+            iv = id;
+            increment = next.inst;
+        }
+    }
+    if (iv == IRCFG::kNone || users[increment].size() != 1) return false;
+
+    // The trip count, from `i pred bound` with the loop staying on true.
+    IRPred pred = cmp.pred;
+    IRValue bound;
+    if (isInst(cmp.a, iv)) {
+        bound = cmp.b;
+    } else if (isInst(cmp.b, iv)) {
+        bound = cmp.a;
+        pred = pred == IRPred::SLT ? IRPred::SGT : pred == IRPred::SLE ? IRPred::SGE : pred == IRPred::SGT ? IRPred::SLT
+             : pred == IRPred::SGE ? IRPred::SLE : pred;
+    } else {
+        return false;
+    }
+    if (!stayOnTrue) {
+        pred = pred == IRPred::SGE ? IRPred::SLT : pred == IRPred::SGT ? IRPred::SLE : pred == IRPred::EQ ? IRPred::NE
+             : IRPred::EQ;  // anything left does not count up to a bound
+    }
+    if (bound.kind != IRValue::Kind::Int) return false;
+    int64_t start = incomingFrom(fn.insts[iv], pre).i, trips;
+    if (pred == IRPred::SLT) trips = bound.i - start;
+    else if (pred == IRPred::SLE && bound.i < INT32_MAX) trips = static_cast<int64_t>(bound.i) - start + 1;
+    else if (pred == IRPred::NE && bound.i >= start) trips = bound.i - start;
+    else return false;
+
+    // Sums: a phi whose only use is `s + x` or `s - x` in the body, which only the phi reads.
+    std::vector<uint32_t> sums, idle;
+    std::vector<char> isSum(fn.insts.size(), 0);
+    for (uint32_t id : phis) {
+        if (id == iv) continue;
+        const IRInst& phi = fn.insts[id];
+        std::vector<uint32_t> uses;
+        for (uint32_t user : users[id]) {
+            if (user != id && (blockOf[user] == header || blockOf[user] == body)) uses.push_back(user);
+        }
+        IRValue next = incomingFrom(phi, body);
+        if (users[id].empty() || (users[id].size() == 1 && users[id][0] == id)) {
+            idle.push_back(id);
+            continue;
+        }
+        if (phi.type != IRType::I32 || uses.size() != 1 || !isInst(next, uses[0]) || users[uses[0]].size() != 1) return false;
+        const IRInst& add = fn.insts[uses[0]];
+        bool sum = (add.op == IROp::Add && isInst(add.a, id) != isInst(add.b, id)) || (add.op == IROp::Sub && isInst(add.a, id) && !isInst(add.b, id));
+        if (!sum) return false;
+        sums.push_back(id);
+        isSum[id] = 1;
+    }
+
+    // Everything in the body must have a lane-wise vector form of a single element type.
+    IRType scalar = IRType::Void;
+    auto agree = [&](IRType type) {
+        if (scalar == IRType::Void) scalar = type;
+        return scalar == type && (type == IRType::I32 || type == IRType::Float);
+    };
+    auto lanewise = [&](const IRValue& v) {
+        if (v.kind == IRValue::Kind::Inst) return inBody(v) ? v.inst != increment : isSum[v.inst] || blockOf[v.inst] != header;
+        return v.isConstant() || v.kind == IRValue::Kind::Arg;
+    };
+    std::vector<uint32_t> bodyInsts = fn.blocks[body].insts;
+    for (size_t k = 0; k + 1 < bodyInsts.size(); ++k) {
+        uint32_t id = bodyInsts[k];
+        const IRInst& inst = fn.insts[id];
+        if (id == increment) continue;
+        bool ok;
+        switch (inst.op) {
+            case IROp::GEP: {
+                ok = isInst(inst.b, iv) && agree(inst.type);
+                for (uint32_t user : users[id]) {
+                    const IRInst& access = fn.insts[user];
+                    ok = ok && ((access.op == IROp::Load && isInst(access.a, id)) ||
+                                (access.op == IROp::Store && isInst(access.b, id) && !isInst(access.a, id)));
+                }
+                break;
+            }
+            case IROp::Load:
+                ok = inBody(inst.a) && fn.insts[inst.a.inst].op == IROp::GEP;
+                break;
+            case IROp::Store:
+                ok = inBody(inst.b) && fn.insts[inst.b.inst].op == IROp::GEP && lanewise(inst.a);
+                break;
+            case IROp::Add:
+            case IROp::Sub:
+            case IROp::Mul:
+            case IROp::FAdd:
+            case IROp::FSub:
+            case IROp::FMul:
+            case IROp::FDiv:
+                ok = agree(inst.type) && lanewise(inst.a) && lanewise(inst.b);
+                break;
+            default:
+                ok = false;
+                break;
+        }
+        if (!ok) return false;
+    }
+    IRType vector = scalar == IRType::Float ? IRType::V8Float : IRType::V4I32;
+    uint32_t lanes = laneCount(vector);
+    if (scalar == IRType::Void || trips < lanes) return false;
+    int32_t vectorEnd = static_cast<int32_t>(start + trips / lanes * lanes);
+    bool epilogue = trips % lanes != 0;
+
+    // The vector loop goes between the preheader and the original header.
+    uint32_t cond = static_cast<uint32_t>(fn.blocks.size()), vbody = cond + 1, middle = cond + 2;
+    fn.blocks.push_back({freshLabel(fn, "vector.cond"), {}});
+    fn.blocks.push_back({freshLabel(fn, "vector.body"), {}});
+    fn.blocks.push_back({freshLabel(fn, "middle.block"), {}});
+    auto append = [&](IRInst inst, uint32_t block) {
+        uint32_t id = static_cast<uint32_t>(fn.insts.size());
+        fn.insts.push_back(std::move(inst));
+        fn.blocks[block].insts.push_back(id);
+        return IRValue::ofInst(id);
+    };
+    auto branch = [](uint32_t target) {
+        IRInst br{IROp::Br, IRType::Void};
+        br.target[0] = target;
+        return br;
+    };
+    std::vector<uint32_t>& preInsts = fn.blocks[pre].insts;
+    uint32_t preBranch = preInsts.back();
+    preInsts.pop_back();
+
+    uint32_t vi = static_cast<uint32_t>(fn.insts.size());
+    IRInst viPhi{IROp::Phi, IRType::I32};
+    viPhi.incoming = {{pre, IRValue::ofInt(static_cast<int32_t>(start))}, {vbody, IRValue()}};
+    append(std::move(viPhi), cond);
+    std::vector<IRValue> mapped(fn.insts.size());
+    for (uint32_t sum : sums) {
+        IRInst acc{IROp::Phi, IRType::V4I32};
+        acc.incoming = {{pre, IRValue::ofInt(0)}};
+        mapped[sum] = append(std::move(acc), cond);
+    }
+    IRInst test{IROp::ICmp, IRType::I32, IRPred::SLT};
+    test.a = IRValue::ofInst(vi);
+    test.b = IRValue::ofInt(vectorEnd);
+    IRInst condBr{IROp::CondBr, IRType::Void};
+    condBr.a = append(std::move(test), cond);
+    condBr.target[0] = vbody;
+    condBr.target[1] = middle;
+    append(std::move(condBr), cond);
+
+    // Invariants and constants other than zero are splatted in the preheader, so the loop
+    // keeps them in registers instead of building them on every trip.
+    std::vector<std::pair<IRValue, IRValue>> splats;  // scalar, vector
+    auto operand = [&](const IRValue& v) {
+        if (v.kind == IRValue::Kind::Inst && mapped[v.inst].kind != IRValue::Kind::None) return mapped[v.inst];
+        bool zero = (v.kind == IRValue::Kind::Int && v.i == 0) || (v.kind == IRValue::Kind::Float && sameValue(v, IRValue::ofFloat(0.0f)));
+        if (zero || v.kind == IRValue::Kind::Undef || v.kind == IRValue::Kind::None) return v;
+        for (const auto& [scalar, splat] : splats) {
+            if (sameValue(scalar, v)) return splat;
+        }
+        IRInst insert{IROp::InsertElement, vector};
+        insert.a = IRValue::undef();
+        insert.b = v;
+        IRInst shuffle{IROp::ShuffleVector, vector};
+        shuffle.a = append(std::move(insert), pre);
+        splats.push_back({v, append(std::move(shuffle), pre)});
+        return splats.back().second;
+    };
+    for (size_t k = 0; k + 1 < bodyInsts.size(); ++k) {
+        uint32_t id = bodyInsts[k];
+        if (id == increment) continue;
+        IRInst inst = fn.insts[id];
+        if (inst.op == IROp::GEP) {
+            inst.b = IRValue::ofInst(vi);
+            IRInst cast{IROp::Bitcast, vector};
+            cast.a = append(std::move(inst), vbody);
+            mapped[id] = append(std::move(cast), vbody);
+            continue;
+        }
+        inst.type = vector;
+        inst.a = operand(inst.a);
+        inst.b = operand(inst.b);
+        mapped[id] = append(std::move(inst), vbody);
+    }
+    IRInst step{IROp::Add, IRType::I32};
+    step.a = IRValue::ofInst(vi);
+    step.b = IRValue::ofInt(static_cast<int32_t>(lanes));
+    IRValue viNext = append(std::move(step), vbody);
+    append(branch(cond), vbody);
+    fn.insts[vi].incoming[1].value = viNext;
+
+    std::vector<IRValue> replaced(fn.insts.size());
+    replaced[iv] = IRValue::ofInt(vectorEnd);
+    for (uint32_t sum : sums) {
+        uint32_t add = incomingFrom(fn.insts[sum], body).inst;
+        fn.insts[mapped[sum].inst].incoming.push_back({vbody, mapped[add]});
+        IRInst reduce{IROp::ReduceAdd, IRType::I32};
+        reduce.a = mapped[sum];
+        IRInst total{IROp::Add, IRType::I32};
+        total.a = incomingFrom(fn.insts[sum], pre);
+        total.b = append(std::move(reduce), middle);
+        bool fromZero = total.a.kind == IRValue::Kind::Int && total.a.i == 0;
+        replaced[sum] = fromZero ? total.b : append(std::move(total), middle);
+    }
+    for (uint32_t id : idle) replaced[id] = IRValue::undef();
+    append(branch(epilogue ? header : exit), middle);
+    fn.insts[preBranch].target[0] = cond;
+    preInsts.push_back(preBranch);
+
+    if (epilogue) {
+        // The original loop picks up where the vector loop stopped.
+        for (uint32_t id : phis) {
+            for (IRIncoming& in : fn.insts[id].incoming) {
+                if (in.block == pre) in = {middle, replaced[id]};
+            }
+        }
+    } else {
+        for (uint32_t b : {header, body}) {
+            for (uint32_t id : fn.blocks[b].insts) fn.insts[id].dead = true;
+            fn.blocks[b].insts.clear();
+        }
+        for (uint32_t id : fn.blocks[exit].insts) {
+            for (IRIncoming& in : fn.insts[id].incoming) {
+                if (in.block == header) in.block = middle;
+            }
+        }
+        replaced.resize(fn.insts.size());
+        resolveAll(fn, replaced);
+    }
+
+    std::vector<uint32_t> order;
+    for (uint32_t b = 0; b < cond; ++b) {
+        if (b == header) order.insert(order.end(), {cond, vbody, middle});
+        order.push_back(b);
+    }
+    reorderBlocks(fn, order);
+    return true;
+}
+
+
+// Loops are found again after each one vectorized, since the vector loop changes the CFG.
+// Dead code goes first: mem2reg leaves header phis for variables declared inside a loop,
+// and those would otherwise look like values carried out of it.
+uint32_t vectorizeLoops(IRFunction& fn) {
+    if (fn.blocks.size() == 1) return 0;
+    if (eliminateDeadCode(fn) != 0) compactBlocks(fn);
+    uint32_t vectorized = 0;
+    for (bool progress = true; progress;) {
+        IRCFG cfg(fn);
+        progress = false;
+        for (const IRLoop& loop : findLoops(fn, cfg)) {
+            if (vectorizeLoop(fn, cfg, loop)) {
+                ++vectorized;
+                progress = true;
+                break;
+            }
+        }
+    }
+    return vectorized;
+}
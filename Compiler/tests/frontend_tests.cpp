@@ -0,0 +1,405 @@
+// Regression tests for the front end, run through Compilation as the web page and minicc
+// use it. Each test is a function in kTests; a failed CHECK prints the expression and the
+// compiler output it was about and marks the test failed, and the others still run.
+//
+//   npm test
+//   ./tests/frontend_tests parser_
+#include "../frontend/web_driver.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace {
+
+bool failed = false;
+
+#define CHECK(cond, context)                                                               \
+    do {                                                                                   \
+        if (!(cond)) {                                                                     \
+            std::fprintf(stderr, "  %s:%d: CHECK(%s) failed\n%s\n", __FILE__, __LINE__, #cond, \
+                         std::string(context).c_str());                                    \
+            failed = true;                                                                 \
+        }                                                                                  \
+    } while (0)
+
+bool contains(const std::string& text, const std::string& part) { return text.find(part) != std::string::npos; }
+
+// -------------------- Parser --------------------
+
+void parser_top_level_initialized_declaration() {
+    Compilation c("int g = 5;\nint main() { return 0; }\n");
+    const std::string& ast = c.astDump();
+    CHECK(!contains(c.diagnosticsText(), "Expected ';'"), c.diagnosticsText());
+    CHECK(contains(ast, "• VarDecl\n    • Type: int\n    • Name: g\n    • Literal: 5\n"), ast);
+}
+
+void parser_top_level_declaration_kinds() {
+    Compilation c("float f = 1.5;\nchar k;\nint a[4];\n");
+    const std::string& ast = c.astDump();
+    CHECK(contains(ast, "• Name: f\n    • Literal: 1.5\n"), ast);
+    CHECK(contains(ast, "• Type: char\n    • Name: k\n"), ast);
+    CHECK(contains(ast, "• ArrayDecl\n"), ast);
+}
+
+void parser_top_level_declaration_errors() {
+    Compilation missingName("int = 5;\nint main() { return 0; }\n");
+    CHECK(contains(missingName.diagnosticsText(), "Expected variable name after 'int'."), missingName.diagnosticsText());
+    Compilation missingSemicolon("int g = 5 int main() { return 0; }\n");
+    CHECK(contains(missingSemicolon.diagnosticsText(), "Expected ';' but got 'int'"), missingSemicolon.diagnosticsText());
+}
+
+void parser_reports_malformed_input() {
+    struct {
+        const char* src;
+        const char* diagnostic;
+    } kCases[] = {
+        {"int main() { return 1;", "Expected '}' but got end of input"},
+        {"int main() return 1;", "Expected '{' but got 'return'"},
+        {"int main() { int 5; return 1; }", "Expected variable name after 'int'."},
+        {"int main() { return 1 }", "Expected ';' but got '}'"},
+        {"int main() { 5; ) ] return 1; }", "Expected a statement but got '5'"},
+        {"int main() { 5; ) ] return 1; }", "Expected a statement but got ')'"},
+        {"int main() { return 1; } )))", "Expected a declaration or function but got ')'"},
+        {"int main() { int x = 5 return x; }", "Expected ';' but got 'return'"},
+        {"int main() { int x = ; return 1; }", "Expected an expression after 'x ='."},
+        {"int main() { x x; return 1; }", "Expected '=' after identifier."},
+        {"int f(int a, float) { return a; }", "Expected a parameter type and name in 'f'."},
+    };
+    for (const auto& c : kCases) {
+        Compilation compilation(c.src);
+        const std::string& diagnostics = compilation.diagnosticsText();
+        CHECK(contains(diagnostics, c.diagnostic), c.src + ("\n" + diagnostics));
+    }
+
+    // A declaration missing only its ';' is kept, so its uses are not reported on top of it.
+    Compilation missingSemicolon("int main() { int x = 5 return x; }");
+    CHECK(!contains(missingSemicolon.diagnosticsText(), "Undeclared variable"), missingSemicolon.diagnosticsText());
+    // A run of stray tokens draws one diagnostic, and empty statements none.
+    Compilation strays("int main() { ;; return 1; ) ] ) }\n) ] }");
+    CHECK(strays.diagnostics().size() == 2, strays.diagnosticsText());
+    // A malformed parameter list is reported once and the body still parsed.
+    Compilation header("int f(int a, float) { return b; }\nint main() { return f(1); }");
+    CHECK(!contains(header.diagnosticsText(), "Expected ')'"), header.diagnosticsText());
+    CHECK(contains(header.diagnosticsText(), "Undeclared variable: b"), header.diagnosticsText());
+}
+
+// -------------------- Incremental editing --------------------
+
+// Every artifact after a sequence of edits matches a fresh Compilation of the edited text,
+// with edits on both sides of the last one, inserts big enough to grow the buffers, and
+// fragments that open and close comments and character literals.
+void edits_match_fresh_compilation() {
+    const char* kFragments[] = {"", "1", "x", " ", "\n", ";", "}", "{", "/*", "*/", "//", "'", "'a'",
+                                "int y = 2;\n", "return 0; }\nint g(int q) { ", "(", ")", "==", "7.5"};
+    std::string base;
+    for (int i = 0; i < 40; ++i) {
+        base += "int f" + std::to_string(i) + "(int a) { int b = a * " + std::to_string(i) +
+                "; /* note */ if (b > 3) { return b; } return a - 1; }\n";
+    }
+    base += "int main() { return f3(2); }\n";
+
+    uint32_t seed = 12345;
+    auto random = [&](size_t bound) {
+        seed = seed * 1103515245u + 12345u;
+        return bound ? (seed >> 8) % bound : 0;
+    };
+    for (int session = 0; session < 3; ++session) {
+        Compilation c(base);
+        std::string text = base;
+        if (session == 1) c.tokens();
+        if (session == 2) c.ast();
+        for (int step = 0; step < 150; ++step) {
+            size_t offset = random(text.size() + 1);
+            size_t removed = random(std::min<size_t>(text.size() - offset, 12) + 1);
+            std::string inserted = kFragments[random(sizeof(kFragments) / sizeof(kFragments[0]))];
+            if (random(20) == 0) inserted = std::string(base, 0, random(base.size()));
+            CHECK(c.applyEdit(offset, removed, inserted), "edit out of range");
+            text.replace(offset, removed, inserted);
+            if (step % 3 != 2 && session != 0) continue;
+
+            Compilation fresh(text);
+            std::string where = "session " + std::to_string(session) + " step " + std::to_string(step);
+            CHECK(c.text() == text, where);
+            CHECK(c.tokenDump() == fresh.tokenDump(), where);
+            bool offsetsMatch = c.tokens().size() == fresh.tokens().size();
+            for (size_t i = 0; offsetsMatch && i < c.tokens().size(); ++i) {
+                offsetsMatch = c.tokens()[i].offset == fresh.tokens()[i].offset;
+            }
+            CHECK(offsetsMatch, where);
+            CHECK(c.astDump() == fresh.astDump(), where);
+            CHECK(c.diagnosticsText() == fresh.diagnosticsText(), where);
+        }
+    }
+    Compilation c("int main() { return 0; }\n");
+    CHECK(!c.applyEdit(26, 0, "x"), "edit past the end accepted");
+    CHECK(!c.applyEdit(20, 7, ""), "removal past the end accepted");
+}
+
+// -------------------- Semantic analysis --------------------
+
+void sema_rejects_file_scope_variables() {
+    const char* kPrograms[] = {
+        "int g;\nint main() { return g + 1; }\n",
+        "int g = 5;\nint main() { return g; }\n",
+        "int a[4];\nint main() { return a[0]; }\n",
+    };
+    for (const char* src : kPrograms) {
+        Compilation c(src);
+        const std::string& diagnostics = c.diagnosticsText();
+        CHECK(contains(diagnostics, "is not supported; declare it inside a function."), src + diagnostics);
+        // Declared anyway, so the uses are not reported on top of it.
+        CHECK(!contains(diagnostics, "Undeclared variable"), src + diagnostics);
+    }
+}
+
+void sema_accepts_function_scope_variables() {
+    Compilation c("int f(int p) { return p; }\nint main() { int g = 5; int a[4]; a[0] = g; return f(a[0] + 1); }\n");
+    CHECK(c.diagnostics().empty(), c.diagnosticsText());
+    CHECK(!contains(c.ir(), "undef"), c.ir());
+}
+
+// -------------------- IR --------------------
+
+void ir_decoder_rejects_missing_operands() {
+    Compilation c("int main() { int s = 0; int i; for (i = 0; i < 10; i = i + 1) { s = s + i; } return s; }\n");
+    IRModule module = c.irModule();
+    bool cleared = false;
+    for (IRInst& inst : module.functions[0].insts) {
+        if (inst.op == IROp::Store && !cleared) {
+            inst.a = IRValue();  // `store i32 , i32* %s`
+            cleared = true;
+        }
+    }
+    IRModule decoded;
+    std::string error;
+    CHECK(!deserializeIR(serializeIR(module), decoded, error) && contains(error, "malformed store"), error);
+}
+
+// parseIR and deserializeIR both refuse what the passes cannot handle: a phi missing the
+// value of a predecessor, and a value defined in code that does not reach its use.
+void ir_rejects_broken_ssa() {
+    const char* kModules[] = {
+        "define i32 @main() {\nentry:\n  br label %loop\nloop:\n  %i = phi i32 [ 0, %entry ]\n"
+        "  %0 = icmp slt i32 %i, 3\n  br i1 %0, label %loop, label %done\ndone:\n  ret i32 %i\n}\n",
+        "define i32 @main() {\nentry:\n  br label %join\ndead:\n  %0 = add i32 1, 2\n  br label %join\n"
+        "join:\n  %1 = phi i32 [ 0, %entry ], [ %0, %dead ]\n  %2 = add i32 %0, %1\n  ret i32 %2\n}\n",
+    };
+    for (const char* text : kModules) {
+        IRModule module;
+        std::string error;
+        CHECK(!parseIR(text, module, error), text);
+        CHECK(contains(error, "phi without a value") || contains(error, "definition does not reach"), error);
+    }
+}
+
+// Every byte of a few encoded modules, overwritten with values that hit the opcode, type,
+// operand-kind and varint bits. Whatever the decoder accepts has to survive the optimizer,
+// the x86 lowering and the bytecode compiler; the sanitizer build turns a bad read into a
+// failure here.
+void ir_decoder_survives_mutation() {
+    const char* kPrograms[] = {
+        "int main() { int s = 0; int i; for (i = 0; i < 100; i = i + 1) { s = s + i; if (s > 100000) { return 7; } } return s; }\n",
+        "int fib(int n) { if (n < 2) { return n; } return fib(n - 1) + fib(n - 2); }\nint main() { return fib(10); }\n",
+        "int main() { int a[16]; float f[16]; int i; int s = 0; for (i = 0; i < 16; i = i + 1) { a[i] = i * 3; f[i] = 0.5; }\n"
+        "  for (i = 0; i < 16; i = i + 1) { s = s + a[i]; } return s; }\n",
+    };
+    size_t accepted = 0;
+    for (const char* src : kPrograms) {
+        Compilation c(src);
+        for (const std::string& encoded : {c.irBinary(), serializeIR(c.optimizedModule())}) {
+            for (size_t at = 5; at < encoded.size(); ++at) {
+                uint8_t original = static_cast<uint8_t>(encoded[at]);
+                for (uint8_t value : {0, 1, 2, 4, 0x7f, 0x80, original ^ 1, original + 1, original - 1}) {
+                    if (value == original) continue;
+                    std::string mutated = encoded;
+                    mutated[at] = static_cast<char>(value);
+                    IRModule module;
+                    std::string error;
+                    if (!deserializeIR(mutated, module, error)) continue;
+                    ++accepted;
+                    IRModule optimized = module;
+                    optimizeIR(optimized);
+                    lowerToX86(module);
+                    lowerToX86(optimized);
+                    compileBytecode(module);
+                    compileBytecode(optimized);
+                }
+            }
+        }
+    }
+    CHECK(accepted > 0, "no mutation decoded");
+}
+
+// -------------------- Bytecode VM --------------------
+
+// Expected values are what the same programs return when compiled with gcc.
+void vm_matches_gcc_and_jit() {
+    const struct {
+        const char* src;
+        int32_t expected;
+    } kPrograms[] = {
+        {"int main() { int s = 0; int i; for (i = 0; i < 100; i = i + 1) { s = s + i; if (s > 100000) { return 7; } } return s; }\n",
+         4950},
+        {"int classify(int x) { if (x < 0) { return 0 - 1; } else if (x == 0) { return 0; } else if (x > 100) { return 2; } return 1; }\n"
+         "int main() { int r = 0; int i; for (i = 0 - 5; i < 200; i = i + 7) { r = r * 3 + classify(i); } return r; }\n",
+         1602404082},
+        {"int fib(int n) { if (n < 2) { return n; } return fib(n - 1) + fib(n - 2); }\n"
+         "int gcd(int a, int b) { if (b == 0) { return a; } return gcd(b, a - a / b * b); }\n"
+         "int main() { return fib(20) + gcd(1071, 462); }\n",
+         6786},
+        {"int main() {\n"
+         "    int a[8]; int i; int j;\n"
+         "    a[0] = 5; a[1] = 0 - 3; a[2] = 9; a[3] = 0; a[4] = 12; a[5] = 0 - 7; a[6] = 4; a[7] = 1;\n"
+         "    for (i = 0; i < 8; i = i + 1) {\n"
+         "        for (j = 0; j + 1 < 8 - i; j = j + 1) {\n"
+         "            if (a[j] > a[j + 1]) { int t = a[j]; a[j] = a[j + 1]; a[j + 1] = t; }\n"
+         "        }\n"
+         "    }\n"
+         "    int r = 0;\n"
+         "    for (i = 0; i < 8; i = i + 1) { r = r * 5 + a[i]; }\n"
+         "    return r;\n"
+         "}\n",
+         -592443},
+        {"int main() {\n"
+         "    float x = 0.5; float s = 0.0; int i; int r = 0;\n"
+         "    for (i = 0; i < 20; i = i + 1) { x = x * 1.5; s = s + x / 4.0; if (s > 100.0) { r = r + 1; } }\n"
+         "    if (x > 1000.0) { r = r + 1000; }\n"
+         "    return r;\n"
+         "}\n",
+         1007},
+        // Swapped in the loop, so the phi copies on the back edge read each other.
+        {"int main() { int a = 1; int b = 2; int i; for (i = 0; i < 10; i = i + 1) { int t = a; a = b; b = t + b * 2; } return a - b; }\n",
+         -8119},
+    };
+    for (const auto& program : kPrograms) {
+        Compilation c(program.src);
+        CHECK(c.diagnostics().empty(), c.diagnosticsText());
+        VMResult run = runBytecode(c.bytecode());
+        CHECK(run.ok && run.value == program.expected, program.src + run.error + std::to_string(run.value));
+        VMResult unoptimized = execute(c.irModule());
+        CHECK(unoptimized.ok && unoptimized.value == program.expected, program.src + unoptimized.error);
+        if (jitAvailable()) {
+            JITResult jit = runJIT(c.optimizedModule());
+            CHECK(jit.ok && jit.value == run.value, program.src + jit.error);
+        }
+    }
+}
+
+void vm_runs_vectorized_loops() {
+    Compilation c(
+        "int main() {\n"
+        "    int a[64]; int b[64]; float f[64]; int i; int s = 0; float fs = 0.0;\n"
+        "    for (i = 0; i < 64; i = i + 1) { b[i] = i * 3 - 50; f[i] = 0.25; }\n"
+        "    for (i = 0; i < 64; i = i + 1) { a[i] = b[i] * 7 + 2; }\n"
+        "    for (i = 0; i < 64; i = i + 1) { f[i] = f[i] * 2.0 + 1.0; }\n"
+        "    for (i = 0; i < 64; i = i + 1) { s = s + a[i]; }\n"
+        "    for (i = 0; i < 64; i = i + 1) { fs = fs + f[i]; }\n"
+        "    if (fs > 95.0) { s = s + 1; }\n"
+        "    return s;\n"
+        "}\n");
+    CHECK(contains(c.optimizedIR(), "<4 x i32>") && contains(c.optimizedIR(), "<8 x float>"), c.optimizedIR());
+    VMResult run = runBytecode(c.bytecode());
+    CHECK(run.ok && run.value == 20065, run.error + std::to_string(run.value));
+    if (jitAvailable()) {
+        JITResult jit = runJIT(c.optimizedModule());
+        CHECK(jit.ok && jit.value == run.value, jit.error);
+    }
+}
+
+// Char literals are ints to sema, so Mini-C cannot reach i8 arithmetic; this is IR: 100 + 50
+// wraps to -106, times 3 to -62, and the i1 sum 1 + 1 to 0.
+void vm_wraps_i8_and_i1() {
+    IRModule module;
+    std::string error;
+    bool parsed = parseIR("define i32 @main() {\n"
+                          "entry:\n"
+                          "  %0 = add i8 100, 50\n"
+                          "  %1 = mul i8 %0, 3\n"
+                          "  %2 = icmp eq i8 %1, -62\n"
+                          "  %3 = icmp slt i8 %0, 0\n"
+                          "  %4 = add i1 %2, %3\n"
+                          "  %5 = zext i1 %4 to i32\n"
+                          "  %6 = zext i1 %2 to i32\n"
+                          "  %7 = mul i32 %6, 10\n"
+                          "  %8 = add i32 %7, %5\n"
+                          "  ret i32 %8\n"
+                          "}\n",
+                          module, error);
+    CHECK(parsed, error);
+    VMResult run = execute(module);
+    CHECK(run.ok && run.value == 10, run.error + std::to_string(run.value));
+    // Checked against constant folding (wrapToType) rather than the JIT: the front end never
+    // does arithmetic on i1, and the x86 backend does not wrap it.
+    optimizeIR(module);
+    CHECK(contains(printIR(module), "ret i32 10"), printIR(module));
+}
+
+void vm_reports_runtime_errors() {
+    Compilation outOfBounds("int main() { int a[4]; int i; int s = 0; for (i = 0; i < 6; i = i + 1) { a[i] = i; s = s + a[i]; } return s; }\n");
+    VMResult run = runBytecode(outOfBounds.bytecode());
+    CHECK(!run.ok && contains(run.error, "index 4 is outside an array of 4"), run.error);
+
+    Compilation deep("int g(int x) { if (x > 5) { return x - 1; } return x + 1; }\n"
+                     "int f(int n) { if (n == 0) { return 0; } return g(f(n - 1)); }\n"
+                     "int main() { return f(100000000); }\n");
+    run = runBytecode(deep.bytecode());
+    CHECK(!run.ok && contains(run.error, "ran out of stack"), run.error);
+
+    IRModule noMain;
+    std::string error;
+    CHECK(parseIR("define i32 @f() {\nentry:\n  ret i32 1\n}\n", noMain, error), error);
+    Bytecode program = compileBytecode(noMain);
+    CHECK(program.code.empty() && contains(program.error, "@main"), program.error);
+    CHECK(!runBytecode(program).ok, "");
+}
+
+// Whichever runs it, JIT or VM, the program is run rather than a `ret i32` read off it.
+void vm_backs_run_codegen() {
+    Compilation c("int main() { int s = 0; int i; for (i = 0; i < 100; i = i + 1) { s = s + i; if (s > 100000) { return 7; } } return s; }\n");
+    CHECK(contains(c.executionResult(), "Execution result: 4950\n"), c.executionResult());
+    std::string text = runCodegen(printIR(c.optimizedModule()));
+    CHECK(contains(text, "Execution result: 4950\n"), text);
+    text = runCodegen("define i32 @main() {\nentry:\n  ret i32 3\n  ret i32 4\n");
+    CHECK(contains(text, "Execution error:") && !contains(text, "result"), text);
+}
+
+struct Test {
+    const char* name;
+    void (*run)();
+};
+
+const Test kTests[] = {
+    {"parser_top_level_initialized_declaration", parser_top_level_initialized_declaration},
+    {"parser_top_level_declaration_kinds", parser_top_level_declaration_kinds},
+    {"parser_top_level_declaration_errors", parser_top_level_declaration_errors},
+    {"parser_reports_malformed_input", parser_reports_malformed_input},
+    {"edits_match_fresh_compilation", edits_match_fresh_compilation},
+    {"sema_rejects_file_scope_variables", sema_rejects_file_scope_variables},
+    {"sema_accepts_function_scope_variables", sema_accepts_function_scope_variables},
+    {"ir_decoder_rejects_missing_operands", ir_decoder_rejects_missing_operands},
+    {"ir_rejects_broken_ssa", ir_rejects_broken_ssa},
+    {"ir_decoder_survives_mutation", ir_decoder_survives_mutation},
+    {"vm_matches_gcc_and_jit", vm_matches_gcc_and_jit},
+    {"vm_runs_vectorized_loops", vm_runs_vectorized_loops},
+    {"vm_wraps_i8_and_i1", vm_wraps_i8_and_i1},
+    {"vm_reports_runtime_errors", vm_reports_runtime_errors},
+    {"vm_backs_run_codegen", vm_backs_run_codegen},
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    std::string filter = argc > 1 ? argv[1] : "";
+    int run = 0, failures = 0;
+    for (const Test& test : kTests) {
+        if (std::string(test.name).compare(0, filter.size(), filter) != 0) continue;
+        failed = false;
+        test.run();
+        ++run;
+        failures += failed;
+        std::printf("%s %s\n", failed ? "FAIL" : "ok  ", test.name);
+    }
+    std::printf("%d of %d tests passed\n", run - failures, run);
+    return failures ? 1 : 0;
+}
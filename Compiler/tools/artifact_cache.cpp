@@ -0,0 +1,160 @@
+#include "artifact_cache.h"
+
+#include "sha256.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <system_error>
+#include <vector>
+
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// The npm build scripts pass MINICC_COMPILER_ID, a hash of the compiler sources, so
+// every tool built from the same sources shares entries. Otherwise the running executable
+// is hashed. Either way, changing the compiler starts a fresh key space instead of
+// replaying stale output.
+const std::string& compilerIdentity() {
+    static const std::string identity = [] {
+#ifdef MINICC_COMPILER_ID
+        return std::string(MINICC_COMPILER_ID);
+#else
+        std::ifstream exe("/proc/self/exe", std::ios::binary);
+        if (!exe) return std::string("minicc-" __DATE__ " " __TIME__);
+        Sha256 hash;
+        char buffer[64 * 1024];
+        while (exe.read(buffer, sizeof buffer) || exe.gcount() > 0) {
+            hash.update(std::string_view(buffer, static_cast<size_t>(exe.gcount())));
+        }
+        return hash.hex();
+#endif
+    }();
+    return identity;
+}
+
+}  // namespace
+
+ArtifactCache::ArtifactCache(std::string directory, uint64_t maxBytes)
+    : dir(std::move(directory)), maxBytes(maxBytes) {
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+    ok = !ec && fs::is_directory(dir, ec);
+    if (!ok) return;
+
+    uint64_t total = 0;
+    for (auto it = fs::recursive_directory_iterator(dir, ec); !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+        if (it->is_regular_file(ec)) total += it->file_size(ec);
+    }
+    totalBytes = total;
+}
+
+std::string ArtifactCache::keyFor(std::string_view input) {
+    Sha256 hash;
+    hash.update(compilerIdentity());
+    hash.update(std::string_view("\0", 1));
+    hash.update(input);
+    return hash.hex();
+}
+
+std::string ArtifactCache::pathFor(const std::string& key, const char* artifact) const {
+    return dir + "/" + key.substr(0, 2) + "/" + key + "." + artifact;
+}
+
+bool ArtifactCache::load(const std::string& key, const char* artifact, std::string& out) {
+    if (!ok) {
+        ++misses;
+        return false;
+    }
+    std::string path = pathFor(key, artifact);
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        ++misses;
+        return false;
+    }
+    std::ostringstream buffer;
+    buffer << in.rdbuf();
+    out = buffer.str();
+    std::error_code ec;
+    fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+    ++hits;
+    return true;
+}
+
+void ArtifactCache::store(const std::string& key, const char* artifact, std::string_view data) {
+    if (!ok || data.size() > maxBytes) return;
+    std::string path = pathFor(key, artifact);
+    std::error_code ec;
+    fs::create_directories(fs::path(path).parent_path(), ec);
+    if (ec) return;
+
+    std::string temp = path + ".tmp." + std::to_string(::getpid()) + "." + std::to_string(tempCounter.fetch_add(1));
+    {
+        std::ofstream out(temp, std::ios::binary);
+        out.write(data.data(), static_cast<std::streamsize>(data.size()));
+        if (!out) {
+            fs::remove(temp, ec);
+            return;
+        }
+    }
+    fs::rename(temp, path, ec);
+    if (ec) {
+        fs::remove(temp, ec);
+        return;
+    }
+    ++stores;
+    if (totalBytes.fetch_add(data.size()) + data.size() > maxBytes) evict();
+}
+
+// Rescans the directory, which also picks up what other processes have added, and deletes
+// the oldest files until the total is under 90% of the cap.
+void ArtifactCache::evict() {
+    std::lock_guard<std::mutex> lock(sizeMutex);
+    struct Entry {
+        fs::file_time_type used;
+        uint64_t size;
+        fs::path path;
+    };
+    std::vector<Entry> entries;
+    uint64_t total = 0;
+    std::error_code ec;
+    for (auto it = fs::recursive_directory_iterator(dir, ec); !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+        std::error_code fileEc;
+        if (!it->is_regular_file(fileEc)) continue;
+        Entry entry{it->last_write_time(fileEc), it->file_size(fileEc), it->path()};
+        if (fileEc) continue;
+        total += entry.size;
+        entries.push_back(std::move(entry));
+    }
+    if (total <= maxBytes) {
+        totalBytes = total;
+        return;
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.used < b.used; });
+    uint64_t target = maxBytes / 10 * 9;
+    for (const Entry& entry : entries) {
+        if (total <= target) break;
+        std::error_code removeEc;
+        if (fs::remove(entry.path, removeEc)) {
+            total -= entry.size;
+            ++evictions;
+        }
+    }
+    totalBytes = total;
+}
+
+ArtifactCache::Stats ArtifactCache::stats() const {
+    return {hits.load(), misses.load(), stores.load(), evictions.load(), totalBytes.load()};
+}
+
+std::string ArtifactCache::statsText() const {
+    Stats s = stats();
+    return "cache: " + std::to_string(s.hits) + " hits, " + std::to_string(s.misses) + " misses, " +
+           std::to_string(s.stores) + " stores, " + std::to_string(s.evictions) + " evictions, " +
+           std::to_string(s.bytes) + " bytes";
+}
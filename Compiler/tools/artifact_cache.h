@@ -0,0 +1,60 @@
+// Persistent content-addressed store for compiler outputs, shared by the native tools.
+//
+// An entry is keyed by the SHA-256 of the compiler's identity and the input text, and
+// each artifact of that input (tokens, ast, diagnostics, ir, opt, asm) is a separate file,
+// DIR/<first two hex digits>/<key>.<artifact>, so a build that only wants assembly
+// neither reads nor writes the token dump. Files are written to a temporary name and
+// renamed into place, which makes the cache safe to share between threads and processes.
+//
+// The total size is capped. A hit refreshes the file's modification time, and when a store
+// pushes the directory over the cap the least recently used files are deleted until it is
+// back under 90% of it. compile-pool.js uses the same layout for the server's llc cache.
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+class ArtifactCache {
+public:
+    struct Stats {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t stores;
+        uint64_t evictions;
+        uint64_t bytes;  // on disk, as of the last scan plus our own stores
+    };
+
+    ArtifactCache(std::string dir, uint64_t maxBytes);
+
+    // False if the directory could not be created; every lookup then misses and stores
+    // are dropped.
+    bool usable() const { return ok; }
+
+    // Cache key for `input`: changes whenever the input or the compiler binary does.
+    static std::string keyFor(std::string_view input);
+
+    bool load(const std::string& key, const char* artifact, std::string& out);
+    void store(const std::string& key, const char* artifact, std::string_view data);
+
+    Stats stats() const;
+    std::string statsText() const;
+
+private:
+    std::string pathFor(const std::string& key, const char* artifact) const;
+    void evict();
+
+    std::string dir;
+    uint64_t maxBytes;
+    bool ok = false;
+
+    std::mutex sizeMutex;  // serializes eviction scans
+    std::atomic<uint64_t> totalBytes{0};
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+    std::atomic<uint64_t> stores{0};
+    std::atomic<uint64_t> evictions{0};
+    std::atomic<uint64_t> tempCounter{0};
+};
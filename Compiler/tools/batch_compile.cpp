@@ -0,0 +1,163 @@
+// Compiles a batch of Mini-C files in parallel.
+//
+//   npm run build:batch
+//   ./tools/batch_compile -j 16 --emit asm -o out/ gen/*.c
+//   ./tools/batch_compile --emit opt @filelist.txt > all.ll
+//
+// Without -o the outputs are written to stdout one after another, each preceded by a
+// "; ==> path" line. With -o each input gets DIR/<name>.ll or DIR/<name>.s. Diagnostics go
+// to stderr as "path: message". Output is identical for any -j; the exit status is 1 if any
+// file could not be read or had diagnostics.
+//
+// --cache DIR (or MINICC_CACHE=DIR) shares minicc's ArtifactCache: files whose output is
+// stored there are replayed instead of compiled, so an unchanged nightly rebuild only
+// hashes its inputs.
+#include "batch_driver.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Options {
+    unsigned jobs = 0;
+    BatchEmit emit = BatchEmit::OptimizedIR;
+    std::string outDir;
+    std::string cacheDir;
+    uint64_t cacheMegabytes = 512;
+    bool cacheStats = false;
+    std::vector<std::string> inputs;
+};
+
+[[noreturn]] void usage(const char* argv0) {
+    std::fprintf(stderr,
+                 "usage: %s [-j N] [--emit ir|opt|asm] [-o DIR] [--cache DIR] FILE... | @LIST\n"
+                 "  -j N        worker threads (default: hardware concurrency)\n"
+                 "  --emit      raw IR, optimized IR (default) or x86-64 assembly\n"
+                 "  -o DIR      write one output file per input instead of stdout\n"
+                 "  --cache DIR reuse outputs stored in DIR (default: $MINICC_CACHE)\n"
+                 "  --cache-size MB  cap on the cache directory (default 512)\n"
+                 "  --cache-stats    print cache hits and misses to stderr\n"
+                 "  @LIST       read input paths from LIST, one per line\n",
+                 argv0);
+    std::exit(2);
+}
+
+bool readList(const std::string& listPath, std::vector<std::string>& inputs) {
+    std::ifstream list(listPath);
+    if (!list) return false;
+    std::string line;
+    while (std::getline(list, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (!line.empty()) inputs.push_back(line);
+    }
+    return true;
+}
+
+Options parseArgs(int argc, char** argv) {
+    Options opts;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-j" && i + 1 < argc) {
+            opts.jobs = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg.rfind("-j", 0) == 0 && arg.size() > 2) {
+            opts.jobs = static_cast<unsigned>(std::strtoul(arg.c_str() + 2, nullptr, 10));
+        } else if (arg == "--emit" && i + 1 < argc) {
+            std::string kind = argv[++i];
+            if (kind == "ir") opts.emit = BatchEmit::IR;
+            else if (kind == "opt") opts.emit = BatchEmit::OptimizedIR;
+            else if (kind == "asm") opts.emit = BatchEmit::Assembly;
+            else usage(argv[0]);
+        } else if (arg == "-o" && i + 1 < argc) {
+            opts.outDir = argv[++i];
+        } else if (arg == "--cache" && i + 1 < argc) {
+            opts.cacheDir = argv[++i];
+        } else if (arg == "--cache-size" && i + 1 < argc) {
+            opts.cacheMegabytes = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--cache-stats") {
+            opts.cacheStats = true;
+        } else if (arg[0] == '@') {
+            if (!readList(arg.substr(1), opts.inputs)) {
+                std::fprintf(stderr, "cannot read file list %s\n", arg.c_str() + 1);
+                std::exit(2);
+            }
+        } else if (arg[0] == '-') {
+            usage(argv[0]);
+        } else {
+            opts.inputs.push_back(arg);
+        }
+    }
+    if (opts.inputs.empty()) usage(argv[0]);
+    if (opts.jobs == 0) opts.jobs = std::thread::hardware_concurrency();
+    if (opts.cacheDir.empty() && std::getenv("MINICC_CACHE")) opts.cacheDir = std::getenv("MINICC_CACHE");
+    return opts;
+}
+
+// DIR/<basename without extension>.ll or .s
+std::string outputPath(const Options& opts, const std::string& input) {
+    size_t slash = input.find_last_of('/');
+    std::string name = slash == std::string::npos ? input : input.substr(slash + 1);
+    size_t dot = name.find_last_of('.');
+    if (dot != std::string::npos && dot > 0) name.resize(dot);
+    std::string dir = opts.outDir;
+    if (!dir.empty() && dir.back() != '/') dir += '/';
+    return dir + name + (opts.emit == BatchEmit::Assembly ? ".s" : ".ll");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options opts = parseArgs(argc, argv);
+
+    std::vector<std::string> outputs;
+    if (!opts.outDir.empty()) {
+        std::set<std::string> seen;
+        for (const std::string& input : opts.inputs) {
+            outputs.push_back(outputPath(opts, input));
+            if (!seen.insert(outputs.back()).second) {
+                std::fprintf(stderr, "%s: output %s would be written twice\n", input.c_str(), outputs.back().c_str());
+                return 2;
+            }
+        }
+    }
+
+    std::unique_ptr<ArtifactCache> cache;
+    if (!opts.cacheDir.empty()) {
+        cache = std::make_unique<ArtifactCache>(opts.cacheDir, opts.cacheMegabytes << 20);
+        if (!cache->usable()) std::fprintf(stderr, "cache directory %s is not usable; compiling without it\n", opts.cacheDir.c_str());
+    }
+
+    bool failed = false;
+    WorkStealingPool pool(opts.jobs);
+    compileBatch(opts.inputs, opts.emit, pool, [&](size_t index, BatchResult& result) {
+        if (!result.readable) {
+            std::fprintf(stderr, "%s: cannot read file\n", result.path.c_str());
+            failed = true;
+            return;
+        }
+        for (const std::string& message : result.diagnostics) {
+            std::fprintf(stderr, "%s: %s\n", result.path.c_str(), message.c_str());
+            failed = true;
+        }
+        if (opts.outDir.empty()) {
+            std::printf("; ==> %s\n", result.path.c_str());
+            std::fwrite(result.output.data(), 1, result.output.size(), stdout);
+            return;
+        }
+        std::ofstream out(outputs[index], std::ios::binary);
+        out.write(result.output.data(), static_cast<std::streamsize>(result.output.size()));
+        if (!out) {
+            std::fprintf(stderr, "%s: cannot write %s\n", result.path.c_str(), outputs[index].c_str());
+            failed = true;
+        }
+    }, cache.get());
+    if (cache && opts.cacheStats) std::fprintf(stderr, "%s\n", cache->statsText().c_str());
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,238 @@
+#include "batch_driver.h"
+
+#include "../frontend/web_driver.h"
+
+#include <condition_variable>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+
+namespace {
+
+// What the task for one unit of Function nodes produced.
+struct FunctionOutput {
+    IRModule module;                    // the unit's functions, optimized unless emitting IR
+    std::string text;                   // printIR of `module`
+    std::vector<PassStats> stats;
+    std::vector<X86Function> machine;
+    bool lowered = false;               // false if a block lacks a terminator
+};
+
+// Everything one input file needs while its function tasks are running. Tokens and AST
+// nodes point into `source` and `arena`, so both stay alive until the last task is done.
+// A unit is one function, or the whole file when a function calls another, since the
+// inliner needs its callees optimized first.
+struct FileJob {
+    std::string source;
+    CompileContext context;
+    Arena arena;
+    std::vector<std::vector<ASTNode*>> units;
+    std::vector<FunctionOutput> outputs;
+    std::atomic<size_t> remaining{0};
+};
+
+// Collects finished files and releases them to the caller strictly in input order.
+class OrderedResults {
+public:
+    explicit OrderedResults(size_t count) : slots(count) {}
+
+    void publish(size_t index, BatchResult result) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            slots[index] = std::move(result);
+        }
+        ready.notify_one();
+    }
+
+    void drain(const std::function<void(size_t, BatchResult&)>& sink) {
+        for (size_t next = 0; next < slots.size(); ++next) {
+            BatchResult result;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                ready.wait(lock, [&] { return slots[next].has_value(); });
+                result = std::move(*slots[next]);
+                slots[next].reset();
+            }
+            sink(next, result);
+        }
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::vector<std::optional<BatchResult>> slots;
+};
+
+const char* artifactName(BatchEmit emit) {
+    switch (emit) {
+        case BatchEmit::IR:          return "ir";
+        case BatchEmit::OptimizedIR: return "opt";
+        case BatchEmit::Assembly:    return "asm";
+    }
+    return "ir";
+}
+
+// Diagnostics are cached as Compilation::diagnosticsText prints them, one per line.
+std::string joinDiagnostics(const std::vector<std::string>& diagnostics) {
+    std::string out;
+    for (const std::string& message : diagnostics) out += message + "\n";
+    return out;
+}
+
+std::vector<std::string> splitDiagnostics(const std::string& text) {
+    std::vector<std::string> out;
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = text.find('\n', start);
+        if (end == std::string::npos) end = text.size();
+        out.emplace_back(text, start, end - start);
+        start = end + 1;
+    }
+    return out;
+}
+
+// Whether anything under `node` calls a function other than `self`.
+bool callsOther(const ASTNode* node, std::string_view self) {
+    if (node->kind == NodeKind::Call && node->value != self) return true;
+    for (const ASTNode* child : *node) {
+        if (callsOther(child, self)) return true;
+    }
+    return false;
+}
+
+void compileUnit(FunctionOutput& out, const std::vector<ASTNode*>& functions, BatchEmit emit) {
+    for (ASTNode* function : functions) out.module.functions.push_back(buildFunctionIR(function));
+    if (emit != BatchEmit::IR) out.stats = optimizeModule(out.module);
+    if (emit != BatchEmit::Assembly) {
+        out.text = printIR(out.module);
+        return;
+    }
+    std::string error;
+    for (const IRFunction& fn : out.module.functions) {
+        if (!checkIRFunction(fn, error)) return;
+        out.machine.push_back(selectX86(fn));
+    }
+    out.lowered = true;
+}
+
+// Joins per-unit outputs into exactly what Compilation would print for the whole file.
+// printIR and the passes work one function at a time, so this is concatenation.
+std::string assembleOutput(FileJob& job, BatchEmit emit) {
+    if (emit == BatchEmit::IR) {
+        std::string ir;
+        for (const FunctionOutput& out : job.outputs) ir += out.text;
+        return ir;
+    }
+
+    if (emit == BatchEmit::Assembly) {
+        std::vector<X86Function> functions;
+        for (FunctionOutput& out : job.outputs) {
+            // A function without ret is rare; lowerToX86 reports it the same way Compilation does.
+            if (!out.lowered) return lowerToX86(out.module);
+            for (X86Function& fn : out.machine) functions.push_back(std::move(fn));
+        }
+        return printX86(functions);
+    }
+
+    // Every pass works one function at a time, so the module totals are per-function sums.
+    std::vector<PassStats> totals;
+    if (job.outputs.empty()) {
+        IRModule empty;
+        totals = optimizeModule(empty);
+    } else {
+        totals = job.outputs.front().stats;
+        for (size_t i = 1; i < job.outputs.size(); ++i) {
+            for (size_t p = 0; p < totals.size(); ++p) totals[p].count += job.outputs[i].stats[p].count;
+        }
+    }
+    std::string out = "; Optimized IR\n";
+    for (const PassStats& s : totals) {
+        out += "; " + std::string(s.pass) + ": " + std::to_string(s.count) + " " + s.unit + "\n";
+    }
+    for (const FunctionOutput& f : job.outputs) out += f.text;
+    return out;
+}
+
+}  // namespace
+
+void compileBatch(const std::vector<std::string>& paths, BatchEmit emit, WorkStealingPool& pool,
+                  const std::function<void(size_t index, BatchResult& result)>& sink,
+                  ArtifactCache* cache) {
+    OrderedResults results(paths.size());
+
+    for (size_t index = 0; index < paths.size(); ++index) {
+        pool.submit([&, index] {
+            BatchResult result;
+            result.path = paths[index];
+
+            std::ifstream in(result.path, std::ios::binary);
+            if (!in) {
+                results.publish(index, std::move(result));
+                return;
+            }
+            result.readable = true;
+            std::ostringstream buffer;
+            buffer << in.rdbuf();
+
+            auto job = std::make_shared<FileJob>();
+            job->source = buffer.str();
+
+            std::string key;
+            if (cache) {
+                key = ArtifactCache::keyFor(job->source);
+                std::string diagnostics;
+                if (cache->load(key, artifactName(emit), result.output) && cache->load(key, "diagnostics", diagnostics)) {
+                    result.diagnostics = splitDiagnostics(diagnostics);
+                    results.publish(index, std::move(result));
+                    return;
+                }
+            }
+            auto finish = [&results, cache, key, index, emit](BatchResult& done) {
+                if (cache) {
+                    cache->store(key, artifactName(emit), done.output);
+                    cache->store(key, "diagnostics", joinDiagnostics(done.diagnostics));
+                }
+                results.publish(index, std::move(done));
+            };
+
+            ASTNode* root = parseProgram(job->context, job->source, job->arena);
+            analyzeSemantics(job->context, root);
+            result.diagnostics = std::move(job->context.errors);
+
+            bool calls = false;
+            for (ASTNode* child : *root) {
+                if (child->kind != NodeKind::Function) continue;
+                job->units.push_back({child});
+                calls = calls || callsOther(child, child->value);
+            }
+            if (calls && emit != BatchEmit::IR) {
+                std::vector<ASTNode*> all;
+                for (const std::vector<ASTNode*>& unit : job->units) all.push_back(unit[0]);
+                job->units = {all};
+            }
+            if (job->units.empty()) {
+                result.output = assembleOutput(*job, emit);
+                finish(result);
+                return;
+            }
+
+            // The last unit task to finish stitches the file together and publishes it.
+            job->outputs.resize(job->units.size());
+            job->remaining = job->units.size();
+            auto pendingResult = std::make_shared<BatchResult>(std::move(result));
+            for (size_t f = 0; f < job->units.size(); ++f) {
+                pool.submit([finish, job, pendingResult, f, emit] {
+                    compileUnit(job->outputs[f], job->units[f], emit);
+                    if (job->remaining.fetch_sub(1) != 1) return;
+                    pendingResult->output = assembleOutput(*job, emit);
+                    finish(*pendingResult);
+                });
+            }
+        });
+    }
+
+    results.drain(sink);
+    pool.wait();
+}
@@ -0,0 +1,32 @@
+// Compiles many Mini-C files at once on a WorkStealingPool.
+//
+// Every file is read, parsed and analyzed as one task; that task then spawns one task per
+// function to generate, optimize and lower its IR, or a single task for all of them when
+// one calls another, so callees are optimized before they are inlined. Results are
+// stitched back together in function order and handed to the caller in input order, so the
+// output is byte-identical to compiling each file alone with Compilation regardless of
+// thread count. With a cache, a file whose output and diagnostics are already stored is
+// not compiled at all.
+#pragma once
+
+#include "artifact_cache.h"
+#include "work_stealing_pool.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+enum class BatchEmit { IR, OptimizedIR, Assembly };
+
+struct BatchResult {
+    std::string path;
+    bool readable = false;
+    std::vector<std::string> diagnostics;  // syntax and semantic errors, in Compilation order
+    std::string output;
+};
+
+// Calls `sink` on the calling thread once per path, in the order given, as soon as that
+// file and every file before it have finished.
+void compileBatch(const std::vector<std::string>& paths, BatchEmit emit, WorkStealingPool& pool,
+                  const std::function<void(size_t index, BatchResult& result)>& sink,
+                  ArtifactCache* cache = nullptr);
@@ -0,0 +1,446 @@
+// Native command-line front end for the compiler (frontend/web_driver.h and the ir/,
+// optimizer/, backend/, jit/ and vm/ it includes).
+//
+//   npm run build:minicc
+//   ./tools/minicc --asm prog.c > prog.s && gcc prog.s -o prog
+//   cat prog.c | ./tools/minicc --tokens --ir -
+//   ./tools/minicc --opt --asm prog.ll
+//   ./tools/minicc --mir -o prog.mir prog.c && ./tools/minicc --run prog.mir
+//   generate_huge_program | ./tools/minicc --stream --asm - > huge.s
+//
+// Each requested artifact is written and flushed as soon as its phase finishes, in
+// pipeline order (tokens, ast, ir, opt, asm, run, vm), so a reader on the other end of a pipe
+// sees the tokens before the program has been parsed. With more than one artifact or
+// more than one input, each section starts with a "; ==> input: artifact" line.
+//
+// Inputs ending in .ll are taken as IR and only accept --opt, --asm, --run and --vm; so
+// are inputs ending in .mir, the binary IR that --mir writes (serializeIR). With no
+// inputs, or "-", the source is read from stdin. Diagnostics go to stderr as
+// "input: message"; the exit status is 1 if any input had diagnostics or could not be read.
+//
+// --stream compiles one fixed-size chunk at a time with StreamingCompiler instead of
+// reading the whole input first, so memory stays bounded by the largest top-level item
+// however large the input is. It takes exactly one of --tokens, --ir or --asm.
+//
+// --cache DIR (or MINICC_CACHE=DIR) keeps every artifact of every source input in an
+// ArtifactCache, so recompiling an unchanged file replays its output and diagnostics
+// without running any phase. --cache-stats prints the hit and miss counts to stderr.
+//
+// --trace FILE writes the phases each source input ran, with their timings and counters,
+// as Chrome trace-event JSON (load it in chrome://tracing or Perfetto). Every input gets its
+// own track; phases answered from the cache do not appear.
+#include "../frontend/web_driver.h"
+#include "artifact_cache.h"
+
+#include <chrono>
+#include <memory>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+enum Artifact : unsigned {
+    Tokens = 1u << 0,
+    Ast = 1u << 1,
+    Ir = 1u << 2,
+    Opt = 1u << 3,
+    Asm = 1u << 4,
+    Run = 1u << 5,
+    Mir = 1u << 6,
+    Vm = 1u << 7,
+};
+
+struct Options {
+    unsigned artifacts = 0;
+    bool stream = false;
+    size_t chunkSize = 64 * 1024;
+    std::string cacheDir;
+    uint64_t cacheMegabytes = 512;
+    bool cacheStats = false;
+    std::string trace;
+    std::string output;
+    std::vector<std::string> inputs;
+};
+
+[[noreturn]] void usage(const char* argv0) {
+    std::fprintf(stderr,
+                 "usage: %s [--tokens] [--ast] [--ir] [--opt] [--asm] [--run] [--vm] [--mir] [-o FILE] [FILE...|-]\n"
+                 "  --tokens    token stream\n"
+                 "  --ast       syntax tree\n"
+                 "  --ir        LLVM IR as generated\n"
+                 "  --opt       optimized LLVM IR\n"
+                 "  --asm       x86-64 assembly (default)\n"
+                 "  --run       run the optimized IR (JIT-compiled on x86-64)\n"
+                 "  --vm        run the optimized IR in the bytecode VM\n"
+                 "  --mir       binary IR as generated\n"
+                 "  --stream    compile in bounded memory (one of --tokens, --ir, --asm)\n"
+                 "  --chunk N   bytes read per chunk with --stream (default 65536)\n"
+                 "  --cache DIR reuse artifacts stored in DIR (default: $MINICC_CACHE)\n"
+                 "  --cache-size MB  cap on the cache directory (default 512)\n"
+                 "  --cache-stats    print cache hits and misses to stderr\n"
+                 "  --trace FILE     write per-phase timings as Chrome trace JSON\n"
+                 "  -o FILE     write to FILE instead of stdout\n",
+                 argv0);
+    std::exit(2);
+}
+
+Options parseArgs(int argc, char** argv) {
+    static const struct {
+        const char* flag;
+        Artifact artifact;
+    } flags[] = {
+        {"--tokens", Tokens}, {"--ast", Ast}, {"--ir", Ir}, {"--opt", Opt}, {"--asm", Asm}, {"--run", Run},
+        {"--vm", Vm}, {"--mir", Mir},
+    };
+
+    Options opts;
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        bool matched = false;
+        for (const auto& f : flags) {
+            if (std::strcmp(arg, f.flag) == 0) {
+                opts.artifacts |= f.artifact;
+                matched = true;
+            }
+        }
+        if (matched) continue;
+        if (std::strcmp(arg, "-o") == 0 && i + 1 < argc) {
+            opts.output = argv[++i];
+        } else if (std::strcmp(arg, "--stream") == 0) {
+            opts.stream = true;
+        } else if (std::strcmp(arg, "--chunk") == 0 && i + 1 < argc) {
+            opts.chunkSize = std::strtoull(argv[++i], nullptr, 10);
+            if (opts.chunkSize == 0) usage(argv[0]);
+        } else if (std::strcmp(arg, "--cache") == 0 && i + 1 < argc) {
+            opts.cacheDir = argv[++i];
+        } else if (std::strcmp(arg, "--cache-size") == 0 && i + 1 < argc) {
+            opts.cacheMegabytes = std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(arg, "--cache-stats") == 0) {
+            opts.cacheStats = true;
+        } else if (std::strcmp(arg, "--trace") == 0 && i + 1 < argc) {
+            opts.trace = argv[++i];
+        } else if (arg[0] == '-' && arg[1] != '\0') {
+            usage(argv[0]);
+        } else {
+            opts.inputs.push_back(arg);
+        }
+    }
+    if (opts.artifacts == 0) opts.artifacts = Asm;
+    if (opts.inputs.empty()) opts.inputs.push_back("-");
+    if (opts.cacheDir.empty() && std::getenv("MINICC_CACHE")) opts.cacheDir = std::getenv("MINICC_CACHE");
+    if (opts.stream && opts.artifacts != Tokens && opts.artifacts != Ir && opts.artifacts != Asm) usage(argv[0]);
+    if (opts.stream && !opts.trace.empty()) usage(argv[0]);
+    return opts;
+}
+
+bool readInput(const std::string& path, std::string& text) {
+    FILE* in = path == "-" ? stdin : std::fopen(path.c_str(), "rb");
+    if (!in) return false;
+    char buffer[64 * 1024];
+    size_t n;
+    while ((n = std::fread(buffer, 1, sizeof buffer, in)) > 0) text.append(buffer, n);
+    bool ok = !std::ferror(in);
+    if (in != stdin) std::fclose(in);
+    return ok;
+}
+
+bool streamSource(const std::string& input, const Options& opts, FILE* out, bool headers) {
+    FILE* in = input == "-" ? stdin : std::fopen(input.c_str(), "rb");
+    if (!in) {
+        std::fprintf(stderr, "%s: cannot read file\n", input.c_str());
+        return false;
+    }
+    const char* name = input == "-" ? "<stdin>" : input.c_str();
+    StreamEmit emit = opts.artifacts == Tokens ? StreamEmit::Tokens : opts.artifacts == Ir ? StreamEmit::IR : StreamEmit::Assembly;
+    if (headers) std::fprintf(out, "; ==> %s: %s\n", name, opts.artifacts == Tokens ? "tokens" : opts.artifacts == Ir ? "ir" : "asm");
+
+    bool clean = true;
+    StreamingCompiler compiler(
+        emit, [&](std::string_view text) { std::fwrite(text.data(), 1, text.size(), out); },
+        [&](const std::string& message) {
+            std::fprintf(stderr, "%s: %s\n", name, message.c_str());
+            clean = false;
+        });
+    std::vector<char> chunk(opts.chunkSize);
+    size_t n;
+    while ((n = std::fread(chunk.data(), 1, chunk.size(), in)) > 0) {
+        compiler.feed(std::string_view(chunk.data(), n));
+        std::fflush(out);
+    }
+    bool readOk = !std::ferror(in);
+    if (in != stdin) std::fclose(in);
+    if (!readOk) {
+        std::fprintf(stderr, "%s: cannot read file\n", name);
+        return false;
+    }
+    compiler.finish();
+    std::fflush(out);
+    return clean;
+}
+
+bool hasExtension(const std::string& path, const char* extension) {
+    size_t n = std::strlen(extension);
+    return path.size() > n && path.compare(path.size() - n, n, extension) == 0;
+}
+
+// Writes one artifact and flushes, so each phase reaches the consumer as it completes.
+class SectionWriter {
+public:
+    SectionWriter(FILE* out, bool headers) : out(out), headers(headers) {}
+
+    void write(const std::string& input, const char* artifact, const std::string& text) {
+        if (headers) std::fprintf(out, "; ==> %s: %s\n", input == "-" ? "<stdin>" : input.c_str(), artifact);
+        std::fwrite(text.data(), 1, text.size(), out);
+        if (!text.empty() && text.back() != '\n') std::fputc('\n', out);
+        std::fflush(out);
+    }
+
+    // Binary artifacts are written as they are, without a trailing newline.
+    void writeBinary(const std::string& input, const char* artifact, const std::string& data) {
+        if (headers) std::fprintf(out, "; ==> %s: %s\n", input == "-" ? "<stdin>" : input.c_str(), artifact);
+        std::fwrite(data.data(), 1, data.size(), out);
+        std::fflush(out);
+    }
+
+private:
+    FILE* out;
+    bool headers;
+};
+
+// Collects "complete" trace events (ph "X") in Chrome's trace-event format, timestamped in
+// microseconds since the tool started.
+class TraceWriter {
+public:
+    double nowMs() const {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // `offsetMs` is when the Compilation that recorded `events` was created.
+    void add(const std::string& input, unsigned track, double offsetMs, const std::vector<PhaseEvent>& events) {
+        std::string name = escape(input == "-" ? "<stdin>" : input);
+        char buffer[160];
+        std::snprintf(buffer, sizeof buffer, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"", track);
+        append(std::string(buffer) + name + "\"}}");
+        for (const PhaseEvent& e : events) {
+            std::snprintf(buffer, sizeof buffer, "\",\"cat\":\"compile\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u,\"args\":{",
+                          (offsetMs + e.startMs) * 1000, e.ms * 1000, track);
+            std::string event = "{\"name\":\"" + escape(e.phase) + buffer;
+            for (size_t i = 0; i < e.counters.size(); ++i) {
+                if (i) event += ",";
+                event += "\"" + escape(e.counters[i].name) + "\":" + std::to_string(e.counters[i].value);
+            }
+            append(event + "}}");
+        }
+    }
+
+    bool write(const std::string& path) const {
+        FILE* out = std::fopen(path.c_str(), "wb");
+        if (!out) return false;
+        std::fprintf(out, "{\"traceEvents\":[\n%s\n]}\n", body.c_str());
+        return std::fclose(out) == 0;
+    }
+
+private:
+    static std::string escape(const std::string& text) {
+        std::string out;
+        for (char ch : text) {
+            unsigned char c = static_cast<unsigned char>(ch);
+            if (c == '"' || c == '\\') {
+                out += '\\';
+                out += ch;
+            } else if (c < 0x20) {
+                char hex[8];
+                std::snprintf(hex, sizeof hex, "\\u%04x", c);
+                out += hex;
+            } else {
+                out += ch;
+            }
+        }
+        return out;
+    }
+
+    void append(const std::string& event) {
+        if (!body.empty()) body += ",\n";
+        body += event;
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::string body;
+};
+
+// Artifacts of one source input, taken from the cache when it has them. The Compilation is
+// only created on the first miss, and then runs just the phases that miss needs.
+class SourceArtifacts {
+public:
+    SourceArtifacts(std::string text, ArtifactCache* cache, const TraceWriter* trace)
+        : text(std::move(text)), cache(cache), trace(trace), key(cache ? ArtifactCache::keyFor(this->text) : std::string()) {}
+
+    std::string get(const char* name) {
+        std::string value;
+        if (cache && cache->load(key, name, value)) return value;
+        Compilation& c = compilation();
+        if (std::strcmp(name, "tokens") == 0) value = c.tokenDump();
+        else if (std::strcmp(name, "ast") == 0) value = printASTTree(c.ast());
+        else if (std::strcmp(name, "diagnostics") == 0) value = c.diagnosticsText();
+        else if (std::strcmp(name, "ir") == 0) value = c.ir();
+        else if (std::strcmp(name, "mir") == 0) value = c.irBinary();
+        else if (std::strcmp(name, "opt") == 0) value = c.optimizedIR();
+        else if (std::strcmp(name, "asm") == 0) value = c.assembly();
+        else if (std::strcmp(name, "vm") == 0) value = formatVMResult(runBytecode(c.bytecode()), c.bytecode());
+        if (cache) cache->store(key, name, value);
+        return value;
+    }
+
+    void traceTo(TraceWriter& trace, const std::string& input, unsigned track) const {
+        if (session) trace.add(input, track, createdMs, session->phaseEvents());
+    }
+
+private:
+    Compilation& compilation() {
+        if (!session) {
+            createdMs = trace ? trace->nowMs() : 0;
+            session = std::make_unique<Compilation>(text);
+        }
+        return *session;
+    }
+
+    std::string text;
+    ArtifactCache* cache;
+    const TraceWriter* trace;
+    std::string key;
+    std::unique_ptr<Compilation> session;
+    double createdMs = 0;
+};
+
+bool compileSource(const std::string& input, std::string text, unsigned artifacts, SectionWriter& writer,
+                   ArtifactCache* cache, TraceWriter* trace, unsigned track) {
+    SourceArtifacts source(std::move(text), cache, trace);
+    if (artifacts & Tokens) writer.write(input, "tokens", source.get("tokens"));
+    if (artifacts & Ast) writer.write(input, "ast", source.get("ast"));
+
+    std::string diagnostics = source.get("diagnostics");
+    const char* name = input == "-" ? "<stdin>" : input.c_str();
+    size_t start = 0;
+    while (start < diagnostics.size()) {
+        size_t end = diagnostics.find('\n', start);
+        if (end == std::string::npos) end = diagnostics.size();
+        std::fprintf(stderr, "%s: %.*s\n", name, static_cast<int>(end - start), diagnostics.data() + start);
+        start = end + 1;
+    }
+
+    if (artifacts & Ir) writer.write(input, "ir", source.get("ir"));
+    if (artifacts & Mir) writer.writeBinary(input, "mir", source.get("mir"));
+    std::string optimized;
+    if (artifacts & (Opt | Run)) optimized = source.get("opt");
+    if (artifacts & Opt) writer.write(input, "opt", optimized);
+    if (artifacts & Asm) writer.write(input, "asm", source.get("asm"));
+    if (artifacts & Run) writer.write(input, "run", runCodegen(optimized));
+    if (artifacts & Vm) writer.write(input, "vm", source.get("vm"));
+    if (trace) source.traceTo(*trace, input, track);
+    return diagnostics.empty();
+}
+
+std::string runInVM(const std::string& ir) {
+    IRModule module;
+    std::string error;
+    if (!parseIR(ir, module, error)) return "Execution error: " + error + ".";
+    Bytecode program = compileBytecode(module);
+    return formatVMResult(runBytecode(program), program);
+}
+
+bool compileIR(const std::string& input, const std::string& ir, unsigned artifacts, SectionWriter& writer) {
+    if (artifacts & (Tokens | Ast | Ir | Mir)) {
+        std::fprintf(stderr, "%s: --tokens, --ast, --ir and --mir need Mini-C source, not IR\n", input.c_str());
+        return false;
+    }
+    std::string optimized;
+    if (artifacts & (Opt | Run)) optimized = optimizeIR(ir);
+    if (artifacts & Opt) writer.write(input, "opt", optimized);
+    if (artifacts & Asm) writer.write(input, "asm", compileToX86(ir));
+    if (artifacts & Run) writer.write(input, "run", runCodegen(optimized));
+    if (artifacts & Vm) writer.write(input, "vm", runInVM(optimized));
+    return true;
+}
+
+// Binary IR skips the parser: the module is used as deserializeIR rebuilds it.
+bool compileBinaryIR(const std::string& input, const std::string& data, unsigned artifacts, SectionWriter& writer) {
+    if (artifacts & (Tokens | Ast | Ir | Mir)) {
+        std::fprintf(stderr, "%s: --tokens, --ast, --ir and --mir need Mini-C source, not IR\n", input.c_str());
+        return false;
+    }
+    IRModule module;
+    std::string error;
+    if (!deserializeIR(data, module, error)) {
+        std::fprintf(stderr, "%s: %s\n", input.c_str(), error.c_str());
+        return false;
+    }
+    std::string optimized = optimizeIR(module);
+    if (artifacts & Opt) writer.write(input, "opt", optimized);
+    if (artifacts & Asm) writer.write(input, "asm", lowerToX86(module));
+    if (artifacts & Run) writer.write(input, "run", runCodegen(module));
+    if (artifacts & Vm) {
+        Bytecode program = compileBytecode(module);
+        writer.write(input, "vm", formatVMResult(runBytecode(program), program));
+    }
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options opts = parseArgs(argc, argv);
+
+    FILE* out = stdout;
+    if (!opts.output.empty()) {
+        out = std::fopen(opts.output.c_str(), "wb");
+        if (!out) {
+            std::fprintf(stderr, "cannot write %s\n", opts.output.c_str());
+            return 2;
+        }
+    }
+
+    bool single = (opts.artifacts & (opts.artifacts - 1)) == 0;
+    SectionWriter writer(out, !single || opts.inputs.size() > 1);
+
+    std::unique_ptr<ArtifactCache> cache;
+    if (!opts.cacheDir.empty()) {
+        cache = std::make_unique<ArtifactCache>(opts.cacheDir, opts.cacheMegabytes << 20);
+        if (!cache->usable()) std::fprintf(stderr, "cache directory %s is not usable; compiling without it\n", opts.cacheDir.c_str());
+    }
+
+    std::unique_ptr<TraceWriter> trace;
+    if (!opts.trace.empty()) trace = std::make_unique<TraceWriter>();
+
+    bool ok = true;
+    for (size_t index = 0; index < opts.inputs.size(); ++index) {
+        const std::string& input = opts.inputs[index];
+        if (opts.stream) {
+            ok = streamSource(input, opts, out, opts.inputs.size() > 1) && ok;
+            continue;
+        }
+        std::string text;
+        if (!readInput(input, text)) {
+            std::fprintf(stderr, "%s: cannot read file\n", input.c_str());
+            ok = false;
+            continue;
+        }
+        if (hasExtension(input, ".ll")) ok = compileIR(input, text, opts.artifacts, writer) && ok;
+        else if (hasExtension(input, ".mir")) ok = compileBinaryIR(input, text, opts.artifacts, writer) && ok;
+        else ok = compileSource(input, std::move(text), opts.artifacts, writer, cache.get(), trace.get(), index + 1) && ok;
+    }
+    if (cache && opts.cacheStats) std::fprintf(stderr, "%s\n", cache->statsText().c_str());
+    if (trace && !trace->write(opts.trace)) {
+        std::fprintf(stderr, "cannot write %s\n", opts.trace.c_str());
+        return 2;
+    }
+
+    if (out != stdout && std::fclose(out) != 0) {
+        std::fprintf(stderr, "cannot write %s\n", opts.output.c_str());
+        return 2;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,73 @@
+// Fuzz target for the front end: lexing, parsing, semantic analysis, the AST dump and IR
+// generation, which must all cope with any input. After the full compile the middle third
+// of the input is deleted with applyEdit, and the incremental result has to report the
+// same diagnostics as compiling the edited text from scratch.
+//
+// Built with libFuzzer it generates inputs on its own, starting from bench/parse_corpus;
+// built without it, it replays the files it is given, so a crash the fuzzer saved can be
+// debugged with any compiler.
+//
+//   npm run build:fuzz && ./tools/parse_fuzz -max_len=65536 -timeout=5 bench/parse_corpus
+//   npm run build:fuzz-replay && ./tools/parse_fuzz_replay crash-*
+#include "../frontend/web_driver.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+namespace {
+
+void compileEverything(Compilation& c) {
+    c.tokens();
+    c.diagnostics();
+    c.astDump();
+    c.ir();
+}
+
+void fuzzOne(const uint8_t* data, size_t size) {
+    std::string source(reinterpret_cast<const char*>(data), size);
+    Compilation c(source);
+    compileEverything(c);
+
+    size_t third = size / 3;
+    if (!c.applyEdit(third, third, {})) std::abort();
+    compileEverything(c);
+    Compilation fresh(source.erase(third, third));
+    if (c.diagnostics() != fresh.diagnostics()) {
+        std::fprintf(stderr, "incremental and full diagnostics differ\n");
+        std::abort();
+    }
+}
+
+}  // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    fuzzOne(data, size);
+    return 0;
+}
+
+#ifndef MINICC_LIBFUZZER
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::fprintf(stderr, "usage: %s FILE...\n", argv[0]);
+        return 2;
+    }
+    for (int i = 1; i < argc; ++i) {
+        std::ifstream in(argv[i], std::ios::binary);
+        if (!in) {
+            std::fprintf(stderr, "cannot read %s\n", argv[i]);
+            return 2;
+        }
+        std::ostringstream buf;
+        buf << in.rdbuf();
+        std::string input = buf.str();
+        fuzzOne(reinterpret_cast<const uint8_t*>(input.data()), input.size());
+        std::printf("%s: ok\n", argv[i]);
+    }
+    return 0;
+}
+#endif
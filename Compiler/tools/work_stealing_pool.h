@@ -0,0 +1,134 @@
+// Fixed-size thread pool with one task deque per worker.
+//
+// A worker pushes the tasks it spawns onto the back of its own deque and pops from the
+// back, so a file's function tasks tend to run on the thread that parsed it while the AST
+// is still in cache. Tasks submitted from outside the pool go to a shared FIFO queue that
+// workers take from when their own deque is empty, so top-level jobs start in submission
+// order. A worker with nothing else to do steals from the front of another worker's
+// deque, taking the oldest (usually largest) piece of outstanding work.
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkStealingPool {
+public:
+    using Task = std::function<void()>;
+
+    explicit WorkStealingPool(unsigned threads) {
+        if (threads == 0) threads = 1;
+        for (unsigned i = 0; i < threads; ++i) queues.push_back(std::make_unique<Queue>());
+        for (unsigned i = 0; i < threads; ++i) workers.emplace_back([this, i] { workerLoop(i); });
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    ~WorkStealingPool() {
+        wait();
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers) worker.join();
+    }
+
+    unsigned size() const { return static_cast<unsigned>(workers.size()); }
+
+    void submit(Task task) {
+        pending.fetch_add(1);
+        queued.fetch_add(1);
+        Queue& target = currentPool == this ? *queues[currentWorker] : injector;
+        {
+            std::lock_guard<std::mutex> lock(target.mutex);
+            target.tasks.push_back(std::move(task));
+        }
+        // Taking the sleep mutex orders this push before any worker's next predicate check.
+        { std::lock_guard<std::mutex> lock(sleepMutex); }
+        wake.notify_one();
+    }
+
+    // Blocks until every submitted task, including tasks submitted by tasks, has finished.
+    // Must not be called from a worker.
+    void wait() {
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        idle.wait(lock, [this] { return pending.load() == 0; });
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    bool popLocal(size_t self, Task& task) {
+        Queue& q = *queues[self];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (q.tasks.empty()) return false;
+        task = std::move(q.tasks.back());
+        q.tasks.pop_back();
+        return true;
+    }
+
+    bool popInjected(Task& task) {
+        std::lock_guard<std::mutex> lock(injector.mutex);
+        if (injector.tasks.empty()) return false;
+        task = std::move(injector.tasks.front());
+        injector.tasks.pop_front();
+        return true;
+    }
+
+    bool steal(size_t self, Task& task) {
+        for (size_t i = 1; i < queues.size(); ++i) {
+            Queue& q = *queues[(self + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if (q.tasks.empty()) continue;
+            task = std::move(q.tasks.front());
+            q.tasks.pop_front();
+            return true;
+        }
+        return false;
+    }
+
+    void workerLoop(size_t self) {
+        currentPool = this;
+        currentWorker = self;
+        for (;;) {
+            Task task;
+            if (popLocal(self, task) || popInjected(task) || steal(self, task)) {
+                queued.fetch_sub(1);
+                task();
+                task = nullptr;
+                if (pending.fetch_sub(1) == 1) {
+                    std::lock_guard<std::mutex> lock(sleepMutex);
+                    idle.notify_all();
+                }
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wake.wait(lock, [this] { return stopping || queued.load() > 0; });
+            if (stopping && queued.load() == 0) return;
+        }
+    }
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    Queue injector;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> pending{0};  // submitted and not yet finished
+    std::atomic<size_t> queued{0};   // submitted and not yet started
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    bool stopping = false;
+
+    static inline thread_local WorkStealingPool* currentPool = nullptr;
+    static inline thread_local size_t currentWorker = 0;
+};
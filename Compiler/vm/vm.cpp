@@ -0,0 +1,606 @@
+#include "vm.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// -------------------- Bytecode VM --------------------
+namespace {
+int32_t bitsOf(float f) {
+    int32_t bits;
+    std::memcpy(&bits, &f, sizeof bits);
+    return bits;
+}
+
+float floatOf(int32_t bits) {
+    float f;
+    std::memcpy(&f, &bits, sizeof f);
+    return f;
+}
+
+bool producesValue(IROp op) { return op != IROp::Store && op != IROp::Br && op != IROp::CondBr && op != IROp::Ret; }
+
+// Slots a value of `inst` takes: one per lane, and one for a pointer or an i1.
+uint32_t resultLanes(const IRInst& inst) {
+    if (inst.op == IROp::Alloca || inst.op == IROp::GEP || inst.op == IROp::Bitcast) return 1;
+    return laneCount(inst.type);
+}
+
+// Calls `f(value, lanes)` on every operand `inst` reads, including the incoming values of
+// a phi, which are read on the branches into its block.
+template <typename F>
+void forEachRead(const IRInst& inst, F f) {
+    uint32_t lanes = laneCount(inst.type);
+    switch (inst.op) {
+        case IROp::Alloca:
+        case IROp::Br:            return;
+        case IROp::Store:         f(inst.a, lanes); f(inst.b, 1); return;
+        case IROp::Ret:           if (inst.type != IRType::Void) f(inst.a, 1); return;
+        case IROp::Phi:           for (const IRIncoming& in : inst.incoming) f(in.value, lanes); return;
+        case IROp::Call:          for (const IRArgument& arg : inst.args) f(arg.value, 1); return;
+        case IROp::InsertElement: f(inst.b, 1); return;
+        case IROp::ShuffleVector: f(inst.a, lanes); return;
+        case IROp::ReduceAdd:     f(inst.a, 4); return;
+        case IROp::ICmp:
+        case IROp::FCmp:
+        case IROp::GEP:           f(inst.a, 1); f(inst.b, 1); return;
+        case IROp::Load:
+        case IROp::ZExt:
+        case IROp::CondBr:
+        case IROp::Bitcast:       f(inst.a, 1); return;
+        default:                  f(inst.a, lanes); f(inst.b, lanes); return;  // binary ops
+    }
+}
+}  // namespace
+
+// Lowers one function into the program. Slots are laid out in two sweeps, values first
+// and then the constants the operands name, before any code is written; jumps name
+// blocks until every block has its place and are patched at the end.
+struct BytecodeCompiler {
+    Bytecode& out;
+    const std::unordered_map<std::string_view, uint32_t>& functionIndex;
+    const IRFunction& fn;
+    uint32_t index;
+    std::vector<uint32_t> slotOf;  // by instruction; UINT32_MAX for one without a value
+    std::map<std::pair<int32_t, uint32_t>, uint32_t> constantSlot;  // (bits, lanes) -> slot
+    std::vector<char> phiSlot;     // slots some phi is written to
+    uint32_t staging = 0;          // where the copies of an edge go when they overlap
+    std::vector<uint32_t> blockStart;
+    std::vector<size_t> jumps;     // instructions whose imm is still a block index
+    std::string error;
+
+    BytecodeCompiler(Bytecode& out, const std::unordered_map<std::string_view, uint32_t>& functionIndex,
+                     const IRFunction& fn, uint32_t index)
+        : out(out), functionIndex(functionIndex), fn(fn), index(index) {}
+
+    BytecodeFunction& info() { return out.functions[index]; }
+
+    bool fail(std::string message) {
+        error = "@" + fn.name + ": " + std::move(message);
+        return false;
+    }
+
+    uint32_t slot(const IRValue& v, uint32_t lanes) {
+        if (v.kind == IRValue::Kind::Inst) return slotOf[v.inst];
+        if (v.kind == IRValue::Kind::Arg) return v.inst;
+        int32_t bits = v.kind == IRValue::Kind::Int ? v.i : v.kind == IRValue::Kind::Float ? bitsOf(v.f) : 0;
+        return constantSlot.at({bits, lanes});
+    }
+
+    bool layOut() {
+        uint32_t params = static_cast<uint32_t>(fn.params.size());
+        std::vector<uint32_t> offset(fn.insts.size(), UINT32_MAX);
+        uint32_t values = 0, phiLanes = 0;
+        for (const IRBlock& block : fn.blocks) {
+            uint32_t lanesHere = 0;
+            for (uint32_t id : block.insts) {
+                const IRInst& inst = fn.insts[id];
+                if (inst.dead) continue;
+                if (inst.op == IROp::Phi) lanesHere += laneCount(inst.type);
+                if (!producesValue(inst.op)) continue;
+                offset[id] = values;
+                values += resultLanes(inst);
+            }
+            phiLanes = std::max(phiLanes, lanesHere);
+        }
+
+        std::vector<std::pair<int32_t, uint32_t>> constants;
+        bool ok = true;
+        for (const IRBlock& block : fn.blocks) {
+            for (uint32_t id : block.insts) {
+                if (fn.insts[id].dead) continue;
+                forEachRead(fn.insts[id], [&](const IRValue& v, uint32_t lanes) {
+                    if (v.kind == IRValue::Kind::Inst) {
+                        ok = ok && v.inst < fn.insts.size() && offset[v.inst] != UINT32_MAX;
+                    } else if (v.kind == IRValue::Kind::Arg) {
+                        ok = ok && v.inst < params;
+                    } else {
+                        int32_t bits = v.kind == IRValue::Kind::Int ? v.i : v.kind == IRValue::Kind::Float ? bitsOf(v.f) : 0;
+                        if (constantSlot.emplace(std::make_pair(bits, lanes), 0).second) constants.push_back({bits, lanes});
+                    }
+                });
+            }
+        }
+        if (!ok) return fail("an operand names no value of the function");
+
+        BytecodeFunction& f = info();
+        f.params = params;
+        f.constBegin = static_cast<uint32_t>(out.constants.size());
+        uint32_t next = params;
+        for (const auto& [bits, lanes] : constants) {
+            constantSlot[{bits, lanes}] = next;
+            next += lanes;
+            out.constants.insert(out.constants.end(), lanes, bits);
+        }
+        f.constCount = next - params;
+        slotOf.assign(fn.insts.size(), UINT32_MAX);
+        for (size_t id = 0; id < fn.insts.size(); ++id) {
+            if (offset[id] != UINT32_MAX) slotOf[id] = next + offset[id];
+        }
+        staging = next + values;
+        // Vector operands read whole lanes from wherever they point, so a frame has room
+        // for a vector past its last slot.
+        f.slots = staging + phiLanes + 8;
+        phiSlot.assign(f.slots, 0);
+        for (const IRBlock& block : fn.blocks) {
+            for (uint32_t id : block.insts) {
+                if (fn.insts[id].dead) continue;
+                if (fn.insts[id].op != IROp::Phi) break;
+                for (uint32_t k = 0; k < laneCount(fn.insts[id].type); ++k) phiSlot[slotOf[id] + k] = 1;
+            }
+        }
+        return true;
+    }
+
+    void emit(Op op, uint32_t d, uint32_t a = 0, uint32_t b = 0, int32_t imm = 0, uint32_t n = 1) {
+        Instr inst;
+        inst.op = op;
+        inst.n = static_cast<uint8_t>(n);
+        inst.d = d;
+        inst.a = a;
+        inst.b = b;
+        inst.imm = imm;
+        out.code.push_back(inst);
+    }
+
+    void jump(Op op, uint32_t block, uint32_t condition = 0) {
+        jumps.push_back(out.code.size());
+        emit(op, 0, condition, 0, static_cast<int32_t>(block));
+    }
+
+    // The phi copies of the edge `from` -> `to`. They happen at once: when a phi of `to`
+    // is read by another one, every value is first copied aside.
+    std::vector<Instr> edgeCopies(uint32_t from, uint32_t to) {
+        std::vector<Instr> copies;
+        bool overlap = false;
+        for (uint32_t id : fn.blocks[to].insts) {
+            const IRInst& phi = fn.insts[id];
+            if (phi.dead) continue;
+            if (phi.op != IROp::Phi) break;
+            uint32_t lanes = laneCount(phi.type);
+            uint32_t src = slot(incomingFrom(phi, from), lanes);
+            if (src == slotOf[id]) continue;
+            for (uint32_t k = 0; k < lanes; ++k) overlap = overlap || phiSlot[src + k];
+            Instr copy;
+            copy.op = Op::Move;
+            copy.n = static_cast<uint8_t>(lanes);
+            copy.d = slotOf[id];
+            copy.a = src;
+            copies.push_back(copy);
+        }
+        if (overlap && copies.size() > 1) {
+            std::vector<Instr> staged;
+            uint32_t at = staging;
+            for (Instr& copy : copies) {
+                Instr aside = copy;
+                aside.d = at;
+                staged.push_back(aside);
+                copy.a = at;
+                at += copy.n;
+            }
+            staged.insert(staged.end(), copies.begin(), copies.end());
+            return staged;
+        }
+        return copies;
+    }
+
+    // Branches along `from` -> `to`, unless `to` is laid out next and there is nothing
+    // to copy.
+    void edge(uint32_t from, uint32_t to, uint32_t next) {
+        std::vector<Instr> copies = edgeCopies(from, to);
+        out.code.insert(out.code.end(), copies.begin(), copies.end());
+        if (to != next) jump(Op::Jump, to);
+    }
+
+    bool instruction(uint32_t block, uint32_t id, uint32_t next) {
+        const IRInst& inst = fn.insts[id];
+        uint32_t d = slotOf[id], lanes = laneCount(inst.type);
+        bool vector = isVectorType(inst.type);
+        switch (inst.op) {
+            case IROp::Alloca: {
+                uint32_t count = inst.b.kind == IRValue::Kind::Int ? static_cast<uint32_t>(inst.b.i) : 1;
+                emit(Op::Addr, d, 0, 0, static_cast<int32_t>(info().cells));
+                info().cells += count;
+                return true;
+            }
+            case IROp::Load:
+                emit(Op::Load, d, slot(inst.a, 1), 0, 0, lanes);
+                return true;
+            case IROp::Store:
+                emit(Op::Store, 0, slot(inst.b, 1), slot(inst.a, lanes), 0, lanes);
+                return true;
+            case IROp::Add:
+            case IROp::Sub:
+            case IROp::Mul:
+            case IROp::SDiv: {
+                static const Op scalar[] = {Op::Add, Op::Sub, Op::Mul, Op::Div};
+                static const Op lanewise[] = {Op::VAdd, Op::VSub, Op::VMul};
+                size_t k = static_cast<size_t>(inst.op) - static_cast<size_t>(IROp::Add);
+                if (vector && inst.op == IROp::SDiv) return fail("sdiv on a vector");
+                emit(vector ? lanewise[k] : scalar[k], d, slot(inst.a, lanes), slot(inst.b, lanes), 0, lanes);
+                if (inst.type == IRType::I8) emit(Op::Sext8, d);
+                if (inst.type == IRType::I1) emit(Op::Trunc1, d);
+                return true;
+            }
+            case IROp::FAdd:
+            case IROp::FSub:
+            case IROp::FMul:
+            case IROp::FDiv: {
+                static const Op scalar[] = {Op::FAdd, Op::FSub, Op::FMul, Op::FDiv};
+                static const Op lanewise[] = {Op::VFAdd, Op::VFSub, Op::VFMul, Op::VFDiv};
+                size_t k = static_cast<size_t>(inst.op) - static_cast<size_t>(IROp::FAdd);
+                emit(vector ? lanewise[k] : scalar[k], d, slot(inst.a, lanes), slot(inst.b, lanes), 0, lanes);
+                return true;
+            }
+            case IROp::ICmp:
+            case IROp::FCmp: {
+                // IRPred lists the integer predicates and then the float ones in the order of Op.
+                Op op = static_cast<Op>(static_cast<uint8_t>(Op::Eq) + static_cast<uint8_t>(inst.pred));
+                emit(op, d, slot(inst.a, 1), slot(inst.b, 1));
+                return true;
+            }
+            case IROp::ZExt:
+            case IROp::Bitcast:
+                emit(Op::Move, d, slot(inst.a, 1));
+                return true;
+            case IROp::Phi:
+                return true;
+            case IROp::Br:
+                edge(block, inst.target[0], next);
+                return true;
+            case IROp::CondBr: {
+                uint32_t condition = slot(inst.a, 1), onTrue = inst.target[0], onFalse = inst.target[1];
+                std::vector<Instr> trueCopies = edgeCopies(block, onTrue), falseCopies = edgeCopies(block, onFalse);
+                if (trueCopies.empty() && falseCopies.empty()) {
+                    if (onTrue == next) {
+                        jump(Op::JumpIfNot, onFalse, condition);
+                    } else {
+                        jump(Op::JumpIf, onTrue, condition);
+                        if (onFalse != next) jump(Op::Jump, onFalse);
+                    }
+                    return true;
+                }
+                // The true edge falls through to its copies; the false edge skips them.
+                size_t skip = out.code.size();
+                emit(Op::JumpIfNot, 0, condition);
+                out.code.insert(out.code.end(), trueCopies.begin(), trueCopies.end());
+                jump(Op::Jump, onTrue);
+                out.code[skip].imm = static_cast<int32_t>(out.code.size());
+                edge(block, onFalse, next);
+                return true;
+            }
+            case IROp::Ret:
+                if (inst.type == IRType::Void) emit(Op::RetVoid, 0);
+                else emit(Op::Ret, 0, slot(inst.a, 1));
+                return true;
+            case IROp::GEP: {
+                const IRInst* array = inst.a.kind == IRValue::Kind::Inst ? &fn.insts[inst.a.inst] : nullptr;
+                if (!array || array->op != IROp::Alloca || array->b.kind != IRValue::Kind::Int) {
+                    return fail("getelementptr on something other than an array alloca");
+                }
+                emit(Op::Index, d, slot(inst.a, 1), slot(inst.b, 1), array->b.i);
+                return true;
+            }
+            case IROp::InsertElement:
+                emit(Op::Splat, d, slot(inst.b, 1), 0, 0, lanes);
+                return true;
+            case IROp::ShuffleVector:
+                emit(Op::Splat, d, slot(inst.a, lanes), 0, 0, lanes);
+                return true;
+            case IROp::ReduceAdd:
+                emit(Op::Reduce, d, slot(inst.a, 4), 0, 0, 4);
+                return true;
+            case IROp::Call: {
+                auto callee = functionIndex.find(inst.name);
+                if (callee == functionIndex.end()) return fail("call to undefined function @" + inst.name);
+                uint32_t args = static_cast<uint32_t>(out.args.size());
+                for (const IRArgument& arg : inst.args) out.args.push_back(slot(arg.value, 1));
+                emit(Op::Call, d, 0, args, static_cast<int32_t>(callee->second), static_cast<uint32_t>(inst.args.size()));
+                return true;
+            }
+        }
+        return fail("unsupported instruction");
+    }
+
+    bool compile() {
+        std::string problem;
+        if (!checkIRFunction(fn, problem)) return fail(problem);
+        if (!layOut()) return false;
+        info().entry = static_cast<uint32_t>(out.code.size());
+        blockStart.assign(fn.blocks.size(), 0);
+        for (uint32_t b = 0; b < fn.blocks.size(); ++b) {
+            if (fn.blocks[b].insts.empty()) continue;
+            uint32_t next = b + 1;
+            while (next < fn.blocks.size() && fn.blocks[next].insts.empty()) ++next;
+            blockStart[b] = static_cast<uint32_t>(out.code.size());
+            for (uint32_t id : fn.blocks[b].insts) {
+                if (!fn.insts[id].dead && !instruction(b, id, next)) return false;
+            }
+        }
+        for (size_t at : jumps) out.code[at].imm = static_cast<int32_t>(blockStart[out.code[at].imm]);
+        return true;
+    }
+};
+
+Bytecode compileBytecode(const IRModule& module) {
+    Bytecode program;
+    std::unordered_map<std::string_view, uint32_t> functionIndex;
+    for (const IRFunction& fn : module.functions) {
+        functionIndex.emplace(fn.name, static_cast<uint32_t>(program.functions.size()));
+        program.functions.push_back({});
+        program.functions.back().name = fn.name;
+    }
+    auto main = functionIndex.find("main");
+    if (main == functionIndex.end()) {
+        program.error = "no @main to run";
+        return program;
+    }
+    const IRFunction& entry = module.functions[main->second];
+    if (entry.returnType != IRType::I32 || !entry.params.empty()) {
+        program.error = "@main is not `i32 ()`";
+        return program;
+    }
+    if (!checkIRCalls(module, program.error)) return program;
+    program.main = main->second;
+    for (uint32_t k = 0; k < module.functions.size(); ++k) {
+        BytecodeCompiler compiler(program, functionIndex, module.functions[k], k);
+        if (!compiler.compile()) {
+            Bytecode failed;
+            failed.error = std::move(compiler.error);
+            return failed;
+        }
+    }
+    return program;
+}
+
+VMResult runBytecode(const Bytecode& program) {
+    VMResult result;
+    if (program.code.empty()) {
+        result.error = program.error.empty() ? "no bytecode to run" : program.error;
+        return result;
+    }
+    auto started = std::chrono::steady_clock::now();
+
+    struct Frame {
+        const Instr* ip;  // the call
+        uint32_t base, memBase, function;
+    };
+    std::vector<Frame> frames;
+    std::vector<int32_t> registers, memory;
+    auto grow = [](std::vector<int32_t>& cells, size_t need) {
+        if (need > kMaxVMStackCells) return false;
+        if (need > cells.size()) cells.resize(std::min<size_t>(std::max(need, cells.size() * 2), kMaxVMStackCells));
+        return true;
+    };
+
+    const Instr* const code = program.code.data();
+    const BytecodeFunction* fn = &program.functions[program.main];
+    uint32_t function = program.main, base = 0, memBase = 0;
+    if (!grow(registers, fn->slots) || !grow(memory, fn->cells)) {
+        result.error = "@main needs more than the VM's stack";
+        return result;
+    }
+    std::copy_n(program.constants.begin() + fn->constBegin, fn->constCount, registers.begin() + fn->params);
+    int32_t* r = registers.data();
+    int32_t* mem = memory.data();
+    const Instr* ip = code + fn->entry;
+
+    // Integer arithmetic wraps like the hardware does instead of relying on signed overflow.
+    auto wrap = [](uint32_t v) { return static_cast<int32_t>(v); };
+    auto divide = [&](int32_t l, int32_t d) { return d == 0 ? 0 : d == -1 ? wrap(0u - uint32_t(l)) : l / d; };
+    // Whether n cells at the pointer in slot `a` belong to the current frame.
+    auto inFrame = [&](uint32_t a, uint32_t n) {
+        uint32_t at = static_cast<uint32_t>(r[a]) - memBase;
+        return at < fn->cells && fn->cells - at >= n;
+    };
+
+#if defined(__GNUC__) || defined(__clang__)
+    // Direct threading: every handler jumps straight to the next one.
+    static const void* const labels[] = {
+        &&op_Move,  &&op_Addr,  &&op_Index, &&op_Load,  &&op_Store, &&op_Add,   &&op_Sub,    &&op_Mul,
+        &&op_Div,   &&op_Sext8, &&op_Trunc1, &&op_FAdd, &&op_FSub,  &&op_FMul,  &&op_FDiv,   &&op_VAdd,
+        &&op_VSub,  &&op_VMul,  &&op_VFAdd, &&op_VFSub, &&op_VFMul, &&op_VFDiv, &&op_Splat,  &&op_Reduce,
+        &&op_Eq,    &&op_Ne,    &&op_Lt,    &&op_Le,    &&op_Gt,    &&op_Ge,    &&op_FEq,    &&op_FNe,
+        &&op_FLt,   &&op_FLe,   &&op_FGt,   &&op_FGe,   &&op_Jump,  &&op_JumpIf, &&op_JumpIfNot, &&op_Call,
+        &&op_Ret,   &&op_RetVoid};
+    static_assert(sizeof labels / sizeof *labels == static_cast<size_t>(Op::RetVoid) + 1, "a handler per op");
+#define VM_CASE(name) op_##name:
+#define VM_NEXT() goto *labels[static_cast<uint8_t>((++ip)->op)]
+#define VM_JUMP(target) do { ip = code + (target); goto *labels[static_cast<uint8_t>(ip->op)]; } while (0)
+    goto *labels[static_cast<uint8_t>(ip->op)];
+#else
+#define VM_CASE(name) case Op::name:
+#define VM_NEXT() ++ip; continue
+#define VM_JUMP(target) ip = code + (target); continue
+    for (;;) switch (ip->op) {
+#endif
+        VM_CASE(Move) {
+            for (uint32_t k = 0; k < ip->n; ++k) r[ip->d + k] = r[ip->a + k];
+            VM_NEXT();
+        }
+        VM_CASE(Addr) { r[ip->d] = static_cast<int32_t>(memBase + ip->imm); VM_NEXT(); }
+        VM_CASE(Index) {
+            int32_t index = r[ip->b];
+            if (index < 0 || index >= ip->imm) {
+                result.error = "@" + fn->name + ": index " + std::to_string(index) + " is outside an array of " +
+                               std::to_string(ip->imm);
+                goto done;
+            }
+            r[ip->d] = r[ip->a] + index;
+            VM_NEXT();
+        }
+        VM_CASE(Load) {
+            if (!inFrame(ip->a, ip->n)) goto badAccess;
+            for (uint32_t k = 0; k < ip->n; ++k) r[ip->d + k] = mem[r[ip->a] + k];
+            VM_NEXT();
+        }
+        VM_CASE(Store) {
+            if (!inFrame(ip->a, ip->n)) goto badAccess;
+            for (uint32_t k = 0; k < ip->n; ++k) mem[r[ip->a] + k] = r[ip->b + k];
+            VM_NEXT();
+        }
+        VM_CASE(Add) { r[ip->d] = wrap(uint32_t(r[ip->a]) + uint32_t(r[ip->b])); VM_NEXT(); }
+        VM_CASE(Sub) { r[ip->d] = wrap(uint32_t(r[ip->a]) - uint32_t(r[ip->b])); VM_NEXT(); }
+        VM_CASE(Mul) { r[ip->d] = wrap(uint32_t(r[ip->a]) * uint32_t(r[ip->b])); VM_NEXT(); }
+        VM_CASE(Div) { r[ip->d] = divide(r[ip->a], r[ip->b]); VM_NEXT(); }
+        VM_CASE(Sext8) { r[ip->d] = static_cast<int8_t>(static_cast<uint8_t>(r[ip->d])); VM_NEXT(); }
+        VM_CASE(Trunc1) { r[ip->d] &= 1; VM_NEXT(); }
+        VM_CASE(FAdd) { r[ip->d] = bitsOf(floatOf(r[ip->a]) + floatOf(r[ip->b])); VM_NEXT(); }
+        VM_CASE(FSub) { r[ip->d] = bitsOf(floatOf(r[ip->a]) - floatOf(r[ip->b])); VM_NEXT(); }
+        VM_CASE(FMul) { r[ip->d] = bitsOf(floatOf(r[ip->a]) * floatOf(r[ip->b])); VM_NEXT(); }
+        VM_CASE(FDiv) { r[ip->d] = bitsOf(floatOf(r[ip->a]) / floatOf(r[ip->b])); VM_NEXT(); }
+        VM_CASE(VAdd) {
+            for (uint32_t k = 0; k < ip->n; ++k) r[ip->d + k] = wrap(uint32_t(r[ip->a + k]) + uint32_t(r[ip->b + k]));
+            VM_NEXT();
+        }
+        VM_CASE(VSub) {
+            for (uint32_t k = 0; k < ip->n; ++k) r[ip->d + k] = wrap(uint32_t(r[ip->a + k]) - uint32_t(r[ip->b + k]));
+            VM_NEXT();
+        }
+        VM_CASE(VMul) {
+            for (uint32_t k = 0; k < ip->n; ++k) r[ip->d + k] = wrap(uint32_t(r[ip->a + k]) * uint32_t(r[ip->b + k]));
+            VM_NEXT();
+        }
+        VM_CASE(VFAdd) {
+            for (uint32_t k = 0; k < ip->n; ++k) r[ip->d + k] = bitsOf(floatOf(r[ip->a + k]) + floatOf(r[ip->b + k]));
+            VM_NEXT();
+        }
+        VM_CASE(VFSub) {
+            for (uint32_t k = 0; k < ip->n; ++k) r[ip->d + k] = bitsOf(floatOf(r[ip->a + k]) - floatOf(r[ip->b + k]));
+            VM_NEXT();
+        }
+        VM_CASE(VFMul) {
+            for (uint32_t k = 0; k < ip->n; ++k) r[ip->d + k] = bitsOf(floatOf(r[ip->a + k]) * floatOf(r[ip->b + k]));
+            VM_NEXT();
+        }
+        VM_CASE(VFDiv) {
+            for (uint32_t k = 0; k < ip->n; ++k) r[ip->d + k] = bitsOf(floatOf(r[ip->a + k]) / floatOf(r[ip->b + k]));
+            VM_NEXT();
+        }
+        VM_CASE(Splat) {
+            int32_t lane = r[ip->a];
+            for (uint32_t k = 0; k < ip->n; ++k) r[ip->d + k] = lane;
+            VM_NEXT();
+        }
+        VM_CASE(Reduce) {
+            uint32_t sum = 0;
+            for (uint32_t k = 0; k < ip->n; ++k) sum += uint32_t(r[ip->a + k]);
+            r[ip->d] = wrap(sum);
+            VM_NEXT();
+        }
+        VM_CASE(Eq) { r[ip->d] = r[ip->a] == r[ip->b]; VM_NEXT(); }
+        VM_CASE(Ne) { r[ip->d] = r[ip->a] != r[ip->b]; VM_NEXT(); }
+        VM_CASE(Lt) { r[ip->d] = r[ip->a] < r[ip->b]; VM_NEXT(); }
+        VM_CASE(Le) { r[ip->d] = r[ip->a] <= r[ip->b]; VM_NEXT(); }
+        VM_CASE(Gt) { r[ip->d] = r[ip->a] > r[ip->b]; VM_NEXT(); }
+        VM_CASE(Ge) { r[ip->d] = r[ip->a] >= r[ip->b]; VM_NEXT(); }
+        VM_CASE(FEq) { r[ip->d] = floatOf(r[ip->a]) == floatOf(r[ip->b]); VM_NEXT(); }
+        VM_CASE(FNe) { r[ip->d] = !(floatOf(r[ip->a]) == floatOf(r[ip->b])); VM_NEXT(); }
+        VM_CASE(FLt) { r[ip->d] = floatOf(r[ip->a]) < floatOf(r[ip->b]); VM_NEXT(); }
+        VM_CASE(FLe) { r[ip->d] = floatOf(r[ip->a]) <= floatOf(r[ip->b]); VM_NEXT(); }
+        VM_CASE(FGt) { r[ip->d] = floatOf(r[ip->a]) > floatOf(r[ip->b]); VM_NEXT(); }
+        VM_CASE(FGe) { r[ip->d] = floatOf(r[ip->a]) >= floatOf(r[ip->b]); VM_NEXT(); }
+        VM_CASE(Jump) { VM_JUMP(ip->imm); }
+        VM_CASE(JumpIf) {
+            if (r[ip->a]) VM_JUMP(ip->imm);
+            VM_NEXT();
+        }
+        VM_CASE(JumpIfNot) {
+            if (!r[ip->a]) VM_JUMP(ip->imm);
+            VM_NEXT();
+        }
+        VM_CASE(Call) {
+            const BytecodeFunction& callee = program.functions[ip->imm];
+            uint32_t calleeBase = base + fn->slots, calleeMem = memBase + fn->cells;
+            if (frames.size() == kMaxVMCallDepth || !grow(registers, size_t{calleeBase} + callee.slots) ||
+                !grow(memory, size_t{calleeMem} + callee.cells)) {
+                result.error = "the program ran out of stack, most likely in deep recursion";
+                goto done;
+            }
+            mem = memory.data();
+            int32_t* frame = registers.data() + calleeBase;
+            r = registers.data() + base;
+            const uint32_t* args = program.args.data() + ip->b;
+            for (uint32_t k = 0; k < ip->n; ++k) frame[k] = r[args[k]];
+            std::copy_n(program.constants.begin() + callee.constBegin, callee.constCount, frame + callee.params);
+            frames.push_back({ip, base, memBase, function});
+            function = static_cast<uint32_t>(ip->imm);
+            fn = &callee;
+            base = calleeBase;
+            memBase = calleeMem;
+            r = frame;
+            VM_JUMP(callee.entry);
+        }
+        VM_CASE(Ret) {
+            int32_t value = r[ip->a];
+            if (frames.empty()) {
+                result.ok = true;
+                result.value = value;
+                goto done;
+            }
+            const Frame& caller = frames.back();
+            ip = caller.ip;
+            base = caller.base;
+            memBase = caller.memBase;
+            function = caller.function;
+            frames.pop_back();
+            fn = &program.functions[function];
+            r = registers.data() + base;
+            r[ip->d] = value;
+            VM_NEXT();
+        }
+        VM_CASE(RetVoid) {
+            // Calls always want a value, so only a function no one calls gets here.
+            result.error = "@" + fn->name + " returned no value";
+            goto done;
+        }
+#if !(defined(__GNUC__) || defined(__clang__))
+    }
+#endif
+#undef VM_CASE
+#undef VM_NEXT
+#undef VM_JUMP
+
+badAccess:
+    result.error = "@" + fn->name + ": memory access outside its frame";
+done:
+    result.runMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    return result;
+}
+
+VMResult execute(const IRModule& module) {
+    return runBytecode(compileBytecode(module));
+}
+
+std::string formatVMResult(const VMResult& run, const Bytecode& program) {
+    if (!run.ok) return "Execution error: " + run.error + ".";
+    char timing[96];
+    std::snprintf(timing, sizeof timing, "\nExecution time: %.4f ms (VM, %zu instructions)", run.runMs, program.code.size());
+    return "Execution result: " + std::to_string(run.value) + timing;
+}
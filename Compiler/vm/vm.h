@@ -0,0 +1,109 @@
+// Runs optimized modules in a register-based bytecode interpreter, for builds without the
+// JIT (WebAssembly) and to check the JIT's results against.
+#pragma once
+
+#include "../ir/ir.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// -------------------- Bytecode VM --------------------
+// Each function runs in a frame of 32-bit slots: its parameters, then the constants it
+// uses (copied in on every call), then one slot per lane of every value it computes. Floats
+// are kept as their bits and i8 values sign-extended, as in the x86 backend. Allocas are
+// cells of a separate memory stack, addressed by index, so a pointer is an int as well;
+// loads and stores are checked against the frame's cells and array indices against the
+// array's length, and a bad one stops the program with an error instead of reading
+// another frame. Phi operands are copied on the branches into their block.
+enum class Op : uint8_t {
+    Move,     // d = a, n slots
+    Addr,     // d = the frame's first cell + imm (an alloca)
+    Index,    // d = a + b; error unless 0 <= b < imm (getelementptr)
+    Load,     // d = memory[a], n lanes
+    Store,    // memory[a] = b, n lanes
+    Add,      // the integer ops wrap; Sext8 and Trunc1 follow them on i8 and i1
+    Sub,
+    Mul,
+    Div,      // division by zero yields 0 and x / -1 wraps, as in the JIT
+    Sext8,    // d = d sign-extended from its low byte
+    Trunc1,   // d = d & 1
+    FAdd,
+    FSub,
+    FMul,
+    FDiv,
+    VAdd,     // lane-wise over n i32 lanes
+    VSub,
+    VMul,
+    VFAdd,    // lane-wise over n float lanes
+    VFSub,
+    VFMul,
+    VFDiv,
+    Splat,    // every one of n lanes of d = a
+    Reduce,   // d = the sum of the n i32 lanes of a
+    Eq,       // d = a `pred` b, as 0 or 1, on ints
+    Ne,
+    Lt,
+    Le,
+    Gt,
+    Ge,
+    FEq,      // on floats; FNe is true when either is NaN, the others false
+    FNe,
+    FLt,
+    FLe,
+    FGt,
+    FGe,
+    Jump,     // to imm
+    JumpIf,   // to imm if a is not 0
+    JumpIfNot,
+    Call,     // d = functions[imm](the n slots listed at args[b])
+    Ret,      // returns a
+    RetVoid
+};
+
+struct Instr {
+    Op op;
+    uint8_t n = 1;  // lanes, or arguments of a call
+    uint32_t d = 0, a = 0, b = 0;
+    int32_t imm = 0;
+};
+
+struct BytecodeFunction {
+    std::string name;
+    uint32_t entry = 0;       // index of its first instruction
+    uint32_t params = 0;
+    uint32_t constBegin = 0;  // its constants are constants[constBegin, + constCount)
+    uint32_t constCount = 0;
+    uint32_t slots = 0;       // frame size
+    uint32_t cells = 0;       // memory its allocas take
+};
+
+struct Bytecode {
+    std::vector<Instr> code;
+    std::vector<BytecodeFunction> functions;
+    std::vector<int32_t> constants;
+    std::vector<uint32_t> args;  // argument slots of every call
+    uint32_t main = 0;           // index of @main in functions
+    std::string error;           // why the module could not be compiled; then code is empty
+};
+
+struct VMResult {
+    bool ok = false;
+    int32_t value = 0;  // what @main returned
+    double runMs = 0;
+    std::string error;
+};
+
+// Call depth and the slots and cells all frames together may take.
+constexpr uint32_t kMaxVMCallDepth = 1 << 20;
+constexpr uint32_t kMaxVMStackCells = 1 << 24;
+
+// Compiles an optimized module, which has to pass checkIRFunction and checkIRCalls and
+// have an `i32 @main()`, as runJIT requires.
+Bytecode compileBytecode(const IRModule& module);
+// Calls @main. Running out of the stack limits above is an error, not a crash.
+VMResult runBytecode(const Bytecode& program);
+// compileBytecode and runBytecode in one.
+VMResult execute(const IRModule& module);
+// "Execution result: N" and the time, or "Execution error: ...", worded as runCodegen's.
+std::string formatVMResult(const VMResult& run, const Bytecode& program);